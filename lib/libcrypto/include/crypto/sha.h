@@ -85,5 +85,22 @@ namespace crypto
 
 		void Sha1(const uint8_t* in, uint64_t size, uint8_t hash[kSha1HashLen]);
 		void Sha256(const uint8_t* in, uint64_t size, uint8_t hash[kSha256HashLen]);
+
+		// incremental SHA-256 for data that is not available in one contiguous buffer
+		class Sha256Calculator
+		{
+		public:
+			Sha256Calculator();
+			~Sha256Calculator();
+
+			void initialise();
+			void update(const uint8_t* in, uint64_t size);
+			void finalise(uint8_t hash[kSha256HashLen]);
+		private:
+			Sha256Calculator(const Sha256Calculator&);
+			void operator=(const Sha256Calculator&);
+
+			void* mCtx;
+		};
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <crypto/rsa.h>
 #include <polarssl/rsa.h>
 #include <polarssl/md.h>
+#include <random>
 
 using namespace crypto::rsa;
 using namespace crypto::sha;
@@ -165,6 +166,35 @@ int crypto::rsa::pkcs::rsaVerify(const sRsa4096Key & key, HashType hash_type, co
 	return ret;
 }
 
+int getRandomBytes(void* p_rng, unsigned char* output, size_t output_len)
+{
+	std::random_device* rng = (std::random_device*)p_rng;
+	for (size_t i = 0; i < output_len; i++)
+	{
+		output[i] = (unsigned char)(*rng)();
+	}
+	return 0;
+}
+
+int crypto::rsa::pss::rsaSign(const sRsa2048Key & key, HashType hash_type, const uint8_t * hash, uint8_t signature[kRsa2048Size])
+{
+	int ret;
+	rsa_context ctx;
+	rsa_init(&ctx, RSA_PKCS_V21, getMdWrappedHashType(hash_type));
+
+	ctx.len = kRsa2048Size;
+	mpi_read_binary(&ctx.D, key.priv_exponent, ctx.len);
+	mpi_read_binary(&ctx.N, key.modulus, ctx.len);
+
+	// the salt is random
+	std::random_device rng;
+	ret = rsa_rsassa_pss_sign(&ctx, getRandomBytes, &rng, RSA_PRIVATE, getWrappedHashType(hash_type), getWrappedHashSize(hash_type), hash, signature);
+
+	rsa_free(&ctx);
+
+	return ret;
+}
+
 int crypto::rsa::pss::rsaVerify(const sRsa2048Key & key, HashType hash_type, const uint8_t * hash, const uint8_t signature[kRsa2048Size])
 {
 	static const uint8_t public_exponent[3] = { 0x01, 0x00, 0x01 };
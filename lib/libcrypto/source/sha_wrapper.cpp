@@ -12,4 +12,30 @@ void crypto::sha::Sha1(const uint8_t* in, uint64_t size, uint8_t hash[kSha1HashL
 void crypto::sha::Sha256(const uint8_t* in, uint64_t size, uint8_t hash[kSha256HashLen])
 {
 	sha2(in, size, hash, false);
+}
+
+crypto::sha::Sha256Calculator::Sha256Calculator() :
+	mCtx(new sha2_context)
+{
+	initialise();
+}
+
+crypto::sha::Sha256Calculator::~Sha256Calculator()
+{
+	delete (sha2_context*)mCtx;
+}
+
+void crypto::sha::Sha256Calculator::initialise()
+{
+	sha2_starts((sha2_context*)mCtx, false);
+}
+
+void crypto::sha::Sha256Calculator::update(const uint8_t* in, uint64_t size)
+{
+	sha2_update((sha2_context*)mCtx, in, size);
+}
+
+void crypto::sha::Sha256Calculator::finalise(uint8_t hash[kSha256HashLen])
+{
+	sha2_finish((sha2_context*)mCtx, hash);
 }
\ No newline at end of file
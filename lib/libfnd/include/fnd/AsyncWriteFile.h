@@ -0,0 +1,89 @@
+#pragma once
+#include <fnd/IFile.h>
+#include <fnd/Vec.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef _WIN32
+#include <fnd/SimpleFile.h>
+#endif
+
+namespace fnd
+{
+	// Output file written behind the caller by a background thread. write() copies into
+	// a large buffer, full buffers are queued to the writer thread and the caller only
+	// waits when the queue is full. The thread is started by the first full buffer, a file
+	// that fits in one buffer is written by flush()/close() directly. On Linux, written ranges are pushed to disk and dropped
+	// from the page cache as the writer moves on, so dirty pages stay bounded by the queue.
+	// Write errors are reported by the next write(), flush() or close().
+	class AsyncWriteFile : public IFile
+	{
+	public:
+		static const size_t kDefaultBufferSize = 0x400000;
+		static const size_t kDefaultQueueDepth = 4;
+
+		AsyncWriteFile();
+		AsyncWriteFile(const std::string& path, size_t buffer_size = kDefaultBufferSize, size_t queue_depth = kDefaultQueueDepth);
+		~AsyncWriteFile();
+
+		// creates (or truncates) the file, buffer_size and queue_depth bound the memory held by queued writes
+		void open(const std::string& path, size_t buffer_size = kDefaultBufferSize, size_t queue_depth = kDefaultQueueDepth);
+		bool isOpen() const;
+		// waits until everything written so far is in the file, throws if a write failed
+		void flush();
+		void close();
+
+		size_t size();
+		void seek(size_t offset);
+		void read(byte_t* out, size_t len);
+		void read(byte_t* out, size_t offset, size_t len);
+		void write(const byte_t* out, size_t len);
+		void write(const byte_t* out, size_t offset, size_t len);
+
+	private:
+		const std::string kModuleName = "AsyncWriteFile";
+
+		struct sBuffer
+		{
+			fnd::Vec<byte_t> data;
+			size_t size;
+			size_t offset;
+		};
+
+		bool mOpen;
+		size_t mBufferSize;
+		size_t mQueueDepth;
+		size_t mPos;
+		size_t mSize;
+
+		// only touched by the caller
+		std::unique_ptr<sBuffer> mCurrent;
+
+		// shared with the writer thread
+		std::mutex mLock;
+		std::condition_variable mWorkCond;
+		std::condition_variable mDoneCond;
+		std::deque<std::unique_ptr<sBuffer>> mQueue;
+		std::vector<std::unique_ptr<sBuffer>> mFreeBuffers;
+		size_t mPendingNum;
+		bool mStop;
+		std::string mError;
+		std::thread mThread;
+
+#ifdef _WIN32
+		fnd::SimpleFile mFile;
+#else
+		int mFd;
+		size_t mWrittenEnd;
+#endif
+
+		void submitCurrent(bool final);
+		void checkError();
+		void writerMain();
+		void writeBuffer(const sBuffer& buffer);
+	};
+}
\ No newline at end of file
@@ -3,9 +3,25 @@
 
 namespace fnd
 {
+	class SimpleFile;
+
 	class IFile
 	{
 	public:
+		enum AccessHint
+		{
+			ACCESS_NORMAL,
+			ACCESS_SEQUENTIAL,
+			ACCESS_RANDOM
+		};
+
+		struct sReadRange
+		{
+			byte_t* out;
+			size_t offset;
+			size_t len;
+		};
+
 		inline virtual ~IFile() {}
 
 		virtual size_t size() = 0;
@@ -14,5 +30,24 @@ namespace fnd
 		virtual void read(byte_t* out, size_t offset, size_t len) = 0;
 		virtual void write(const byte_t* out, size_t len) = 0;
 		virtual void write(const byte_t* out, size_t offset, size_t len) = 0;
+
+		// If reads are passed through to a SimpleFile unchanged, returns that file and
+		// adds the offset this file starts at to 'offset'. Returns nullptr otherwise.
+		inline virtual SimpleFile* getPlainFile(size_t& offset) { return nullptr; }
+
+		// How the file is about to be read. Wrappers pass it down to the file they read from,
+		// base files may use it to tune read-ahead.
+		inline virtual void setAccessHint(AccessHint hint) {}
+
+		// A range that is about to be read. Base files may start loading it in the background.
+		inline virtual void prefetch(size_t offset, size_t len) {}
+
+		// Reads several ranges, as if by read() in order. Wrappers pass the whole list down,
+		// base files that can merge adjacent ranges or keep reads in flight together override it.
+		inline virtual void readv(const sReadRange* ranges, size_t num)
+		{
+			for (size_t i = 0; i < num; i++)
+				read(ranges[i].out, ranges[i].offset, ranges[i].len);
+		}
 	};
 }
@@ -33,6 +33,17 @@ namespace fnd
 		void read(byte_t* out, size_t offset, size_t len);
 		void write(const byte_t* out, size_t len);
 		void write(const byte_t* out, size_t offset, size_t len);
+		SimpleFile* getPlainFile(size_t& offset);
+		void setAccessHint(AccessHint hint);
+		void prefetch(size_t offset, size_t len);
+		// ranges that follow on in the file are read with one preadv
+		void readv(const sReadRange* ranges, size_t num);
+
+		// Copies len bytes at src_offset of src to the current position without passing
+		// them through user space, where supported (copy_file_range, which shares extents
+		// on CoW file systems, then sendfile). Returns the number of bytes copied, the
+		// remainder must be copied through a buffer.
+		size_t copyFrom(SimpleFile& src, size_t src_offset, size_t len);
 	
 	private:
 		const std::string kModuleName = "SimpleFile";
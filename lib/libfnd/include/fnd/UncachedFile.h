@@ -0,0 +1,72 @@
+#pragma once
+#include <fnd/IFile.h>
+#include <string>
+#ifdef _WIN32
+#include <fnd/SimpleFile.h>
+#endif
+
+namespace fnd
+{
+	// Read-only file that keeps its data out of the page cache, for large one-pass scans.
+	//  - DirectIo opens the file with O_DIRECT (F_NOCACHE on macOS). Reads that are already
+	//    aligned go straight into the caller's buffer, others are rounded out to the alignment
+	//    in a bounce buffer, which also serves small reads within the last block range read.
+	//    Files on file systems that reject O_DIRECT fall back to DropCache.
+	//  - DropCache reads normally and drops each range from the page cache once read.
+	// On Windows reads are cached normally.
+	class UncachedFile : public IFile
+	{
+	public:
+		enum Mode
+		{
+			DirectIo,
+			DropCache
+		};
+
+		UncachedFile();
+		UncachedFile(const std::string& path, Mode mode);
+		~UncachedFile();
+
+		void open(const std::string& path, Mode mode);
+		bool isOpen() const;
+		void close();
+		// the mode in effect, DirectIo may have fallen back to DropCache
+		Mode getMode() const;
+
+		size_t size();
+		void seek(size_t offset);
+		void read(byte_t* out, size_t len);
+		void read(byte_t* out, size_t offset, size_t len);
+		void write(const byte_t* out, size_t len);
+		void write(const byte_t* out, size_t offset, size_t len);
+
+	private:
+		const std::string kModuleName = "UncachedFile";
+		// NCA data is sector (0x200) aligned, devices that need more reject the read and it is retried
+		static const size_t kMinAlignment = 0x200;
+		static const size_t kMaxAlignment = 0x1000;
+		static const size_t kBounceSize = 0x100000;
+
+		bool mOpen;
+		Mode mMode;
+		size_t mPos;
+
+#ifdef _WIN32
+		fnd::SimpleFile mFile;
+#else
+		int mFd;
+		std::string mPath;
+
+		// aligned bounce buffer, holding [mBounceOffset, mBounceOffset + mBounceLen) of the file
+		byte_t* mBounce;
+		size_t mBounceOffset;
+		size_t mBounceLen;
+		size_t mAlignment;
+
+		void readDirect(byte_t* out, size_t offset, size_t len);
+		// false if the read was rejected as misaligned
+		bool preadDirect(byte_t* out, size_t offset, size_t len, size_t& done);
+		void fallBackToDropCache();
+#endif
+	};
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+#include <fnd/IFile.h>
+#include <fnd/List.h>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <fnd/SimpleFile.h>
+#endif
+
+namespace fnd
+{
+	// Read-only file that can keep many positional reads in flight. On Linux the reads go
+	// through an io_uring (set up with raw syscalls, so no liburing is needed); where io_uring
+	// isn't available (kernels before 5.6, sandboxes that block it, other platforms) every read
+	// is a plain pread and the batch API completes requests as it submits them.
+	// Large read() calls are split into chunks that are all submitted at once.
+	// Not thread safe, share it between threads through a lock (like SimpleFile).
+	class UringFile : public IFile
+	{
+	public:
+		static const size_t kDefaultQueueDepth = 64;
+
+		struct sReadRequest
+		{
+			byte_t* out;
+			size_t offset;
+			size_t len;
+			// index of the registered buffer holding out, or -1
+			int buffer_index;
+			// set on completion: bytes read (short at the end of the file)
+			size_t result;
+		};
+
+		UringFile();
+		UringFile(const std::string& path, size_t queue_depth = kDefaultQueueDepth);
+		~UringFile();
+
+		void open(const std::string& path, size_t queue_depth = kDefaultQueueDepth);
+		bool isOpen() const;
+		void close();
+		// false when reads fall back to pread
+		bool isUringActive() const;
+
+		// registers buffers with the kernel, so reads into them (buffer_index >= 0) don't map the pages each time
+		void registerBuffers(const fnd::List<std::pair<byte_t*, size_t>>& buffers);
+
+		// queues reads and returns how many were taken, limited by the free queue slots
+		size_t submit(sReadRequest* requests, size_t num);
+		// waits for at least min_complete submitted reads and returns up to max completed ones
+		size_t reap(sReadRequest** completed, size_t max, size_t min_complete);
+		// submits all the requests and waits for all of them
+		void readBatch(sReadRequest* requests, size_t num);
+
+		size_t size();
+		void seek(size_t offset);
+		void read(byte_t* out, size_t len);
+		void read(byte_t* out, size_t offset, size_t len);
+		void write(const byte_t* out, size_t len);
+		void write(const byte_t* out, size_t offset, size_t len);
+		// all the ranges are in flight at once
+		void readv(const sReadRange* ranges, size_t num);
+		void prefetch(size_t offset, size_t len);
+
+	private:
+		const std::string kModuleName = "UringFile";
+		static const size_t kReadChunkSize = 0x40000;
+
+		bool mOpen;
+		size_t mPos;
+		size_t mQueueDepth;
+		size_t mInFlightNum;
+		// requests completed by the pread fallback, waiting to be reaped
+		std::vector<sReadRequest*> mCompleted;
+
+#ifdef _WIN32
+		fnd::SimpleFile mFile;
+#else
+		int mFd;
+
+		// io_uring state, mRingFd is -1 when not active
+		int mRingFd;
+		void* mSqRing;
+		size_t mSqRingSize;
+		void* mCqRing;
+		size_t mCqRingSize;
+		void* mSqes;
+		size_t mSqesSize;
+		unsigned* mSqHead;
+		unsigned* mSqTail;
+		unsigned* mSqMask;
+		unsigned* mSqArray;
+		unsigned* mCqHead;
+		unsigned* mCqTail;
+		unsigned* mCqMask;
+		void* mCqes;
+		bool mBuffersRegistered;
+
+		bool setupRing(size_t queue_depth);
+		void teardownRing();
+#endif
+		void readDirect(sReadRequest& request);
+		// waits for every submitted read, so none is left writing through a request the caller may free
+		void drain();
+	};
+}
\ No newline at end of file
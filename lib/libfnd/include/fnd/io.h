@@ -1,8 +1,14 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <functional>
+#include <fnd/types.h>
+#include <fnd/List.h>
 
 namespace fnd
 {
+	class SimpleFile;
+
 	namespace io
 	{
 #ifdef _WIN32
@@ -15,5 +21,18 @@ namespace fnd
 		void makeDirectory(const std::string& path);
 		void getEnvironVar(std::string& var, const std::string& key);
 		void appendToPath(std::string& base, const std::string& add);
+		bool isDirectory(const std::string& path);
+		bool fileExists(const std::string& path);
+		uint64_t getFileModifiedTime(const std::string& path);
+		void getDirectoryListing(const std::string& path, fnd::List<std::string>& dirs, fnd::List<std::string>& files);
+		// the lines of a text file, trimmed, without empty lines and '#' comments
+		void getLineList(const std::string& path, std::vector<std::string>& lines);
+		// write is given a temporary file that is renamed over path once write returns, so a reader
+		// never sees a partial file and a failed write (the temporary file is removed) leaves path as it was
+		void replaceFile(const std::string& path, const std::function<void(fnd::SimpleFile& file)>& write);
+		void replaceFile(const std::string& path, const byte_t* data, size_t size);
+		// both return false if the file system doesn't support it (or the paths are on different volumes)
+		bool createHardLink(const std::string& target, const std::string& link_path);
+		bool cloneFile(const std::string& src, const std::string& dst);
 	}
 }
@@ -0,0 +1,324 @@
+#include <fnd/AsyncWriteFile.h>
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+using namespace fnd;
+
+AsyncWriteFile::AsyncWriteFile() :
+	mOpen(false),
+	mBufferSize(kDefaultBufferSize),
+	mQueueDepth(kDefaultQueueDepth),
+	mPos(0),
+	mSize(0),
+	mPendingNum(0),
+	mStop(false)
+#ifndef _WIN32
+	, mFd(-1),
+	mWrittenEnd(0)
+#endif
+{
+}
+
+AsyncWriteFile::AsyncWriteFile(const std::string& path, size_t buffer_size, size_t queue_depth) :
+	AsyncWriteFile()
+{
+	open(path, buffer_size, queue_depth);
+}
+
+AsyncWriteFile::~AsyncWriteFile()
+{
+	try
+	{
+		close();
+	}
+	catch (const fnd::Exception&)
+	{
+		// errors are only reported to callers that close() explicitly
+	}
+}
+
+void AsyncWriteFile::open(const std::string& path, size_t buffer_size, size_t queue_depth)
+{
+	close();
+
+#ifdef _WIN32
+	mFile.open(path, fnd::SimpleFile::Create);
+#else
+	mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (mFd < 0)
+	{
+		throw fnd::Exception(kModuleName, "Failed to open file.");
+	}
+	mWrittenEnd = 0;
+#endif
+
+	mBufferSize = buffer_size > 0 ? buffer_size : kDefaultBufferSize;
+	mQueueDepth = queue_depth > 0 ? queue_depth : 1;
+	mPos = 0;
+	mSize = 0;
+	mPendingNum = 0;
+	mStop = false;
+	mError.clear();
+	mOpen = true;
+}
+
+bool AsyncWriteFile::isOpen() const
+{
+	return mOpen;
+}
+
+void AsyncWriteFile::flush()
+{
+	if (mOpen == false)
+		return;
+
+	submitCurrent(true);
+
+	std::unique_lock<std::mutex> lock(mLock);
+	mDoneCond.wait(lock, [this] { return mPendingNum == 0; });
+	lock.unlock();
+
+	checkError();
+}
+
+void AsyncWriteFile::close()
+{
+	if (mOpen == false)
+		return;
+
+	// the file is closed even if the last writes failed, the error is thrown after
+	std::string error;
+	try
+	{
+		flush();
+	}
+	catch (const fnd::Exception& e)
+	{
+		error = e.error();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mStop = true;
+	}
+	mWorkCond.notify_all();
+	if (mThread.joinable())
+		mThread.join();
+
+#ifdef _WIN32
+	mFile.close();
+#else
+	if (::close(mFd) != 0 && error.empty())
+		error = std::string("Failed to close file (") + strerror(errno) + ")";
+	mFd = -1;
+#endif
+
+	mQueue.clear();
+	mFreeBuffers.clear();
+	mCurrent.reset();
+	mOpen = false;
+
+	if (error.empty() == false)
+		throw fnd::Exception(kModuleName, error);
+}
+
+size_t AsyncWriteFile::size()
+{
+	return mSize;
+}
+
+void AsyncWriteFile::seek(size_t offset)
+{
+	// a buffer holds one contiguous range
+	if (offset != mPos)
+		submitCurrent(false);
+	mPos = offset;
+}
+
+void AsyncWriteFile::read(byte_t* out, size_t len)
+{
+	throw fnd::Exception(kModuleName, "read() not supported");
+}
+
+void AsyncWriteFile::read(byte_t* out, size_t offset, size_t len)
+{
+	throw fnd::Exception(kModuleName, "read() not supported");
+}
+
+void AsyncWriteFile::write(const byte_t* out, size_t len)
+{
+	if (mOpen == false)
+	{
+		throw fnd::Exception(kModuleName, "File is not open.");
+	}
+
+	checkError();
+
+	while (len > 0)
+	{
+		if (mCurrent == nullptr)
+		{
+			std::unique_lock<std::mutex> lock(mLock);
+			if (mFreeBuffers.empty() == false)
+			{
+				mCurrent = std::move(mFreeBuffers.back());
+				mFreeBuffers.pop_back();
+			}
+			lock.unlock();
+
+			if (mCurrent == nullptr)
+			{
+				mCurrent.reset(new sBuffer);
+				mCurrent->data.alloc(mBufferSize);
+			}
+			mCurrent->size = 0;
+			mCurrent->offset = mPos;
+		}
+
+		size_t copy_len = _MIN(len, mCurrent->data.size() - mCurrent->size);
+		memcpy(mCurrent->data.data() + mCurrent->size, out, copy_len);
+		mCurrent->size += copy_len;
+		mPos += copy_len;
+		mSize = _MAX(mSize, mPos);
+		out += copy_len;
+		len -= copy_len;
+
+		if (mCurrent->size == mCurrent->data.size())
+			submitCurrent(false);
+	}
+}
+
+void AsyncWriteFile::write(const byte_t* out, size_t offset, size_t len)
+{
+	seek(offset);
+	write(out, len);
+}
+
+void AsyncWriteFile::submitCurrent(bool final)
+{
+	if (mCurrent == nullptr)
+		return;
+
+	if (mCurrent->size == 0)
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mFreeBuffers.push_back(std::move(mCurrent));
+		return;
+	}
+
+	if (mThread.joinable() == false)
+	{
+		// nothing more is coming, there's nothing to overlap the write with
+		if (final)
+		{
+			std::unique_ptr<sBuffer> buffer = std::move(mCurrent);
+			try
+			{
+				writeBuffer(*buffer);
+			}
+			catch (const fnd::Exception& e)
+			{
+				std::lock_guard<std::mutex> lock(mLock);
+				mError = e.error();
+			}
+			std::lock_guard<std::mutex> lock(mLock);
+			mFreeBuffers.push_back(std::move(buffer));
+			return;
+		}
+
+		mThread = std::thread(&AsyncWriteFile::writerMain, this);
+	}
+
+	// the queue (and the buffer being written) bound the memory held by this file
+	std::unique_lock<std::mutex> lock(mLock);
+	mDoneCond.wait(lock, [this] { return mPendingNum < mQueueDepth; });
+	mQueue.push_back(std::move(mCurrent));
+	mPendingNum++;
+	lock.unlock();
+	mWorkCond.notify_one();
+}
+
+void AsyncWriteFile::checkError()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	if (mError.empty() == false)
+	{
+		throw fnd::Exception(kModuleName, mError);
+	}
+}
+
+void AsyncWriteFile::writerMain()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	while (true)
+	{
+		mWorkCond.wait(lock, [this] { return mStop || mQueue.empty() == false; });
+		if (mQueue.empty())
+			break;
+
+		std::unique_ptr<sBuffer> buffer = std::move(mQueue.front());
+		mQueue.pop_front();
+
+		// once a write failed the rest of the queue is dropped
+		if (mError.empty())
+		{
+			lock.unlock();
+			std::string error;
+			try
+			{
+				writeBuffer(*buffer);
+			}
+			catch (const fnd::Exception& e)
+			{
+				error = e.error();
+			}
+			lock.lock();
+			if (mError.empty())
+				mError = error;
+		}
+
+		mFreeBuffers.push_back(std::move(buffer));
+		mPendingNum--;
+		mDoneCond.notify_all();
+	}
+}
+
+void AsyncWriteFile::writeBuffer(const sBuffer& buffer)
+{
+#ifdef _WIN32
+	mFile.write(buffer.data.data(), buffer.offset, buffer.size);
+#else
+	for (size_t pos = 0; pos < buffer.size; )
+	{
+		ssize_t ret = pwrite(mFd, buffer.data.data() + pos, buffer.size - pos, buffer.offset + pos);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+		{
+			throw fnd::Exception(kModuleName, std::string("Failed to write file (") + strerror(errno) + ")");
+		}
+		pos += ret;
+	}
+
+#ifdef __linux__
+	// start write back of this buffer, then wait for the range before it and drop it from
+	// the page cache, so a slow output volume doesn't fill memory with dirty pages
+	if (buffer.offset == mWrittenEnd)
+	{
+		size_t prev_offset = buffer.offset >= buffer.size ? buffer.offset - buffer.size : 0;
+		sync_file_range(mFd, buffer.offset, buffer.size, SYNC_FILE_RANGE_WRITE);
+		if (buffer.offset > prev_offset)
+		{
+			sync_file_range(mFd, prev_offset, buffer.offset - prev_offset, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+			posix_fadvise(mFd, prev_offset, buffer.offset - prev_offset, POSIX_FADV_DONTNEED);
+		}
+	}
+#endif
+	mWrittenEnd = buffer.offset + buffer.size;
+#endif
+}
\ No newline at end of file
@@ -1,5 +1,14 @@
 #include <fnd/SimpleFile.h>
 #include <fnd/StringConv.h>
+#ifdef __linux__
+#include <cerrno>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <climits>
+#include <vector>
+#endif
 
 using namespace fnd;
 
@@ -250,6 +259,130 @@ void SimpleFile::write(const byte_t* out, size_t offset, size_t len)
 	write(out, len);
 }
 
+SimpleFile* SimpleFile::getPlainFile(size_t& offset)
+{
+	return this;
+}
+
+void SimpleFile::setAccessHint(AccessHint hint)
+{
+#if defined(__linux__) && defined(POSIX_FADV_SEQUENTIAL)
+	// tunes the kernel read-ahead window for the file
+	int advice = hint == ACCESS_SEQUENTIAL ? POSIX_FADV_SEQUENTIAL : (hint == ACCESS_RANDOM ? POSIX_FADV_RANDOM : POSIX_FADV_NORMAL);
+	if (isOpen())
+		posix_fadvise(fileno(mFp), 0, 0, advice);
+#endif
+}
+
+void SimpleFile::readv(const sReadRange* ranges, size_t num)
+{
+#ifdef __linux__
+	if (num == 0)
+		return;
+
+	// anything written through the stream must reach the descriptor first
+	if (mMode != Read)
+		fflush(mFp);
+
+	int fd = fileno(mFp);
+	std::vector<iovec> iov;
+	for (size_t i = 0; i < num;)
+	{
+		// gather the ranges that follow on from each other
+		size_t run_offset = ranges[i].offset;
+		size_t run_len = 0;
+		iov.clear();
+		for (; i < num && ranges[i].offset == run_offset + run_len && iov.size() < IOV_MAX; i++)
+		{
+			iovec vec = { ranges[i].out, ranges[i].len };
+			iov.push_back(vec);
+			run_len += ranges[i].len;
+		}
+
+		// preadv may stop short, continue from where it got to
+		size_t done = 0;
+		size_t vec_index = 0;
+		while (done < run_len && vec_index < iov.size())
+		{
+			ssize_t ret = preadv(fd, iov.data() + vec_index, (int)(iov.size() - vec_index), run_offset + done);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0)
+			{
+				throw fnd::Exception(kModuleName, "Failed to read file.");
+			}
+			// end of file, like read() the rest is left as is
+			if (ret == 0)
+				break;
+
+			done += ret;
+			for (size_t consumed = ret; consumed > 0;)
+			{
+				size_t step = _MIN(consumed, iov[vec_index].iov_len);
+				iov[vec_index].iov_base = (byte_t*)iov[vec_index].iov_base + step;
+				iov[vec_index].iov_len -= step;
+				consumed -= step;
+				if (iov[vec_index].iov_len == 0)
+					vec_index++;
+			}
+		}
+	}
+
+	// leave the position where read() would have
+	seek(ranges[num - 1].offset + ranges[num - 1].len);
+#else
+	IFile::readv(ranges, num);
+#endif
+}
+
+void SimpleFile::prefetch(size_t offset, size_t len)
+{
+#if defined(__linux__) && defined(POSIX_FADV_WILLNEED)
+	// the kernel starts reading the range into the page cache and returns
+	if (isOpen())
+		posix_fadvise(fileno(mFp), offset, len, POSIX_FADV_WILLNEED);
+#endif
+}
+
+size_t SimpleFile::copyFrom(SimpleFile& src, size_t src_offset, size_t len)
+{
+	size_t copied = 0;
+#ifdef __linux__
+	// write out anything buffered by the stream, the copy goes straight to the descriptor
+	fflush(mFp);
+	int in_fd = fileno(src.mFp);
+	int out_fd = fileno(mFp);
+	off_t in_off = src_offset;
+	off_t out_off = pos();
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+	while (copied < len)
+	{
+		ssize_t ret = copy_file_range(in_fd, &in_off, out_fd, &out_off, len - copied, 0);
+		if (ret <= 0)
+			break;
+		copied += ret;
+	}
+#endif
+
+	// older kernels, or files on different file systems
+	if (copied < len && lseek(out_fd, out_off, SEEK_SET) == out_off)
+	{
+		while (copied < len)
+		{
+			ssize_t ret = sendfile(out_fd, in_fd, &in_off, len - copied);
+			if (ret <= 0)
+				break;
+			copied += ret;
+		}
+		out_off = lseek(out_fd, 0, SEEK_CUR);
+	}
+
+	seek(out_off);
+#endif
+	return copied;
+}
+
 #ifdef _WIN32
 DWORD SimpleFile::getOpenModeFlag(OpenMode mode) const
 {
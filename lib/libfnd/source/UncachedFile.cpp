@@ -0,0 +1,267 @@
+#include <fnd/UncachedFile.h>
+#include <cstring>
+#include <cstdlib>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+using namespace fnd;
+
+UncachedFile::UncachedFile() :
+	mOpen(false),
+	mMode(DirectIo),
+	mPos(0)
+#ifndef _WIN32
+	, mFd(-1),
+	mBounce(nullptr),
+	mBounceOffset(0),
+	mBounceLen(0),
+	mAlignment(kMinAlignment)
+#endif
+{
+}
+
+UncachedFile::UncachedFile(const std::string& path, Mode mode) :
+	UncachedFile()
+{
+	open(path, mode);
+}
+
+UncachedFile::~UncachedFile()
+{
+	close();
+}
+
+void UncachedFile::open(const std::string& path, Mode mode)
+{
+	close();
+
+	mMode = mode;
+#ifdef _WIN32
+	mFile.open(path, fnd::SimpleFile::Read);
+#else
+	mPath = path;
+	mFd = -1;
+#ifdef O_DIRECT
+	if (mMode == DirectIo)
+		mFd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+#endif
+	if (mFd < 0)
+	{
+		mFd = ::open(path.c_str(), O_RDONLY);
+		if (mFd < 0)
+		{
+			throw fnd::Exception(kModuleName, "Failed to open file.");
+		}
+
+#if defined(__APPLE__) && defined(F_NOCACHE)
+		if (mMode == DirectIo && fcntl(mFd, F_NOCACHE, 1) != 0)
+			mMode = DropCache;
+#elif defined(O_DIRECT)
+		// the file system doesn't do O_DIRECT
+		mMode = DropCache;
+#endif
+	}
+
+#ifdef POSIX_FADV_NOREUSE
+	if (mMode == DropCache)
+		posix_fadvise(mFd, 0, 0, POSIX_FADV_NOREUSE);
+#endif
+
+	if (posix_memalign((void**)&mBounce, kMaxAlignment, kBounceSize) != 0)
+	{
+		mBounce = nullptr;
+		::close(mFd);
+		mFd = -1;
+		throw fnd::Exception(kModuleName, "Failed to allocate read buffer.");
+	}
+	mBounceOffset = 0;
+	mBounceLen = 0;
+	mAlignment = kMinAlignment;
+#endif
+
+	mPos = 0;
+	mOpen = true;
+}
+
+bool UncachedFile::isOpen() const
+{
+	return mOpen;
+}
+
+void UncachedFile::close()
+{
+	if (mOpen == false)
+		return;
+
+#ifdef _WIN32
+	mFile.close();
+#else
+	::close(mFd);
+	mFd = -1;
+	free(mBounce);
+	mBounce = nullptr;
+	mBounceLen = 0;
+#endif
+	mOpen = false;
+}
+
+UncachedFile::Mode UncachedFile::getMode() const
+{
+	return mMode;
+}
+
+size_t UncachedFile::size()
+{
+#ifdef _WIN32
+	return mFile.size();
+#else
+	struct stat st;
+	if (fstat(mFd, &st) != 0)
+	{
+		throw fnd::Exception(kModuleName, "Failed to check filesize");
+	}
+	return st.st_size;
+#endif
+}
+
+void UncachedFile::seek(size_t offset)
+{
+	mPos = offset;
+}
+
+void UncachedFile::read(byte_t* out, size_t len)
+{
+	read(out, mPos, len);
+}
+
+void UncachedFile::read(byte_t* out, size_t offset, size_t len)
+{
+#ifdef _WIN32
+	mFile.read(out, offset, len);
+#else
+	if (mMode == DirectIo)
+	{
+		readDirect(out, offset, len);
+	}
+	else
+	{
+		size_t read_len;
+		preadDirect(out, offset, len, read_len);
+#ifdef POSIX_FADV_DONTNEED
+		if (read_len > 0)
+			posix_fadvise(mFd, offset, read_len, POSIX_FADV_DONTNEED);
+#endif
+	}
+#endif
+	mPos = offset + len;
+}
+
+void UncachedFile::write(const byte_t* out, size_t len)
+{
+	throw fnd::Exception(kModuleName, "write() not supported");
+}
+
+void UncachedFile::write(const byte_t* out, size_t offset, size_t len)
+{
+	throw fnd::Exception(kModuleName, "write() not supported");
+}
+
+#ifndef _WIN32
+void UncachedFile::readDirect(byte_t* out, size_t offset, size_t len)
+{
+	while (len > 0)
+	{
+		// served by the last range read (headers and hash layers are often read twice)
+		if (offset >= mBounceOffset && offset < mBounceOffset + mBounceLen)
+		{
+			size_t copy_len = _MIN(len, mBounceOffset + mBounceLen - offset);
+			memcpy(out, mBounce + (offset - mBounceOffset), copy_len);
+			out += copy_len;
+			offset += copy_len;
+			len -= copy_len;
+			continue;
+		}
+
+		// aligned whole blocks go straight into the caller's buffer (e.g. a mapped output window),
+		// anything else is read rounded out to the alignment in the bounce buffer
+		size_t direct_len = len - (len % mAlignment);
+		bool direct = (offset % mAlignment) == 0 && ((uintptr_t)out % mAlignment) == 0 && direct_len > 0;
+		size_t read_offset = direct ? offset : offset - (offset % mAlignment);
+		size_t read_len = direct ? direct_len : _MIN(align(offset + len, mAlignment) - read_offset, kBounceSize);
+		byte_t* read_out = direct ? out : mBounce;
+
+		mBounceLen = 0;
+		size_t done;
+		if (preadDirect(read_out, read_offset, read_len, done) == false)
+		{
+			// the device needs a larger alignment, or the file system only accepted O_DIRECT at open
+			if (mAlignment < kMaxAlignment)
+			{
+				mAlignment = kMaxAlignment;
+				continue;
+			}
+			fallBackToDropCache();
+			read(out, offset, len);
+			return;
+		}
+
+		if (direct)
+		{
+			if (done < direct_len)
+				return;
+			out += direct_len;
+			offset += direct_len;
+			len -= direct_len;
+			continue;
+		}
+
+		mBounceOffset = read_offset;
+		mBounceLen = done;
+
+		// end of file
+		if (offset >= mBounceOffset + mBounceLen)
+			return;
+	}
+}
+
+bool UncachedFile::preadDirect(byte_t* out, size_t offset, size_t len, size_t& done)
+{
+	done = 0;
+	while (done < len)
+	{
+		ssize_t ret = pread(mFd, out + done, len - done, offset + done);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && errno == EINVAL && done == 0)
+			return false;
+		if (ret < 0)
+		{
+			throw fnd::Exception(kModuleName, std::string("Failed to read file (") + strerror(errno) + ")");
+		}
+		if (ret == 0)
+			break;
+		done += ret;
+	}
+	return true;
+}
+
+void UncachedFile::fallBackToDropCache()
+{
+	int fd = ::open(mPath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw fnd::Exception(kModuleName, "Failed to reopen file.");
+	}
+	::close(mFd);
+	mFd = fd;
+	mMode = DropCache;
+	mBounceLen = 0;
+#ifdef POSIX_FADV_NOREUSE
+	posix_fadvise(mFd, 0, 0, POSIX_FADV_NOREUSE);
+#endif
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,563 @@
+#include <fnd/UringFile.h>
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#ifdef __NR_io_uring_setup
+#define FND_HAS_IO_URING
+#endif
+#endif
+#endif
+
+using namespace fnd;
+
+#ifdef FND_HAS_IO_URING
+static int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int ring_fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static bool io_uring_read_supported(int ring_fd)
+{
+	// IORING_OP_READ (and the probe) came in 5.6, rings on older kernels only have the iovec reads
+	static const unsigned kProbeOpNum = 256;
+	std::vector<byte_t> buffer(sizeof(io_uring_probe) + kProbeOpNum * sizeof(io_uring_probe_op), 0);
+	io_uring_probe* probe = (io_uring_probe*)buffer.data();
+	if (io_uring_register(ring_fd, IORING_REGISTER_PROBE, probe, kProbeOpNum) != 0)
+		return false;
+
+	return probe->last_op >= IORING_OP_READ && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+#endif
+
+UringFile::UringFile() :
+	mOpen(false),
+	mPos(0),
+	mQueueDepth(kDefaultQueueDepth),
+	mInFlightNum(0)
+#ifndef _WIN32
+	, mFd(-1),
+	mRingFd(-1),
+	mSqRing(nullptr),
+	mSqRingSize(0),
+	mCqRing(nullptr),
+	mCqRingSize(0),
+	mSqes(nullptr),
+	mSqesSize(0),
+	mSqHead(nullptr),
+	mSqTail(nullptr),
+	mSqMask(nullptr),
+	mSqArray(nullptr),
+	mCqHead(nullptr),
+	mCqTail(nullptr),
+	mCqMask(nullptr),
+	mCqes(nullptr),
+	mBuffersRegistered(false)
+#endif
+{
+}
+
+UringFile::UringFile(const std::string& path, size_t queue_depth) :
+	UringFile()
+{
+	open(path, queue_depth);
+}
+
+UringFile::~UringFile()
+{
+	close();
+}
+
+void UringFile::open(const std::string& path, size_t queue_depth)
+{
+	close();
+
+	mQueueDepth = queue_depth > 0 ? queue_depth : 1;
+#ifdef _WIN32
+	mFile.open(path, fnd::SimpleFile::Read);
+#else
+	mFd = ::open(path.c_str(), O_RDONLY);
+	if (mFd < 0)
+	{
+		throw fnd::Exception(kModuleName, "Failed to open file.");
+	}
+
+	setupRing(mQueueDepth);
+#endif
+
+	mPos = 0;
+	mInFlightNum = 0;
+	mCompleted.clear();
+	mOpen = true;
+}
+
+bool UringFile::isOpen() const
+{
+	return mOpen;
+}
+
+void UringFile::close()
+{
+	if (mOpen == false)
+		return;
+
+#ifdef _WIN32
+	mFile.close();
+#else
+	// the kernel may still be writing into the callers' buffers, wait for it
+	drain();
+
+	teardownRing();
+	::close(mFd);
+	mFd = -1;
+#endif
+	mInFlightNum = 0;
+	mCompleted.clear();
+	mOpen = false;
+}
+
+bool UringFile::isUringActive() const
+{
+#ifdef _WIN32
+	return false;
+#else
+	return mRingFd >= 0;
+#endif
+}
+
+void UringFile::registerBuffers(const fnd::List<std::pair<byte_t*, size_t>>& buffers)
+{
+#ifdef FND_HAS_IO_URING
+	if (mRingFd < 0)
+		return;
+
+	if (mBuffersRegistered)
+	{
+		io_uring_register(mRingFd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+		mBuffersRegistered = false;
+	}
+
+	std::vector<iovec> iov(buffers.size());
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		iov[i].iov_base = buffers[i].first;
+		iov[i].iov_len = buffers[i].second;
+	}
+
+	if (iov.empty() == false && io_uring_register(mRingFd, IORING_REGISTER_BUFFERS, iov.data(), (unsigned)iov.size()) != 0)
+	{
+		throw fnd::Exception(kModuleName, std::string("Failed to register buffers (") + strerror(errno) + ")");
+	}
+	mBuffersRegistered = iov.empty() == false;
+#endif
+}
+
+size_t UringFile::submit(sReadRequest* requests, size_t num)
+{
+	if (mOpen == false)
+	{
+		throw fnd::Exception(kModuleName, "File is not open.");
+	}
+
+#ifdef FND_HAS_IO_URING
+	if (mRingFd >= 0)
+	{
+		size_t queued = _MIN(num, mQueueDepth - mInFlightNum);
+		unsigned tail = *mSqTail;
+		for (size_t i = 0; i < queued; i++)
+		{
+			unsigned index = tail & *mSqMask;
+			io_uring_sqe* sqe = (io_uring_sqe*)mSqes + index;
+			memset(sqe, 0, sizeof(io_uring_sqe));
+			if (requests[i].buffer_index >= 0 && mBuffersRegistered)
+			{
+				sqe->opcode = IORING_OP_READ_FIXED;
+				sqe->buf_index = (__u16)requests[i].buffer_index;
+			}
+			else
+			{
+				sqe->opcode = IORING_OP_READ;
+			}
+			sqe->fd = mFd;
+			sqe->addr = (__u64)(uintptr_t)requests[i].out;
+			sqe->len = (__u32)requests[i].len;
+			sqe->off = requests[i].offset;
+			sqe->user_data = (__u64)(uintptr_t)&requests[i];
+			mSqArray[index] = index;
+			tail++;
+		}
+		__atomic_store_n(mSqTail, tail, __ATOMIC_RELEASE);
+
+		size_t submitted = 0;
+		while (submitted < queued)
+		{
+			int ret = io_uring_enter(mRingFd, (unsigned)(queued - submitted), 0, 0);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0)
+			{
+				throw fnd::Exception(kModuleName, std::string("Failed to submit reads (") + strerror(errno) + ")");
+			}
+			submitted += ret;
+		}
+		mInFlightNum += queued;
+		return queued;
+	}
+#endif
+
+	// without a ring the reads are done now and handed out by reap()
+	for (size_t i = 0; i < num; i++)
+	{
+		readDirect(requests[i]);
+		mCompleted.push_back(&requests[i]);
+	}
+	return num;
+}
+
+size_t UringFile::reap(sReadRequest** completed, size_t max, size_t min_complete)
+{
+	size_t reaped = 0;
+
+	while (reaped < max && mCompleted.empty() == false)
+	{
+		completed[reaped++] = mCompleted.back();
+		mCompleted.pop_back();
+	}
+
+#ifdef FND_HAS_IO_URING
+	if (mRingFd >= 0)
+	{
+		min_complete = _MIN(_MIN(min_complete, max), reaped + mInFlightNum);
+		std::string error;
+		while (reaped < max)
+		{
+			unsigned head = *mCqHead;
+			unsigned tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+			if (head == tail)
+			{
+				if (reaped >= min_complete)
+					break;
+
+				int ret = io_uring_enter(mRingFd, 0, (unsigned)(min_complete - reaped), IORING_ENTER_GETEVENTS);
+				if (ret < 0 && errno != EINTR)
+				{
+					throw fnd::Exception(kModuleName, std::string("Failed to wait for reads (") + strerror(errno) + ")");
+				}
+				continue;
+			}
+
+			for (; head != tail && reaped < max; head++)
+			{
+				const io_uring_cqe* cqe = (const io_uring_cqe*)mCqes + (head & *mCqMask);
+				sReadRequest* request = (sReadRequest*)(uintptr_t)cqe->user_data;
+				mInFlightNum--;
+
+				if (cqe->res < 0)
+				{
+					if (error.empty())
+						error = std::string("Failed to read file (") + strerror(-cqe->res) + ")";
+					continue;
+				}
+
+				// a short read that isn't at the end of the file is finished directly
+				request->result = (size_t)cqe->res;
+				if (request->result > 0 && request->result < request->len)
+				{
+					sReadRequest rest = { request->out + request->result, request->offset + request->result, request->len - request->result, -1, 0 };
+					readDirect(rest);
+					request->result += rest.result;
+				}
+				completed[reaped++] = request;
+			}
+			__atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+		}
+
+		if (error.empty() == false)
+		{
+			throw fnd::Exception(kModuleName, error);
+		}
+	}
+#endif
+
+	return reaped;
+}
+
+void UringFile::readBatch(sReadRequest* requests, size_t num)
+{
+	std::vector<sReadRequest*> completed(mQueueDepth);
+	size_t submitted = 0;
+	size_t done = 0;
+	try
+	{
+		while (done < num)
+		{
+			if (submitted < num)
+				submitted += submit(requests + submitted, num - submitted);
+			done += reap(completed.data(), completed.size(), 1);
+		}
+	}
+	catch (const fnd::Exception&)
+	{
+		// the rest of the batch still points at the requests (and the buffers they read into),
+		// which the caller frees once this throws
+		drain();
+		for (size_t i = 0; i < mCompleted.size();)
+		{
+			if (mCompleted[i] >= requests && mCompleted[i] < requests + num)
+				mCompleted.erase(mCompleted.begin() + i);
+			else
+				i++;
+		}
+		throw;
+	}
+}
+
+void UringFile::drain()
+{
+#ifndef _WIN32
+	sReadRequest* completed[16];
+	while (mInFlightNum > 0 && mRingFd >= 0)
+	{
+		size_t in_flight_num = mInFlightNum;
+		try
+		{
+			reap(completed, 16, 1);
+		}
+		catch (const fnd::Exception&)
+		{
+			// failed reads still complete, only a ring that can't be waited on stops the wait
+			if (mInFlightNum == in_flight_num)
+				break;
+		}
+	}
+#endif
+}
+
+size_t UringFile::size()
+{
+#ifdef _WIN32
+	return mFile.size();
+#else
+	struct stat st;
+	if (fstat(mFd, &st) != 0)
+	{
+		throw fnd::Exception(kModuleName, "Failed to check filesize");
+	}
+	return st.st_size;
+#endif
+}
+
+void UringFile::seek(size_t offset)
+{
+	mPos = offset;
+}
+
+void UringFile::read(byte_t* out, size_t len)
+{
+	read(out, mPos, len);
+}
+
+void UringFile::read(byte_t* out, size_t offset, size_t len)
+{
+	// one request unless a deeper queue can be kept busy
+	if (isUringActive() == false || len <= kReadChunkSize)
+	{
+		sReadRequest request = { out, offset, len, -1, 0 };
+		readDirect(request);
+	}
+	else
+	{
+		std::vector<sReadRequest> requests;
+		for (size_t pos = 0; pos < len; pos += kReadChunkSize)
+		{
+			sReadRequest request = { out + pos, offset + pos, _MIN(len - pos, kReadChunkSize), -1, 0 };
+			requests.push_back(request);
+		}
+		readBatch(requests.data(), requests.size());
+	}
+
+	mPos = offset + len;
+}
+
+void UringFile::readv(const sReadRange* ranges, size_t num)
+{
+	if (num == 0)
+		return;
+
+	std::vector<sReadRequest> requests;
+	for (size_t i = 0; i < num; i++)
+	{
+		byte_t* out = ranges[i].out;
+		size_t offset = ranges[i].offset;
+		size_t len = ranges[i].len;
+
+		// ranges that continue both in the file and in memory are one read
+		for (; i + 1 < num && ranges[i + 1].offset == offset + len && ranges[i + 1].out == out + len; i++)
+			len += ranges[i + 1].len;
+
+		for (size_t pos = 0; pos < len; pos += kReadChunkSize)
+		{
+			sReadRequest request = { out + pos, offset + pos, _MIN(len - pos, kReadChunkSize), -1, 0 };
+			requests.push_back(request);
+		}
+	}
+	readBatch(requests.data(), requests.size());
+
+	mPos = ranges[num - 1].offset + ranges[num - 1].len;
+}
+
+void UringFile::prefetch(size_t offset, size_t len)
+{
+#ifdef _WIN32
+	mFile.prefetch(offset, len);
+#elif defined(POSIX_FADV_WILLNEED)
+	if (mOpen)
+		posix_fadvise(mFd, offset, len, POSIX_FADV_WILLNEED);
+#endif
+}
+
+void UringFile::write(const byte_t* out, size_t len)
+{
+	throw fnd::Exception(kModuleName, "write() not supported");
+}
+
+void UringFile::write(const byte_t* out, size_t offset, size_t len)
+{
+	throw fnd::Exception(kModuleName, "write() not supported");
+}
+
+void UringFile::readDirect(sReadRequest& request)
+{
+#ifdef _WIN32
+	mFile.read(request.out, request.offset, request.len);
+	request.result = request.len;
+#else
+	request.result = 0;
+	while (request.result < request.len)
+	{
+		ssize_t ret = pread(mFd, request.out + request.result, request.len - request.result, request.offset + request.result);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+		{
+			throw fnd::Exception(kModuleName, std::string("Failed to read file (") + strerror(errno) + ")");
+		}
+		if (ret == 0)
+			break;
+		request.result += ret;
+	}
+#endif
+}
+
+#ifndef _WIN32
+bool UringFile::setupRing(size_t queue_depth)
+{
+#ifdef FND_HAS_IO_URING
+	io_uring_params params;
+	memset(&params, 0, sizeof(io_uring_params));
+	int ring_fd = io_uring_setup((unsigned)queue_depth, &params);
+	if (ring_fd < 0)
+		return false;
+
+	if (io_uring_read_supported(ring_fd) == false)
+	{
+		::close(ring_fd);
+		return false;
+	}
+
+	mRingFd = ring_fd;
+	mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		mSqRingSize = mCqRingSize = _MAX(mSqRingSize, mCqRingSize);
+
+	mSqRing = mmap(nullptr, mSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQ_RING);
+	if (mSqRing == MAP_FAILED)
+	{
+		mSqRing = nullptr;
+		teardownRing();
+		return false;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		mCqRing = mSqRing;
+	}
+	else
+	{
+		mCqRing = mmap(nullptr, mCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_CQ_RING);
+		if (mCqRing == MAP_FAILED)
+		{
+			mCqRing = nullptr;
+			teardownRing();
+			return false;
+		}
+	}
+
+	mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	mSqes = mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQES);
+	if (mSqes == MAP_FAILED)
+	{
+		mSqes = nullptr;
+		teardownRing();
+		return false;
+	}
+
+	byte_t* sq = (byte_t*)mSqRing;
+	mSqHead = (unsigned*)(sq + params.sq_off.head);
+	mSqTail = (unsigned*)(sq + params.sq_off.tail);
+	mSqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+	mSqArray = (unsigned*)(sq + params.sq_off.array);
+
+	byte_t* cq = (byte_t*)mCqRing;
+	mCqHead = (unsigned*)(cq + params.cq_off.head);
+	mCqTail = (unsigned*)(cq + params.cq_off.tail);
+	mCqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+	mCqes = cq + params.cq_off.cqes;
+
+	// the kernel may round the queue up, but never hold more than the submission ring
+	mQueueDepth = _MIN(queue_depth, (size_t)params.sq_entries);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void UringFile::teardownRing()
+{
+#ifdef FND_HAS_IO_URING
+	if (mSqes != nullptr)
+		munmap(mSqes, mSqesSize);
+	if (mCqRing != nullptr && mCqRing != mSqRing)
+		munmap(mCqRing, mCqRingSize);
+	if (mSqRing != nullptr)
+		munmap(mSqRing, mSqRingSize);
+	if (mRingFd >= 0)
+		::close(mRingFd);
+#endif
+	mSqes = nullptr;
+	mCqRing = nullptr;
+	mSqRing = nullptr;
+	mRingFd = -1;
+	mBuffersRegistered = false;
+}
+#endif
\ No newline at end of file
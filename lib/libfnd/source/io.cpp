@@ -1,12 +1,23 @@
 #include <fnd/io.h>
 #include <fnd/StringConv.h>
+#include <fnd/Exception.h>
 #include <fnd/SimpleFile.h>
 #include <fstream>
 #ifdef _WIN32
 #include <direct.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <cstdlib>
+#include <windows.h>
 #else
 #include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 #endif
 
 using namespace fnd;
@@ -72,3 +83,196 @@ void fnd::io::appendToPath(std::string& base, const std::string& add)
 		base += add;
 	}
 }
+
+
+bool fnd::io::isDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	std::u16string wpath = fnd::StringConv::ConvertChar8ToChar16(path);
+	DWORD attr = GetFileAttributesW((LPCWSTR)wpath.c_str());
+	return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+	return S_ISDIR(st.st_mode);
+#endif
+}
+
+bool fnd::io::fileExists(const std::string& path)
+{
+#ifdef _WIN32
+	std::u16string wpath = fnd::StringConv::ConvertChar8ToChar16(path);
+	DWORD attr = GetFileAttributesW((LPCWSTR)wpath.c_str());
+	return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) == 0;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+	return S_ISREG(st.st_mode);
+#endif
+}
+
+uint64_t fnd::io::getFileModifiedTime(const std::string& path)
+{
+#ifdef _WIN32
+	std::u16string wpath = fnd::StringConv::ConvertChar8ToChar16(path);
+	struct _stat64 st;
+	if (_wstat64((const wchar_t*)wpath.c_str(), &st) != 0)
+	{
+		throw fnd::Exception("io", "Failed to stat file (" + path + ")");
+	}
+	return (uint64_t)st.st_mtime;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+	{
+		throw fnd::Exception("io", "Failed to stat file (" + path + ")");
+	}
+	return (uint64_t)st.st_mtime;
+#endif
+}
+
+void fnd::io::getDirectoryListing(const std::string& path, fnd::List<std::string>& dirs, fnd::List<std::string>& files)
+{
+#ifdef _WIN32
+	std::string search_path = path;
+	appendToPath(search_path, "*");
+	std::u16string wpath = fnd::StringConv::ConvertChar8ToChar16(search_path);
+
+	WIN32_FIND_DATAW find_data;
+	HANDLE find = FindFirstFileW((LPCWSTR)wpath.c_str(), &find_data);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		throw fnd::Exception("io", "Failed to open directory (" + path + ")");
+	}
+
+	do
+	{
+		std::string name = fnd::StringConv::ConvertChar16ToChar8(std::u16string((char16_t*)find_data.cFileName));
+		if (name == "." || name == "..")
+			continue;
+
+		if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			dirs.addElement(name);
+		else
+			files.addElement(name);
+	} while (FindNextFileW(find, &find_data));
+
+	FindClose(find);
+#else
+	DIR* dp = opendir(path.c_str());
+	if (dp == nullptr)
+	{
+		throw fnd::Exception("io", "Failed to open directory (" + path + ")");
+	}
+
+	struct dirent* ep;
+	while ((ep = readdir(dp)) != nullptr)
+	{
+		std::string name = ep->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string full_path = path;
+		appendToPath(full_path, name);
+		if (isDirectory(full_path))
+			dirs.addElement(name);
+		else
+			files.addElement(name);
+	}
+
+	closedir(dp);
+#endif
+}
+
+void fnd::io::getLineList(const std::string& path, std::vector<std::string>& lines)
+{
+	std::ifstream file(path);
+	if (file.is_open() == false)
+	{
+		throw fnd::Exception("io", "Failed to open list file (" + path + ")");
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		// trim whitespace (including the \r of CRLF files)
+		size_t begin = line.find_first_not_of(" \t\r\n");
+		size_t end = line.find_last_not_of(" \t\r\n");
+		if (begin == std::string::npos)
+			continue;
+		line = line.substr(begin, end - begin + 1);
+
+		// skip comments
+		if (line[0] == '#')
+			continue;
+
+		lines.push_back(line);
+	}
+}
+
+void fnd::io::replaceFile(const std::string& path, const std::function<void(fnd::SimpleFile& file)>& write)
+{
+	std::string tmp_path = path + ".tmp";
+	try
+	{
+		fnd::SimpleFile file(tmp_path, fnd::SimpleFile::Create);
+		write(file);
+	}
+	catch (...)
+	{
+		::remove(tmp_path.c_str());
+		throw;
+	}
+
+#ifdef _WIN32
+	// rename doesn't replace an existing file here
+	::remove(path.c_str());
+#endif
+	if (::rename(tmp_path.c_str(), path.c_str()) != 0)
+	{
+		::remove(tmp_path.c_str());
+		throw fnd::Exception("io", "Failed to replace file (" + path + ")");
+	}
+}
+
+void fnd::io::replaceFile(const std::string& path, const byte_t* data, size_t size)
+{
+	replaceFile(path, [data, size](fnd::SimpleFile& file) { file.write(data, size); });
+}
+
+bool fnd::io::createHardLink(const std::string& target, const std::string& link_path)
+{
+#ifdef _WIN32
+	std::u16string wtarget = fnd::StringConv::ConvertChar8ToChar16(target);
+	std::u16string wlink = fnd::StringConv::ConvertChar8ToChar16(link_path);
+	return CreateHardLinkW((LPCWSTR)wlink.c_str(), (LPCWSTR)wtarget.c_str(), nullptr) != 0;
+#else
+	return link(target.c_str(), link_path.c_str()) == 0;
+#endif
+}
+
+bool fnd::io::cloneFile(const std::string& src, const std::string& dst)
+{
+#if defined(__linux__) && defined(FICLONE)
+	int src_fd = open(src.c_str(), O_RDONLY);
+	if (src_fd < 0)
+		return false;
+	int dst_fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (dst_fd < 0)
+	{
+		close(src_fd);
+		return false;
+	}
+
+	bool cloned = ioctl(dst_fd, FICLONE, src_fd) == 0;
+	close(dst_fd);
+	close(src_fd);
+	if (cloned == false)
+		unlink(dst.c_str());
+	return cloned;
+#else
+	return false;
+#endif
+}
\ No newline at end of file
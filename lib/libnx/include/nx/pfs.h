@@ -1,3 +1,4 @@
+#pragma once
 #include <fnd/types.h>
 #include <crypto/sha.h>
 #include <nx/macro.h>
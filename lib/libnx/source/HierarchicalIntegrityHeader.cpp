@@ -38,7 +38,44 @@ bool nx::HierarchicalIntegrityHeader::operator!=(const HierarchicalIntegrityHead
 
 void nx::HierarchicalIntegrityHeader::toBytes()
 {
-	throw fnd::Exception(kModuleName, "exportBinary() not implemented");
+	std::stringstream error_str;
+
+	if (mLayerInfo.size() != hierarchicalintegrity::kDefaultLayerNum)
+	{
+		error_str.clear();
+		error_str << "Invalid layer count. ";
+		error_str << "(actual=" << std::dec << mLayerInfo.size() << ", expected=" << nx::hierarchicalintegrity::kDefaultLayerNum << ")";
+		throw fnd::Exception(kModuleName, error_str.str());
+	}
+
+	// the layer info table has a spare entry, the master hash list follows it
+	size_t layer_num = hierarchicalintegrity::kDefaultLayerNum + 1;
+	size_t master_hash_offset = align((sizeof(nx::sHierarchicalIntegrityHeader) + sizeof(nx::sHierarchicalIntegrityLayerInfo) * layer_num), nx::hierarchicalintegrity::kHeaderAlignLen);
+	size_t master_hash_size = sizeof(crypto::sha::sSha256Hash) * mMasterHashList.size();
+
+	mRawBinary.alloc(master_hash_offset + master_hash_size);
+	memset(mRawBinary.data(), 0, mRawBinary.size());
+	nx::sHierarchicalIntegrityHeader* hdr = (nx::sHierarchicalIntegrityHeader*)mRawBinary.data();
+
+	hdr->st_magic = hierarchicalintegrity::kStructMagic;
+	hdr->type_id = hierarchicalintegrity::kRomfsTypeId;
+	hdr->master_hash_size = (uint32_t)master_hash_size;
+	hdr->layer_num = (uint32_t)layer_num;
+
+	// block sizes are stored as they are held, as a power of 2
+	nx::sHierarchicalIntegrityLayerInfo* layer_info = (nx::sHierarchicalIntegrityLayerInfo*)(mRawBinary.data() + sizeof(nx::sHierarchicalIntegrityHeader));
+	for (size_t i = 0; i < mLayerInfo.size(); i++)
+	{
+		layer_info[i].offset = mLayerInfo[i].offset;
+		layer_info[i].size = mLayerInfo[i].size;
+		layer_info[i].block_size = (uint32_t)mLayerInfo[i].block_size;
+	}
+
+	crypto::sha::sSha256Hash* hash_list = (crypto::sha::sSha256Hash*)(mRawBinary.data() + master_hash_offset);
+	for (size_t i = 0; i < mMasterHashList.size(); i++)
+	{
+		hash_list[i] = mMasterHashList[i];
+	}
 }
 
 void nx::HierarchicalIntegrityHeader::fromBytes(const byte_t* data, size_t len)
@@ -39,7 +39,28 @@ bool nx::HierarchicalSha256Header::operator!=(const HierarchicalSha256Header & o
 
 void nx::HierarchicalSha256Header::toBytes()
 {
-	throw fnd::Exception(kModuleName, "exportBinary() not implemented");
+	std::stringstream error_str;
+
+	if (mLayerInfo.size() != nx::hierarchicalsha256::kDefaultLayerNum)
+	{
+		error_str.clear();
+		error_str << "Invalid layer count. ";
+		error_str << "(actual=" << std::dec << mLayerInfo.size() << ", expected=" << nx::hierarchicalsha256::kDefaultLayerNum << ")";
+		throw fnd::Exception(kModuleName, error_str.str());
+	}
+
+	mRawBinary.alloc(sizeof(nx::sHierarchicalSha256Header));
+	memset(mRawBinary.data(), 0, mRawBinary.size());
+	nx::sHierarchicalSha256Header* hdr = (nx::sHierarchicalSha256Header*)mRawBinary.data();
+
+	hdr->master_hash = mMasterHash;
+	hdr->hash_block_size = (uint32_t)mHashBlockSize;
+	hdr->layer_num = (uint32_t)mLayerInfo.size();
+	for (size_t i = 0; i < mLayerInfo.size(); i++)
+	{
+		hdr->layer[i].offset = mLayerInfo[i].offset;
+		hdr->layer[i].size = mLayerInfo[i].size;
+	}
 }
 
 void nx::HierarchicalSha256Header::fromBytes(const byte_t* data, size_t len)
@@ -38,6 +38,7 @@ void nx::NcaHeader::operator=(const NcaHeader & other)
 	else
 	{
 		mRawBinary.clear();
+		mFormatVersion = other.mFormatVersion;
 		mDistributionType = other.mDistributionType;
 		mContentType = other.mContentType;
 		mKeyGeneration = other.mKeyGeneration;
@@ -46,6 +47,7 @@ void nx::NcaHeader::operator=(const NcaHeader & other)
 		mProgramId = other.mProgramId;
 		mContentIndex = other.mContentIndex;
 		mSdkAddonVersion = other.mSdkAddonVersion;
+		memcpy(mRightsId, other.mRightsId, nca::kRightsIdLen);
 		mPartitions = other.mPartitions;
 		mEncAesKeys = other.mEncAesKeys;
 	}
@@ -54,9 +56,9 @@ void nx::NcaHeader::operator=(const NcaHeader & other)
 void nx::NcaHeader::toBytes()
 {
 	mRawBinary.alloc(sizeof(sNcaHeader));
+	memset(mRawBinary.data(), 0, mRawBinary.size());
 	sNcaHeader* hdr = (sNcaHeader*)mRawBinary.data();
 
-	
 	switch(mFormatVersion)
 	{
 	case (NCA2_FORMAT):
@@ -88,7 +90,7 @@ void nx::NcaHeader::toBytes()
 	hdr->sdk_addon_version = mSdkAddonVersion;
 	memcpy(hdr->rights_id, mRightsId, nca::kRightsIdLen);
 
-	// TODO: properly reconstruct NCA layout? atm in hands of user
+	// partitions are laid out by the caller, offsets and sizes are stored in sectors
 	for (size_t i = 0; i < mPartitions.size(); i++)
 	{
 		// determine partition index
@@ -102,7 +104,8 @@ void nx::NcaHeader::toBytes()
 		hdr->partition_hash[idx] = mPartitions[i].hash;
 	}
 
-	for (size_t i = 0; i < nca::kAesKeyNum; i++)
+	// the key area may be set partially, the rest is left zero
+	for (size_t i = 0; i < _MIN(mEncAesKeys.size(), nca::kAesKeyNum); i++)
 	{
 		hdr->enc_aes_key[i] = mEncAesKeys[i];
 	}
@@ -130,7 +133,8 @@ void nx::NcaHeader::fromBytes(const byte_t * data, size_t len)
 		case (nca::kNca3StructMagic) :
 			mFormatVersion = NCA3_FORMAT;
 			break;
-		throw fnd::Exception(kModuleName, "NCA header corrupt");
+		default :
+			throw fnd::Exception(kModuleName, "NCA header corrupt");
 	}
 
 	mDistributionType = (nca::DistributionType)hdr->distribution_type;
@@ -174,6 +178,7 @@ void nx::NcaHeader::clear()
 	mProgramId = 0;
 	mContentIndex = 0;
 	mSdkAddonVersion = 0;
+	memset(mRightsId, 0, nca::kRightsIdLen);
 
 	mPartitions.clear();
 	mEncAesKeys.clear();
@@ -300,7 +305,7 @@ const fnd::List<nx::NcaHeader::sPartition>& nx::NcaHeader::getPartitions() const
 void nx::NcaHeader::setPartitions(const fnd::List<nx::NcaHeader::sPartition>& partitions)
 {
 	mPartitions = partitions;
-	if (mPartitions.size() >= nca::kPartitionNum)
+	if (mPartitions.size() > nca::kPartitionNum)
 	{
 		throw fnd::Exception(kModuleName, "Too many NCA partitions");
 	}
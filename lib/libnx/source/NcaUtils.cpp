@@ -19,6 +19,20 @@ void nx::NcaUtils::decryptNcaHeader(const byte_t* src, byte_t* dst, const crypto
 	}
 }
 
+void nx::NcaUtils::encryptNcaHeader(const byte_t* src, byte_t* dst, const crypto::aes::sAesXts128Key& key)
+{
+	byte_t tweak[crypto::aes::kAesBlockSize];
+
+	// NCA2 fs headers are each encrypted as sector 0
+	bool useNca2SectorIndex = ((const nx::sNcaHeader*)(src + sectorToOffset(1)))->st_magic.get() == nx::nca::kNca2StructMagic;
+
+	for (size_t i = 0; i < nx::nca::kHeaderSectorNum; i++)
+	{
+		crypto::aes::AesXtsMakeTweak(tweak, (i > 1 && useNca2SectorIndex)? 0 : i);
+		crypto::aes::AesXtsEncryptSector(src + sectorToOffset(i), nx::nca::kSectorSize, key.key[0], key.key[1], tweak, dst + sectorToOffset(i));
+	}
+}
+
 byte_t nx::NcaUtils::getMasterKeyRevisionFromKeyGeneration(byte_t key_generation)
 {
 	byte_t masterkey_rev;
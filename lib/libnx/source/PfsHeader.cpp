@@ -35,6 +35,11 @@ bool nx::PfsHeader::operator!=(const PfsHeader & other) const
 	return !(*this == other);
 }
 
+size_t nx::PfsHeader::getSize() const
+{
+	return mRawBinary.size();
+}
+
 const fnd::Vec<byte_t>& nx::PfsHeader::getBytes() const
 {
 	return mRawBinary;
@@ -57,6 +62,7 @@ void nx::PfsHeader::toBytes()
 
 	// allocate pfs header binary
 	mRawBinary.alloc(pfs_header_size);
+	memset(mRawBinary.data(), 0, mRawBinary.size());
 	sPfsHeader* hdr = (sPfsHeader*)mRawBinary.data();
 
 	// set header fields
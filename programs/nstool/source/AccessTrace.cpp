@@ -0,0 +1,245 @@
+#include "AccessTrace.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <fnd/SimpleFile.h>
+#include <fnd/io.h>
+#include <fnd/Vec.h>
+
+AccessTrace::AccessTrace() :
+	mStartTime(std::chrono::steady_clock::now()),
+	mCreationTime((uint64_t)time(nullptr))
+{
+}
+
+void AccessTrace::load(const std::string& path)
+{
+	fnd::SimpleFile file(path, fnd::SimpleFile::Read);
+	fnd::Vec<byte_t> data;
+	data.alloc(file.size());
+	file.read(data.data(), 0, data.size());
+
+	const sAccessTraceHeader* hdr = (const sAccessTraceHeader*)data.data();
+	if (data.size() < sizeof(sAccessTraceHeader) || hdr->st_magic.get() != accesstrace::kAccessTraceStructMagic)
+	{
+		throw fnd::Exception(kModuleName, "Access trace corrupt (" + path + ")");
+	}
+
+	if (hdr->format_version.get() != accesstrace::kFormatVersion || hdr->layer_size.get() != sizeof(sAccessTraceLayerEntry) || hdr->record_size.get() != sizeof(sAccessTraceRecordEntry))
+	{
+		throw fnd::Exception(kModuleName, "Unsupported access trace format version (" + path + ")");
+	}
+
+	uint64_t layer_table_offset = sizeof(sAccessTraceHeader);
+	uint64_t record_table_offset = layer_table_offset + (uint64_t)hdr->layer_num.get() * sizeof(sAccessTraceLayerEntry);
+	uint64_t string_pool_offset = record_table_offset + (uint64_t)hdr->record_num.get() * sizeof(sAccessTraceRecordEntry);
+	if (string_pool_offset + hdr->string_pool_size.get() > data.size())
+	{
+		throw fnd::Exception(kModuleName, "Access trace corrupt (" + path + ")");
+	}
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mCreationTime = hdr->creation_time.get();
+	mLayers.clear();
+	mRecords.clear();
+	mLastRecord.clear();
+
+	const sAccessTraceLayerEntry* layer = (const sAccessTraceLayerEntry*)(data.data() + layer_table_offset);
+	for (size_t i = 0; i < hdr->layer_num.get(); i++)
+	{
+		if ((uint64_t)layer[i].name_offset.get() + layer[i].name_size.get() > hdr->string_pool_size.get())
+		{
+			throw fnd::Exception(kModuleName, "Access trace corrupt (" + path + ")");
+		}
+		mLayers.push_back(std::string((const char*)(data.data() + string_pool_offset + layer[i].name_offset.get()), layer[i].name_size.get()));
+		mLastRecord.push_back(SIZE_MAX);
+	}
+
+	const sAccessTraceRecordEntry* record = (const sAccessTraceRecordEntry*)(data.data() + record_table_offset);
+	for (size_t i = 0; i < hdr->record_num.get(); i++)
+	{
+		if (record[i].layer_index.get() >= mLayers.size())
+		{
+			throw fnd::Exception(kModuleName, "Access trace corrupt (" + path + ")");
+		}
+		mRecords.push_back(record[i]);
+	}
+}
+
+void AccessTrace::save(const std::string& path) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	std::string string_pool;
+	for (size_t i = 0; i < mLayers.size(); i++)
+		string_pool += mLayers[i];
+
+	fnd::Vec<byte_t> data;
+	data.alloc(sizeof(sAccessTraceHeader) + mLayers.size() * sizeof(sAccessTraceLayerEntry) + mRecords.size() * sizeof(sAccessTraceRecordEntry) + string_pool.size());
+	memset(data.data(), 0, data.size());
+
+	sAccessTraceHeader* hdr = (sAccessTraceHeader*)data.data();
+	hdr->st_magic = accesstrace::kAccessTraceStructMagic;
+	hdr->format_version = accesstrace::kFormatVersion;
+	hdr->creation_time = mCreationTime;
+	hdr->layer_num = (uint32_t)mLayers.size();
+	hdr->layer_size = sizeof(sAccessTraceLayerEntry);
+	hdr->record_num = (uint32_t)mRecords.size();
+	hdr->record_size = sizeof(sAccessTraceRecordEntry);
+	hdr->string_pool_size = (uint32_t)string_pool.size();
+
+	sAccessTraceLayerEntry* layer = (sAccessTraceLayerEntry*)(data.data() + sizeof(sAccessTraceHeader));
+	uint32_t name_offset = 0;
+	for (size_t i = 0; i < mLayers.size(); i++)
+	{
+		layer[i].name_offset = name_offset;
+		layer[i].name_size = (uint32_t)mLayers[i].size();
+		name_offset += (uint32_t)mLayers[i].size();
+	}
+
+	sAccessTraceRecordEntry* record = (sAccessTraceRecordEntry*)(layer + mLayers.size());
+	for (size_t i = 0; i < mRecords.size(); i++)
+	{
+		record[i] = mRecords[i];
+	}
+	memcpy(record + mRecords.size(), string_pool.data(), string_pool.size());
+
+	fnd::io::replaceFile(path, data.data(), data.size());
+}
+
+size_t AccessTrace::addLayer(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	// a file opened again (by another job, or the server) continues its layer
+	for (size_t i = 0; i < mLayers.size(); i++)
+	{
+		if (mLayers[i] == name)
+			return i;
+	}
+
+	mLayers.push_back(name);
+	mLastRecord.push_back(SIZE_MAX);
+	return mLayers.size() - 1;
+}
+
+void AccessTrace::recordRead(size_t layer_index, uint64_t offset, uint64_t size)
+{
+	if (size == 0)
+		return;
+
+	uint64_t time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - mStartTime).count();
+
+	std::lock_guard<std::mutex> lock(mLock);
+
+	// a read continuing the last one of the layer extends its record
+	size_t last = mLastRecord[layer_index];
+	if (last != SIZE_MAX && mRecords[last].offset.get() + mRecords[last].size.get() == offset && mRecords[last].size.get() + size <= UINT32_MAX)
+	{
+		mRecords[last].size = (uint32_t)(mRecords[last].size.get() + size);
+		return;
+	}
+
+	// record sizes are 32 bit, larger reads take several
+	for (uint64_t pos = 0; pos < size; pos += UINT32_MAX)
+	{
+		sAccessTraceRecordEntry record;
+		record.offset = offset + pos;
+		record.size = (uint32_t)_MIN(size - pos, (uint64_t)UINT32_MAX);
+		record.layer_index = (uint32_t)layer_index;
+		record.time = time;
+		mRecords.push_back(record);
+	}
+	mLastRecord[layer_index] = mRecords.size() - 1;
+}
+
+uint64_t AccessTrace::getCreationTime() const
+{
+	return mCreationTime;
+}
+
+size_t AccessTrace::getLayerNum() const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	return mLayers.size();
+}
+
+std::string AccessTrace::getLayerName(size_t index) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	return mLayers[index];
+}
+
+size_t AccessTrace::getRecordNum() const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	return mRecords.size();
+}
+
+sAccessTraceRecordEntry AccessTrace::getRecord(size_t index) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	return mRecords[index];
+}
+
+bool AccessTrace::findLayer(const std::string& path, size_t& index) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	for (size_t i = 0; i < mLayers.size(); i++)
+	{
+		if (mLayers[i] == path)
+		{
+			index = i;
+			return true;
+		}
+	}
+
+	// the file may have been opened through another directory, the name is unique enough
+	std::string name = getFileName(path);
+	for (size_t i = 0; i < mLayers.size(); i++)
+	{
+		if (getFileName(mLayers[i]) == name)
+		{
+			index = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void AccessTrace::makePrefetchPlan(size_t layer_index, uint64_t max_gap_size, fnd::List<sExtent>& plan) const
+{
+	std::vector<sExtent> ranges;
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		for (size_t i = 0; i < mRecords.size(); i++)
+		{
+			if (mRecords[i].layer_index.get() == layer_index)
+				ranges.push_back({ mRecords[i].offset.get(), mRecords[i].size.get() });
+		}
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](const sExtent& a, const sExtent& b) { return a.offset < b.offset; });
+
+	// merge ranges that overlap or are less than max_gap_size apart
+	plan.clear();
+	for (size_t i = 0; i < ranges.size(); )
+	{
+		sExtent extent = ranges[i];
+		for (i++; i < ranges.size() && ranges[i].offset <= extent.offset + extent.size + max_gap_size; i++)
+		{
+			extent.size = _MAX(extent.size, ranges[i].offset + ranges[i].size - extent.offset);
+		}
+		plan.addElement(extent);
+	}
+}
+
+std::string AccessTrace::getFileName(const std::string& path)
+{
+	size_t pos = path.find_last_of("/\\");
+	return pos == std::string::npos ? path : path.substr(pos + 1);
+}
\ No newline at end of file
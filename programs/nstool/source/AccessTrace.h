@@ -0,0 +1,96 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <fnd/types.h>
+#include <fnd/List.h>
+#include <nx/macro.h>
+
+namespace accesstrace
+{
+	static const uint32_t kAccessTraceStructMagic = _MAKE_STRUCT_MAGIC_U32("NSAT");
+	static const uint32_t kFormatVersion = 1;
+}
+
+#pragma pack(push,1)
+struct sAccessTraceHeader
+{
+	le_uint32_t st_magic;
+	le_uint32_t format_version;
+	le_uint64_t creation_time;
+	le_uint32_t layer_num;
+	le_uint32_t layer_size;
+	le_uint32_t record_num;
+	le_uint32_t record_size;
+	le_uint32_t string_pool_size;
+	byte_t reserved[4];
+};
+
+// a traced file, named by the path it was opened with
+struct sAccessTraceLayerEntry
+{
+	le_uint32_t name_offset;
+	le_uint32_t name_size;
+};
+
+// a read, or a run of reads that each started where the one before ended
+struct sAccessTraceRecordEntry
+{
+	le_uint64_t offset;
+	le_uint32_t size;
+	le_uint32_t layer_index;
+	// microseconds since tracing started, when the first read of the run was made
+	le_uint64_t time;
+};
+#pragma pack(pop)
+
+// The reads made from input files during a session, in the order they were made.
+// The trace saved by one session is turned into a prefetch plan for the next: the
+// ranges a file was read at, in offset order, so they can be loaded with a few
+// large sequential reads before they are needed.
+class AccessTrace
+{
+public:
+	struct sExtent
+	{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// ranges closer than this are prefetched as one, reading the gap costs less than a seek
+	static const uint64_t kDefaultPlanGapSize = 0x10000;
+
+	AccessTrace();
+
+	void load(const std::string& path);
+	// atomically replaces any existing file
+	void save(const std::string& path) const;
+
+	// recording is safe from several threads
+	size_t addLayer(const std::string& name);
+	void recordRead(size_t layer_index, uint64_t offset, uint64_t size);
+
+	uint64_t getCreationTime() const;
+	size_t getLayerNum() const;
+	std::string getLayerName(size_t index) const;
+	size_t getRecordNum() const;
+	sAccessTraceRecordEntry getRecord(size_t index) const;
+
+	// finds the layer of a path, by the full path and then by the file name
+	bool findLayer(const std::string& path, size_t& index) const;
+	void makePrefetchPlan(size_t layer_index, uint64_t max_gap_size, fnd::List<sExtent>& plan) const;
+
+private:
+	const std::string kModuleName = "AccessTrace";
+
+	mutable std::mutex mLock;
+	std::chrono::steady_clock::time_point mStartTime;
+	uint64_t mCreationTime;
+	std::vector<std::string> mLayers;
+	std::vector<sAccessTraceRecordEntry> mRecords;
+	// index of the last record of each layer, which the next read may continue
+	std::vector<size_t> mLastRecord;
+
+	static std::string getFileName(const std::string& path);
+};
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "AccessTraceProcess.h"
+#include <ctime>
+#include <vector>
+
+AccessTraceProcess::AccessTraceProcess() :
+	mCliOutputMode(_BIT(OUTPUT_BASIC))
+{
+}
+
+void AccessTraceProcess::process()
+{
+	mTrace.load(mInputPath);
+
+	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+		displayTrace();
+}
+
+void AccessTraceProcess::setInputPath(const std::string& path)
+{
+	mInputPath = path;
+}
+
+void AccessTraceProcess::setCliOutputMode(CliOutputMode type)
+{
+	mCliOutputMode = type;
+}
+
+void AccessTraceProcess::displayTrace()
+{
+	struct sLayerStats
+	{
+		size_t record_num;
+		uint64_t read_size;
+		uint64_t first_time;
+		uint64_t last_time;
+	};
+
+	std::vector<sLayerStats> stats(mTrace.getLayerNum(), sLayerStats{ 0, 0, 0, 0 });
+	for (size_t i = 0; i < mTrace.getRecordNum(); i++)
+	{
+		sAccessTraceRecordEntry record = mTrace.getRecord(i);
+		sLayerStats& layer = stats[record.layer_index.get()];
+		if (layer.record_num == 0)
+			layer.first_time = record.time.get();
+		layer.last_time = record.time.get();
+		layer.record_num++;
+		layer.read_size += record.size.get();
+	}
+
+	time_t creation_time = (time_t)mTrace.getCreationTime();
+	char time_str[0x40] = "";
+	strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", gmtime(&creation_time));
+
+	printf("[Access Trace]\n");
+	printf("  CreationTime:   %s UTC\n", time_str);
+	printf("  LayerNum:       %" PRIu64 "\n", (uint64_t)mTrace.getLayerNum());
+	printf("  RecordNum:      %" PRIu64 "\n", (uint64_t)mTrace.getRecordNum());
+
+	for (size_t i = 0; i < mTrace.getLayerNum(); i++)
+	{
+		fnd::List<AccessTrace::sExtent> plan;
+		mTrace.makePrefetchPlan(i, AccessTrace::kDefaultPlanGapSize, plan);
+
+		uint64_t plan_size = 0;
+		for (size_t j = 0; j < plan.size(); j++)
+			plan_size += plan[j].size;
+
+		printf("  %s\n", mTrace.getLayerName(i).c_str());
+		printf("    RecordNum:    %" PRIu64 "\n", (uint64_t)stats[i].record_num);
+		printf("    ReadSize:     0x%" PRIx64 "\n", stats[i].read_size);
+		printf("    ReadTime:     %.3fs - %.3fs\n", stats[i].first_time / 1000000.0, stats[i].last_time / 1000000.0);
+		printf("    PrefetchPlan: %" PRIu64 " extents, 0x%" PRIx64 " bytes\n", (uint64_t)plan.size(), plan_size);
+		if (_HAS_BIT(mCliOutputMode, OUTPUT_EXTENDED))
+		{
+			for (size_t j = 0; j < plan.size(); j++)
+				printf("      0x%012" PRIx64 "-0x%012" PRIx64 "\n", plan[j].offset, plan[j].offset + plan[j].size);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include "AccessTrace.h"
+
+#include "nstool.h"
+
+// Shows the layers of an access trace and the prefetch plan each one makes
+class AccessTraceProcess
+{
+public:
+	AccessTraceProcess();
+
+	void process();
+
+	void setInputPath(const std::string& path);
+	void setCliOutputMode(CliOutputMode type);
+
+private:
+	const std::string kModuleName = "AccessTraceProcess";
+
+	std::string mInputPath;
+	CliOutputMode mCliOutputMode;
+
+	AccessTrace mTrace;
+
+	void displayTrace();
+};
\ No newline at end of file
@@ -32,25 +32,29 @@ void AesCtrWrappedIFile::read(byte_t* out, size_t len)
 {
 	//printf("[%x] AesCtrWrappedIFile::read(offset=0x%" PRIx64 ", size=0x%" PRIx64 ")\n", this, mFileOffset, len);
 
-	size_t read_len;
-	size_t read_pos; 
+	size_t read_pos = 0;
 
-	size_t cache_reads = (len / kCacheSize) + ((len % kCacheSize) != 0);
-
-	for (size_t i = 0; i < cache_reads; i++)
+	// a read starting inside an AES block decrypts that block in the cache
+	size_t offset_in_block = mFileOffset & 0xf;
+	if (offset_in_block != 0)
 	{
-		read_len = _MIN(len - (i * kCacheSize), kCacheSize);
-		read_pos = ((mFileOffset >> 4) << 4) + (i * kCacheSize);
+		read_pos = _MIN(len, crypto::aes::kAesBlockSize - offset_in_block);
+
+		mFile->read(mCache.data(), mFileOffset - offset_in_block, crypto::aes::kAesBlockSize);
 
-		//printf("[%x] AesCtrWrappedIFile::read() CACHE READ: readlen=%" PRIx64 "\n", this, read_len);
-		
-		mFile->seek(read_pos);
-		mFile->read(mCache.data(), kCacheSizeAllocSize);
+		crypto::aes::AesIncrementCounter(mBaseCtr.iv, mFileOffset>>4, mCurrentCtr.iv);
+		crypto::aes::AesCtr(mCache.data(), crypto::aes::kAesBlockSize, mKey.key, mCurrentCtr.iv, mCache.data());
+
+		memcpy(out, mCache.data() + offset_in_block, read_pos);
+	}
 
-		crypto::aes::AesIncrementCounter(mBaseCtr.iv, read_pos>>4, mCurrentCtr.iv);
-		crypto::aes::AesCtr(mCache.data(), kCacheSizeAllocSize, mKey.key, mCurrentCtr.iv, mCache.data());
+	// the rest is block aligned, so it is read and decrypted in place in the caller's buffer
+	if (read_pos < len)
+	{
+		mFile->read(out + read_pos, mFileOffset + read_pos, len - read_pos);
 
-		memcpy(out + (i * kCacheSize), mCache.data() + (mFileOffset & 0xf), read_len);
+		crypto::aes::AesIncrementCounter(mBaseCtr.iv, (mFileOffset + read_pos)>>4, mCurrentCtr.iv);
+		crypto::aes::AesCtr(out + read_pos, len - read_pos, mKey.key, mCurrentCtr.iv, out + read_pos);
 	}
 
 	seek(mFileOffset + len);
@@ -64,46 +68,40 @@ void AesCtrWrappedIFile::read(byte_t* out, size_t offset, size_t len)
 
 void AesCtrWrappedIFile::write(const byte_t* in, size_t len)
 {
-	size_t write_len;
-	size_t write_pos; 
-
-	size_t cache_writes = (len / kCacheSize) + ((len % kCacheSize) != 0);
-
-	for (size_t i = 0; i < cache_writes; i++)
+	if (mWriteBuffer.size() == 0)
 	{
-		write_len = _MIN(len - (i * kCacheSize), kCacheSize);
-		write_pos = ((mFileOffset >> 4) << 4) + (i * kCacheSize);
-
-		//printf("[%x] AesCtrWrappedIFile::read() CACHE READ: readlen=%" PRIx64 "\n", this, read_len);
-		
-		memcpy(mCache.data() + (mFileOffset & 0xf), in + (i * kCacheSize), write_len);
-
-		crypto::aes::AesIncrementCounter(mBaseCtr.iv, write_pos>>4, mCurrentCtr.iv);
-		crypto::aes::AesCtr(mCache.data(), kCacheSizeAllocSize, mKey.key, mCurrentCtr.iv, mCache.data());
-
-		mFile->seek(write_pos);
-		mFile->write(mCache.data(), kCacheSizeAllocSize);
+		setWriteThreadNum(0);
 	}
 
-	seek(mFileOffset + len);
-
-	/*
-	for (size_t i = 0; i < (len / kAesCtrScratchSize); i++)
+	// the input is copied into the buffer at its offset in its first AES block, so every pass
+	// encrypts from a block boundary (the bytes around the input are encrypted, but not written)
+	size_t write_pos = 0;
+	while (write_pos < len)
 	{
-		memcpy(mScratch.data() + mBlockOffset, out + (i * kAesCtrScratchSize), kAesCtrScratchSize);
-		crypto::aes::AesCtr(mScratch.data(), kAesCtrScratchAllocSize, mKey.key, mCurrentCtr.iv, mScratch.data());
-		mFile->write(mScratch.data() + mBlockOffset, kAesCtrScratchSize);
+		size_t file_offset = mFileOffset + write_pos;
+		size_t offset_in_block = file_offset & 0xf;
+		size_t write_len = _MIN(len - write_pos, mWriteBuffer.size() - offset_in_block);
+		size_t crypt_len = (size_t)align(offset_in_block + write_len, crypto::aes::kAesBlockSize);
+
+		byte_t* buf = mWriteBuffer.data();
+		memcpy(buf + offset_in_block, in + write_pos, write_len);
+
+		size_t block_index = (file_offset - offset_in_block) >> 4;
+		for (size_t task_pos = 0; task_pos < crypt_len; task_pos += kWriteTaskSize)
+		{
+			size_t task_len = _MIN(crypt_len - task_pos, kWriteTaskSize);
+			mWritePool->enqueue([this, buf, task_pos, task_len, block_index] {
+				crypto::aes::sAesIvCtr ctr;
+				crypto::aes::AesIncrementCounter(mBaseCtr.iv, block_index + (task_pos >> 4), ctr.iv);
+				crypto::aes::AesCtr(buf + task_pos, task_len, mKey.key, ctr.iv, buf + task_pos);
+			});
+		}
+		mWritePool->wait();
+
+		mFile->write(buf + offset_in_block, file_offset, write_len);
+		write_pos += write_len;
 	}
 
-	if (len % kAesCtrScratchSize)
-	{
-		size_t write_len = len % kAesCtrScratchSize;
-		size_t write_pos = ((len / kAesCtrScratchSize) * kAesCtrScratchSize); 
-		memcpy(mScratch.data() + mBlockOffset, out + write_pos, write_len);
-		crypto::aes::AesCtr(mScratch.data(), kAesCtrScratchAllocSize, mKey.key, mCurrentCtr.iv, mScratch.data());
-		mFile->write(mScratch.data() + mBlockOffset, write_len);
-	}
-	*/
 	seek(mFileOffset + len);
 }
 
@@ -111,4 +109,40 @@ void AesCtrWrappedIFile::write(const byte_t* in, size_t offset, size_t len)
 {
 	seek(offset);
 	write(in, len);
+}
+
+void AesCtrWrappedIFile::setAccessHint(AccessHint hint)
+{
+	mFile->setAccessHint(hint);
+}
+
+void AesCtrWrappedIFile::setWriteThreadNum(size_t thread_num)
+{
+	mWritePool.reset(new ThreadPool(thread_num));
+	mWriteBuffer.alloc(kWriteTaskSize * mWritePool->getThreadNum());
+}
+
+void AesCtrWrappedIFile::readv(const sReadRange* ranges, size_t num)
+{
+	if (num == 0)
+		return;
+
+	// block aligned ranges are read together and decrypted in place, the rest go through read()
+	std::vector<sReadRange> aligned;
+	for (size_t i = 0; i < num; i++)
+	{
+		if ((ranges[i].offset & 0xf) == 0)
+			aligned.push_back(ranges[i]);
+		else
+			read(ranges[i].out, ranges[i].offset, ranges[i].len);
+	}
+
+	mFile->readv(aligned.data(), aligned.size());
+	for (size_t i = 0; i < aligned.size(); i++)
+	{
+		crypto::aes::AesIncrementCounter(mBaseCtr.iv, aligned[i].offset>>4, mCurrentCtr.iv);
+		crypto::aes::AesCtr(aligned[i].out, aligned[i].len, mKey.key, mCurrentCtr.iv, aligned[i].out);
+	}
+
+	seek(ranges[num - 1].offset + ranges[num - 1].len);
 }
\ No newline at end of file
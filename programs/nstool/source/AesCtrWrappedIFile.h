@@ -1,6 +1,10 @@
+#pragma once
+#include <vector>
+#include <memory>
 #include <fnd/IFile.h>
 #include <fnd/Vec.h>
 #include <crypto/aes.h>
+#include "ThreadPool.h"
 
 class AesCtrWrappedIFile : public fnd::IFile
 {
@@ -14,10 +18,17 @@ public:
 	void read(byte_t* out, size_t offset, size_t len);
 	void write(const byte_t* out, size_t len);
 	void write(const byte_t* out, size_t offset, size_t len);
+	void setAccessHint(AccessHint hint);
+	void readv(const sReadRange* ranges, size_t num);
+
+	// writes are encrypted out of place, split across this many threads (0 or 1 encrypts inline)
+	void setWriteThreadNum(size_t thread_num);
 private:
 	const std::string kModuleName = "AesCtrWrappedIFile";
 	static const size_t kCacheSize = 0x10000;
 	static const size_t kCacheSizeAllocSize = kCacheSize + crypto::aes::kAesBlockSize;
+	// data encrypted by one write task
+	static const size_t kWriteTaskSize = 0x100000;
 
 	bool mOwnIFile;
 	fnd::IFile* mFile;
@@ -26,4 +37,7 @@ private:
 	size_t mFileOffset;
 
 	fnd::Vec<byte_t> mCache;
+
+	std::unique_ptr<ThreadPool> mWritePool;
+	fnd::Vec<byte_t> mWriteBuffer;
 };
\ No newline at end of file
@@ -70,6 +70,21 @@ void AssetProcess::setRomfsExtractPath(const std::string& path)
 	mRomfs.setExtractPath(path);
 }
 
+void AssetProcess::setRomfsExtractFilter(const PathFilter& filter)
+{
+	mRomfs.setExtractFilter(filter);
+}
+
+void AssetProcess::setRomfsIncrementalExtract(bool incremental)
+{
+	mRomfs.setIncrementalExtract(incremental);
+}
+
+void AssetProcess::setRomfsExtractStorePath(const std::string& store_path)
+{
+	mRomfs.setExtractStorePath(store_path);
+}
+
 
 void AssetProcess::importHeader()
 {
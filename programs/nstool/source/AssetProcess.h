@@ -25,6 +25,9 @@ public:
 	void setIconExtractPath(const std::string& path);
 	void setNacpExtractPath(const std::string& path);
 	void setRomfsExtractPath(const std::string& path);
+	void setRomfsExtractFilter(const PathFilter& filter);
+	void setRomfsIncrementalExtract(bool incremental);
+	void setRomfsExtractStorePath(const std::string& store_path);
 
 
 private:
@@ -0,0 +1,607 @@
+#include "BatchProcess.h"
+#include "FileProcess.h"
+#include "ThreadPool.h"
+#include "OutputCapture.h"
+#include "CatalogueScanner.h"
+#include "BlockIndexScanner.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <fnd/io.h>
+#include <fnd/SimpleFile.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <fnd/StringConv.h>
+#else
+#include <glob.h>
+#endif
+
+BatchProcess::BatchProcess() :
+	mUserSettings(nullptr),
+	mInputIsFileList(false),
+	mJobNum(0),
+	mVerifyCache(nullptr),
+	mCatalogueRetainNum(0),
+	mCatalogueDropNum(0),
+	mNextPrintIndex(0)
+{
+}
+
+void BatchProcess::process()
+{
+	if (mUserSettings == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No user settings set.");
+	}
+
+	// build the list of files to process
+	mEntries.clear();
+	if (mInputIsFileList)
+		collectInputFileList(mInputPath);
+	else
+		collectInputPath(mInputPath);
+
+	if (mEntries.empty())
+	{
+		throw fnd::Exception(kModuleName, "No input files found.");
+	}
+
+	// without output capture concurrent processes would interleave their output
+	size_t job_num = mJobNum != 0 ? mJobNum : ThreadPool::getDefaultThreadNum();
+	if (OutputCapture::isSupported() == false)
+		job_num = 1;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (mCataloguePath.isSet)
+		loadCatalogue();
+
+	mNextPrintIndex = 0;
+	{
+		ThreadPool pool(job_num);
+		for (size_t i = 0; i < mEntries.size(); i++)
+		{
+			pool.enqueue([this, i] { processEntry(i); });
+		}
+		pool.wait();
+	}
+
+	if (mCataloguePath.isSet)
+		saveCatalogue();
+	if (mBlockIndexPath.isSet)
+		saveBlockIndex();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	displaySummary(elapsed.count());
+}
+
+void BatchProcess::setUserSettings(const UserSettings* user_set)
+{
+	mUserSettings = user_set;
+}
+
+void BatchProcess::setInputPath(const std::string& path)
+{
+	mInputPath = path;
+}
+
+void BatchProcess::setInputIsFileList(bool is_list)
+{
+	mInputIsFileList = is_list;
+}
+
+void BatchProcess::setJobNum(size_t job_num)
+{
+	mJobNum = job_num;
+}
+
+void BatchProcess::setCataloguePath(const std::string& path)
+{
+	mCataloguePath = path;
+}
+
+void BatchProcess::setBlockIndexPath(const std::string& path)
+{
+	mBlockIndexPath = path;
+}
+
+void BatchProcess::setVerifyCache(VerifyCache* cache)
+{
+	mVerifyCache = cache;
+}
+
+void BatchProcess::collectInputFileList(const std::string& list_path)
+{
+	std::vector<std::string> paths;
+	fnd::io::getLineList(list_path, paths);
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		collectInputPath(paths[i]);
+	}
+}
+
+void BatchProcess::collectInputPath(const std::string& path)
+{
+	if (path.find_first_of("*?") != std::string::npos)
+	{
+		std::vector<std::string> matches;
+		expandWildcardPath(path, matches);
+		for (size_t i = 0; i < matches.size(); i++)
+		{
+			if (fnd::io::isDirectory(matches[i]))
+				collectDirectory(matches[i]);
+			else
+			{
+				sBatchEntry entry;
+				entry.path = matches[i];
+				mEntries.push_back(entry);
+			}
+		}
+	}
+	else if (fnd::io::isDirectory(path))
+	{
+		collectDirectory(path);
+	}
+	else
+	{
+		sBatchEntry entry;
+		entry.path = path;
+		mEntries.push_back(entry);
+	}
+}
+
+void BatchProcess::collectDirectory(const std::string& path)
+{
+	fnd::List<std::string> dirs, files;
+	fnd::io::getDirectoryListing(path, dirs, files);
+
+	// sort so the batch order (and output) is stable between runs
+	std::vector<std::string> names;
+	for (size_t i = 0; i < files.size(); i++)
+		names.push_back(files[i]);
+	std::sort(names.begin(), names.end());
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		sBatchEntry entry;
+		fnd::io::appendToPath(entry.path, path);
+		fnd::io::appendToPath(entry.path, names[i]);
+		mEntries.push_back(entry);
+	}
+
+	names.clear();
+	for (size_t i = 0; i < dirs.size(); i++)
+		names.push_back(dirs[i]);
+	std::sort(names.begin(), names.end());
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		std::string dir_path;
+		fnd::io::appendToPath(dir_path, path);
+		fnd::io::appendToPath(dir_path, names[i]);
+		collectDirectory(dir_path);
+	}
+}
+
+void BatchProcess::expandWildcardPath(const std::string& pattern, std::vector<std::string>& matches)
+{
+#ifdef _WIN32
+	// FindFirstFile only expands wildcards in the last path component
+	std::string dir_path;
+	size_t divider = pattern.find_last_of("\\/");
+	if (divider != std::string::npos)
+		dir_path = pattern.substr(0, divider);
+
+	std::u16string wpattern = fnd::StringConv::ConvertChar8ToChar16(pattern);
+	WIN32_FIND_DATAW find_data;
+	HANDLE find = FindFirstFileW((LPCWSTR)wpattern.c_str(), &find_data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+
+	do
+	{
+		std::string name = fnd::StringConv::ConvertChar16ToChar8(std::u16string((char16_t*)find_data.cFileName));
+		if (name == "." || name == "..")
+			continue;
+
+		std::string match_path;
+		fnd::io::appendToPath(match_path, dir_path);
+		fnd::io::appendToPath(match_path, name);
+		matches.push_back(match_path);
+	} while (FindNextFileW(find, &find_data));
+
+	FindClose(find);
+	std::sort(matches.begin(), matches.end());
+#else
+	glob_t glob_result;
+	if (glob(pattern.c_str(), 0, nullptr, &glob_result) == 0)
+	{
+		for (size_t i = 0; i < glob_result.gl_pathc; i++)
+		{
+			matches.push_back(glob_result.gl_pathv[i]);
+		}
+	}
+	globfree(&glob_result);
+#endif
+}
+
+void BatchProcess::processEntry(size_t index)
+{
+	sBatchEntry& entry = mEntries[index];
+	OutputCapture capture;
+
+	try
+	{
+		if (mCataloguePath.isSet)
+		{
+			// anything printed while scanning is discarded, the entry only reports what was recorded
+			capture.begin();
+			processCatalogueEntry(entry);
+			capture.end();
+
+			entry.success = entry.record.error.empty();
+			if (entry.success == false)
+				entry.error = entry.record.error;
+		}
+		else if (mBlockIndexPath.isSet)
+		{
+			capture.begin();
+			processBlockIndexEntry(entry);
+			capture.end();
+		}
+		else
+		{
+			fnd::IFile* file = mUserSettings->openInputFile(entry.path);
+			FileProcess obj;
+			obj.setInputFile(file, OWN_IFILE);
+			obj.setInputPath(entry.path);
+			obj.setVerifyCache(mVerifyCache);
+
+			// the file is sniffed through the same handle it is processed with
+			entry.size = file->size();
+			if (mUserSettings->getFileType() != FILE_INVALID)
+				entry.type = mUserSettings->getFileType();
+			else
+				entry.type = mUserSettings->determineFileType(file);
+
+			if (entry.type != FILE_INVALID)
+			{
+				obj.setFileType(entry.type);
+				obj.setUserSettings(mUserSettings);
+
+				capture.begin();
+				obj.process();
+				capture.end();
+
+				entry.success = true;
+			}
+		}
+	}
+	catch (const fnd::Exception& e)
+	{
+		entry.error = e.what();
+	}
+	catch (const std::exception& e)
+	{
+		entry.error = e.what();
+	}
+	capture.end();
+
+	{
+		std::lock_guard<std::mutex> lock(mPrintLock);
+		if (mCataloguePath.isSet == false && mBlockIndexPath.isSet == false)
+			entry.output = capture.getOutput();
+		entry.done = true;
+	}
+
+	printCompletedEntries();
+}
+
+void BatchProcess::processCatalogueEntry(sBatchEntry& entry)
+{
+	CatalogueIndex::sFileRecord& record = entry.record;
+
+	entry.size = fnd::io::getFileSize(entry.path);
+	uint64_t mtime = fnd::io::getFileModifiedTime(entry.path);
+
+	// a file with the same size and mtime as when it was indexed is not opened at all
+	std::unordered_map<std::string, size_t>::const_iterator indexed = mCatalogueFileMap.find(entry.path);
+	if (indexed != mCatalogueFileMap.end())
+	{
+		const sCatalogueFileEntry& old_entry = mCatalogue.getFileEntry(indexed->second);
+		if (old_entry.size.get() == entry.size && old_entry.mtime.get() == mtime)
+		{
+			mCatalogue.getFileRecord(indexed->second, record);
+			entry.type = (FileType)(int32_t)record.entry.file_type.get();
+			entry.catalogue_state = CATALOGUE_UNCHANGED;
+			return;
+		}
+	}
+
+	fnd::IFile* file = mUserSettings->openInputFile(entry.path);
+	CatalogueScanner scanner;
+	scanner.setInputFile(file, OWN_IFILE);
+
+	// a touched but otherwise unchanged file is recognised by the hash of its header region
+	byte_t header_hash[crypto::sha::kSha256HashLen];
+	{
+		fnd::Vec<byte_t> scratch;
+		scratch.alloc(_MIN(kCatalogueHeaderHashSize, entry.size));
+		file->read(scratch.data(), 0, scratch.size());
+		crypto::sha::Sha256(scratch.data(), scratch.size(), header_hash);
+	}
+
+	if (indexed != mCatalogueFileMap.end())
+	{
+		const sCatalogueFileEntry& old_entry = mCatalogue.getFileEntry(indexed->second);
+		if (old_entry.size.get() == entry.size && memcmp(old_entry.header_hash, header_hash, crypto::sha::kSha256HashLen) == 0)
+		{
+			mCatalogue.getFileRecord(indexed->second, record);
+			record.entry.mtime = mtime;
+			entry.type = (FileType)(int32_t)record.entry.file_type.get();
+			entry.catalogue_state = CATALOGUE_UNCHANGED;
+			return;
+		}
+	}
+
+	if (mUserSettings->getFileType() != FILE_INVALID)
+		entry.type = mUserSettings->getFileType();
+	else
+		entry.type = mUserSettings->determineFileType(file);
+
+	// files that can't hold NCAs are still recorded so they aren't sniffed again next time
+	if (entry.type == FILE_XCI || entry.type == FILE_NSP || entry.type == FILE_PARTITIONFS || entry.type == FILE_NCA)
+	{
+		scanner.setInputName(entry.path.substr(entry.path.find_last_of("/\\") == std::string::npos ? 0 : entry.path.find_last_of("/\\") + 1));
+		scanner.setFileType(entry.type);
+		scanner.setKeyset(&mUserSettings->getKeyset());
+
+		try
+		{
+			scanner.process();
+			record = scanner.getFileRecord();
+		}
+		catch (const fnd::Exception& e)
+		{
+			// keep the failure in the index, the file is only rescanned once it changes
+			record = scanner.getFileRecord();
+			record.error = e.what();
+			record.entry.status = _BIT(catalogue::FILE_STATUS_SCAN_ERROR);
+		}
+	}
+	else
+	{
+		memset(&record.entry, 0, sizeof(sCatalogueFileEntry));
+	}
+
+	record.entry.file_type = (uint32_t)entry.type;
+	record.entry.size = entry.size;
+	record.entry.mtime = mtime;
+	memcpy(record.entry.header_hash, header_hash, crypto::sha::kSha256HashLen);
+	entry.catalogue_state = CATALOGUE_SCANNED;
+}
+
+void BatchProcess::loadCatalogue()
+{
+	mCatalogue.close();
+	mCatalogueFileMap.clear();
+
+	// a missing index is created from scratch
+	if (fnd::io::fileExists(mCataloguePath.var) == false)
+		return;
+
+	mCatalogue.open(mCataloguePath.var);
+	for (size_t i = 0; i < mCatalogue.getFileNum(); i++)
+	{
+		mCatalogueFileMap[mCatalogue.getString(mCatalogue.getFileEntry(i).path)] = i;
+	}
+}
+
+void BatchProcess::saveCatalogue()
+{
+	fnd::List<CatalogueIndex::sFileRecord> records;
+	std::unordered_map<std::string, size_t> batch_paths;
+
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		if (mEntries[i].catalogue_state == CATALOGUE_NONE || batch_paths.count(mEntries[i].path) != 0)
+			continue;
+
+		mEntries[i].record.path = mEntries[i].path;
+		records.addElement(mEntries[i].record);
+		batch_paths[mEntries[i].path] = i;
+	}
+
+	// files indexed by an earlier batch are kept for as long as they exist
+	mCatalogueRetainNum = 0;
+	mCatalogueDropNum = 0;
+	for (size_t i = 0; i < mCatalogue.getFileNum(); i++)
+	{
+		CatalogueIndex::sFileRecord record;
+		std::string path = mCatalogue.getString(mCatalogue.getFileEntry(i).path);
+		if (batch_paths.count(path) != 0)
+			continue;
+
+		if (fnd::io::fileExists(path))
+		{
+			mCatalogue.getFileRecord(i, record);
+			records.addElement(record);
+			mCatalogueRetainNum++;
+		}
+		else
+		{
+			mCatalogueDropNum++;
+		}
+	}
+
+	// the old index stays mapped until every record has been copied out of it
+	mCatalogue.close();
+	CatalogueIndex::save(mCataloguePath.var, records);
+}
+
+void BatchProcess::processBlockIndexEntry(sBatchEntry& entry)
+{
+	fnd::IFile* file = mUserSettings->openInputFile(entry.path);
+	BlockIndexScanner scanner;
+	scanner.setInputFile(file, OWN_IFILE);
+
+	entry.size = file->size();
+	if (mUserSettings->getFileType() != FILE_INVALID)
+		entry.type = mUserSettings->getFileType();
+	else
+		entry.type = mUserSettings->determineFileType(file);
+
+	// only containers of NCAs have hash trees to harvest
+	if (entry.type != FILE_XCI && entry.type != FILE_NSP && entry.type != FILE_PARTITIONFS && entry.type != FILE_NCA)
+	{
+		entry.type = FILE_INVALID;
+		return;
+	}
+
+	scanner.setInputPath(entry.path);
+	scanner.setFileType(entry.type);
+	scanner.setKeyset(&mUserSettings->getKeyset());
+	scanner.process();
+
+	entry.block_sources = scanner.getSources();
+	entry.success = scanner.getError().empty();
+	if (entry.success == false)
+		entry.error = scanner.getError();
+}
+
+void BatchProcess::saveBlockIndex()
+{
+	fnd::List<BlockIndex::sSourceRecord> sources;
+	std::unordered_map<std::string, size_t> batch_paths;
+
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		if (batch_paths.count(mEntries[i].path) != 0)
+			continue;
+		batch_paths[mEntries[i].path] = i;
+
+		for (size_t j = 0; j < mEntries[i].block_sources.size(); j++)
+			sources.addElement(mEntries[i].block_sources[j]);
+
+		// the hashes are only needed until the index is written
+		mEntries[i].block_sources.clear();
+	}
+
+	BlockIndex::save(mBlockIndexPath.var, sources);
+}
+
+void BatchProcess::printCompletedEntries()
+{
+	// entries are printed in batch order as soon as all entries before them have completed
+	std::lock_guard<std::mutex> lock(mPrintLock);
+	while (mNextPrintIndex < mEntries.size() && mEntries[mNextPrintIndex].done)
+	{
+		sBatchEntry& entry = mEntries[mNextPrintIndex];
+		if (entry.type != FILE_INVALID || entry.error.empty() == false)
+			displayEntry(entry);
+		entry.output.clear();
+		mNextPrintIndex++;
+	}
+}
+
+void BatchProcess::displayEntry(const sBatchEntry& entry)
+{
+	std::string block;
+	char line[0x200];
+
+	block += "[Batch Entry]\n";
+	block += "  Path:         " + entry.path + "\n";
+	block += "  Type:         " + getFileTypeStr(entry.type) + "\n";
+	snprintf(line, sizeof(line), "  Size:         0x%" PRIx64 "\n", entry.size);
+	block += line;
+	block += entry.output;
+	if (entry.catalogue_state != CATALOGUE_NONE)
+	{
+		snprintf(line, sizeof(line), "  Catalogue:    %s (NcaNum: %" PRIu64 ", TitleNum: %" PRIu64 ")\n", entry.catalogue_state == CATALOGUE_SCANNED ? "Scanned" : "Unchanged", (uint64_t)entry.record.nca.size(), (uint64_t)entry.record.title.size());
+		block += line;
+	}
+	if (mBlockIndexPath.isSet)
+	{
+		uint64_t block_num = 0;
+		for (size_t i = 0; i < entry.block_sources.size(); i++)
+			block_num += entry.block_sources[i].block_hash.size();
+		snprintf(line, sizeof(line), "  BlockIndex:   %" PRIu64 " partitions, %" PRIu64 " blocks\n", (uint64_t)entry.block_sources.size(), block_num);
+		block += line;
+	}
+	if (entry.success)
+		block += "  Result:       OK\n";
+	else
+		block += "  Result:       FAIL (" + entry.error + ")\n";
+
+	OutputCapture::print(block);
+}
+
+void BatchProcess::displaySummary(double elapsed_sec)
+{
+	std::map<std::string, size_t> type_count;
+	size_t success_num = 0;
+	size_t fail_num = 0;
+	size_t unknown_num = 0;
+	uint64_t total_size = 0;
+
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		const sBatchEntry& entry = mEntries[i];
+		total_size += entry.size;
+		if (entry.type == FILE_INVALID && entry.error.empty())
+		{
+			unknown_num++;
+			continue;
+		}
+
+		type_count[getFileTypeStr(entry.type)]++;
+		if (entry.success)
+			success_num++;
+		else
+			fail_num++;
+	}
+
+	printf("[Batch Summary]\n");
+	printf("  FileNum:      %" PRIu64 "\n", (uint64_t)mEntries.size());
+	for (std::map<std::string, size_t>::iterator itr = type_count.begin(); itr != type_count.end(); itr++)
+	{
+		printf("    %-14s%" PRIu64 "\n", (itr->first + ":").c_str(), (uint64_t)itr->second);
+	}
+	printf("  Unrecognised: %" PRIu64 "\n", (uint64_t)unknown_num);
+	printf("  Succeeded:    %" PRIu64 "\n", (uint64_t)success_num);
+	printf("  Failed:       %" PRIu64 "\n", (uint64_t)fail_num);
+	if (fail_num > 0)
+	{
+		printf("  Failures:\n");
+		for (size_t i = 0; i < mEntries.size(); i++)
+		{
+			const sBatchEntry& entry = mEntries[i];
+			if (entry.success == false && entry.error.empty() == false)
+				printf("    %s (%s)\n", entry.path.c_str(), entry.error.c_str());
+		}
+	}
+	if (mCataloguePath.isSet)
+	{
+		size_t scan_num = 0;
+		size_t unchanged_num = 0;
+		for (size_t i = 0; i < mEntries.size(); i++)
+		{
+			if (mEntries[i].catalogue_state == CATALOGUE_SCANNED)
+				scan_num++;
+			else if (mEntries[i].catalogue_state == CATALOGUE_UNCHANGED)
+				unchanged_num++;
+		}
+
+		printf("  Catalogue:    %s\n", mCataloguePath.var.c_str());
+		printf("    Scanned:    %" PRIu64 "\n", (uint64_t)scan_num);
+		printf("    Unchanged:  %" PRIu64 "\n", (uint64_t)unchanged_num);
+		printf("    Retained:   %" PRIu64 "\n", (uint64_t)mCatalogueRetainNum);
+		printf("    Dropped:    %" PRIu64 "\n", (uint64_t)mCatalogueDropNum);
+	}
+	if (mBlockIndexPath.isSet)
+		printf("  BlockIndex:   %s\n", mBlockIndexPath.var.c_str());
+	printf("  Elapsed:      %.3f sec\n", elapsed_sec);
+	if (elapsed_sec > 0)
+	{
+		printf("  Throughput:   %.2f files/sec, %.2f MiB/sec\n", mEntries.size() / elapsed_sec, (total_size / (1024.0 * 1024.0)) / elapsed_sec);
+	}
+}
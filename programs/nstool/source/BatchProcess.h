@@ -0,0 +1,92 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <fnd/types.h>
+#include "UserSettings.h"
+#include "CatalogueIndex.h"
+#include "BlockIndex.h"
+#include "VerifyCache.h"
+
+#include "nstool.h"
+
+class BatchProcess
+{
+public:
+	BatchProcess();
+
+	void process();
+
+	void setUserSettings(const UserSettings* user_set);
+	void setInputPath(const std::string& path);
+	void setInputIsFileList(bool is_list);
+	void setJobNum(size_t job_num);
+	void setCataloguePath(const std::string& path);
+	void setBlockIndexPath(const std::string& path);
+	void setVerifyCache(VerifyCache* cache);
+
+private:
+	const std::string kModuleName = "BatchProcess";
+	static const size_t kCatalogueHeaderHashSize = 0x4000;
+
+	enum CatalogueState
+	{
+		CATALOGUE_NONE,
+		CATALOGUE_SCANNED,
+		CATALOGUE_UNCHANGED
+	};
+
+	struct sBatchEntry
+	{
+		std::string path;
+		FileType type;
+		uint64_t size;
+		bool done;
+		bool success;
+		std::string output;
+		std::string error;
+		CatalogueState catalogue_state;
+		CatalogueIndex::sFileRecord record;
+		fnd::List<BlockIndex::sSourceRecord> block_sources;
+
+		sBatchEntry() :
+			type(FILE_INVALID),
+			size(0),
+			done(false),
+			success(false),
+			catalogue_state(CATALOGUE_NONE)
+		{}
+	};
+
+	const UserSettings* mUserSettings;
+	std::string mInputPath;
+	bool mInputIsFileList;
+	size_t mJobNum;
+	sOptional<std::string> mCataloguePath;
+	sOptional<std::string> mBlockIndexPath;
+	VerifyCache* mVerifyCache;
+
+	CatalogueIndex mCatalogue;
+	std::unordered_map<std::string, size_t> mCatalogueFileMap;
+	size_t mCatalogueRetainNum;
+	size_t mCatalogueDropNum;
+
+	std::vector<sBatchEntry> mEntries;
+	std::mutex mPrintLock;
+	size_t mNextPrintIndex;
+
+	void collectInputFileList(const std::string& list_path);
+	void collectInputPath(const std::string& path);
+	void collectDirectory(const std::string& path);
+	void expandWildcardPath(const std::string& pattern, std::vector<std::string>& matches);
+	void processEntry(size_t index);
+	void processCatalogueEntry(sBatchEntry& entry);
+	void loadCatalogue();
+	void saveCatalogue();
+	void processBlockIndexEntry(sBatchEntry& entry);
+	void saveBlockIndex();
+	void printCompletedEntries();
+	void displayEntry(const sBatchEntry& entry);
+	void displaySummary(double elapsed_sec);
+};
@@ -0,0 +1,202 @@
+#include "BlockIndex.h"
+#include <cstdio>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <fnd/SimpleFile.h>
+#include <fnd/io.h>
+
+static const size_t kEntrySize[blockindex::TABLE_NUM] = { sizeof(sBlockIndexSourceEntry), sizeof(sBlockIndexBlockEntry), 1 };
+
+BlockIndex::BlockIndex()
+{
+}
+
+BlockIndex::~BlockIndex()
+{
+}
+
+void BlockIndex::open(const std::string& path)
+{
+	fnd::SimpleFile file(path, fnd::SimpleFile::Read);
+	mData.alloc(file.size());
+	file.read(mData.data(), 0, mData.size());
+
+	try
+	{
+		validateLayout();
+	}
+	catch (const fnd::Exception&)
+	{
+		mData.alloc(0);
+		throw;
+	}
+}
+
+bool BlockIndex::isOpen() const
+{
+	return mData.size() != 0;
+}
+
+const sBlockIndexHeader& BlockIndex::getHeader() const
+{
+	return *((const sBlockIndexHeader*)mData.data());
+}
+
+size_t BlockIndex::getSourceNum() const
+{
+	return getTableEntryNum(blockindex::TABLE_SOURCE);
+}
+
+size_t BlockIndex::getBlockNum() const
+{
+	return getTableEntryNum(blockindex::TABLE_BLOCK);
+}
+
+const sBlockIndexSourceEntry& BlockIndex::getSourceEntry(size_t index) const
+{
+	return *((const sBlockIndexSourceEntry*)getTableEntry(blockindex::TABLE_SOURCE, index));
+}
+
+const sBlockIndexBlockEntry& BlockIndex::getBlockEntry(size_t index) const
+{
+	return *((const sBlockIndexBlockEntry*)getTableEntry(blockindex::TABLE_BLOCK, index));
+}
+
+std::string BlockIndex::getString(const sBlockIndexString& str) const
+{
+	const sBlockIndexHeader::sTable& pool = getHeader().table[blockindex::TABLE_STRING_POOL];
+	if (((uint64_t)str.offset.get() + (uint64_t)str.size.get()) > pool.entry_num.get())
+	{
+		throw fnd::Exception(kModuleName, "String reference is out of bounds");
+	}
+
+	return std::string((const char*)(mData.data() + pool.offset.get() + str.offset.get()), str.size.get());
+}
+
+void BlockIndex::save(const std::string& path, const fnd::List<sSourceRecord>& sources)
+{
+	std::string string_pool;
+	struct sStringPoolWriter
+	{
+		std::string& pool;
+		sBlockIndexString add(const std::string& str)
+		{
+			sBlockIndexString ref;
+			ref.offset = (uint32_t)pool.size();
+			ref.size = (uint32_t)str.size();
+			pool += str;
+			return ref;
+		}
+	} strings = { string_pool };
+
+	// flatten sources and their blocks into tables
+	std::vector<sBlockIndexSourceEntry> source_table;
+	std::vector<sBlockIndexBlockEntry> block_table;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		sBlockIndexSourceEntry source = sources[i].entry;
+		source.path = strings.add(sources[i].path);
+		source.nca_name = strings.add(sources[i].nca_name);
+		source.block_num = (uint32_t)sources[i].block_hash.size();
+		source_table.push_back(source);
+
+		for (size_t j = 0; j < sources[i].block_hash.size(); j++)
+		{
+			sBlockIndexBlockEntry block;
+			memcpy(block.hash, sources[i].block_hash[j].bytes, blockindex::kBlockHashLen);
+			block.source_index = (uint32_t)i;
+			block.block_index = (uint32_t)j;
+			block_table.push_back(block);
+		}
+	}
+
+	// blocks with the same hash end up next to each other
+	std::sort(block_table.begin(), block_table.end(), [](const sBlockIndexBlockEntry& a, const sBlockIndexBlockEntry& b)
+	{
+		int cmp = memcmp(a.hash, b.hash, blockindex::kBlockHashLen);
+		if (cmp != 0)
+			return cmp < 0;
+		if (a.source_index.get() != b.source_index.get())
+			return a.source_index.get() < b.source_index.get();
+		return a.block_index.get() < b.block_index.get();
+	});
+
+	// layout tables after the header
+	sBlockIndexHeader hdr;
+	memset(&hdr, 0, sizeof(sBlockIndexHeader));
+	hdr.st_magic = blockindex::kBlockIndexStructMagic;
+	hdr.format_version = blockindex::kFormatVersion;
+	hdr.creation_time = (uint64_t)time(nullptr);
+
+	const size_t entry_num[blockindex::TABLE_NUM] = { source_table.size(), block_table.size(), string_pool.size() };
+	uint64_t offset = align(sizeof(sBlockIndexHeader), blockindex::kTableAlign);
+	for (size_t i = 0; i < blockindex::TABLE_NUM; i++)
+	{
+		hdr.table[i].offset = offset;
+		hdr.table[i].entry_num = (uint32_t)entry_num[i];
+		hdr.table[i].entry_size = (uint32_t)kEntrySize[i];
+		offset = align(offset + entry_num[i] * kEntrySize[i], blockindex::kTableAlign);
+	}
+
+	fnd::Vec<byte_t> data;
+	data.alloc(offset);
+	memset(data.data(), 0, data.size());
+	memcpy(data.data(), &hdr, sizeof(sBlockIndexHeader));
+	if (source_table.empty() == false)
+		memcpy(data.data() + hdr.table[blockindex::TABLE_SOURCE].offset.get(), source_table.data(), source_table.size() * sizeof(sBlockIndexSourceEntry));
+	if (block_table.empty() == false)
+		memcpy(data.data() + hdr.table[blockindex::TABLE_BLOCK].offset.get(), block_table.data(), block_table.size() * sizeof(sBlockIndexBlockEntry));
+	memcpy(data.data() + hdr.table[blockindex::TABLE_STRING_POOL].offset.get(), string_pool.data(), string_pool.size());
+
+	fnd::io::replaceFile(path, data.data(), data.size());
+}
+
+size_t BlockIndex::getTableEntryNum(blockindex::TableIndex table) const
+{
+	// an index that isn't open is treated as empty
+	return isOpen() ? getHeader().table[table].entry_num.get() : 0;
+}
+
+const byte_t* BlockIndex::getTableEntry(blockindex::TableIndex table, size_t index) const
+{
+	const sBlockIndexHeader::sTable& info = getHeader().table[table];
+	if (index >= info.entry_num.get())
+	{
+		throw fnd::Exception(kModuleName, "Table entry index is out of bounds");
+	}
+
+	return mData.data() + info.offset.get() + index * info.entry_size.get();
+}
+
+void BlockIndex::validateLayout() const
+{
+	if (mData.size() < sizeof(sBlockIndexHeader))
+	{
+		throw fnd::Exception(kModuleName, "Index is too small");
+	}
+
+	const sBlockIndexHeader& hdr = getHeader();
+	if (hdr.st_magic.get() != blockindex::kBlockIndexStructMagic)
+	{
+		throw fnd::Exception(kModuleName, "Index header corrupt");
+	}
+
+	if (hdr.format_version.get() != blockindex::kFormatVersion)
+	{
+		throw fnd::Exception(kModuleName, "Unsupported index format version");
+	}
+
+	for (size_t i = 0; i < blockindex::TABLE_NUM; i++)
+	{
+		if (hdr.table[i].entry_size.get() != kEntrySize[i])
+		{
+			throw fnd::Exception(kModuleName, "Index table has unexpected entry size");
+		}
+
+		if ((hdr.table[i].offset.get() + (uint64_t)hdr.table[i].entry_num.get() * hdr.table[i].entry_size.get()) > mData.size())
+		{
+			throw fnd::Exception(kModuleName, "Index table is out of bounds");
+		}
+	}
+}
\ No newline at end of file
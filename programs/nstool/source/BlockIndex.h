@@ -0,0 +1,108 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include <fnd/List.h>
+#include <fnd/Vec.h>
+#include <crypto/sha.h>
+#include <nx/macro.h>
+
+namespace blockindex
+{
+	static const uint32_t kBlockIndexStructMagic = _MAKE_STRUCT_MAGIC_U32("NSBI");
+	static const uint32_t kFormatVersion = 1;
+	static const size_t kTableAlign = 0x10;
+	// block hashes are stored truncated, which is plenty to tell data blocks apart
+	static const size_t kBlockHashLen = 0x10;
+
+	enum TableIndex
+	{
+		TABLE_SOURCE,
+		TABLE_BLOCK,
+		TABLE_STRING_POOL,
+		TABLE_NUM
+	};
+}
+
+#pragma pack(push,1)
+struct sBlockIndexString
+{
+	le_uint32_t offset;
+	le_uint32_t size;
+};
+
+struct sBlockIndexHeader
+{
+	le_uint32_t st_magic;
+	le_uint32_t format_version;
+	le_uint64_t creation_time;
+	struct sTable
+	{
+		le_uint64_t offset;
+		le_uint32_t entry_num;
+		le_uint32_t entry_size;
+	} table[blockindex::TABLE_NUM];
+};
+
+// a hashed NCA partition
+struct sBlockIndexSourceEntry
+{
+	sBlockIndexString path;
+	sBlockIndexString nca_name;
+	le_uint64_t nca_offset;
+	le_uint64_t data_size;
+	le_uint32_t block_size;
+	le_uint32_t block_num;
+	byte_t partition_index;
+	byte_t hash_type;
+	byte_t reserved[6];
+};
+
+// sorted by hash, then source, then block
+struct sBlockIndexBlockEntry
+{
+	byte_t hash[blockindex::kBlockHashLen];
+	le_uint32_t source_index;
+	le_uint32_t block_index;
+};
+#pragma pack(pop)
+
+// Leaf hashes of the hash trees of NCA partitions across a library: which data blocks
+// (by SHA-256) each partition is made of. Identical hashes in different sources are
+// duplicated data. Like the catalogue index, every table is an array of fixed width
+// entries that reference a shared string pool.
+class BlockIndex
+{
+public:
+	struct sSourceRecord
+	{
+		sBlockIndexSourceEntry entry;
+		std::string path;
+		std::string nca_name;
+		fnd::List<crypto::sha::sSha256Hash> block_hash;
+	};
+
+	BlockIndex();
+	~BlockIndex();
+
+	void open(const std::string& path);
+	bool isOpen() const;
+
+	const sBlockIndexHeader& getHeader() const;
+	size_t getSourceNum() const;
+	size_t getBlockNum() const;
+	const sBlockIndexSourceEntry& getSourceEntry(size_t index) const;
+	const sBlockIndexBlockEntry& getBlockEntry(size_t index) const;
+	std::string getString(const sBlockIndexString& str) const;
+
+	// write sources as a new index (atomically replaces any existing file)
+	static void save(const std::string& path, const fnd::List<sSourceRecord>& sources);
+
+private:
+	const std::string kModuleName = "BlockIndex";
+
+	fnd::Vec<byte_t> mData;
+
+	size_t getTableEntryNum(blockindex::TableIndex table) const;
+	const byte_t* getTableEntry(blockindex::TableIndex table, size_t index) const;
+	void validateLayout() const;
+};
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "BlockIndexProcess.h"
+#include <ctime>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+BlockIndexProcess::BlockIndexProcess() :
+	mCliOutputMode(_BIT(OUTPUT_BASIC))
+{
+}
+
+void BlockIndexProcess::process()
+{
+	mIndex.open(mInputPath);
+
+	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+		displayReport();
+}
+
+void BlockIndexProcess::setInputPath(const std::string& path)
+{
+	mInputPath = path;
+}
+
+void BlockIndexProcess::setCliOutputMode(CliOutputMode type)
+{
+	mCliOutputMode = type;
+}
+
+void BlockIndexProcess::displayReport()
+{
+	struct sSharedData
+	{
+		uint64_t size;
+		std::vector<uint32_t> blocks;
+	};
+
+	bool show_blocks = _HAS_BIT(mCliOutputMode, OUTPUT_EXTENDED);
+
+	uint64_t total_size = 0;
+	uint64_t duplicate_size = 0;
+	uint64_t wide_size = 0;
+	size_t unique_num = 0;
+	std::map<std::pair<uint32_t, uint32_t>, sSharedData> shared;
+
+	// the block table is sorted by hash, so every run of equal hashes is one duplicated block
+	std::vector<uint32_t> group_sources;
+	std::vector<uint32_t> group_blocks;
+	for (size_t i = 0; i < mIndex.getBlockNum(); )
+	{
+		const sBlockIndexBlockEntry& first = mIndex.getBlockEntry(i);
+		group_sources.clear();
+		group_blocks.clear();
+
+		size_t j = i;
+		for (; j < mIndex.getBlockNum() && memcmp(mIndex.getBlockEntry(j).hash, first.hash, blockindex::kBlockHashLen) == 0; j++)
+		{
+			const sBlockIndexBlockEntry& block = mIndex.getBlockEntry(j);
+			total_size += mIndex.getSourceEntry(block.source_index.get()).block_size.get();
+
+			// entries are sorted by source, so one block per source is kept
+			if (group_sources.empty() || group_sources.back() != block.source_index.get())
+			{
+				group_sources.push_back(block.source_index.get());
+				group_blocks.push_back(block.block_index.get());
+			}
+		}
+
+		uint64_t block_size = mIndex.getSourceEntry(first.source_index.get()).block_size.get();
+		duplicate_size += (j - i - 1) * block_size;
+		unique_num++;
+
+		if (group_sources.size() > kMaxPairGroupSize)
+		{
+			wide_size += (group_sources.size() - 1) * block_size;
+		}
+		else
+		{
+			for (size_t a = 0; a < group_sources.size(); a++)
+			{
+				for (size_t b = a + 1; b < group_sources.size(); b++)
+				{
+					sSharedData& data = shared[std::make_pair(group_sources[a], group_sources[b])];
+					data.size += block_size;
+					if (show_blocks)
+						data.blocks.push_back(group_blocks[a]);
+				}
+			}
+		}
+
+		i = j;
+	}
+
+	time_t creation_time = (time_t)mIndex.getHeader().creation_time.get();
+	char time_str[0x40] = "";
+	strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", gmtime(&creation_time));
+
+	printf("[Block Index]\n");
+	printf("  FormatVersion:  %" PRId32 "\n", mIndex.getHeader().format_version.get());
+	printf("  CreationTime:   %s UTC\n", time_str);
+	printf("  SourceNum:      %" PRIu64 "\n", (uint64_t)mIndex.getSourceNum());
+	printf("  BlockNum:       %" PRIu64 "\n", (uint64_t)mIndex.getBlockNum());
+	printf("  UniqueBlockNum: %" PRIu64 "\n", (uint64_t)unique_num);
+	printf("  DataSize:       0x%" PRIx64 "\n", total_size);
+	printf("  DuplicateSize:  0x%" PRIx64 " (%.2f%%)\n", duplicate_size, total_size == 0 ? 0.0 : (duplicate_size * 100.0) / total_size);
+
+	// pairs of sources, most shared data first
+	std::vector<std::pair<uint64_t, std::pair<uint32_t, uint32_t>>> pairs;
+	for (std::map<std::pair<uint32_t, uint32_t>, sSharedData>::const_iterator itr = shared.begin(); itr != shared.end(); itr++)
+	{
+		pairs.push_back(std::make_pair(itr->second.size, itr->first));
+	}
+	std::sort(pairs.begin(), pairs.end(), [](const std::pair<uint64_t, std::pair<uint32_t, uint32_t>>& a, const std::pair<uint64_t, std::pair<uint32_t, uint32_t>>& b) { return a.first > b.first; });
+
+	size_t display_num = show_blocks ? pairs.size() : _MIN(pairs.size(), kDefaultPairDisplayNum);
+	printf("[Shared Data]\n");
+	if (wide_size > 0)
+		printf("  In more than %" PRIu64 " sources: 0x%" PRIx64 "\n", (uint64_t)kMaxPairGroupSize, wide_size);
+	for (size_t i = 0; i < display_num; i++)
+	{
+		printf("  0x%" PRIx64 ":\n", pairs[i].first);
+		printf("    %s\n", getSourceStr(pairs[i].second.first).c_str());
+		printf("    %s\n", getSourceStr(pairs[i].second.second).c_str());
+
+		if (show_blocks)
+		{
+			// blocks of the first source, as ranges
+			std::vector<uint32_t> blocks = shared[pairs[i].second].blocks;
+			std::sort(blocks.begin(), blocks.end());
+			printf("    Blocks:");
+			for (size_t j = 0; j < blocks.size(); )
+			{
+				size_t k = j;
+				while (k + 1 < blocks.size() && blocks[k + 1] == blocks[k] + 1)
+					k++;
+				if (k == j)
+					printf(" %" PRId32, blocks[j]);
+				else
+					printf(" %" PRId32 "-%" PRId32, blocks[j], blocks[k]);
+				j = k + 1;
+			}
+			printf("\n");
+		}
+	}
+	if (display_num < pairs.size())
+		printf("  (%" PRIu64 " more, use -v to show all)\n", (uint64_t)(pairs.size() - display_num));
+}
+
+std::string BlockIndexProcess::getSourceStr(size_t index) const
+{
+	const sBlockIndexSourceEntry& source = mIndex.getSourceEntry(index);
+	return mIndex.getString(source.path) + " : " + mIndex.getString(source.nca_name) + "/" + std::to_string(source.partition_index);
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include "BlockIndex.h"
+
+#include "nstool.h"
+
+// Reports the data duplicated across the sources (NCA partitions) of a block index
+class BlockIndexProcess
+{
+public:
+	BlockIndexProcess();
+
+	void process();
+
+	void setInputPath(const std::string& path);
+	void setCliOutputMode(CliOutputMode type);
+
+private:
+	const std::string kModuleName = "BlockIndexProcess";
+	// blocks in more sources than this (padding, common middleware) aren't attributed to pairs of sources
+	static const size_t kMaxPairGroupSize = 32;
+	static const size_t kDefaultPairDisplayNum = 20;
+
+	std::string mInputPath;
+	CliOutputMode mCliOutputMode;
+
+	BlockIndex mIndex;
+
+	void displayReport();
+	std::string getSourceStr(size_t index) const;
+};
\ No newline at end of file
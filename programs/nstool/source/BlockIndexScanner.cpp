@@ -0,0 +1,178 @@
+#include "BlockIndexScanner.h"
+#include <memory>
+#include "OffsetAdjustedIFile.h"
+#include "XciProcess.h"
+#include "PfsProcess.h"
+#include "NcaProcess.h"
+
+BlockIndexScanner::BlockIndexScanner() :
+	mFile(nullptr),
+	mOwnIFile(false),
+	mPath(),
+	mFileType(FILE_INVALID),
+	mKeyset(nullptr)
+{
+}
+
+BlockIndexScanner::~BlockIndexScanner()
+{
+	if (mOwnIFile)
+	{
+		delete mFile;
+	}
+}
+
+void BlockIndexScanner::process()
+{
+	if (mFile == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No file reader set.");
+	}
+
+	if (mKeyset == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No keyset set.");
+	}
+
+	mSources.clear();
+	mError.clear();
+
+	if (mFileType == FILE_XCI)
+		scanXci(mFile);
+	else if (mFileType == FILE_NSP || mFileType == FILE_PARTITIONFS)
+		scanPfs(mFile, 0, "");
+	else if (mFileType == FILE_NCA)
+		scanNca(mFile, 0, mPath.substr(mPath.find_last_of("/\\") == std::string::npos ? 0 : mPath.find_last_of("/\\") + 1));
+}
+
+void BlockIndexScanner::setInputFile(fnd::IFile* file, bool ownIFile)
+{
+	mFile = file;
+	mOwnIFile = ownIFile;
+}
+
+void BlockIndexScanner::setInputPath(const std::string& path)
+{
+	mPath = path;
+}
+
+void BlockIndexScanner::setFileType(FileType type)
+{
+	mFileType = type;
+}
+
+void BlockIndexScanner::setKeyset(const sKeyset* keyset)
+{
+	mKeyset = keyset;
+}
+
+const fnd::List<BlockIndex::sSourceRecord>& BlockIndexScanner::getSources() const
+{
+	return mSources;
+}
+
+const std::string& BlockIndexScanner::getError() const
+{
+	return mError;
+}
+
+void BlockIndexScanner::scanXci(fnd::IFile* file)
+{
+	XciProcess xci;
+	xci.setInputFile(file, SHARED_IFILE);
+	xci.setKeyset(mKeyset);
+	xci.setCliOutputMode(0);
+	xci.process();
+
+	const fnd::List<nx::PfsHeader::sFile>& partitions = xci.getRootPfsHeader().getFileList();
+	for (size_t i = 0; i < partitions.size(); i++)
+	{
+		uint64_t offset = xci.getXciHeader().getPartitionFsAddress() + partitions[i].offset;
+		OffsetAdjustedIFile partition(file, SHARED_IFILE, offset, partitions[i].size);
+		scanPfs(&partition, offset, kXciMountPointName + partitions[i].name);
+	}
+}
+
+void BlockIndexScanner::scanPfs(fnd::IFile* file, uint64_t base_offset, const std::string& mount_name)
+{
+	PfsProcess pfs;
+	pfs.setInputFile(file, SHARED_IFILE);
+	pfs.setCliOutputMode(0);
+	pfs.process();
+
+	const fnd::List<nx::PfsHeader::sFile>& entries = pfs.getPfsHeader().getFileList();
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (isNcaFile(entries[i].name) == false)
+			continue;
+
+		std::string path = mount_name;
+		if (path.empty() == false && path[path.length()-1] != '/')
+			path += "/";
+		path += entries[i].name;
+
+		OffsetAdjustedIFile nca(file, SHARED_IFILE, entries[i].offset, entries[i].size);
+		scanNca(&nca, base_offset + entries[i].offset, path);
+	}
+}
+
+void BlockIndexScanner::scanNca(fnd::IFile* file, uint64_t base_offset, const std::string& name)
+{
+	const size_t kHashSize = sizeof(crypto::sha::sSha256Hash);
+
+	try
+	{
+		NcaProcess nca;
+		nca.setInputFile(file, SHARED_IFILE);
+		nca.setKeyset(mKeyset);
+		nca.setCliOutputMode(0);
+		nca.process();
+
+		const nx::NcaHeader& hdr = nca.getNcaHeader();
+		for (size_t i = 0; i < hdr.getPartitions().size(); i++)
+		{
+			size_t index = hdr.getPartitions()[i].index;
+			const HashTreeMeta* meta = nca.getPartitionHashTreeMeta(index);
+			if (meta == nullptr)
+				continue;
+
+			BlockIndex::sSourceRecord source;
+			memset(&source.entry, 0, sizeof(sBlockIndexSourceEntry));
+			source.path = mPath;
+			source.nca_name = name;
+			source.entry.nca_offset = base_offset;
+			source.entry.data_size = meta->getDataLayer().size;
+			source.entry.block_size = (uint32_t)meta->getDataLayer().block_size;
+			source.entry.partition_index = (byte_t)index;
+			source.entry.hash_type = meta->getAlignHashToBlock() ? nx::nca::HASH_HIERARCHICAL_INTERGRITY : nx::nca::HASH_HIERARCHICAL_SHA256;
+
+			// the leaf layer holds one hash per data block (it may be padded past the last block)
+			size_t block_num = (size_t)((meta->getDataLayer().size + meta->getDataLayer().block_size - 1) / meta->getDataLayer().block_size);
+			if (meta->getHashLayerInfo().size() == 0)
+			{
+				for (size_t j = 0; j < _MIN(block_num, meta->getMasterHashList().size()); j++)
+					source.block_hash.addElement(meta->getMasterHashList()[j]);
+			}
+			else
+			{
+				const HashTreeMeta::sLayer& leaf = meta->getHashLayerInfo()[meta->getHashLayerInfo().size() - 1];
+				block_num = _MIN(block_num, leaf.size / kHashSize);
+
+				std::unique_ptr<fnd::IFile> partition(nca.openPartitionDecryptedReader(index));
+				fnd::Vec<byte_t> layer;
+				layer.alloc(block_num * kHashSize);
+				partition->read(layer.data(), leaf.offset, layer.size());
+				for (size_t j = 0; j < block_num; j++)
+					source.block_hash.addElement(((const crypto::sha::sSha256Hash*)layer.data())[j]);
+			}
+
+			mSources.addElement(source);
+		}
+	}
+	catch (const fnd::Exception& e)
+	{
+		if (mError.empty() == false)
+			mError += "; ";
+		mError += name + ": " + e.what();
+	}
+}
\ No newline at end of file
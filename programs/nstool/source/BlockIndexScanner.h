@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include <fnd/IFile.h>
+#include <fnd/List.h>
+#include "BlockIndex.h"
+
+#include "nstool.h"
+
+// Collects the leaf hashes (the last hash layer, one SHA-256 per data block) of every
+// hashed NCA partition in a container. Only the hash layers are read and decrypted,
+// the data blocks themselves are never touched.
+class BlockIndexScanner
+{
+public:
+	BlockIndexScanner();
+	~BlockIndexScanner();
+
+	void process();
+
+	void setInputFile(fnd::IFile* file, bool ownIFile);
+	void setInputPath(const std::string& path);
+	void setFileType(FileType type);
+	void setKeyset(const sKeyset* keyset);
+
+	const fnd::List<BlockIndex::sSourceRecord>& getSources() const;
+	// NCAs that couldn't be scanned, empty if there were none
+	const std::string& getError() const;
+
+private:
+	const std::string kModuleName = "BlockIndexScanner";
+	const std::string kXciMountPointName = "gamecard:/";
+
+	fnd::IFile* mFile;
+	bool mOwnIFile;
+	std::string mPath;
+	FileType mFileType;
+	const sKeyset* mKeyset;
+
+	fnd::List<BlockIndex::sSourceRecord> mSources;
+	std::string mError;
+
+	void scanXci(fnd::IFile* file);
+	void scanPfs(fnd::IFile* file, uint64_t base_offset, const std::string& mount_name);
+	void scanNca(fnd::IFile* file, uint64_t base_offset, const std::string& name);
+};
\ No newline at end of file
@@ -0,0 +1,380 @@
+#include "CatalogueIndex.h"
+#include <cstdio>
+#include <ctime>
+#include <fnd/SimpleFile.h>
+#include <fnd/io.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+CatalogueIndex::CatalogueIndex() :
+	mData(nullptr),
+	mDataSize(0),
+	mMapping(nullptr),
+	mMappingSize(0)
+{
+}
+
+CatalogueIndex::~CatalogueIndex()
+{
+	close();
+}
+
+void CatalogueIndex::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	// no mapping on windows, the index is read into memory instead
+	fnd::SimpleFile file(path, fnd::SimpleFile::Read);
+	mDataBuffer.alloc(file.size());
+	file.read(mDataBuffer.data(), 0, mDataBuffer.size());
+	mData = mDataBuffer.data();
+	mDataSize = mDataBuffer.size();
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw fnd::Exception(kModuleName, "Failed to open index (" + path + ")");
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		throw fnd::Exception(kModuleName, "Failed to determine index size (" + path + ")");
+	}
+
+	void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		throw fnd::Exception(kModuleName, "Failed to map index (" + path + ")");
+	}
+
+	mMapping = mapping;
+	mMappingSize = st.st_size;
+	mData = (const byte_t*)mMapping;
+	mDataSize = mMappingSize;
+#endif
+
+	try
+	{
+		validateLayout();
+	}
+	catch (const fnd::Exception&)
+	{
+		close();
+		throw;
+	}
+}
+
+void CatalogueIndex::close()
+{
+#ifndef _WIN32
+	if (mMapping != nullptr)
+	{
+		munmap(mMapping, mMappingSize);
+	}
+#endif
+	mMapping = nullptr;
+	mMappingSize = 0;
+	mDataBuffer.alloc(0);
+	mData = nullptr;
+	mDataSize = 0;
+}
+
+bool CatalogueIndex::isOpen() const
+{
+	return mData != nullptr;
+}
+
+const sCatalogueHeader& CatalogueIndex::getHeader() const
+{
+	return *((const sCatalogueHeader*)mData);
+}
+
+size_t CatalogueIndex::getFileNum() const
+{
+	return getTableEntryNum(catalogue::TABLE_FILE);
+}
+
+size_t CatalogueIndex::getNcaNum() const
+{
+	return getTableEntryNum(catalogue::TABLE_NCA);
+}
+
+size_t CatalogueIndex::getTitleNum() const
+{
+	return getTableEntryNum(catalogue::TABLE_TITLE);
+}
+
+size_t CatalogueIndex::getContentNum() const
+{
+	return getTableEntryNum(catalogue::TABLE_CONTENT);
+}
+
+size_t CatalogueIndex::getNameNum() const
+{
+	return getTableEntryNum(catalogue::TABLE_NAME);
+}
+
+size_t CatalogueIndex::getTableEntryNum(catalogue::TableIndex table) const
+{
+	// an index that isn't open is treated as empty
+	return isOpen() ? getHeader().table[table].entry_num.get() : 0;
+}
+
+const sCatalogueFileEntry& CatalogueIndex::getFileEntry(size_t index) const
+{
+	return *((const sCatalogueFileEntry*)getTableEntry(catalogue::TABLE_FILE, index));
+}
+
+const sCatalogueNcaEntry& CatalogueIndex::getNcaEntry(size_t index) const
+{
+	return *((const sCatalogueNcaEntry*)getTableEntry(catalogue::TABLE_NCA, index));
+}
+
+const sCatalogueTitleEntry& CatalogueIndex::getTitleEntry(size_t index) const
+{
+	return *((const sCatalogueTitleEntry*)getTableEntry(catalogue::TABLE_TITLE, index));
+}
+
+const sCatalogueContentEntry& CatalogueIndex::getContentEntry(size_t index) const
+{
+	return *((const sCatalogueContentEntry*)getTableEntry(catalogue::TABLE_CONTENT, index));
+}
+
+const sCatalogueNameEntry& CatalogueIndex::getNameEntry(size_t index) const
+{
+	return *((const sCatalogueNameEntry*)getTableEntry(catalogue::TABLE_NAME, index));
+}
+
+std::string CatalogueIndex::getString(const sCatalogueString& str) const
+{
+	const sCatalogueHeader::sTable& pool = getHeader().table[catalogue::TABLE_STRING_POOL];
+	if (((uint64_t)str.offset.get() + (uint64_t)str.size.get()) > pool.entry_num.get())
+	{
+		throw fnd::Exception(kModuleName, "String reference is out of bounds");
+	}
+
+	return std::string((const char*)(mData + pool.offset.get() + str.offset.get()), str.size.get());
+}
+
+void CatalogueIndex::getFileRecord(size_t index, sFileRecord& record) const
+{
+	const sCatalogueFileEntry& file = getFileEntry(index);
+
+	record.entry = file;
+	record.path = getString(file.path);
+	record.error = getString(file.error);
+	record.nca.clear();
+	record.title.clear();
+
+	for (size_t i = 0; i < file.nca_num.get(); i++)
+	{
+		sNcaRecord nca;
+		nca.entry = getNcaEntry(file.nca_index.get() + i);
+		nca.name = getString(nca.entry.name);
+		record.nca.addElement(nca);
+	}
+
+	for (size_t i = 0; i < file.title_num.get(); i++)
+	{
+		sTitleRecord title;
+		title.entry = getTitleEntry(file.title_index.get() + i);
+
+		for (size_t j = 0; j < title.entry.content_num.get(); j++)
+		{
+			title.content.addElement(getContentEntry(title.entry.content_index.get() + j));
+		}
+
+		for (size_t j = 0; j < title.entry.name_num.get(); j++)
+		{
+			const sCatalogueNameEntry& name_entry = getNameEntry(title.entry.name_index.get() + j);
+			sNameRecord name;
+			name.language = name_entry.language.get();
+			name.name = getString(name_entry.name);
+			name.publisher = getString(name_entry.publisher);
+			title.name.addElement(name);
+		}
+
+		record.title.addElement(title);
+	}
+
+	// indexes are relative to the record until it is saved again
+	record.entry.nca_index = 0;
+	record.entry.title_index = 0;
+	for (size_t i = 0; i < record.nca.size(); i++)
+	{
+		record.nca[i].entry.file_index = 0;
+	}
+	for (size_t i = 0; i < record.title.size(); i++)
+	{
+		record.title[i].entry.file_index = 0;
+		record.title[i].entry.nca_index = record.title[i].entry.nca_index.get() - file.nca_index.get();
+	}
+}
+
+void CatalogueIndex::save(const std::string& path, const fnd::List<sFileRecord>& records)
+{
+	fnd::List<sCatalogueFileEntry> file_table;
+	fnd::List<sCatalogueNcaEntry> nca_table;
+	fnd::List<sCatalogueTitleEntry> title_table;
+	fnd::List<sCatalogueContentEntry> content_table;
+	fnd::List<sCatalogueNameEntry> name_table;
+	std::string string_pool;
+
+	struct sStringPoolWriter
+	{
+		std::string& pool;
+		sCatalogueString add(const std::string& str)
+		{
+			sCatalogueString ref;
+			ref.offset = (uint32_t)pool.size();
+			ref.size = (uint32_t)str.size();
+			pool += str;
+			return ref;
+		}
+	} strings = { string_pool };
+
+	// flatten records into tables, fixing up indexes to be absolute
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const sFileRecord& record = records[i];
+		sCatalogueFileEntry file = record.entry;
+		uint32_t file_nca_index = (uint32_t)nca_table.size();
+
+		file.path = strings.add(record.path);
+		file.error = strings.add(record.error);
+		file.nca_index = file_nca_index;
+		file.nca_num = (uint32_t)record.nca.size();
+		file.title_index = (uint32_t)title_table.size();
+		file.title_num = (uint32_t)record.title.size();
+
+		for (size_t j = 0; j < record.nca.size(); j++)
+		{
+			sCatalogueNcaEntry nca = record.nca[j].entry;
+			nca.file_index = (uint32_t)i;
+			nca.name = strings.add(record.nca[j].name);
+			nca_table.addElement(nca);
+		}
+
+		for (size_t j = 0; j < record.title.size(); j++)
+		{
+			const sTitleRecord& title_record = record.title[j];
+			sCatalogueTitleEntry title = title_record.entry;
+			title.file_index = (uint32_t)i;
+			title.nca_index = file_nca_index + title.nca_index.get();
+			title.content_index = (uint32_t)content_table.size();
+			title.content_num = (uint32_t)title_record.content.size();
+			title.name_index = (uint32_t)name_table.size();
+			title.name_num = (uint32_t)title_record.name.size();
+
+			for (size_t k = 0; k < title_record.content.size(); k++)
+			{
+				content_table.addElement(title_record.content[k]);
+			}
+
+			for (size_t k = 0; k < title_record.name.size(); k++)
+			{
+				sCatalogueNameEntry name;
+				memset(&name, 0, sizeof(sCatalogueNameEntry));
+				name.title_index = (uint32_t)title_table.size();
+				name.language = title_record.name[k].language;
+				name.name = strings.add(title_record.name[k].name);
+				name.publisher = strings.add(title_record.name[k].publisher);
+				name_table.addElement(name);
+			}
+
+			title_table.addElement(title);
+		}
+
+		file_table.addElement(file);
+	}
+
+	// layout tables after the header
+	sCatalogueHeader hdr;
+	memset(&hdr, 0, sizeof(sCatalogueHeader));
+	hdr.st_magic = catalogue::kCatalogueStructMagic;
+	hdr.format_version = catalogue::kFormatVersion;
+	hdr.creation_time = (uint64_t)time(nullptr);
+
+	const size_t entry_num[catalogue::TABLE_NUM] = { file_table.size(), nca_table.size(), title_table.size(), content_table.size(), name_table.size(), string_pool.size() };
+	const size_t entry_size[catalogue::TABLE_NUM] = { sizeof(sCatalogueFileEntry), sizeof(sCatalogueNcaEntry), sizeof(sCatalogueTitleEntry), sizeof(sCatalogueContentEntry), sizeof(sCatalogueNameEntry), 1 };
+	uint64_t offset = align(sizeof(sCatalogueHeader), catalogue::kTableAlign);
+	for (size_t i = 0; i < catalogue::TABLE_NUM; i++)
+	{
+		hdr.table[i].offset = offset;
+		hdr.table[i].entry_num = (uint32_t)entry_num[i];
+		hdr.table[i].entry_size = (uint32_t)entry_size[i];
+		offset = align(offset + entry_num[i] * entry_size[i], catalogue::kTableAlign);
+	}
+
+	fnd::Vec<byte_t> data;
+	data.alloc(offset);
+	memset(data.data(), 0, data.size());
+	memcpy(data.data(), &hdr, sizeof(sCatalogueHeader));
+
+#define _WRITE_TABLE(idx, list) \
+	for (size_t i = 0; i < list.size(); i++) \
+		memcpy(data.data() + hdr.table[idx].offset.get() + i * entry_size[idx], &list[i], entry_size[idx]);
+
+	_WRITE_TABLE(catalogue::TABLE_FILE, file_table);
+	_WRITE_TABLE(catalogue::TABLE_NCA, nca_table);
+	_WRITE_TABLE(catalogue::TABLE_TITLE, title_table);
+	_WRITE_TABLE(catalogue::TABLE_CONTENT, content_table);
+	_WRITE_TABLE(catalogue::TABLE_NAME, name_table);
+	memcpy(data.data() + hdr.table[catalogue::TABLE_STRING_POOL].offset.get(), string_pool.data(), string_pool.size());
+
+#undef _WRITE_TABLE
+
+	fnd::io::replaceFile(path, data.data(), data.size());
+}
+
+const byte_t* CatalogueIndex::getTableEntry(catalogue::TableIndex table, size_t index) const
+{
+	const sCatalogueHeader::sTable& info = getHeader().table[table];
+	if (index >= info.entry_num.get())
+	{
+		throw fnd::Exception(kModuleName, "Table entry index is out of bounds");
+	}
+
+	return mData + info.offset.get() + index * info.entry_size.get();
+}
+
+void CatalogueIndex::validateLayout() const
+{
+	if (mDataSize < sizeof(sCatalogueHeader))
+	{
+		throw fnd::Exception(kModuleName, "Index is too small");
+	}
+
+	const sCatalogueHeader& hdr = getHeader();
+	if (hdr.st_magic.get() != catalogue::kCatalogueStructMagic)
+	{
+		throw fnd::Exception(kModuleName, "Index header corrupt");
+	}
+
+	if (hdr.format_version.get() != catalogue::kFormatVersion)
+	{
+		throw fnd::Exception(kModuleName, "Unsupported index format version");
+	}
+
+	const size_t entry_size[catalogue::TABLE_NUM] = { sizeof(sCatalogueFileEntry), sizeof(sCatalogueNcaEntry), sizeof(sCatalogueTitleEntry), sizeof(sCatalogueContentEntry), sizeof(sCatalogueNameEntry), 1 };
+	for (size_t i = 0; i < catalogue::TABLE_NUM; i++)
+	{
+		if (hdr.table[i].entry_size.get() != entry_size[i])
+		{
+			throw fnd::Exception(kModuleName, "Index table has unexpected entry size");
+		}
+
+		if ((hdr.table[i].offset.get() + (uint64_t)hdr.table[i].entry_num.get() * hdr.table[i].entry_size.get()) > mDataSize)
+		{
+			throw fnd::Exception(kModuleName, "Index table is out of bounds");
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include <fnd/List.h>
+#include <fnd/Vec.h>
+#include <crypto/sha.h>
+#include <nx/macro.h>
+#include <nx/nca.h>
+#include <nx/cnmt.h>
+
+namespace catalogue
+{
+	static const uint32_t kCatalogueStructMagic = _MAKE_STRUCT_MAGIC_U32("NSCI");
+	static const uint32_t kFormatVersion = 1;
+	static const size_t kTableAlign = 0x10;
+
+	enum TableIndex
+	{
+		TABLE_FILE,
+		TABLE_NCA,
+		TABLE_TITLE,
+		TABLE_CONTENT,
+		TABLE_NAME,
+		TABLE_STRING_POOL,
+		TABLE_NUM
+	};
+
+	enum FileStatusFlag
+	{
+		FILE_STATUS_SCAN_ERROR
+	};
+}
+
+#pragma pack(push,1)
+struct sCatalogueString
+{
+	le_uint32_t offset;
+	le_uint32_t size;
+};
+
+struct sCatalogueHeader
+{
+	le_uint32_t st_magic;
+	le_uint32_t format_version;
+	le_uint64_t creation_time;
+	struct sTable
+	{
+		le_uint64_t offset;
+		le_uint32_t entry_num;
+		le_uint32_t entry_size;
+	} table[catalogue::TABLE_NUM];
+};
+
+struct sCatalogueFileEntry
+{
+	sCatalogueString path;
+	le_uint64_t size;
+	le_uint64_t mtime;
+	le_uint32_t file_type;
+	le_uint32_t status;
+	le_uint32_t nca_index;
+	le_uint32_t nca_num;
+	le_uint32_t title_index;
+	le_uint32_t title_num;
+	sCatalogueString error;
+	byte_t header_hash[crypto::sha::kSha256HashLen];
+};
+
+struct sCatalogueNcaEntry
+{
+	le_uint32_t file_index;
+	sCatalogueString name;
+	byte_t content_id[nx::cnmt::kContentIdLen];
+	le_uint64_t offset;
+	le_uint64_t size;
+	le_uint64_t program_id;
+	le_uint64_t content_size;
+	le_uint32_t sdk_addon_version;
+	le_uint32_t content_index;
+	byte_t format_version;
+	byte_t distribution_type;
+	byte_t content_type;
+	byte_t key_generation;
+	byte_t kaek_index;
+	byte_t has_rights_id;
+	byte_t partition_mask;
+	byte_t reserved_0;
+	byte_t rights_id[nx::nca::kRightsIdLen];
+	struct sPartition
+	{
+		le_uint64_t offset;
+		le_uint64_t size;
+	} partition[nx::nca::kPartitionNum];
+	byte_t header_hash[crypto::sha::kSha256HashLen];
+	byte_t reserved_1[4];
+};
+
+struct sCatalogueTitleEntry
+{
+	le_uint32_t file_index;
+	le_uint32_t nca_index;
+	le_uint64_t title_id;
+	le_uint32_t title_version;
+	byte_t meta_type;
+	byte_t reserved[3];
+	le_uint32_t content_index;
+	le_uint32_t content_num;
+	le_uint32_t name_index;
+	le_uint32_t name_num;
+};
+
+struct sCatalogueContentEntry
+{
+	byte_t content_id[nx::cnmt::kContentIdLen];
+	byte_t hash[crypto::sha::kSha256HashLen];
+	le_uint64_t size;
+	byte_t content_type;
+	byte_t reserved[7];
+};
+
+struct sCatalogueNameEntry
+{
+	le_uint32_t title_index;
+	le_uint32_t language;
+	sCatalogueString name;
+	sCatalogueString publisher;
+};
+#pragma pack(pop)
+
+// A library catalogue: one record per scanned container, holding the NCAs it contains
+// and the titles described by its CNMT(s). On disk every table is an array of fixed width
+// entries that reference a shared string pool, so the file can be mapped and queried in place.
+class CatalogueIndex
+{
+public:
+	struct sNcaRecord
+	{
+		sCatalogueNcaEntry entry;
+		std::string name;
+	};
+
+	struct sNameRecord
+	{
+		uint32_t language;
+		std::string name;
+		std::string publisher;
+	};
+
+	struct sTitleRecord
+	{
+		sCatalogueTitleEntry entry;
+		fnd::List<sCatalogueContentEntry> content;
+		fnd::List<sNameRecord> name;
+	};
+
+	struct sFileRecord
+	{
+		sCatalogueFileEntry entry;
+		std::string path;
+		std::string error;
+		fnd::List<sNcaRecord> nca;
+		fnd::List<sTitleRecord> title;
+	};
+
+	CatalogueIndex();
+	~CatalogueIndex();
+
+	// read access (mapped)
+	void open(const std::string& path);
+	void close();
+	bool isOpen() const;
+
+	const sCatalogueHeader& getHeader() const;
+	size_t getFileNum() const;
+	size_t getNcaNum() const;
+	size_t getTitleNum() const;
+	size_t getContentNum() const;
+	size_t getNameNum() const;
+	const sCatalogueFileEntry& getFileEntry(size_t index) const;
+	const sCatalogueNcaEntry& getNcaEntry(size_t index) const;
+	const sCatalogueTitleEntry& getTitleEntry(size_t index) const;
+	const sCatalogueContentEntry& getContentEntry(size_t index) const;
+	const sCatalogueNameEntry& getNameEntry(size_t index) const;
+	std::string getString(const sCatalogueString& str) const;
+
+	// copy a file entry and everything that belongs to it out of the mapped index
+	void getFileRecord(size_t index, sFileRecord& record) const;
+
+	// write records as a new index (atomically replaces any existing file)
+	static void save(const std::string& path, const fnd::List<sFileRecord>& records);
+
+private:
+	const std::string kModuleName = "CatalogueIndex";
+
+	const byte_t* mData;
+	size_t mDataSize;
+	fnd::Vec<byte_t> mDataBuffer;
+	void* mMapping;
+	size_t mMappingSize;
+
+	size_t getTableEntryNum(catalogue::TableIndex table) const;
+	const byte_t* getTableEntry(catalogue::TableIndex table, size_t index) const;
+	void validateLayout() const;
+};
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "CatalogueProcess.h"
+#include <ctime>
+
+CatalogueProcess::CatalogueProcess() :
+	mCliOutputMode(_BIT(OUTPUT_BASIC))
+{
+}
+
+void CatalogueProcess::process()
+{
+	mIndex.open(mInputPath);
+
+	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+	{
+		displayHeader();
+		displayTitles();
+	}
+}
+
+void CatalogueProcess::setInputPath(const std::string& path)
+{
+	mInputPath = path;
+}
+
+void CatalogueProcess::setCliOutputMode(CliOutputMode type)
+{
+	mCliOutputMode = type;
+}
+
+void CatalogueProcess::setTitleIdFilter(uint64_t title_id)
+{
+	mTitleIdFilter = title_id;
+}
+
+void CatalogueProcess::setTitleVersionFilter(uint32_t title_version)
+{
+	mTitleVersionFilter = title_version;
+}
+
+void CatalogueProcess::displayHeader()
+{
+	time_t creation_time = (time_t)mIndex.getHeader().creation_time.get();
+	char time_str[0x40] = "";
+	strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", gmtime(&creation_time));
+
+	printf("[Catalogue Index]\n");
+	printf("  FormatVersion:  %" PRId32 "\n", mIndex.getHeader().format_version.get());
+	printf("  CreationTime:   %s UTC\n", time_str);
+	printf("  FileNum:        %" PRIu64 "\n", (uint64_t)mIndex.getFileNum());
+	printf("  NcaNum:         %" PRIu64 "\n", (uint64_t)mIndex.getNcaNum());
+	printf("  TitleNum:       %" PRIu64 "\n", (uint64_t)mIndex.getTitleNum());
+	printf("  ContentNum:     %" PRIu64 "\n", (uint64_t)mIndex.getContentNum());
+}
+
+void CatalogueProcess::displayTitles()
+{
+	if (mTitleIdFilter.isSet || mTitleVersionFilter.isSet)
+	{
+		printf("  Query:\n");
+		if (mTitleIdFilter.isSet)
+			printf("    TitleId:      0x%016" PRIx64 "\n", mTitleIdFilter.var);
+		if (mTitleVersionFilter.isSet)
+			printf("    TitleVersion: v%" PRId32 "\n", mTitleVersionFilter.var);
+	}
+
+	// the title table is fixed-width so a query is a linear scan of the mapped table
+	size_t match_num = 0;
+	for (size_t i = 0; i < mIndex.getTitleNum(); i++)
+	{
+		const sCatalogueTitleEntry& title = mIndex.getTitleEntry(i);
+		if (mTitleIdFilter.isSet && title.title_id.get() != mTitleIdFilter.var)
+			continue;
+		if (mTitleVersionFilter.isSet && title.title_version.get() != mTitleVersionFilter.var)
+			continue;
+
+		displayTitle(i);
+		match_num++;
+	}
+
+	if (mTitleIdFilter.isSet || mTitleVersionFilter.isSet)
+		printf("  MatchNum:       %" PRIu64 "\n", (uint64_t)match_num);
+}
+
+void CatalogueProcess::displayTitle(size_t index)
+{
+#define _HEXDUMP_L(var, len) do { for (size_t a__a__A = 0; a__a__A < len; a__a__A++) printf("%02x", var[a__a__A]); } while(0)
+
+	const sCatalogueTitleEntry& title = mIndex.getTitleEntry(index);
+	const sCatalogueFileEntry& file = mIndex.getFileEntry(title.file_index.get());
+
+	printf("  [Title]\n");
+	printf("    TitleId:      0x%016" PRIx64 "\n", title.title_id.get());
+	printf("    Version:      v%" PRId32 "\n", title.title_version.get());
+	printf("    Type:         %s\n", getContentMetaTypeStr(title.meta_type));
+	printf("    File:         %s\n", mIndex.getString(file.path).c_str());
+	if (title.nca_index.get() < mIndex.getNcaNum())
+		printf("    MetaNca:      %s\n", mIndex.getString(mIndex.getNcaEntry(title.nca_index.get()).name).c_str());
+
+	for (size_t i = 0; i < title.name_num.get(); i++)
+	{
+		const sCatalogueNameEntry& name = mIndex.getNameEntry(title.name_index.get() + i);
+		// the first name is enough unless all of them were asked for
+		if (i > 0 && _HAS_BIT(mCliOutputMode, OUTPUT_EXTENDED) == false)
+			break;
+		printf("    Name:         %s (%s) [%s]\n", mIndex.getString(name.name).c_str(), mIndex.getString(name.publisher).c_str(), getLanguageStr(name.language.get()));
+	}
+
+	if (title.content_num.get() > 0)
+	{
+		printf("    Content:\n");
+		for (size_t i = 0; i < title.content_num.get(); i++)
+		{
+			const sCatalogueContentEntry& content = mIndex.getContentEntry(title.content_index.get() + i);
+			printf("      ");
+			_HEXDUMP_L(content.content_id, nx::cnmt::kContentIdLen);
+			printf(" %-16s 0x%" PRIx64 "\n", getContentTypeStr(content.content_type), content.size.get());
+		}
+	}
+
+#undef _HEXDUMP_L
+}
+
+const char* CatalogueProcess::getContentTypeStr(byte_t type) const
+{
+	const char* str = nullptr;
+
+	switch (type)
+	{
+		case (nx::cnmt::TYPE_META):
+			str = "Meta";
+			break;
+		case (nx::cnmt::TYPE_PROGRAM):
+			str = "Program";
+			break;
+		case (nx::cnmt::TYPE_DATA):
+			str = "Data";
+			break;
+		case (nx::cnmt::TYPE_CONTROL):
+			str = "Control";
+			break;
+		case (nx::cnmt::TYPE_HTML_DOCUMENT):
+			str = "HtmlDocument";
+			break;
+		case (nx::cnmt::TYPE_LEGAL_INFORMATION):
+			str = "LegalInformation";
+			break;
+		case (nx::cnmt::TYPE_DELTA_FRAGMENT):
+			str = "DeltaFragment";
+			break;
+		default:
+			str = "Unknown";
+			break;
+	}
+
+	return str;
+}
+
+const char* CatalogueProcess::getContentMetaTypeStr(byte_t type) const
+{
+	const char* str = nullptr;
+
+	switch (type)
+	{
+		case (nx::cnmt::METATYPE_SYSTEM_PROGRAM):
+			str = "SystemProgram";
+			break;
+		case (nx::cnmt::METATYPE_SYSTEM_DATA):
+			str = "SystemData";
+			break;
+		case (nx::cnmt::METATYPE_SYSTEM_UPDATE):
+			str = "SystemUpdate";
+			break;
+		case (nx::cnmt::METATYPE_BOOT_IMAGE_PACKAGE):
+			str = "BootImagePackage";
+			break;
+		case (nx::cnmt::METATYPE_BOOT_IMAGE_PACKAGE_SAFE):
+			str = "BootImagePackageSafe";
+			break;
+		case (nx::cnmt::METATYPE_APPLICATION):
+			str = "Application";
+			break;
+		case (nx::cnmt::METATYPE_PATCH):
+			str = "Patch";
+			break;
+		case (nx::cnmt::METATYPE_ADD_ON_CONTENT):
+			str = "AddOnContent";
+			break;
+		case (nx::cnmt::METATYPE_DELTA):
+			str = "Delta";
+			break;
+		default:
+			str = "Unknown";
+			break;
+	}
+
+	return str;
+}
+
+const char* CatalogueProcess::getLanguageStr(uint32_t language) const
+{
+	static const char* kLanguageStr[] =
+	{
+		"AmericanEnglish",
+		"BritishEnglish",
+		"Japanese",
+		"French",
+		"German",
+		"LatinAmericanSpanish",
+		"Spanish",
+		"Italian",
+		"Dutch",
+		"CanadianFrench",
+		"Portuguese",
+		"Russian",
+		"Korean",
+		"TraditionalChinese",
+		"SimplifiedChinese"
+	};
+
+	return language < (sizeof(kLanguageStr) / sizeof(kLanguageStr[0])) ? kLanguageStr[language] : "Unknown";
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include "CatalogueIndex.h"
+
+#include "nstool.h"
+
+class CatalogueProcess
+{
+public:
+	CatalogueProcess();
+
+	void process();
+
+	void setInputPath(const std::string& path);
+	void setCliOutputMode(CliOutputMode type);
+
+	// query
+	void setTitleIdFilter(uint64_t title_id);
+	void setTitleVersionFilter(uint32_t title_version);
+
+private:
+	const std::string kModuleName = "CatalogueProcess";
+
+	std::string mInputPath;
+	CliOutputMode mCliOutputMode;
+	sOptional<uint64_t> mTitleIdFilter;
+	sOptional<uint32_t> mTitleVersionFilter;
+
+	CatalogueIndex mIndex;
+
+	void displayHeader();
+	void displayTitles();
+	void displayTitle(size_t index);
+	const char* getContentTypeStr(byte_t type) const;
+	const char* getContentMetaTypeStr(byte_t type) const;
+	const char* getLanguageStr(uint32_t language) const;
+};
\ No newline at end of file
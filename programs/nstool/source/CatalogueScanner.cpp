@@ -0,0 +1,310 @@
+#include "CatalogueScanner.h"
+#include "OffsetAdjustedIFile.h"
+#include "XciProcess.h"
+#include "PfsProcess.h"
+#include "RomfsProcess.h"
+#include "NcaProcess.h"
+#include "CnmtProcess.h"
+#include "NacpProcess.h"
+
+CatalogueScanner::CatalogueScanner() :
+	mFile(nullptr),
+	mOwnIFile(false),
+	mName(),
+	mFileType(FILE_INVALID),
+	mKeyset(nullptr)
+{
+}
+
+CatalogueScanner::~CatalogueScanner()
+{
+	if (mOwnIFile)
+	{
+		delete mFile;
+	}
+}
+
+void CatalogueScanner::process()
+{
+	if (mFile == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No file reader set.");
+	}
+
+	if (mKeyset == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No keyset set.");
+	}
+
+	memset(&mRecord.entry, 0, sizeof(sCatalogueFileEntry));
+	mRecord.entry.file_type = (uint32_t)mFileType;
+	mRecord.path.clear();
+	mRecord.error.clear();
+	mRecord.nca.clear();
+	mRecord.title.clear();
+	mControlData.clear();
+
+	if (mFileType == FILE_XCI)
+		scanXci(mFile);
+	else if (mFileType == FILE_NSP || mFileType == FILE_PARTITIONFS)
+		scanPfs(mFile, 0, "");
+	else if (mFileType == FILE_NCA)
+		scanNca(mFile, 0, mName);
+
+	linkControlData();
+
+	if (mRecord.error.empty() == false)
+		mRecord.entry.status = _BIT(catalogue::FILE_STATUS_SCAN_ERROR);
+}
+
+void CatalogueScanner::setInputFile(fnd::IFile* file, bool ownIFile)
+{
+	mFile = file;
+	mOwnIFile = ownIFile;
+}
+
+void CatalogueScanner::setInputName(const std::string& name)
+{
+	mName = name;
+}
+
+void CatalogueScanner::setFileType(FileType type)
+{
+	mFileType = type;
+}
+
+void CatalogueScanner::setKeyset(const sKeyset* keyset)
+{
+	mKeyset = keyset;
+}
+
+const CatalogueIndex::sFileRecord& CatalogueScanner::getFileRecord() const
+{
+	return mRecord;
+}
+
+void CatalogueScanner::scanXci(fnd::IFile* file)
+{
+	XciProcess xci;
+	xci.setInputFile(file, SHARED_IFILE);
+	xci.setKeyset(mKeyset);
+	xci.setCliOutputMode(0);
+	xci.process();
+
+	const fnd::List<nx::PfsHeader::sFile>& partitions = xci.getRootPfsHeader().getFileList();
+	for (size_t i = 0; i < partitions.size(); i++)
+	{
+		uint64_t offset = xci.getXciHeader().getPartitionFsAddress() + partitions[i].offset;
+		OffsetAdjustedIFile partition(file, SHARED_IFILE, offset, partitions[i].size);
+		scanPfs(&partition, offset, kXciMountPointName + partitions[i].name);
+	}
+}
+
+void CatalogueScanner::scanPfs(fnd::IFile* file, uint64_t base_offset, const std::string& mount_name)
+{
+	PfsProcess pfs;
+	pfs.setInputFile(file, SHARED_IFILE);
+	pfs.setCliOutputMode(0);
+	pfs.process();
+
+	const fnd::List<nx::PfsHeader::sFile>& entries = pfs.getPfsHeader().getFileList();
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (isNcaFile(entries[i].name) == false)
+			continue;
+
+		std::string path = mount_name;
+		if (path.empty() == false && path[path.length()-1] != '/')
+			path += "/";
+		path += entries[i].name;
+
+		OffsetAdjustedIFile nca(file, SHARED_IFILE, entries[i].offset, entries[i].size);
+		scanNca(&nca, base_offset + entries[i].offset, path);
+	}
+}
+
+void CatalogueScanner::scanNca(fnd::IFile* file, uint64_t base_offset, const std::string& name)
+{
+	CatalogueIndex::sNcaRecord record;
+	memset(&record.entry, 0, sizeof(sCatalogueNcaEntry));
+	record.name = name;
+	record.entry.offset = base_offset;
+	record.entry.size = file->size();
+
+	// the content id is the name of the nca (minus extension)
+	std::string file_name = name.substr(name.find_last_of("/\\") == std::string::npos ? 0 : name.find_last_of("/\\") + 1);
+	getContentIdFromName(file_name, record.entry.content_id);
+
+	size_t nca_index = mRecord.nca.size();
+	try
+	{
+		NcaProcess nca;
+		nca.setInputFile(file, SHARED_IFILE);
+		nca.setKeyset(mKeyset);
+		nca.setCliOutputMode(0);
+		nca.process();
+
+		const nx::NcaHeader& hdr = nca.getNcaHeader();
+		record.entry.program_id = hdr.getProgramId();
+		record.entry.content_size = hdr.getContentSize();
+		record.entry.sdk_addon_version = hdr.getSdkAddonVersion();
+		record.entry.content_index = hdr.getContentIndex();
+		record.entry.format_version = (byte_t)hdr.getFormatVersion();
+		record.entry.distribution_type = (byte_t)hdr.getDistributionType();
+		record.entry.content_type = (byte_t)hdr.getContentType();
+		record.entry.key_generation = hdr.getKeyGeneration();
+		record.entry.kaek_index = hdr.getKaekIndex();
+		record.entry.has_rights_id = hdr.hasRightsId();
+		memcpy(record.entry.rights_id, hdr.getRightsId(), nx::nca::kRightsIdLen);
+		for (size_t i = 0; i < hdr.getPartitions().size(); i++)
+		{
+			const nx::NcaHeader::sPartition& partition = hdr.getPartitions()[i];
+			record.entry.partition_mask |= _BIT(partition.index);
+			record.entry.partition[partition.index].offset = partition.offset;
+			record.entry.partition[partition.index].size = partition.size;
+		}
+		crypto::sha::Sha256(hdr.getBytes().data(), hdr.getBytes().size(), record.entry.header_hash);
+
+		mRecord.nca.addElement(record);
+
+		if (hdr.getContentType() == nx::nca::TYPE_META && nca.getPartitionReader(0) != nullptr)
+			importCnmt(nca.getPartitionReader(0), nca_index);
+		else if (hdr.getContentType() == nx::nca::TYPE_CONTROL && nca.getPartitionReader(0) != nullptr)
+			importNacp(nca.getPartitionReader(0), record.entry.content_id);
+	}
+	catch (const fnd::Exception& e)
+	{
+		if (mRecord.nca.size() == nca_index)
+			mRecord.nca.addElement(record);
+
+		if (mRecord.error.empty() == false)
+			mRecord.error += "; ";
+		mRecord.error += name + ": " + e.what();
+	}
+}
+
+void CatalogueScanner::importCnmt(fnd::IFile* partition, size_t nca_index)
+{
+	static const std::string kCnmtExtention = ".cnmt";
+
+	PfsProcess pfs;
+	pfs.setInputFile(partition, SHARED_IFILE);
+	pfs.setCliOutputMode(0);
+	pfs.process();
+
+	const fnd::List<nx::PfsHeader::sFile>& entries = pfs.getPfsHeader().getFileList();
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const std::string& name = entries[i].name;
+		if (name.size() <= kCnmtExtention.size() || name.compare(name.size() - kCnmtExtention.size(), kCnmtExtention.size(), kCnmtExtention) != 0)
+			continue;
+
+		CnmtProcess cnmt;
+		cnmt.setInputFile(new OffsetAdjustedIFile(partition, SHARED_IFILE, entries[i].offset, entries[i].size), OWN_IFILE);
+		cnmt.setCliOutputMode(0);
+		cnmt.process();
+
+		const nx::ContentMetaBinary& meta = cnmt.getContentMetaBinary();
+		CatalogueIndex::sTitleRecord title;
+		memset(&title.entry, 0, sizeof(sCatalogueTitleEntry));
+		title.entry.nca_index = (uint32_t)nca_index;
+		title.entry.title_id = meta.getTitleId();
+		title.entry.title_version = meta.getTitleVersion();
+		title.entry.meta_type = (byte_t)meta.getType();
+
+		for (size_t j = 0; j < meta.getContentInfo().size(); j++)
+		{
+			const nx::ContentMetaBinary::ContentInfo& info = meta.getContentInfo()[j];
+			sCatalogueContentEntry content;
+			memset(&content, 0, sizeof(sCatalogueContentEntry));
+			memcpy(content.content_id, info.nca_id, nx::cnmt::kContentIdLen);
+			memcpy(content.hash, info.hash.bytes, crypto::sha::kSha256HashLen);
+			content.size = info.size;
+			content.content_type = (byte_t)info.type;
+			title.content.addElement(content);
+		}
+
+		mRecord.title.addElement(title);
+	}
+}
+
+void CatalogueScanner::importNacp(fnd::IFile* partition, const byte_t* content_id)
+{
+	RomfsProcess romfs;
+	romfs.setInputFile(partition, SHARED_IFILE);
+	romfs.setCliOutputMode(0);
+	romfs.process();
+
+	const fnd::List<RomfsProcess::sFile>& files = romfs.getRootDir().file_list;
+	if (files.hasElement(kNacpRomfsPath) == false)
+		return;
+	const RomfsProcess::sFile& file = files.getElement(kNacpRomfsPath);
+
+	NacpProcess nacp;
+	nacp.setInputFile(new OffsetAdjustedIFile(partition, SHARED_IFILE, file.offset, file.size), OWN_IFILE);
+	nacp.setCliOutputMode(0);
+	nacp.process();
+
+	sControlData control;
+	memcpy(control.content_id, content_id, nx::cnmt::kContentIdLen);
+	const fnd::List<nx::ApplicationControlPropertyBinary::sTitle>& title = nacp.getApplicationControlPropertyBinary().getTitle();
+	for (size_t i = 0; i < title.size(); i++)
+	{
+		CatalogueIndex::sNameRecord name;
+		name.language = (uint32_t)title[i].language;
+		name.name = title[i].name;
+		name.publisher = title[i].publisher;
+		control.name.addElement(name);
+	}
+	mControlData.addElement(control);
+}
+
+void CatalogueScanner::linkControlData()
+{
+	// names belong to the title whose CNMT lists the control NCA they were read from
+	for (size_t i = 0; i < mControlData.size(); i++)
+	{
+		CatalogueIndex::sTitleRecord* owner = nullptr;
+		for (size_t j = 0; j < mRecord.title.size() && owner == nullptr; j++)
+		{
+			for (size_t k = 0; k < mRecord.title[j].content.size(); k++)
+			{
+				if (memcmp(mRecord.title[j].content[k].content_id, mControlData[i].content_id, nx::cnmt::kContentIdLen) == 0)
+				{
+					owner = &mRecord.title[j];
+					break;
+				}
+			}
+		}
+
+		if (owner == nullptr && mRecord.title.size() > 0)
+			owner = &mRecord.title[0];
+		if (owner == nullptr)
+			continue;
+
+		for (size_t j = 0; j < mControlData[i].name.size(); j++)
+		{
+			owner->name.addElement(mControlData[i].name[j]);
+		}
+	}
+}
+
+bool CatalogueScanner::getContentIdFromName(const std::string& name, byte_t* content_id) const
+{
+	static const size_t kContentIdStrLen = nx::cnmt::kContentIdLen * 2;
+
+	if (name.size() < kContentIdStrLen || (name.size() > kContentIdStrLen && name[kContentIdStrLen] != '.'))
+		return false;
+
+	for (size_t i = 0; i < kContentIdStrLen; i++)
+	{
+		if (isxdigit(name[i]) == false)
+			return false;
+	}
+
+	for (size_t i = 0; i < nx::cnmt::kContentIdLen; i++)
+	{
+		content_id[i] = (charToByte(name[i * 2]) << 4) | charToByte(name[(i * 2) + 1]);
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include <fnd/IFile.h>
+#include "CatalogueIndex.h"
+
+#include "nstool.h"
+
+// Collects the catalogue record of a container: the header fields and layout of every
+// NCA it contains, the titles and content listed by its CNMT(s) and the NACP title names.
+class CatalogueScanner
+{
+public:
+	CatalogueScanner();
+	~CatalogueScanner();
+
+	void process();
+
+	void setInputFile(fnd::IFile* file, bool ownIFile);
+	void setInputName(const std::string& name);
+	void setFileType(FileType type);
+	void setKeyset(const sKeyset* keyset);
+
+	// file record without path/size/mtime, which are left to the caller
+	const CatalogueIndex::sFileRecord& getFileRecord() const;
+
+private:
+	const std::string kModuleName = "CatalogueScanner";
+	const std::string kXciMountPointName = "gamecard:/";
+	const std::string kNacpRomfsPath = "control.nacp";
+
+	fnd::IFile* mFile;
+	bool mOwnIFile;
+	std::string mName;
+	FileType mFileType;
+	const sKeyset* mKeyset;
+
+	struct sControlData
+	{
+		byte_t content_id[nx::cnmt::kContentIdLen];
+		fnd::List<CatalogueIndex::sNameRecord> name;
+	};
+
+	CatalogueIndex::sFileRecord mRecord;
+	fnd::List<sControlData> mControlData;
+
+	void scanXci(fnd::IFile* file);
+	void scanPfs(fnd::IFile* file, uint64_t base_offset, const std::string& mount_name);
+	void scanNca(fnd::IFile* file, uint64_t base_offset, const std::string& name);
+	void importCnmt(fnd::IFile* partition, size_t nca_index);
+	void importNacp(fnd::IFile* partition, const byte_t* content_id);
+	void linkControlData();
+	bool getContentIdFromName(const std::string& name, byte_t* content_id) const;
+};
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include "ContainerFs.h"
+#include <algorithm>
+#include <fnd/SimpleFile.h>
+#include <fnd/io.h>
+#include "OffsetAdjustedIFile.h"
+#include "LockedIFile.h"
+#include "XciProcess.h"
+#include "PfsProcess.h"
+
+ContainerFs::ContainerFs() :
+	mUserSettings(nullptr),
+	mRoot(nullptr)
+{
+}
+
+ContainerFs::~ContainerFs()
+{
+	// nca processes own the partition readers handed out to nodes, and are
+	// themselves reading from readers in mReaders
+	for (size_t i = 0; i < mNcas.size(); i++)
+	{
+		delete mNcas[i];
+	}
+	for (size_t i = mReaders.size(); i > 0; i--)
+	{
+		delete mReaders[i-1];
+	}
+	for (size_t i = 0; i < mNodes.size(); i++)
+	{
+		delete mNodes[i];
+	}
+}
+
+void ContainerFs::open(const std::string& path, const UserSettings* user_set)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (mRoot != nullptr)
+	{
+		throw fnd::Exception(kModuleName, "A container is already open");
+	}
+
+	mUserSettings = user_set;
+
+	fnd::IFile* file = mUserSettings->openInputFile(path);
+	mReaders.push_back(file);
+
+	mRoot = createNode(path.substr(path.find_last_of("/\\") == std::string::npos ? 0 : path.find_last_of("/\\") + 1), false, file->size(), file);
+	resolveType(mRoot);
+	if (isContainer(mRoot) == false)
+	{
+		throw fnd::Exception(kModuleName, "\"" + path + "\" is not a container");
+	}
+}
+
+void ContainerFs::splitPath(const std::string& path, std::string& container_path, std::string& entry_path)
+{
+	// the container is the shortest prefix of the path that is a file on disk
+	for (size_t pos = path.find_first_of("/\\", 1); ; pos = path.find_first_of("/\\", pos + 1))
+	{
+		std::string prefix = path.substr(0, pos);
+		if (fnd::io::fileExists(prefix))
+		{
+			container_path = prefix;
+			entry_path = pos == std::string::npos ? std::string() : path.substr(pos + 1);
+			return;
+		}
+
+		if (pos == std::string::npos)
+			break;
+	}
+
+	throw fnd::Exception("ContainerFs", "\"" + path + "\" does not begin with a container file");
+}
+
+ContainerFs::sEntry ContainerFs::getEntry(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	sNode* node = findNode(path);
+	resolveType(node);
+	return makeEntry(node);
+}
+
+std::vector<ContainerFs::sEntry> ContainerFs::listDir(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	sNode* node = findNode(path);
+	if (node->is_dir == false)
+	{
+		if (isContainer(node) == false)
+		{
+			throw fnd::Exception(kModuleName, "\"" + path + "\" is not a directory");
+		}
+		mount(node);
+	}
+
+	std::vector<sEntry> entries;
+	for (size_t i = 0; i < node->children.size(); i++)
+	{
+		resolveType(node->children[i]);
+		entries.push_back(makeEntry(node->children[i]));
+	}
+	return entries;
+}
+
+size_t ContainerFs::readFile(const std::string& path, uint64_t offset, size_t size, byte_t* out)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	sNode* node = findNode(path);
+	if (node->is_dir)
+	{
+		throw fnd::Exception(kModuleName, "\"" + path + "\" is a directory");
+	}
+
+	if (offset >= node->size)
+		return 0;
+	size = (size_t)_MIN(size, node->size - offset);
+
+	node->reader->read(out, offset, size);
+	return size;
+}
+
+fnd::IFile* ContainerFs::openFile(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	sNode* node = findNode(path);
+	if (node->is_dir)
+	{
+		throw fnd::Exception(kModuleName, "\"" + path + "\" is a directory");
+	}
+
+	// the node reader (and the container readers under it) are shared with every other user of this ContainerFs
+	return new LockedIFile(new OffsetAdjustedIFile(node->reader, SHARED_IFILE, 0, node->size), OWN_IFILE, mLock);
+}
+
+ContainerFs::sNode* ContainerFs::createNode(const std::string& name, bool is_dir, uint64_t size, fnd::IFile* reader)
+{
+	sNode* node = new sNode;
+	node->name = name;
+	node->is_dir = is_dir;
+	node->mounted = is_dir;
+	node->type_known = is_dir;
+	node->type = FILE_INVALID;
+	node->size = size;
+	node->reader = reader;
+	mNodes.push_back(node);
+	return node;
+}
+
+ContainerFs::sNode* ContainerFs::findNode(const std::string& path)
+{
+	if (mRoot == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No container open");
+	}
+
+	sNode* node = mRoot;
+	size_t pos = 0;
+	while (pos < path.size())
+	{
+		size_t end = path.find('/', pos);
+		if (end == std::string::npos)
+			end = path.size();
+		std::string name = path.substr(pos, end - pos);
+		pos = end + 1;
+
+		if (name.empty() || name == ".")
+			continue;
+
+		if (node->is_dir == false)
+		{
+			if (isContainer(node) == false)
+			{
+				throw fnd::Exception(kModuleName, "\"" + node->name + "\" is not a directory or container");
+			}
+			mount(node);
+		}
+
+		sNode* child = nullptr;
+		for (size_t i = 0; i < node->children.size() && child == nullptr; i++)
+		{
+			const sNode* candidate = node->children[i];
+			if (candidate->name == name || std::find(candidate->aliases.begin(), candidate->aliases.end(), name) != candidate->aliases.end())
+				child = node->children[i];
+		}
+		if (child == nullptr)
+		{
+			throw fnd::Exception(kModuleName, "\"" + path + "\" does not exist");
+		}
+		node = child;
+	}
+
+	return node;
+}
+
+void ContainerFs::resolveType(sNode* node)
+{
+	if (node->type_known)
+		return;
+
+	node->type = node->size == 0 ? FILE_INVALID : mUserSettings->determineFileType(node->reader);
+	node->type_known = true;
+}
+
+bool ContainerFs::isContainer(sNode* node)
+{
+	resolveType(node);
+	return node->type == FILE_XCI || node->type == FILE_PARTITIONFS || node->type == FILE_NCA || node->type == FILE_ROMFS;
+}
+
+void ContainerFs::mount(sNode* node)
+{
+	if (node->mounted)
+		return;
+
+	switch (node->type)
+	{
+		case (FILE_XCI):
+			mountXci(node);
+			break;
+		case (FILE_PARTITIONFS):
+			mountPfs(node);
+			break;
+		case (FILE_NCA):
+			mountNca(node);
+			break;
+		case (FILE_ROMFS):
+			mountRomfs(node);
+			break;
+		default:
+			throw fnd::Exception(kModuleName, "\"" + node->name + "\" is not a container");
+	}
+
+	node->mounted = true;
+}
+
+void ContainerFs::mountXci(sNode* node)
+{
+	XciProcess xci;
+	xci.setInputFile(node->reader, SHARED_IFILE);
+	xci.setKeyset(&mUserSettings->getKeyset());
+	xci.setCliOutputMode(0);
+	xci.process();
+
+	const fnd::List<nx::PfsHeader::sFile>& partitions = xci.getRootPfsHeader().getFileList();
+	for (size_t i = 0; i < partitions.size(); i++)
+	{
+		fnd::IFile* reader = new OffsetAdjustedIFile(node->reader, SHARED_IFILE, xci.getXciHeader().getPartitionFsAddress() + partitions[i].offset, partitions[i].size);
+		mReaders.push_back(reader);
+		node->children.push_back(createNode(partitions[i].name, false, partitions[i].size, reader));
+	}
+}
+
+void ContainerFs::mountPfs(sNode* node)
+{
+	PfsProcess pfs;
+	pfs.setInputFile(node->reader, SHARED_IFILE);
+	pfs.setCliOutputMode(0);
+	pfs.process();
+
+	const fnd::List<nx::PfsHeader::sFile>& entries = pfs.getPfsHeader().getFileList();
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		fnd::IFile* reader = new OffsetAdjustedIFile(node->reader, SHARED_IFILE, entries[i].offset, entries[i].size);
+		mReaders.push_back(reader);
+		node->children.push_back(createNode(entries[i].name, false, entries[i].size, reader));
+	}
+}
+
+void ContainerFs::mountNca(sNode* node)
+{
+	NcaProcess* nca = new NcaProcess();
+	mNcas.push_back(nca);
+	nca->setInputFile(node->reader, SHARED_IFILE);
+	nca->setKeyset(&mUserSettings->getKeyset());
+	nca->setCliOutputMode(0);
+	nca->process();
+
+	static const char* kProgramPartitionName[nx::nca::kPartitionNum] = { "code", "data", "logo", "" };
+	bool has_romfs_alias = false;
+
+	// partitions that could not be opened (e.g. missing keys) are left out
+	for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
+	{
+		fnd::IFile* reader = nca->getPartitionReader(i);
+		if (reader == nullptr)
+			continue;
+
+		sNode* child = createNode(std::to_string(i), false, reader->size(), reader);
+		resolveType(child);
+		if (nca->getNcaHeader().getContentType() == nx::nca::TYPE_PROGRAM && kProgramPartitionName[i][0] != '\0')
+		{
+			child->aliases.push_back(kProgramPartitionName[i]);
+		}
+		if (child->type == FILE_ROMFS && has_romfs_alias == false)
+		{
+			child->aliases.push_back("romfs");
+			has_romfs_alias = true;
+		}
+		node->children.push_back(child);
+	}
+}
+
+void ContainerFs::mountRomfs(sNode* node)
+{
+	RomfsProcess romfs;
+	romfs.setInputFile(node->reader, SHARED_IFILE);
+	romfs.setCliOutputMode(0);
+	romfs.process();
+
+	importRomfsDir(node, romfs.getRootDir(), node->reader);
+}
+
+void ContainerFs::importRomfsDir(sNode* parent, const RomfsProcess::sDirectory& dir, fnd::IFile* romfs_reader)
+{
+	for (size_t i = 0; i < dir.dir_list.size(); i++)
+	{
+		sNode* child = createNode(dir.dir_list[i].name, true, 0, nullptr);
+		parent->children.push_back(child);
+		importRomfsDir(child, dir.dir_list[i], romfs_reader);
+	}
+	for (size_t i = 0; i < dir.file_list.size(); i++)
+	{
+		const RomfsProcess::sFile& file = dir.file_list[i];
+		fnd::IFile* reader = new OffsetAdjustedIFile(romfs_reader, SHARED_IFILE, file.offset, file.size);
+		mReaders.push_back(reader);
+		parent->children.push_back(createNode(file.name, false, file.size, reader));
+	}
+}
+
+ContainerFs::sEntry ContainerFs::makeEntry(const sNode* node) const
+{
+	sEntry entry;
+	entry.name = node->name;
+	entry.is_dir = node->is_dir;
+	entry.size = node->size;
+	entry.type = node->type;
+	return entry;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fnd/types.h>
+#include <fnd/IFile.h>
+#include <fnd/Exception.h>
+#include "UserSettings.h"
+#include "NcaProcess.h"
+#include "RomfsProcess.h"
+
+#include "nstool.h"
+
+// Presents a container file (XCI/PFS0/HFS0/NCA/RomFS) as a read-only file tree.
+// Nested containers are mounted the first time a path walks into them, e.g.
+// "secure/<id>.nca/romfs/dir/file" for a file in the RomFS of an NCA in a gamecard.
+// NCA partitions are named by index, and can also be reached by their program
+// partition name (code/data/logo) or, for the first RomFS partition, "romfs".
+// Mounted containers stay open, so the partition readers of an NCA (and the
+// decrypted/verified blocks they hold) are reused by later requests.
+class ContainerFs
+{
+public:
+	struct sEntry
+	{
+		std::string name;
+		bool is_dir;
+		uint64_t size;
+		FileType type;
+	};
+
+	ContainerFs();
+	~ContainerFs();
+
+	void open(const std::string& path, const UserSettings* user_set);
+
+	// splits "game.xci/secure/<id>.nca/romfs/x.bin" into the path of the container on disk and the entry path within it
+	static void splitPath(const std::string& path, std::string& container_path, std::string& entry_path);
+
+	sEntry getEntry(const std::string& path);
+	std::vector<sEntry> listDir(const std::string& path);
+	// returns the number of bytes read, which is less than size at the end of the file
+	size_t readFile(const std::string& path, uint64_t offset, size_t size, byte_t* out);
+	// stream of a file, valid while this ContainerFs exists; like readFile() each access holds
+	// the filesystem lock, so it must not be used from within accessFile()
+	fnd::IFile* openFile(const std::string& path);
+
+	// runs a process on a node's data while holding the filesystem lock
+	template <class T>
+	void accessFile(const std::string& path, T func)
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		sNode* node = findNode(path);
+		if (node->is_dir)
+		{
+			throw fnd::Exception(kModuleName, "\"" + path + "\" is a directory");
+		}
+		resolveType(node);
+		func(node->reader, node->type);
+	}
+
+private:
+	const std::string kModuleName = "ContainerFs";
+
+	struct sNode
+	{
+		std::string name;
+		std::vector<std::string> aliases;
+		bool is_dir;
+		bool mounted;
+		bool type_known;
+		FileType type;
+		uint64_t size;
+		fnd::IFile* reader;
+		std::vector<sNode*> children;
+	};
+
+	std::mutex mLock;
+	const UserSettings* mUserSettings;
+	sNode* mRoot;
+	std::vector<sNode*> mNodes;
+	std::vector<fnd::IFile*> mReaders;
+	std::vector<NcaProcess*> mNcas;
+
+	sNode* createNode(const std::string& name, bool is_dir, uint64_t size, fnd::IFile* reader);
+	sNode* findNode(const std::string& path);
+	void resolveType(sNode* node);
+	bool isContainer(sNode* node);
+	void mount(sNode* node);
+	void mountXci(sNode* node);
+	void mountPfs(sNode* node);
+	void mountNca(sNode* node);
+	void mountRomfs(sNode* node);
+	void importRomfsDir(sNode* parent, const RomfsProcess::sDirectory& dir, fnd::IFile* romfs_reader);
+	sEntry makeEntry(const sNode* node) const;
+};
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include "DiffProcess.h"
+#include <cstdio>
+#include <memory>
+#include <algorithm>
+#include <fnd/SimpleFile.h>
+#include <fnd/Vec.h>
+#include <crypto/sha.h>
+#include "ContainerFs.h"
+#include "OffsetAdjustedIFile.h"
+#include "PfsProcess.h"
+#include "RomfsProcess.h"
+
+DiffProcess::DiffProcess() :
+	mUserSettings(nullptr),
+	mOldPath(),
+	mNewPath(),
+	mHashBytesRead(0),
+	mDataBytesRead(0),
+	mChangedNum(0),
+	mAddedNum(0),
+	mRemovedNum(0)
+{
+}
+
+DiffProcess::~DiffProcess()
+{
+}
+
+void DiffProcess::process()
+{
+	if (mUserSettings == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No user settings set.");
+	}
+
+	// open both NCAs, through their containers if nested
+	std::string container_path[2], entry[2];
+	ContainerFs::splitPath(mOldPath, container_path[0], entry[0]);
+	ContainerFs::splitPath(mNewPath, container_path[1], entry[1]);
+
+	std::unique_ptr<ContainerFs> fs[2];
+	NcaProcess nca[2];
+	for (size_t i = 0; i < 2; i++)
+	{
+		fnd::IFile* file;
+		if (entry[i].empty())
+		{
+			file = mUserSettings->openInputFile(container_path[i]);
+		}
+		else
+		{
+			fs[i].reset(new ContainerFs());
+			fs[i]->open(container_path[i], mUserSettings);
+			file = fs[i]->openFile(entry[i]);
+		}
+
+		nca[i].setInputFile(file, OWN_IFILE);
+		nca[i].setKeyset(&mUserSettings->getKeyset());
+		nca[i].setCliOutputMode(0);
+		nca[i].setVerifyMode(false);
+		nca[i].process();
+	}
+
+	printf("[Diff]\n");
+	printf("  Old:         %s\n", mOldPath.c_str());
+	printf("  New:         %s\n", mNewPath.c_str());
+
+	for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
+	{
+		diffPartition(nca[0], nca[1], i);
+	}
+
+	printf("  Summary:     %" PRIu64 " changed, %" PRIu64 " added, %" PRIu64 " removed\n", (uint64_t)mChangedNum, (uint64_t)mAddedNum, (uint64_t)mRemovedNum);
+	printf("  Read:        0x%" PRIx64 " bytes of hash layers, 0x%" PRIx64 " bytes of file data\n", mHashBytesRead, mDataBytesRead);
+}
+
+void DiffProcess::setUserSettings(const UserSettings* user_set)
+{
+	mUserSettings = user_set;
+}
+
+void DiffProcess::setInputPaths(const std::string& old_path, const std::string& new_path)
+{
+	mOldPath = old_path;
+	mNewPath = new_path;
+}
+
+void DiffProcess::diffPartition(NcaProcess& old_nca, NcaProcess& new_nca, size_t index)
+{
+	crypto::sha::sSha256Hash old_hash, new_hash;
+	bool old_exists = findPartition(old_nca, index, old_hash);
+	bool new_exists = findPartition(new_nca, index, new_hash);
+
+	if (old_exists == false && new_exists == false)
+		return;
+
+	printf("  Partition %" PRIu64 ":\n", (uint64_t)index);
+	if (old_exists == false || new_exists == false)
+	{
+		printf("    %s\n", old_exists ? "Removed" : "Added");
+		return;
+	}
+
+	// the fs header hash covers the master hash, equal headers mean equal partitions
+	if (old_hash == new_hash)
+	{
+		printf("    Unchanged\n");
+		return;
+	}
+
+	nx::nca::FormatType format_type = new_nca.getPartitionFormatType(index);
+	if (old_nca.getPartitionFormatType(index) != format_type)
+	{
+		printf("    Changed (FormatType %s -> %s)\n", getFormatTypeStr(old_nca.getPartitionFormatType(index)), getFormatTypeStr(format_type));
+		return;
+	}
+
+	std::unique_ptr<fnd::IFile> old_raw, new_raw;
+	try
+	{
+		old_raw.reset(old_nca.openPartitionDecryptedReader(index));
+		new_raw.reset(new_nca.openPartitionDecryptedReader(index));
+	}
+	catch (const fnd::Exception& e)
+	{
+		printf("    [WARNING] Failed to open partition (%s)\n", e.error());
+		return;
+	}
+
+	// compare the hash trees to find the data blocks that changed
+	const HashTreeMeta* old_meta = old_nca.getPartitionHashTreeMeta(index);
+	const HashTreeMeta* new_meta = new_nca.getPartitionHashTreeMeta(index);
+	std::vector<size_t> diff_blocks;
+	bool has_block_diff = old_meta != nullptr && new_meta != nullptr && diffHashTree(old_raw.get(), *old_meta, new_raw.get(), *new_meta, diff_blocks);
+
+	// the file system is read from the data layer (the whole partition for unhashed partitions)
+	std::unique_ptr<fnd::IFile> old_data, new_data;
+	if (old_meta != nullptr)
+		old_data.reset(new OffsetAdjustedIFile(old_raw.get(), SHARED_IFILE, old_meta->getDataLayer().offset, old_meta->getDataLayer().size));
+	else
+		old_data.reset(new OffsetAdjustedIFile(old_raw.get(), SHARED_IFILE, 0, old_raw->size()));
+	if (new_meta != nullptr)
+		new_data.reset(new OffsetAdjustedIFile(new_raw.get(), SHARED_IFILE, new_meta->getDataLayer().offset, new_meta->getDataLayer().size));
+	else
+		new_data.reset(new OffsetAdjustedIFile(new_raw.get(), SHARED_IFILE, 0, new_raw->size()));
+
+	size_t block_size = has_block_diff ? new_meta->getDataLayer().block_size : 0;
+	if (has_block_diff)
+		printf("    Changed (%" PRIu64 " of %" PRIu64 " data blocks, block size 0x%" PRIx64 ")\n", (uint64_t)diff_blocks.size(), (uint64_t)((new_data->size() + block_size - 1) / block_size), (uint64_t)block_size);
+	else
+		printf("    Changed (hash trees not comparable, changed files are compared by content)\n");
+
+	std::map<std::string, sFileEntry> old_files, new_files;
+	try
+	{
+		importFileList(old_data.get(), format_type, old_files);
+		importFileList(new_data.get(), format_type, new_files);
+	}
+	catch (const fnd::Exception& e)
+	{
+		printf("    [WARNING] Failed to read file system (%s)\n", e.error());
+		return;
+	}
+
+	std::string prefix = std::to_string(index) + "/";
+	for (std::map<std::string, sFileEntry>::const_iterator itr = old_files.begin(); itr != old_files.end(); itr++)
+	{
+		std::map<std::string, sFileEntry>::const_iterator new_itr = new_files.find(itr->first);
+		if (new_itr == new_files.end())
+		{
+			printf("    D %s%s\n", prefix.c_str(), itr->first.c_str());
+			mRemovedNum++;
+			continue;
+		}
+
+		const sFileEntry& old_entry = itr->second;
+		const sFileEntry& new_entry = new_itr->second;
+		bool changed;
+		if (old_entry.size != new_entry.size)
+			changed = true;
+		else if (has_block_diff && old_entry.offset == new_entry.offset)
+			changed = isRangeChanged(old_data.get(), new_data.get(), diff_blocks, block_size, new_entry.offset, new_entry.size);
+		else // moved files can't be matched to hash blocks, their contents are compared instead
+			changed = isDataChanged(old_data.get(), old_entry.offset, new_data.get(), new_entry.offset, new_entry.size);
+
+		if (changed)
+		{
+			printf("    M %s%s\n", prefix.c_str(), itr->first.c_str());
+			mChangedNum++;
+		}
+	}
+	for (std::map<std::string, sFileEntry>::const_iterator itr = new_files.begin(); itr != new_files.end(); itr++)
+	{
+		if (old_files.find(itr->first) == old_files.end())
+		{
+			printf("    A %s%s\n", prefix.c_str(), itr->first.c_str());
+			mAddedNum++;
+		}
+	}
+}
+
+bool DiffProcess::diffHashTree(fnd::IFile* old_file, const HashTreeMeta& old_meta, fnd::IFile* new_file, const HashTreeMeta& new_meta, std::vector<size_t>& diff_blocks)
+{
+	const size_t kHashSize = sizeof(crypto::sha::sSha256Hash);
+
+	// hashes at the same index only describe the same data if the trees have the same shape
+	if (old_meta.getAlignHashToBlock() != new_meta.getAlignHashToBlock())
+		return false;
+	if (old_meta.getHashLayerInfo().size() != new_meta.getHashLayerInfo().size() || old_meta.getDataLayer().block_size != new_meta.getDataLayer().block_size)
+		return false;
+	for (size_t i = 0; i < new_meta.getHashLayerInfo().size(); i++)
+	{
+		if (old_meta.getHashLayerInfo()[i].block_size != new_meta.getHashLayerInfo()[i].block_size)
+			return false;
+	}
+
+	// master hashes
+	std::vector<size_t> diff;
+	const fnd::List<crypto::sha::sSha256Hash>& old_master = old_meta.getMasterHashList();
+	const fnd::List<crypto::sha::sSha256Hash>& new_master = new_meta.getMasterHashList();
+	for (size_t i = 0; i < _MAX(old_master.size(), new_master.size()); i++)
+	{
+		if (i >= old_master.size() || i >= new_master.size() || old_master[i] != new_master[i])
+			diff.push_back(i);
+	}
+
+	// a HierarchicalSha256 master hash covers the whole first hash layer, not one block of it
+	if (new_meta.getAlignHashToBlock() == false && diff.empty() == false && new_meta.getHashLayerInfo().size() > 0)
+	{
+		size_t block_size = new_meta.getHashLayerInfo()[0].block_size;
+		size_t layer_size = (size_t)_MAX(old_meta.getHashLayerInfo()[0].size, new_meta.getHashLayerInfo()[0].size);
+		diff.clear();
+		for (size_t i = 0; i < (layer_size + block_size - 1) / block_size; i++)
+			diff.push_back(i);
+	}
+
+	// descend each hash layer only below the hashes that differ
+	fnd::Vec<byte_t> old_block, new_block;
+	for (size_t i = 0; i < new_meta.getHashLayerInfo().size(); i++)
+	{
+		const HashTreeMeta::sLayer& old_layer = old_meta.getHashLayerInfo()[i];
+		const HashTreeMeta::sLayer& new_layer = new_meta.getHashLayerInfo()[i];
+		size_t block_size = new_layer.block_size;
+		size_t hash_per_block = block_size / kHashSize;
+		size_t old_hash_num = old_layer.size / kHashSize;
+		size_t new_hash_num = new_layer.size / kHashSize;
+
+		old_block.alloc(block_size);
+		new_block.alloc(block_size);
+
+		std::vector<size_t> next_diff;
+		for (size_t j = 0; j < diff.size(); j++)
+		{
+			size_t pos = diff[j] * block_size;
+			size_t old_len = pos < old_layer.size ? _MIN(old_layer.size - pos, block_size) : 0;
+			size_t new_len = pos < new_layer.size ? _MIN(new_layer.size - pos, block_size) : 0;
+			if (old_len > 0)
+				old_file->read(old_block.data(), old_layer.offset + pos, old_len);
+			if (new_len > 0)
+				new_file->read(new_block.data(), new_layer.offset + pos, new_len);
+			mHashBytesRead += old_len + new_len;
+
+			for (size_t k = 0; k < hash_per_block; k++)
+			{
+				size_t hash_index = diff[j] * hash_per_block + k;
+				bool in_old = hash_index < old_hash_num;
+				bool in_new = hash_index < new_hash_num;
+				if (in_old == false && in_new == false)
+					break;
+
+				if (in_old != in_new || memcmp(old_block.data() + k * kHashSize, new_block.data() + k * kHashSize, kHashSize) != 0)
+					next_diff.push_back(hash_index);
+			}
+		}
+		diff.swap(next_diff);
+	}
+
+	diff_blocks.swap(diff);
+	return true;
+}
+
+void DiffProcess::importFileList(fnd::IFile* file, nx::nca::FormatType format_type, std::map<std::string, sFileEntry>& file_list)
+{
+	if (format_type == nx::nca::FORMAT_PFS0)
+	{
+		PfsProcess pfs;
+		pfs.setInputFile(file, SHARED_IFILE);
+		pfs.setCliOutputMode(0);
+		pfs.process();
+
+		const fnd::List<nx::PfsHeader::sFile>& files = pfs.getPfsHeader().getFileList();
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			file_list[files[i].name] = { files[i].offset, files[i].size };
+		}
+	}
+	else if (format_type == nx::nca::FORMAT_ROMFS)
+	{
+		RomfsProcess romfs;
+		romfs.setInputFile(file, SHARED_IFILE);
+		romfs.setCliOutputMode(0);
+		romfs.process();
+
+		// flatten the directory tree into paths
+		std::vector<std::pair<std::string, const RomfsProcess::sDirectory*>> dirs;
+		dirs.push_back(std::make_pair(std::string(), &romfs.getRootDir()));
+		while (dirs.empty() == false)
+		{
+			std::string path = dirs.back().first;
+			const RomfsProcess::sDirectory* dir = dirs.back().second;
+			dirs.pop_back();
+
+			for (size_t i = 0; i < dir->file_list.size(); i++)
+			{
+				file_list[path + dir->file_list[i].name] = { dir->file_list[i].offset, dir->file_list[i].size };
+			}
+			for (size_t i = 0; i < dir->dir_list.size(); i++)
+			{
+				dirs.push_back(std::make_pair(path + dir->dir_list[i].name + "/", &dir->dir_list[i]));
+			}
+		}
+	}
+	else
+	{
+		throw fnd::Exception(kModuleName, "Unsupported FormatType");
+	}
+}
+
+bool DiffProcess::isRangeChanged(fnd::IFile* old_file, fnd::IFile* new_file, const std::vector<size_t>& diff_blocks, size_t block_size, uint64_t offset, uint64_t size)
+{
+	if (size == 0)
+		return false;
+
+	uint64_t end = offset + size;
+	size_t last_block = (end - 1) / block_size;
+	for (std::vector<size_t>::const_iterator itr = std::lower_bound(diff_blocks.begin(), diff_blocks.end(), offset / block_size); itr != diff_blocks.end() && *itr <= last_block; itr++)
+	{
+		uint64_t block_start = _MAX((uint64_t)*itr * block_size, offset);
+		uint64_t block_end = _MIN((uint64_t)(*itr + 1) * block_size, end);
+
+		// a block fully inside the range differs, so the range does
+		if (block_start == (uint64_t)*itr * block_size && block_end == (uint64_t)(*itr + 1) * block_size)
+			return true;
+
+		if (isDataChanged(old_file, block_start, new_file, block_start, block_end - block_start))
+			return true;
+	}
+
+	return false;
+}
+
+bool DiffProcess::isDataChanged(fnd::IFile* old_file, uint64_t old_offset, fnd::IFile* new_file, uint64_t new_offset, uint64_t size)
+{
+	if (size == 0)
+		return false;
+
+	fnd::Vec<byte_t> old_cache, new_cache;
+	old_cache.alloc((size_t)_MIN(size, (uint64_t)kCacheSize));
+	new_cache.alloc(old_cache.size());
+
+	for (uint64_t pos = 0; pos < size; pos += old_cache.size())
+	{
+		size_t len = (size_t)_MIN(size - pos, (uint64_t)old_cache.size());
+		old_file->read(old_cache.data(), old_offset + pos, len);
+		new_file->read(new_cache.data(), new_offset + pos, len);
+		mDataBytesRead += len * 2;
+		if (memcmp(old_cache.data(), new_cache.data(), len) != 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool DiffProcess::findPartition(NcaProcess& nca, size_t index, crypto::sha::sSha256Hash& fs_header_hash)
+{
+	const fnd::List<nx::NcaHeader::sPartition>& partitions = nca.getNcaHeader().getPartitions();
+	for (size_t i = 0; i < partitions.size(); i++)
+	{
+		if (partitions[i].index == index)
+		{
+			fs_header_hash = partitions[i].hash;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* DiffProcess::getFormatTypeStr(nx::nca::FormatType format_type)
+{
+	const char* str = nullptr;
+
+	switch (format_type)
+	{
+		case (nx::nca::FORMAT_PFS0):
+			str = "PFS0";
+			break;
+		case (nx::nca::FORMAT_ROMFS):
+			str = "RomFS";
+			break;
+		default:
+			str = "Unknown";
+			break;
+	}
+
+	return str;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <fnd/types.h>
+#include <fnd/IFile.h>
+#include "UserSettings.h"
+#include "NcaProcess.h"
+#include "HashTreeMeta.h"
+
+#include "nstool.h"
+
+// Lists the files that differ between two builds of an NCA by comparing hash trees
+// instead of the data: master hashes are compared first, and hash layer blocks are
+// only read (and decrypted) below hashes that differ. The differing data blocks are
+// then mapped to the RomFS/PartitionFS file entries that overlap them.
+class DiffProcess
+{
+public:
+	DiffProcess();
+	~DiffProcess();
+
+	void process();
+
+	void setUserSettings(const UserSettings* user_set);
+	// paths may address NCAs nested in containers, e.g. "game.nsp/<id>.nca"
+	void setInputPaths(const std::string& old_path, const std::string& new_path);
+
+private:
+	const std::string kModuleName = "DiffProcess";
+	static const size_t kCacheSize = 0x100000;
+
+	struct sFileEntry
+	{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	const UserSettings* mUserSettings;
+	std::string mOldPath;
+	std::string mNewPath;
+
+	uint64_t mHashBytesRead;
+	uint64_t mDataBytesRead;
+	size_t mChangedNum;
+	size_t mAddedNum;
+	size_t mRemovedNum;
+
+	void diffPartition(NcaProcess& old_nca, NcaProcess& new_nca, size_t index);
+	// fills diff_blocks with the (sorted) indexes of data blocks whose hashes differ, false if the trees have different geometry
+	bool diffHashTree(fnd::IFile* old_file, const HashTreeMeta& old_meta, fnd::IFile* new_file, const HashTreeMeta& new_meta, std::vector<size_t>& diff_blocks);
+	void importFileList(fnd::IFile* file, nx::nca::FormatType format_type, std::map<std::string, sFileEntry>& file_list);
+	// compares only the parts of the range in differing blocks, as blocks can be shared with neighbouring data
+	bool isRangeChanged(fnd::IFile* old_file, fnd::IFile* new_file, const std::vector<size_t>& diff_blocks, size_t block_size, uint64_t offset, uint64_t size);
+	bool isDataChanged(fnd::IFile* old_file, uint64_t old_offset, fnd::IFile* new_file, uint64_t new_offset, uint64_t size);
+
+	static bool findPartition(NcaProcess& nca, size_t index, crypto::sha::sSha256Hash& fs_header_hash);
+	static const char* getFormatTypeStr(nx::nca::FormatType format_type);
+};
\ No newline at end of file
@@ -0,0 +1,398 @@
+#include "FileExtractor.h"
+#include "MappedOutputFile.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <fnd/SimpleFile.h>
+#include <fnd/AsyncWriteFile.h>
+#include <fnd/io.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+FileExtractor::FileExtractor() :
+	mCliOutputMode(_BIT(OUTPUT_BASIC)),
+	mIncremental(false),
+	mOpen(false)
+{
+}
+
+FileExtractor::~FileExtractor()
+{
+}
+
+void FileExtractor::setCliOutputMode(CliOutputMode type)
+{
+	mCliOutputMode = type;
+}
+
+void FileExtractor::setIncremental(bool incremental)
+{
+	mIncremental = incremental;
+}
+
+void FileExtractor::setStorePath(const std::string& store_path)
+{
+	mStorePath = store_path;
+}
+
+void FileExtractor::open(const std::string& root_path)
+{
+	fnd::io::makeDirectory(root_path);
+
+	std::string root = root_path;
+	while (root.size() > 1 && (root.back() == '/' || root.back() == '\\'))
+		root.pop_back();
+	mManifestPath = root + kManifestExtension;
+
+	if (mStorePath.empty() == false)
+		fnd::io::makeDirectory(mStorePath);
+
+	mManifest.clear();
+	if (mIncremental)
+		loadManifest();
+	mOpen = true;
+}
+
+void FileExtractor::extractFile(fnd::IFile* src, size_t offset, size_t size, const std::string& rel_path, const std::string& out_path, const std::string& source_tag)
+{
+	if (mOpen == false)
+	{
+		throw fnd::Exception(kModuleName, "Extractor not open");
+	}
+
+	if (mIncremental == false)
+	{
+		if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+			printf("extract=[%s]\n", out_path.c_str());
+		writeFile(src, offset, size, out_path, std::string());
+		return;
+	}
+
+	std::map<std::string, sManifestEntry>::iterator prev = mManifest.find(rel_path);
+	std::string src_digest;
+	bool out_same_size = fnd::io::fileExists(out_path) && fnd::io::getFileSize(out_path) == size;
+	if (out_same_size)
+	{
+		uint64_t out_mtime = fnd::io::getFileModifiedTime(out_path);
+		bool prev_valid = prev != mManifest.end() && prev->second.size == size && prev->second.mtime == out_mtime;
+
+		// unchanged source identity, nothing needs to be read
+		bool unchanged = prev_valid && source_tag.empty() == false && prev->second.tag == source_tag;
+
+		// otherwise compare the source bytes with what was written last time
+		if (unchanged == false)
+		{
+			src_digest = hashSource(src, offset, size);
+			std::string out_digest = prev_valid && prev->second.digest.empty() == false ? prev->second.digest : hashFile(out_path);
+			unchanged = src_digest == out_digest;
+			if (unchanged)
+				mManifest[rel_path] = { size, out_mtime, src_digest, source_tag };
+		}
+
+		if (unchanged)
+		{
+			if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+				printf("unchanged=[%s]\n", out_path.c_str());
+			return;
+		}
+	}
+
+	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+		printf("extract=[%s]\n", out_path.c_str());
+	std::string digest = writeFile(src, offset, size, out_path, src_digest);
+	mManifest[rel_path] = { size, fnd::io::getFileModifiedTime(out_path), digest, source_tag };
+}
+
+void FileExtractor::close()
+{
+	if (mOpen && mIncremental)
+		saveManifest();
+	mOpen = false;
+}
+
+void FileExtractor::loadManifest()
+{
+	std::ifstream file(mManifestPath);
+	if (file.is_open() == false)
+		return;
+
+	std::string line;
+	if (!std::getline(file, line) || line != kManifestSignature)
+	{
+		printf("[WARNING] Manifest %s: ignored (unrecognised format)\n", mManifestPath.c_str());
+		return;
+	}
+
+	// <size> <mtime> <sha256 hex or -> <source tag or -> <path>
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		sManifestEntry entry;
+		std::string path;
+		if (!(fields >> entry.size >> entry.mtime >> entry.digest >> entry.tag))
+			continue;
+		if (entry.digest == "-")
+			entry.digest.clear();
+		if (entry.tag == "-")
+			entry.tag.clear();
+		fields.get();
+		std::getline(fields, path);
+		if (path.empty() == false)
+			mManifest[path] = entry;
+	}
+}
+
+void FileExtractor::saveManifest()
+{
+	std::string root_path = mManifestPath.substr(0, mManifestPath.size() - kManifestExtension.size());
+
+	std::ostringstream out;
+	out << kManifestSignature << "\n";
+	for (std::map<std::string, sManifestEntry>::const_iterator itr = mManifest.begin(); itr != mManifest.end(); itr++)
+	{
+		// entries of files that were deleted since are dropped
+		std::string out_path = root_path;
+		fnd::io::appendToPath(out_path, itr->first);
+		if (fnd::io::fileExists(out_path) == false)
+			continue;
+
+		out << itr->second.size << " " << itr->second.mtime << " " << (itr->second.digest.empty() ? "-" : itr->second.digest) << " " << (itr->second.tag.empty() ? "-" : itr->second.tag) << " " << itr->first << "\n";
+	}
+	std::string data = out.str();
+
+	fnd::io::replaceFile(mManifestPath, (const byte_t*)data.data(), data.size());
+}
+
+std::string FileExtractor::getHashStr(const crypto::sha::sSha256Hash& hash)
+{
+	static const char kHexChars[] = "0123456789abcdef";
+	std::string str;
+	for (size_t i = 0; i < sizeof(hash.bytes); i++)
+	{
+		str += kHexChars[hash.bytes[i] >> 4];
+		str += kHexChars[hash.bytes[i] & 0xf];
+	}
+	return str;
+}
+
+std::string FileExtractor::hashSource(fnd::IFile* src, size_t offset, size_t size)
+{
+	// allocate only when a file is read
+	if (mCache.size() == 0)
+		mCache.alloc(kBlockSize);
+
+	crypto::sha::Sha256Calculator calc;
+	calc.initialise();
+	for (size_t pos = 0; pos < size; pos += mCache.size())
+	{
+		size_t len = _MIN(size - pos, mCache.size());
+		src->read(mCache.data(), offset + pos, len);
+		calc.update(mCache.data(), len);
+	}
+
+	crypto::sha::sSha256Hash hash;
+	calc.finalise(hash.bytes);
+	return getHashStr(hash);
+}
+
+std::string FileExtractor::hashFile(const std::string& path)
+{
+	fnd::SimpleFile file(path, fnd::SimpleFile::Read);
+	return hashSource(&file, 0, file.size());
+}
+
+std::string FileExtractor::writeFile(fnd::IFile* src, size_t offset, size_t size, const std::string& out_path, const std::string& known_digest)
+{
+	// the output may be a link to a store object, which must not be written through
+	::remove(out_path.c_str());
+
+	if (mStorePath.empty() == false)
+	{
+		std::string digest = known_digest;
+		if (digest.empty() || fnd::io::fileExists(getStoreObjectPath(digest)) == false)
+			digest = writeStoreObject(src, offset, size);
+		placeStoreObject(digest, out_path);
+		return digest;
+	}
+
+	// data stored as is (not encrypted or hash checked) is copied by the kernel, the manifest
+	// then records no digest and the output is hashed if it is ever compared
+	size_t plain_offset = offset;
+	fnd::SimpleFile* plain_file = src->getPlainFile(plain_offset);
+
+	// anything else is decrypted and verified straight into a mapping of large outputs
+	if (plain_file == nullptr && size >= kMinMappedFileSize && MappedOutputFile::isSupported())
+		return writeMappedFile(src, offset, size, out_path, known_digest);
+
+	if (plain_file != nullptr)
+	{
+		fnd::SimpleFile out_file(out_path, fnd::SimpleFile::Create);
+		if (out_file.copyFrom(*plain_file, plain_offset, size) == size)
+			return known_digest;
+	}
+
+	return writeCachedFile(src, offset, size, out_path, known_digest);
+}
+
+std::string FileExtractor::writeCachedFile(fnd::IFile* src, size_t offset, size_t size, const std::string& out_path, const std::string& known_digest)
+{
+	// the file is (re)written through the cache, with a background writer so
+	// reading and decrypting carry on while the output volume is busy
+	if (mCache.size() == 0)
+		mCache.alloc(kBlockSize);
+
+	crypto::sha::Sha256Calculator calc;
+	calc.initialise();
+
+	fnd::AsyncWriteFile out_file(out_path, _MIN(size, fnd::AsyncWriteFile::kDefaultBufferSize));
+	for (size_t pos = 0; pos < size; pos += mCache.size())
+	{
+		size_t len = _MIN(size - pos, mCache.size());
+		src->read(mCache.data(), offset + pos, len);
+		out_file.write(mCache.data(), len);
+		if (mIncremental)
+			calc.update(mCache.data(), len);
+	}
+	out_file.close();
+
+	if (mIncremental == false)
+		return known_digest;
+
+	crypto::sha::sSha256Hash hash;
+	calc.finalise(hash.bytes);
+	return getHashStr(hash);
+}
+
+std::string FileExtractor::writeMappedFile(fnd::IFile* src, size_t offset, size_t size, const std::string& out_path, const std::string& known_digest)
+{
+	crypto::sha::Sha256Calculator calc;
+	calc.initialise();
+
+	// without the space allocated up front the file is written through the cache instead
+	MappedOutputFile out_file;
+	if (out_file.open(out_path, size) == false)
+		return writeCachedFile(src, offset, size, out_path, known_digest);
+	for (size_t pos = 0; pos < size; )
+	{
+		size_t len;
+		byte_t* window = out_file.map(pos, len);
+		src->read(window, offset + pos, len);
+		if (mIncremental)
+			calc.update(window, len);
+		pos += len;
+	}
+	out_file.close();
+
+	if (mIncremental == false)
+		return known_digest;
+
+	crypto::sha::sSha256Hash hash;
+	calc.finalise(hash.bytes);
+	return getHashStr(hash);
+}
+
+std::string FileExtractor::getStoreObjectPath(const std::string& digest) const
+{
+	std::string path = mStorePath;
+	fnd::io::appendToPath(path, digest.substr(0, 2));
+	fnd::io::appendToPath(path, digest);
+	return path;
+}
+
+std::string FileExtractor::writeStoreObject(fnd::IFile* src, size_t offset, size_t size)
+{
+	// the digest is only known once the data is written, so it goes to a uniquely named
+	// temporary file first (other extractors may be writing to the same store)
+	static std::atomic<uint64_t> tmp_index(0);
+#ifdef _WIN32
+	uint64_t pid = _getpid();
+#else
+	uint64_t pid = getpid();
+#endif
+	std::string tmp_path = mStorePath;
+	fnd::io::appendToPath(tmp_path, "tmp-" + std::to_string(pid) + "-" + std::to_string(tmp_index++));
+
+	// allocate only when a file is read
+	if (mCache.size() == 0)
+		mCache.alloc(kBlockSize);
+
+	crypto::sha::Sha256Calculator calc;
+	calc.initialise();
+	try
+	{
+		fnd::AsyncWriteFile tmp_file(tmp_path, _MIN(size, fnd::AsyncWriteFile::kDefaultBufferSize));
+		for (size_t pos = 0; pos < size; pos += mCache.size())
+		{
+			size_t len = _MIN(size - pos, mCache.size());
+			src->read(mCache.data(), offset + pos, len);
+			tmp_file.write(mCache.data(), len);
+			calc.update(mCache.data(), len);
+		}
+		tmp_file.close();
+	}
+	catch (...)
+	{
+		::remove(tmp_path.c_str());
+		throw;
+	}
+
+	crypto::sha::sSha256Hash hash;
+	calc.finalise(hash.bytes);
+	std::string digest = getHashStr(hash);
+	std::string object_path = getStoreObjectPath(digest);
+
+	if (fnd::io::fileExists(object_path))
+	{
+		::remove(tmp_path.c_str());
+		return digest;
+	}
+
+	std::string shard_path = mStorePath;
+	fnd::io::appendToPath(shard_path, digest.substr(0, 2));
+	fnd::io::makeDirectory(shard_path);
+#ifndef _WIN32
+	// objects are shared by every link to them, make accidental edits fail
+	chmod(tmp_path.c_str(), S_IRUSR | S_IRGRP | S_IROTH);
+#endif
+	if (::rename(tmp_path.c_str(), object_path.c_str()) != 0)
+	{
+		::remove(tmp_path.c_str());
+		// lost a race with another extractor storing the same data
+		if (fnd::io::fileExists(object_path) == false)
+			throw fnd::Exception(kModuleName, "Failed to add file to store (" + object_path + ")");
+	}
+	return digest;
+}
+
+void FileExtractor::placeStoreObject(const std::string& digest, const std::string& out_path)
+{
+	std::string object_path = getStoreObjectPath(digest);
+	if (fnd::io::createHardLink(object_path, out_path) || fnd::io::cloneFile(object_path, out_path))
+		return;
+
+	// the output is on another volume, or the file system has no links
+	fnd::SimpleFile object_file(object_path, fnd::SimpleFile::Read);
+	size_t size = object_file.size();
+	{
+		fnd::SimpleFile out_file(out_path, fnd::SimpleFile::Create);
+		if (out_file.copyFrom(object_file, 0, size) == size)
+			return;
+	}
+
+	if (mCache.size() == 0)
+		mCache.alloc(kBlockSize);
+
+	fnd::AsyncWriteFile out_file(out_path, _MIN(size, fnd::AsyncWriteFile::kDefaultBufferSize));
+	for (size_t pos = 0; pos < size; pos += mCache.size())
+	{
+		size_t len = _MIN(size - pos, mCache.size());
+		object_file.read(mCache.data(), pos, len);
+		out_file.write(mCache.data(), len);
+	}
+	out_file.close();
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <map>
+#include <fnd/types.h>
+#include <fnd/IFile.h>
+#include <fnd/Vec.h>
+#include <crypto/sha.h>
+
+#include "nstool.h"
+
+// Writes the files of one extraction root. In incremental mode a sidecar manifest
+// ("<root>.nstool-manifest") records the size, SHA-256, output mtime and a source tag of
+// every file written, so a later extraction into the same directory skips files that
+// are unchanged:
+//  - same output size and source tag (a cheap identity of the source bytes, such as the
+//    hash tree master hash they are protected by) -> skipped without reading anything
+//  - same output size and same SHA-256 of the source bytes -> skipped without writing
+// Output files edited since the manifest was written are hashed instead of trusted.
+// With a store path set, file data is written once into a content-addressed store
+// ("<store>/<first 2 hex digits>/<sha256>") and the output tree is made of hard links
+// (or reflinks, or copies when neither works) to the store objects.
+class FileExtractor
+{
+public:
+	FileExtractor();
+	~FileExtractor();
+
+	void setCliOutputMode(CliOutputMode type);
+	void setIncremental(bool incremental);
+	void setStorePath(const std::string& store_path);
+
+	void open(const std::string& root_path);
+	// rel_path is the path within the root ('/' separated), out_path the path on disk
+	void extractFile(fnd::IFile* src, size_t offset, size_t size, const std::string& rel_path, const std::string& out_path, const std::string& source_tag);
+	// saves the manifest (incremental mode only)
+	void close();
+
+	static std::string getHashStr(const crypto::sha::sSha256Hash& hash);
+
+private:
+	const std::string kModuleName = "FileExtractor";
+	const std::string kManifestExtension = ".nstool-manifest";
+	const std::string kManifestSignature = "NSTOOL-MANIFEST 1";
+	static const size_t kBlockSize = 0x100000;
+	// smaller files are written through the cache, a mapping isn't worth setting up for them
+	static const size_t kMinMappedFileSize = 0x100000;
+
+	struct sManifestEntry
+	{
+		uint64_t size;
+		uint64_t mtime;
+		std::string digest;
+		std::string tag;
+	};
+
+	CliOutputMode mCliOutputMode;
+	bool mIncremental;
+	bool mOpen;
+	std::string mManifestPath;
+	std::map<std::string, sManifestEntry> mManifest;
+	std::string mStorePath;
+	fnd::Vec<byte_t> mCache;
+
+	void loadManifest();
+	void saveManifest();
+	std::string hashSource(fnd::IFile* src, size_t offset, size_t size);
+	std::string hashFile(const std::string& path);
+	std::string writeFile(fnd::IFile* src, size_t offset, size_t size, const std::string& out_path, const std::string& known_digest);
+	std::string writeCachedFile(fnd::IFile* src, size_t offset, size_t size, const std::string& out_path, const std::string& known_digest);
+	std::string writeMappedFile(fnd::IFile* src, size_t offset, size_t size, const std::string& out_path, const std::string& known_digest);
+	std::string getStoreObjectPath(const std::string& digest) const;
+	std::string writeStoreObject(fnd::IFile* src, size_t offset, size_t size);
+	void placeStoreObject(const std::string& digest, const std::string& out_path);
+};
\ No newline at end of file
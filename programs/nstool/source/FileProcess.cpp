@@ -0,0 +1,351 @@
+#include "FileProcess.h"
+#include "XciProcess.h"
+#include "PfsProcess.h"
+#include "RomfsProcess.h"
+#include "NcaProcess.h"
+#include "NpdmProcess.h"
+#include "CnmtProcess.h"
+#include "NsoProcess.h"
+#include "NroProcess.h"
+#include "NacpProcess.h"
+#include "AssetProcess.h"
+#include "CatalogueProcess.h"
+#include "BlockIndexProcess.h"
+#include "AccessTraceProcess.h"
+
+FileProcess::FileProcess() :
+	mFile(nullptr),
+	mOwnIFile(false),
+	mFileType(FILE_INVALID),
+	mUserSettings(nullptr),
+	mVerifyCache(nullptr),
+	mVerifyPassed(true)
+{
+}
+
+FileProcess::~FileProcess()
+{
+	if (mOwnIFile)
+	{
+		delete mFile;
+	}
+}
+
+void FileProcess::process()
+{
+	if (mFile == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No file reader set.");
+	}
+
+	if (mUserSettings == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No user settings set.");
+	}
+
+	bool verify = mVerify.isSet ? mVerify.var : mUserSettings->isVerifyFile();
+	mVerifyPassed = true;
+
+	// cached verify results are only valid for the file they were recorded for
+	VerifyCache* verify_cache = nullptr;
+	VerifyCache::sFileIdentity identity;
+	if (mVerifyCache != nullptr && verify && mInputPath.empty() == false)
+	{
+		verify_cache = mVerifyCache;
+		VerifyCache::getFileIdentity(mInputPath, identity);
+	}
+
+	if (mFileType == FILE_XCI)
+	{	
+		XciProcess xci;
+
+		xci.setInputFile(mFile, SHARED_IFILE);
+		
+		xci.setKeyset(&mUserSettings->getKeyset());
+		xci.setCliOutputMode(mUserSettings->getCliOutputMode());
+		xci.setVerifyMode(verify);
+		xci.setVerifyHashMode(mUserSettings->isVerifyHash());
+		if (verify_cache != nullptr)
+			xci.setVerifyCache(verify_cache, identity);
+
+		if (mUserSettings->getXciUpdatePath().isSet)
+			xci.setPartitionForExtract(nx::xci::kUpdatePartitionStr, mUserSettings->getXciUpdatePath().var);
+		if (mUserSettings->getXciLogoPath().isSet)
+			xci.setPartitionForExtract(nx::xci::kLogoPartitionStr, mUserSettings->getXciLogoPath().var);
+		if (mUserSettings->getXciNormalPath().isSet)
+			xci.setPartitionForExtract(nx::xci::kNormalPartitionStr, mUserSettings->getXciNormalPath().var);
+		if (mUserSettings->getXciSecurePath().isSet)
+			xci.setPartitionForExtract(nx::xci::kSecurePartitionStr, mUserSettings->getXciSecurePath().var);
+		xci.setExtractFilter(mUserSettings->getExtractFilter());
+		xci.setIncrementalExtract(mUserSettings->isIncrementalExtract());
+		if (mUserSettings->getExtractStorePath().isSet)
+			xci.setExtractStorePath(mUserSettings->getExtractStorePath().var);
+		xci.setListFs(mUserSettings->isListFs());
+		xci.setNcaProcessMode(mUserSettings->isProcessNca());
+		if (mUserSettings->getNcaDirPath().isSet)
+			xci.setNcaExtractPath(mUserSettings->getNcaDirPath().var);
+		xci.setJobNum(mUserSettings->getJobNum());
+
+		xci.process();
+		mVerifyPassed = xci.isVerifyPassed();
+	}
+	else if (mFileType == FILE_PARTITIONFS || mFileType == FILE_NSP)
+	{
+		PfsProcess pfs;
+
+		pfs.setInputFile(mFile, SHARED_IFILE);
+		pfs.setKeyset(&mUserSettings->getKeyset());
+		pfs.setCliOutputMode(mUserSettings->getCliOutputMode());
+		pfs.setVerifyMode(verify);
+		pfs.setVerifyHashMode(mUserSettings->isVerifyHash());
+		if (verify_cache != nullptr)
+			pfs.setVerifyCache(verify_cache, identity);
+
+		if (mUserSettings->getFsPath().isSet)
+			pfs.setExtractPath(mUserSettings->getFsPath().var);
+		pfs.setExtractFilter(mUserSettings->getExtractFilter());
+		pfs.setIncrementalExtract(mUserSettings->isIncrementalExtract());
+		if (mUserSettings->getExtractStorePath().isSet)
+			pfs.setExtractStorePath(mUserSettings->getExtractStorePath().var);
+		pfs.setListFs(mUserSettings->isListFs());
+		pfs.setNcaProcessMode(mUserSettings->isProcessNca());
+		if (mUserSettings->getNcaDirPath().isSet)
+			pfs.setNcaExtractPath(mUserSettings->getNcaDirPath().var);
+		pfs.setJobNum(mUserSettings->getJobNum());
+		
+		pfs.process();
+		mVerifyPassed = pfs.isVerifyPassed();
+	}
+	else if (mFileType == FILE_ROMFS)
+	{
+		RomfsProcess romfs;
+
+		romfs.setInputFile(mFile, SHARED_IFILE);
+		romfs.setCliOutputMode(mUserSettings->getCliOutputMode());
+		romfs.setVerifyMode(verify);
+
+		if (mUserSettings->getFsPath().isSet)
+			romfs.setExtractPath(mUserSettings->getFsPath().var);
+		romfs.setExtractFilter(mUserSettings->getExtractFilter());
+		romfs.setIncrementalExtract(mUserSettings->isIncrementalExtract());
+		if (mUserSettings->getExtractStorePath().isSet)
+			romfs.setExtractStorePath(mUserSettings->getExtractStorePath().var);
+		romfs.setListFs(mUserSettings->isListFs());
+
+		romfs.process();
+	}
+	else if (mFileType == FILE_NCA)
+	{
+		NcaProcess nca;
+
+		nca.setInputFile(mFile, SHARED_IFILE);
+		nca.setKeyset(&mUserSettings->getKeyset());
+		nca.setCliOutputMode(mUserSettings->getCliOutputMode());
+		nca.setVerifyMode(verify);
+		nca.setVerifyHashMode(mUserSettings->isVerifyHash());
+		if (verify_cache != nullptr)
+			nca.setVerifyCache(verify_cache, identity);
+
+
+		if (mUserSettings->getNcaPart0Path().isSet)
+			nca.setPartition0ExtractPath(mUserSettings->getNcaPart0Path().var);
+		if (mUserSettings->getNcaPart1Path().isSet)
+			nca.setPartition1ExtractPath(mUserSettings->getNcaPart1Path().var);
+		if (mUserSettings->getNcaPart2Path().isSet)
+			nca.setPartition2ExtractPath(mUserSettings->getNcaPart2Path().var);
+		if (mUserSettings->getNcaPart3Path().isSet)
+			nca.setPartition3ExtractPath(mUserSettings->getNcaPart3Path().var);
+		nca.setExtractFilter(mUserSettings->getExtractFilter());
+		nca.setIncrementalExtract(mUserSettings->isIncrementalExtract());
+		if (mUserSettings->getExtractStorePath().isSet)
+			nca.setExtractStorePath(mUserSettings->getExtractStorePath().var);
+		nca.setListFs(mUserSettings->isListFs());
+
+		nca.process();
+		mVerifyPassed = nca.isVerifyPassed();
+	}
+	else if (mFileType == FILE_NPDM)
+	{
+		NpdmProcess npdm;
+
+		npdm.setInputFile(mFile, SHARED_IFILE);
+		npdm.setKeyset(&mUserSettings->getKeyset());
+		npdm.setCliOutputMode(mUserSettings->getCliOutputMode());
+		npdm.setVerifyMode(verify);
+
+		npdm.process();
+		mVerifyPassed = npdm.isVerifyPassed();
+	}
+	else if (mFileType == FILE_CNMT)
+	{
+		CnmtProcess cnmt;
+
+		cnmt.setInputFile(mFile, SHARED_IFILE);
+		cnmt.setCliOutputMode(mUserSettings->getCliOutputMode());
+		cnmt.setVerifyMode(verify);
+
+		cnmt.process();
+	}
+	else if (mFileType == FILE_NSO)
+	{
+		NsoProcess obj;
+
+		obj.setInputFile(mFile, SHARED_IFILE);
+		obj.setCliOutputMode(mUserSettings->getCliOutputMode());
+		obj.setVerifyMode(verify);
+		
+		obj.setInstructionType(mUserSettings->getInstType());
+		obj.setListApi(mUserSettings->isListApi());
+		obj.setListSymbols(mUserSettings->isListSymbols());
+
+		obj.process();
+	}
+	else if (mFileType == FILE_NRO)
+	{
+		NroProcess obj;
+
+		obj.setInputFile(mFile, SHARED_IFILE);
+		obj.setCliOutputMode(mUserSettings->getCliOutputMode());
+		obj.setVerifyMode(verify);
+		
+		obj.setInstructionType(mUserSettings->getInstType());
+		obj.setListApi(mUserSettings->isListApi());
+		obj.setListSymbols(mUserSettings->isListSymbols());
+
+		if (mUserSettings->getAssetIconPath().isSet)
+			obj.setAssetIconExtractPath(mUserSettings->getAssetIconPath().var);
+		if (mUserSettings->getAssetNacpPath().isSet)
+			obj.setAssetNacpExtractPath(mUserSettings->getAssetNacpPath().var);
+
+		if (mUserSettings->getFsPath().isSet)
+			obj.setAssetRomfsExtractPath(mUserSettings->getFsPath().var);
+		obj.setAssetRomfsExtractFilter(mUserSettings->getExtractFilter());
+		obj.setAssetRomfsIncrementalExtract(mUserSettings->isIncrementalExtract());
+		if (mUserSettings->getExtractStorePath().isSet)
+			obj.setAssetRomfsExtractStorePath(mUserSettings->getExtractStorePath().var);
+		obj.setAssetListFs(mUserSettings->isListFs());
+
+		obj.process();
+	}
+	else if (mFileType == FILE_NACP)
+	{
+		NacpProcess nacp;
+
+		nacp.setInputFile(mFile, SHARED_IFILE);
+		nacp.setCliOutputMode(mUserSettings->getCliOutputMode());
+		nacp.setVerifyMode(verify);
+
+		nacp.process();
+	}
+	else if (mFileType == FILE_HB_ASSET)
+	{
+		AssetProcess obj;
+
+		obj.setInputFile(mFile, SHARED_IFILE);
+		obj.setCliOutputMode(mUserSettings->getCliOutputMode());
+		obj.setVerifyMode(verify);
+
+		if (mUserSettings->getAssetIconPath().isSet)
+			obj.setIconExtractPath(mUserSettings->getAssetIconPath().var);
+		if (mUserSettings->getAssetNacpPath().isSet)
+			obj.setNacpExtractPath(mUserSettings->getAssetNacpPath().var);
+
+		if (mUserSettings->getFsPath().isSet)
+			obj.setRomfsExtractPath(mUserSettings->getFsPath().var);
+		obj.setRomfsExtractFilter(mUserSettings->getExtractFilter());
+		obj.setRomfsIncrementalExtract(mUserSettings->isIncrementalExtract());
+		if (mUserSettings->getExtractStorePath().isSet)
+			obj.setRomfsExtractStorePath(mUserSettings->getExtractStorePath().var);
+		obj.setListFs(mUserSettings->isListFs());
+
+		obj.process();
+	}
+	else if (mFileType == FILE_CATALOGUE)
+	{
+		// the index is mapped from its path rather than read through the file reader
+		if (mInputPath.empty())
+		{
+			throw fnd::Exception(kModuleName, "No input path set.");
+		}
+
+		CatalogueProcess obj;
+
+		obj.setInputPath(mInputPath);
+		obj.setCliOutputMode(mUserSettings->getCliOutputMode());
+
+		if (mUserSettings->getQueryTitleId().isSet)
+			obj.setTitleIdFilter(mUserSettings->getQueryTitleId().var);
+		if (mUserSettings->getQueryTitleVersion().isSet)
+			obj.setTitleVersionFilter(mUserSettings->getQueryTitleVersion().var);
+
+		obj.process();
+	}
+	else if (mFileType == FILE_BLOCKINDEX)
+	{
+		if (mInputPath.empty())
+		{
+			throw fnd::Exception(kModuleName, "No input path set.");
+		}
+
+		BlockIndexProcess obj;
+
+		obj.setInputPath(mInputPath);
+		obj.setCliOutputMode(mUserSettings->getCliOutputMode());
+
+		obj.process();
+	}
+	else if (mFileType == FILE_ACCESSTRACE)
+	{
+		if (mInputPath.empty())
+		{
+			throw fnd::Exception(kModuleName, "No input path set.");
+		}
+
+		AccessTraceProcess obj;
+
+		obj.setInputPath(mInputPath);
+		obj.setCliOutputMode(mUserSettings->getCliOutputMode());
+
+		obj.process();
+	}
+	else
+	{
+		throw fnd::Exception(kModuleName, "Unknown file type.");
+	}
+}
+
+void FileProcess::setInputFile(fnd::IFile* file, bool ownIFile)
+{
+	mFile = file;
+	mOwnIFile = ownIFile;
+}
+
+void FileProcess::setInputPath(const std::string& path)
+{
+	mInputPath = path;
+}
+
+void FileProcess::setFileType(FileType type)
+{
+	mFileType = type;
+}
+
+void FileProcess::setUserSettings(const UserSettings* user_set)
+{
+	mUserSettings = user_set;
+}
+
+void FileProcess::setVerifyCache(VerifyCache* cache)
+{
+	mVerifyCache = cache;
+}
+
+void FileProcess::setVerifyMode(bool verify)
+{
+	mVerify = verify;
+}
+
+bool FileProcess::isVerifyPassed() const
+{
+	return mVerifyPassed;
+}
\ No newline at end of file
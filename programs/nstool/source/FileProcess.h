@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include <fnd/IFile.h>
+#include "UserSettings.h"
+#include "VerifyCache.h"
+
+#include "nstool.h"
+
+// Hands an input file to the process matching its file type, configured from UserSettings
+class FileProcess
+{
+public:
+	FileProcess();
+	~FileProcess();
+
+	void process();
+
+	void setInputFile(fnd::IFile* file, bool ownIFile);
+	void setInputPath(const std::string& path);
+	void setFileType(FileType type);
+	void setUserSettings(const UserSettings* user_set);
+	void setVerifyCache(VerifyCache* cache);
+	// overrides the verify mode from UserSettings
+	void setVerifyMode(bool verify);
+
+	// post process() accessors
+	// false if verify mode found a failure in a type that is verified (XCI, PFS/NSP, NCA, NPDM)
+	bool isVerifyPassed() const;
+
+private:
+	const std::string kModuleName = "FileProcess";
+
+	fnd::IFile* mFile;
+	bool mOwnIFile;
+	std::string mInputPath;
+	FileType mFileType;
+	const UserSettings* mUserSettings;
+	VerifyCache* mVerifyCache;
+	sOptional<bool> mVerify;
+	bool mVerifyPassed;
+};
@@ -0,0 +1,277 @@
+#include "HashTreeBuilder.h"
+#include <nx/HierarchicalIntegrityHeader.h>
+#include <nx/HierarchicalSha256Header.h>
+#include <fnd/BitMath.h>
+#include "ThreadPool.h"
+
+HashTreeBuilder::HashTreeBuilder() :
+	mFile(nullptr),
+	mOwnIFile(false),
+	mOutFile(nullptr),
+	mOwnOutFile(false),
+	mType(HashTreeMeta::HASH_TYPE_SHA256),
+	mBlockSize(0),
+	mThreadNum(0),
+	mDataOffset(0),
+	mDataSize(0)
+{
+}
+
+HashTreeBuilder::~HashTreeBuilder()
+{
+	if (mOwnIFile)
+	{
+		delete mFile;
+	}
+	if (mOwnOutFile)
+	{
+		delete mOutFile;
+	}
+}
+
+void HashTreeBuilder::process()
+{
+	if (mFile == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No file reader set.");
+	}
+	if (mOutFile == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No output file set.");
+	}
+
+	if (mBlockSize == 0)
+		mBlockSize = mType == HashTreeMeta::HASH_TYPE_INTEGRITY ? kDefaultIntegrityBlockSize : kDefaultSha256BlockSize;
+	if (mBlockSize < crypto::sha::kSha256HashLen || (mBlockSize & (mBlockSize - 1)) != 0)
+	{
+		throw fnd::Exception(kModuleName, "Hash block size must be a power of 2 of at least 0x20 bytes.");
+	}
+
+	mDataSize = mFile->size();
+	if (mDataSize == 0)
+	{
+		throw fnd::Exception(kModuleName, "Data layer is empty.");
+	}
+
+	layoutLayers();
+	hashDataLayer();
+
+	// each layer up hashes the one below it, once it is complete
+	for (size_t i = mLayers.size() - 1; i > 0; i--)
+	{
+		hashLayer(mLayers[i].hashes.data(), mLayers[i].size, mLayers[i - 1].hashes.data());
+	}
+
+	// the master hashes cover the top layer, a HierarchicalSha256 table is hashed whole
+	mMasterHashList.clear();
+	if (mType == HashTreeMeta::HASH_TYPE_INTEGRITY)
+	{
+		fnd::Vec<byte_t> hashes;
+		hashes.alloc(getBlockNum(mLayers[0].size) * sizeof(crypto::sha::sSha256Hash));
+		hashLayer(mLayers[0].hashes.data(), mLayers[0].size, hashes.data());
+		for (size_t i = 0; i < hashes.size() / sizeof(crypto::sha::sSha256Hash); i++)
+			mMasterHashList.addElement(((const crypto::sha::sSha256Hash*)hashes.data())[i]);
+	}
+	else
+	{
+		crypto::sha::sSha256Hash hash;
+		crypto::sha::Sha256(mLayers[0].hashes.data(), mLayers[0].size, hash.bytes);
+		mMasterHashList.addElement(hash);
+	}
+
+	writeHashLayers();
+	makeHeader();
+}
+
+void HashTreeBuilder::setInputFile(fnd::IFile* file, bool ownIFile)
+{
+	mFile = file;
+	mOwnIFile = ownIFile;
+}
+
+void HashTreeBuilder::setOutputFile(fnd::IFile* file, bool ownIFile)
+{
+	mOutFile = file;
+	mOwnOutFile = ownIFile;
+}
+
+void HashTreeBuilder::setHashTreeType(HashTreeMeta::HashTreeType type)
+{
+	mType = type;
+}
+
+void HashTreeBuilder::setBlockSize(size_t block_size)
+{
+	mBlockSize = block_size;
+}
+
+void HashTreeBuilder::setThreadNum(size_t thread_num)
+{
+	mThreadNum = thread_num;
+}
+
+const HashTreeMeta& HashTreeBuilder::getHashTreeMeta() const
+{
+	return mMeta;
+}
+
+const fnd::Vec<byte_t>& HashTreeBuilder::getHashTreeHeader() const
+{
+	return mHeader;
+}
+
+uint64_t HashTreeBuilder::getOutputSize() const
+{
+	return mDataOffset + mDataSize;
+}
+
+void HashTreeBuilder::layoutLayers()
+{
+	// a HierarchicalSha256 tree has one hash layer, an integrity tree always has 5
+	size_t layer_num = mType == HashTreeMeta::HASH_TYPE_INTEGRITY ? nx::hierarchicalintegrity::kDefaultLayerNum - 1 : nx::hierarchicalsha256::kDefaultLayerNum - 1;
+
+	// sizes, from the data up
+	mLayers.clear();
+	mLayers.resize(layer_num);
+	uint64_t size = mDataSize;
+	for (size_t i = layer_num; i > 0; i--)
+	{
+		size = getBlockNum(size) * sizeof(crypto::sha::sSha256Hash);
+		mLayers[i - 1].size = size;
+	}
+
+	// offsets, from the top down. integrity tree layers start on a block, and are hashed
+	// in whole blocks, so each is padded to a block with zeros
+	uint64_t offset = 0;
+	for (size_t i = 0; i < layer_num; i++)
+	{
+		uint64_t padded_size = mType == HashTreeMeta::HASH_TYPE_INTEGRITY ? align(mLayers[i].size, mBlockSize) : align(mLayers[i].size, kSha256DataAlign);
+		mLayers[i].offset = offset;
+		mLayers[i].hashes.alloc(padded_size);
+		memset(mLayers[i].hashes.data(), 0, mLayers[i].hashes.size());
+		offset += padded_size;
+	}
+	mDataOffset = offset;
+}
+
+void HashTreeBuilder::hashDataLayer()
+{
+	ThreadPool pool(mThreadNum != 0 ? mThreadNum : ThreadPool::getDefaultThreadNum());
+
+	// a batch is hashed by every thread at once, while the next is read into the other buffer
+	size_t task_size = align(kTaskSize, mBlockSize);
+	size_t batch_size = task_size * pool.getThreadNum();
+	fnd::Vec<byte_t> buffer[2];
+	buffer[0].alloc(batch_size);
+	buffer[1].alloc(batch_size);
+
+	byte_t* leaf = mLayers.back().hashes.data();
+	mFile->setAccessHint(fnd::IFile::ACCESS_SEQUENTIAL);
+	size_t cur = 0;
+	for (uint64_t pos = 0; pos < mDataSize; pos += batch_size, cur ^= 1)
+	{
+		size_t len = (size_t)_MIN(mDataSize - pos, (uint64_t)batch_size);
+		byte_t* data = buffer[cur].data();
+		mFile->read(data, pos, len);
+
+		// the buffer is hashed in whole blocks, an integrity tree hashes the last one padded with zeros
+		size_t hashed_len = len;
+		if (mType == HashTreeMeta::HASH_TYPE_INTEGRITY)
+		{
+			hashed_len = align(len, mBlockSize);
+			memset(data + len, 0, hashed_len - len);
+		}
+
+		// the other buffer is read into next, its hashing must be done
+		pool.wait();
+		for (size_t task_pos = 0; task_pos < hashed_len; task_pos += task_size)
+		{
+			size_t task_len = _MIN(hashed_len - task_pos, task_size);
+			byte_t* hashes = leaf + ((pos + task_pos) / mBlockSize) * sizeof(crypto::sha::sSha256Hash);
+			pool.enqueue([this, data, task_pos, task_len, hashes] {
+				hashBlocks(data + task_pos, task_len, hashes);
+			});
+		}
+
+		mOutFile->write(data, mDataOffset + pos, len);
+	}
+	pool.wait();
+}
+
+void HashTreeBuilder::hashLayer(const byte_t* data, uint64_t size, byte_t* hashes)
+{
+	// layers shrink by the block size over the hash size at each level, only the lowest are worth splitting
+	size_t hashed_len = mType == HashTreeMeta::HASH_TYPE_INTEGRITY ? align(size, mBlockSize) : size;
+	size_t task_size = align(kTaskSize, mBlockSize);
+	if (hashed_len <= task_size)
+	{
+		hashBlocks(data, hashed_len, hashes);
+		return;
+	}
+
+	ThreadPool pool(mThreadNum != 0 ? mThreadNum : ThreadPool::getDefaultThreadNum());
+	for (size_t pos = 0; pos < hashed_len; pos += task_size)
+	{
+		size_t len = _MIN(hashed_len - pos, task_size);
+		pool.enqueue([this, data, pos, len, hashes] {
+			hashBlocks(data + pos, len, hashes + (pos / mBlockSize) * sizeof(crypto::sha::sSha256Hash));
+		});
+	}
+	pool.wait();
+}
+
+void HashTreeBuilder::hashBlocks(const byte_t* data, uint64_t size, byte_t* hashes)
+{
+	for (uint64_t pos = 0; pos < size; pos += mBlockSize)
+	{
+		crypto::sha::Sha256(data + pos, _MIN(size - pos, (uint64_t)mBlockSize), hashes);
+		hashes += sizeof(crypto::sha::sSha256Hash);
+	}
+}
+
+void HashTreeBuilder::writeHashLayers()
+{
+	// padding included, the output is written without gaps
+	for (size_t i = 0; i < mLayers.size(); i++)
+	{
+		mOutFile->write(mLayers[i].hashes.data(), mLayers[i].offset, mLayers[i].hashes.size());
+	}
+}
+
+void HashTreeBuilder::makeHeader()
+{
+	if (mType == HashTreeMeta::HASH_TYPE_INTEGRITY)
+	{
+		// the data is the last layer, block sizes are held as a power of 2
+		fnd::List<nx::HierarchicalIntegrityHeader::sLayer> layer_info;
+		size_t block_size_log2 = 0;
+		while (_BIT(block_size_log2) < mBlockSize)
+			block_size_log2++;
+		for (size_t i = 0; i < mLayers.size(); i++)
+			layer_info.addElement({ (size_t)mLayers[i].offset, (size_t)mLayers[i].size, block_size_log2 });
+		layer_info.addElement({ (size_t)mDataOffset, (size_t)mDataSize, block_size_log2 });
+
+		nx::HierarchicalIntegrityHeader hdr;
+		hdr.setLayerInfo(layer_info);
+		hdr.setMasterHashList(mMasterHashList);
+		hdr.toBytes();
+		mHeader = hdr.getBytes();
+	}
+	else
+	{
+		fnd::List<nx::HierarchicalSha256Header::sLayer> layer_info;
+		layer_info.addElement({ (size_t)mLayers[0].offset, (size_t)mLayers[0].size });
+		layer_info.addElement({ (size_t)mDataOffset, (size_t)mDataSize });
+
+		nx::HierarchicalSha256Header hdr;
+		hdr.setMasterHash(mMasterHashList[0]);
+		hdr.setHashBlockSize(mBlockSize);
+		hdr.setLayerInfo(layer_info);
+		hdr.toBytes();
+		mHeader = hdr.getBytes();
+	}
+
+	// read back as the hash tree readers see it
+	mMeta = HashTreeMeta();
+	mMeta.importData(mHeader.data(), mHeader.size(), mType);
+}
\ No newline at end of file
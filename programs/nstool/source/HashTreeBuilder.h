@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fnd/types.h>
+#include <fnd/IFile.h>
+#include <fnd/Vec.h>
+#include <crypto/sha.h>
+#include "HashTreeMeta.h"
+
+// Builds the hash tree of a data layer (every hash layer and the master hashes) and writes it,
+// followed by the data, to an output as an NCA partition holds them. The data is read once in
+// large batches: each batch is written out while its blocks are hashed across a thread pool, and
+// the next batch is read meanwhile. Each upper layer is hashed once the layer below is complete.
+class HashTreeBuilder
+{
+public:
+	HashTreeBuilder();
+	~HashTreeBuilder();
+
+	void process();
+
+	void setInputFile(fnd::IFile* file, bool ownIFile);
+	// hash layers and data are written from offset 0 of the output
+	void setOutputFile(fnd::IFile* file, bool ownIFile);
+	void setHashTreeType(HashTreeMeta::HashTreeType type);
+	// 0 selects the usual block size of the hash tree type
+	void setBlockSize(size_t block_size);
+	// 0 uses every CPU core
+	void setThreadNum(size_t thread_num);
+
+	const HashTreeMeta& getHashTreeMeta() const;
+	// HierarchicalSha256/HierarchicalIntegrity header, as held in the hash superblock of an NCA fs header
+	const fnd::Vec<byte_t>& getHashTreeHeader() const;
+	// size of the hash layers and data in the output
+	uint64_t getOutputSize() const;
+
+private:
+	const std::string kModuleName = "HashTreeBuilder";
+	static const size_t kDefaultSha256BlockSize = 0x10000;
+	static const size_t kDefaultIntegrityBlockSize = 0x4000;
+	// the data of a HierarchicalSha256 tree follows the hash table at this alignment
+	static const size_t kSha256DataAlign = 0x200;
+	// data hashed by one task
+	static const size_t kTaskSize = 0x100000;
+
+	struct sLayer
+	{
+		uint64_t offset;
+		uint64_t size;
+		// hashes of the next layer down, padded to where the next layer starts
+		fnd::Vec<byte_t> hashes;
+	};
+
+	fnd::IFile* mFile;
+	bool mOwnIFile;
+	fnd::IFile* mOutFile;
+	bool mOwnOutFile;
+	HashTreeMeta::HashTreeType mType;
+	size_t mBlockSize;
+	size_t mThreadNum;
+
+	// hash layers, the top layer first
+	std::vector<sLayer> mLayers;
+	uint64_t mDataOffset;
+	uint64_t mDataSize;
+	fnd::List<crypto::sha::sSha256Hash> mMasterHashList;
+
+	HashTreeMeta mMeta;
+	fnd::Vec<byte_t> mHeader;
+
+	inline uint64_t getBlockNum(uint64_t size) const { return (size / mBlockSize) + ((size % mBlockSize) > 0); }
+
+	void layoutLayers();
+	void hashDataLayer();
+	void hashLayer(const byte_t* data, uint64_t size, byte_t* hashes);
+	void hashBlocks(const byte_t* data, uint64_t size, byte_t* hashes);
+	void writeHashLayers();
+	void makeHeader();
+};
\ No newline at end of file
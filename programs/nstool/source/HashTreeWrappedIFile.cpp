@@ -1,6 +1,7 @@
 #include "nstool.h"
 #include "HashTreeWrappedIFile.h"
 #include "OffsetAdjustedIFile.h"
+#include <vector>
 
 HashTreeWrappedIFile::HashTreeWrappedIFile(fnd::IFile* file, bool ownIFile, const HashTreeMeta& hdr) :
 	mOwnIFile(ownIFile),
@@ -33,45 +34,38 @@ void HashTreeWrappedIFile::seek(size_t offset)
 
 void HashTreeWrappedIFile::read(byte_t* out, size_t len)
 {
-	size_t offset_in_start_block = getOffsetInBlock(mDataOffset);
-	size_t offset_in_end_block = getOffsetInBlock(offset_in_start_block + len);
+	// the last block may be shorter than a block, so it is always read through the cache
+	size_t full_block_num = getBlockNum(mData->size()) > 0 ? getBlockNum(mData->size()) - 1 : 0;
 
-	size_t start_block = getOffsetBlock(mDataOffset);
-	size_t block_num = align(offset_in_start_block + len, mDataBlockSize) / mDataBlockSize;
-
-	size_t partial_last_block_num = block_num % mCacheBlockNum;
-	bool has_partial_block_num = partial_last_block_num > 0;
-	size_t read_iterations = (block_num / mCacheBlockNum) + has_partial_block_num;
-
-	size_t block_read_len;
-	size_t block_export_offset;
-	size_t block_export_size;
-	size_t block_export_pos = 0;
-	for (size_t i = 0; i < read_iterations; i++)
+	size_t export_pos = 0;
+	while (export_pos < len)
 	{
-		// how many blocks to read from source file
-		block_read_len = (i+1 == read_iterations && has_partial_block_num) ? partial_last_block_num : mCacheBlockNum;
+		size_t offset = mDataOffset + export_pos;
+		size_t block = getOffsetBlock(offset);
+		size_t offset_in_block = getOffsetInBlock(offset);
 
-		// offset in this current read to copy from
-		block_export_offset = (i == 0) ? offset_in_start_block : 0;
+		// whole blocks inside the read are read and verified in place in the caller's buffer
+		size_t direct_block_num = 0;
+		if (offset_in_block == 0 && block < full_block_num)
+			direct_block_num = _MIN((len - export_pos) / mDataBlockSize, full_block_num - block);
 
-		// size of current read to copy
-		block_export_size = (block_read_len * mDataBlockSize) - block_export_offset;
-
-		// if last read, reduce the export size by one block less offset_in_end_block
-		if (i+1 == read_iterations)
+		if (direct_block_num > 0)
 		{
-			block_export_size -= (mDataBlockSize - offset_in_end_block);
+			mData->read(out + export_pos, block * mDataBlockSize, direct_block_num * mDataBlockSize);
+			validateData(out + export_pos, block, direct_block_num, direct_block_num * mDataBlockSize);
+			export_pos += direct_block_num * mDataBlockSize;
+			continue;
 		}
 
-		// read the blocks
-		readData(start_block + (i * mCacheBlockNum), block_read_len);
+		// partial blocks go through the cache, one block at a time when that realigns a long read
+		size_t block_num = align(offset_in_block + (len - export_pos), mDataBlockSize) / mDataBlockSize;
+		block_num = (offset_in_block != 0 && block_num > 1) ? 1 : _MIN(block_num, mCacheBlockNum);
 
-		// export the section of data that is relevant
-		memcpy(out + block_export_pos, mCache.data() + block_export_offset, block_export_size);
+		readData(block, block_num);
 
-		// update export position
-		block_export_pos += block_export_size;
+		size_t export_size = _MIN(block_num * mDataBlockSize - offset_in_block, len - export_pos);
+		memcpy(out + export_pos, mCache.data() + offset_in_block, export_size);
+		export_pos += export_size;
 	}
 
 	// update offset
@@ -97,10 +91,23 @@ void HashTreeWrappedIFile::write(const byte_t* out, size_t offset, size_t len)
 void HashTreeWrappedIFile::initialiseDataLayer(const HashTreeMeta& hdr)
 {
 	crypto::sha::sSha256Hash hash;
-	fnd::Vec<byte_t> cur, prev;
+	fnd::Vec<byte_t> prev;
 
 	mAlignHashCalcToBlock = hdr.getAlignHashToBlock();
 
+	// read every hash layer at once, each is verified against the one before it
+	const fnd::List<HashTreeMeta::sLayer>& layer_info = hdr.getHashLayerInfo();
+	std::vector<fnd::Vec<byte_t>> layers(layer_info.size());
+	std::vector<sReadRange> ranges(layer_info.size());
+	for (size_t i = 0; i < layer_info.size(); i++)
+	{
+		layers[i].alloc(align(layer_info[i].size, layer_info[i].block_size));
+		// blocks are hashed whole (for integrity trees), the tail of the last block is zero
+		memset(layers[i].data(), 0, layers[i].size());
+		ranges[i] = { layers[i].data(), layer_info[i].offset, layer_info[i].size };
+	}
+	mFile->readv(ranges.data(), ranges.size());
+
 	// copy master hash into prev
 	prev.alloc(sizeof(crypto::sha::sSha256Hash) * hdr.getMasterHashList().size());
 	for (size_t i = 0; i < hdr.getMasterHashList().size(); i++)
@@ -109,23 +116,21 @@ void HashTreeWrappedIFile::initialiseDataLayer(const HashTreeMeta& hdr)
 	}
 	
 	// check each hash layer
-	for (size_t i = 0; i < hdr.getHashLayerInfo().size(); i++)
+	for (size_t i = 0; i < layer_info.size(); i++)
 	{
 		// get block size
-		const HashTreeMeta::sLayer& layer = hdr.getHashLayerInfo()[i];
+		const HashTreeMeta::sLayer& layer = layer_info[i];
+		const fnd::Vec<byte_t>& cur = layers[i];
 
-		// allocate layer
-		cur.alloc(align(layer.size, layer.block_size));
-
-		// read layer
-		mFile->read(cur.data(), layer.offset, layer.size);
+		// the master hash of a HierarchicalSha256 tree covers the whole hash table, however many blocks it spans
+		size_t block_size = (i == 0 && mAlignHashCalcToBlock == false) ? cur.size() : layer.block_size;
 		
 		// validate blocks
 		size_t validate_size;
-		for (size_t j = 0; j < cur.size() / layer.block_size; j++)
+		for (size_t j = 0; j < cur.size() / block_size; j++)
 		{
-			validate_size = mAlignHashCalcToBlock? layer.block_size : _MIN(layer.size - (j * layer.block_size), layer.block_size);
-			crypto::sha::Sha256(cur.data() + (j * layer.block_size), validate_size, hash.bytes);
+			validate_size = mAlignHashCalcToBlock? block_size : _MIN(layer.size - (j * block_size), block_size);
+			crypto::sha::Sha256(cur.data() + (j * block_size), validate_size, hash.bytes);
 			if (hash.compare(prev.data() + j * sizeof(crypto::sha::sSha256Hash)) == false)
 			{
 				mErrorSs << "Hash tree layer verification failed (layer: " << i << ", block: " << j << ")";
@@ -161,13 +166,13 @@ void HashTreeWrappedIFile::initialiseDataLayer(const HashTreeMeta& hdr)
 void HashTreeWrappedIFile::readData(size_t block_offset, size_t block_num)
 {
 	mData->seek(block_offset * mDataBlockSize);
-	crypto::sha::sSha256Hash hash;
 
 	// determine read size
 	size_t read_len = 0;
 	if ((block_offset + block_num) == getBlockNum(mData->size()))
 	{
-		read_len = (block_num-1) * mDataBlockSize + getRemanderBlockReadSize(mData->size());
+		// up to the end of the data, the last block may be partial (or whole)
+		read_len = mData->size() - block_offset * mDataBlockSize;
 		memset(mCache.data(), 0, block_num * mDataBlockSize);
 	}
 	else if ((block_offset + block_num) < getBlockNum(mData->size()))
@@ -187,18 +192,28 @@ void HashTreeWrappedIFile::readData(size_t block_offset, size_t block_num)
 		throw fnd::Exception(kModuleName, "Read excessive of cache size");
 	}
 
-	//printf("readlen=0x%" PRIx64 "\n", read_len);
+	validateData(mCache.data(), block_offset, block_num, read_len);
+}
+
+void HashTreeWrappedIFile::validateData(const byte_t* data, size_t block_offset, size_t block_num, size_t read_len)
+{
+	crypto::sha::sSha256Hash hash;
 
 	// validate blocks
 	size_t validate_size;
 	for (size_t i = 0; i < block_num; i++)
 	{
 		validate_size = mAlignHashCalcToBlock? mDataBlockSize : _MIN(read_len - (i * mDataBlockSize), mDataBlockSize);
-		crypto::sha::Sha256(mCache.data() + (i * mDataBlockSize), validate_size, hash.bytes);
+		crypto::sha::Sha256(data + (i * mDataBlockSize), validate_size, hash.bytes);
 		if (hash != mDataHashLayer[block_offset + i])
 		{
 			mErrorSs << "Hash tree layer verification failed (layer: data, block: " << (block_offset + i) << " ( " << i << "/" << block_num-1 << " ), offset: 0x" << std::hex << ((block_offset + i) * mDataBlockSize) << ", size: 0x" << std::hex <<  validate_size <<")";
 			throw fnd::Exception(kModuleName, mErrorSs.str());
 		}
 	}
+}
+
+void HashTreeWrappedIFile::setAccessHint(AccessHint hint)
+{
+	mFile->setAccessHint(hint);
 }
\ No newline at end of file
@@ -18,6 +18,7 @@ public:
 	void read(byte_t* out, size_t offset, size_t len);
 	void write(const byte_t* out, size_t len);
 	void write(const byte_t* out, size_t offset, size_t len);
+	void setAccessHint(AccessHint hint);
 private:
 	const std::string kModuleName = "HashTreeWrappedIFile";
 	static const size_t kDefaultCacheSize = 0x10000;
@@ -43,4 +44,5 @@ private:
 
 	void initialiseDataLayer(const HashTreeMeta& hdr);
 	void readData(size_t block_offset, size_t block_num);
+	void validateData(const byte_t* data, size_t block_offset, size_t block_num, size_t read_len);
 };
\ No newline at end of file
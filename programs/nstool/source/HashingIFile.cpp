@@ -0,0 +1,118 @@
+#include "HashingIFile.h"
+
+HashingIFile::HashingIFile(fnd::IFile* file, bool ownIFile) :
+	mOwnIFile(ownIFile),
+	mFile(file),
+	mFileSize(file->size()),
+	mFileOffset(0),
+	mHashedSize(0),
+	mPartialHashSize(0),
+	mFinalised(false)
+{
+	memset(mHash.bytes, 0, crypto::sha::kSha256HashLen);
+	memset(mPartialHash.bytes, 0, crypto::sha::kSha256HashLen);
+}
+
+HashingIFile::~HashingIFile()
+{
+	if (mOwnIFile)
+	{
+		delete mFile;
+	}
+}
+
+void HashingIFile::setPartialHashSize(size_t size)
+{
+	if (mHashedSize != 0)
+	{
+		throw fnd::Exception(kModuleName, "Partial hash size must be set before reading");
+	}
+
+	mPartialHashSize = _MIN(size, mFileSize);
+}
+
+void HashingIFile::finalise()
+{
+	if (mFinalised)
+		return;
+
+	hashUntil(mFileSize);
+	mCalc.finalise(mHash.bytes);
+	mPartialCalc.finalise(mPartialHash.bytes);
+	mFinalised = true;
+}
+
+const crypto::sha::sSha256Hash& HashingIFile::getHash() const
+{
+	return mHash;
+}
+
+const crypto::sha::sSha256Hash& HashingIFile::getPartialHash() const
+{
+	return mPartialHash;
+}
+
+size_t HashingIFile::size()
+{
+	return mFileSize;
+}
+
+void HashingIFile::seek(size_t offset)
+{
+	mFileOffset = _MIN(offset, mFileSize);
+}
+
+void HashingIFile::read(byte_t* out, size_t len)
+{
+	size_t offset = mFileOffset;
+
+	// catch up on anything skipped over, so the hash stays in file order
+	if (mFinalised == false && offset > mHashedSize)
+		hashUntil(offset);
+
+	mFile->read(out, offset, len);
+
+	if (mFinalised == false && offset <= mHashedSize && offset + len > mHashedSize)
+		hashData(out + (mHashedSize - offset), (offset + len) - mHashedSize);
+
+	seek(offset + len);
+}
+
+void HashingIFile::read(byte_t* out, size_t offset, size_t len)
+{
+	seek(offset);
+	read(out, len);
+}
+
+void HashingIFile::write(const byte_t* out, size_t len)
+{
+	throw fnd::Exception(kModuleName, "write() is not supported");
+}
+
+void HashingIFile::write(const byte_t* out, size_t offset, size_t len)
+{
+	throw fnd::Exception(kModuleName, "write() is not supported");
+}
+
+void HashingIFile::hashData(const byte_t* data, size_t len)
+{
+	mCalc.update(data, len);
+
+	if (mHashedSize < mPartialHashSize)
+		mPartialCalc.update(data, _MIN(len, mPartialHashSize - mHashedSize));
+
+	mHashedSize += len;
+}
+
+void HashingIFile::hashUntil(size_t offset)
+{
+	if (mCache.size() == 0)
+		mCache.alloc(kCacheSize);
+
+	while (mHashedSize < offset)
+	{
+		size_t read_len = _MIN(offset - mHashedSize, kCacheSize);
+		mFile->read(mCache.data(), mHashedSize, read_len);
+		hashData(mCache.data(), read_len);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+#include <fnd/IFile.h>
+#include <fnd/Vec.h>
+#include <crypto/sha.h>
+
+// Hashes a file as a side effect of reading it. Bytes are fed to SHA-256 in file order
+// as reads pass the hashed watermark, so the reads of whatever process is consuming the
+// file double as the hashing pass. finalise() reads whatever was never requested.
+class HashingIFile : public fnd::IFile
+{
+public:
+	HashingIFile(fnd::IFile* file, bool ownIFile);
+	~HashingIFile();
+
+	// also hash the first "size" bytes separately (e.g. HFS0 hash protected region)
+	void setPartialHashSize(size_t size);
+
+	void finalise();
+	const crypto::sha::sSha256Hash& getHash() const;
+	const crypto::sha::sSha256Hash& getPartialHash() const;
+
+	size_t size();
+	void seek(size_t offset);
+	void read(byte_t* out, size_t len);
+	void read(byte_t* out, size_t offset, size_t len);
+	void write(const byte_t* out, size_t len);
+	void write(const byte_t* out, size_t offset, size_t len);
+private:
+	const std::string kModuleName = "HashingIFile";
+	static const size_t kCacheSize = 0x100000;
+
+	bool mOwnIFile;
+	fnd::IFile* mFile;
+	size_t mFileSize;
+	size_t mFileOffset;
+
+	size_t mHashedSize;
+	size_t mPartialHashSize;
+	crypto::sha::Sha256Calculator mCalc;
+	crypto::sha::Sha256Calculator mPartialCalc;
+	crypto::sha::sSha256Hash mHash;
+	crypto::sha::sSha256Hash mPartialHash;
+	bool mFinalised;
+
+	fnd::Vec<byte_t> mCache;
+
+	void hashData(const byte_t* data, size_t len);
+	void hashUntil(size_t offset);
+};
\ No newline at end of file
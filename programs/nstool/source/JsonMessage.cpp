@@ -0,0 +1,292 @@
+#include "JsonMessage.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fnd/Exception.h>
+
+JsonMessage::JsonMessage()
+{
+}
+
+void JsonMessage::fromString(const std::string& str)
+{
+	mMembers.clear();
+
+	size_t pos = 0;
+	skipWhitespace(str, pos);
+	if (pos >= str.size() || str[pos] != '{')
+	{
+		throw fnd::Exception(kModuleName, "Message is not a JSON object");
+	}
+	pos++;
+
+	skipWhitespace(str, pos);
+	if (pos < str.size() && str[pos] == '}')
+		return;
+
+	while (true)
+	{
+		skipWhitespace(str, pos);
+		std::string key = parseString(str, pos);
+
+		skipWhitespace(str, pos);
+		if (pos >= str.size() || str[pos] != ':')
+		{
+			throw fnd::Exception(kModuleName, "Expected ':' after member name");
+		}
+		pos++;
+
+		skipWhitespace(str, pos);
+		sValue value;
+		if (pos < str.size() && str[pos] == '"')
+		{
+			value.type = VALUE_STRING;
+			value.str = parseString(str, pos);
+		}
+		else
+		{
+			value.type = VALUE_RAW;
+			value.str = parseLiteral(str, pos);
+		}
+		mMembers[key] = value;
+
+		skipWhitespace(str, pos);
+		if (pos >= str.size())
+		{
+			throw fnd::Exception(kModuleName, "Unterminated JSON object");
+		}
+		if (str[pos] == '}')
+			break;
+		if (str[pos] != ',')
+		{
+			throw fnd::Exception(kModuleName, "Expected ',' between members");
+		}
+		pos++;
+	}
+}
+
+std::string JsonMessage::toString() const
+{
+	std::string str = "{";
+	for (std::map<std::string, sValue>::const_iterator itr = mMembers.begin(); itr != mMembers.end(); itr++)
+	{
+		if (itr != mMembers.begin())
+			str += ",";
+		str += escapeString(itr->first) + ":";
+		str += itr->second.type == VALUE_STRING ? escapeString(itr->second.str) : itr->second.str;
+	}
+	str += "}";
+	return str;
+}
+
+bool JsonMessage::hasMember(const std::string& key) const
+{
+	return mMembers.find(key) != mMembers.end();
+}
+
+std::string JsonMessage::getString(const std::string& key) const
+{
+	const sValue& value = getMember(key);
+	if (value.type != VALUE_STRING)
+	{
+		throw fnd::Exception(kModuleName, "Member \"" + key + "\" is not a string");
+	}
+	return value.str;
+}
+
+uint64_t JsonMessage::getUInt(const std::string& key) const
+{
+	const sValue& value = getMember(key);
+	char* end = nullptr;
+	uint64_t num = strtoull(value.str.c_str(), &end, 0);
+	if (value.str.empty() || *end != '\0')
+	{
+		throw fnd::Exception(kModuleName, "Member \"" + key + "\" is not an unsigned integer");
+	}
+	return num;
+}
+
+bool JsonMessage::getBool(const std::string& key) const
+{
+	const sValue& value = getMember(key);
+	if (value.type != VALUE_RAW || (value.str != "true" && value.str != "false"))
+	{
+		throw fnd::Exception(kModuleName, "Member \"" + key + "\" is not a bool");
+	}
+	return value.str == "true";
+}
+
+std::string JsonMessage::getJson(const std::string& key) const
+{
+	const sValue& value = getMember(key);
+	return value.type == VALUE_STRING ? escapeString(value.str) : value.str;
+}
+
+void JsonMessage::setString(const std::string& key, const std::string& value)
+{
+	mMembers[key] = { VALUE_STRING, value };
+}
+
+void JsonMessage::setUInt(const std::string& key, uint64_t value)
+{
+	mMembers[key] = { VALUE_RAW, std::to_string(value) };
+}
+
+void JsonMessage::setBool(const std::string& key, bool value)
+{
+	mMembers[key] = { VALUE_RAW, value ? "true" : "false" };
+}
+
+void JsonMessage::setRaw(const std::string& key, const std::string& value)
+{
+	mMembers[key] = { VALUE_RAW, value };
+}
+
+std::string JsonMessage::escapeString(const std::string& str)
+{
+	std::string out = "\"";
+	for (size_t i = 0; i < str.size(); i++)
+	{
+		char chr = str[i];
+		switch (chr)
+		{
+			case ('"'):
+				out += "\\\"";
+				break;
+			case ('\\'):
+				out += "\\\\";
+				break;
+			case ('\n'):
+				out += "\\n";
+				break;
+			case ('\r'):
+				out += "\\r";
+				break;
+			case ('\t'):
+				out += "\\t";
+				break;
+			default:
+				if ((unsigned char)chr < 0x20)
+				{
+					char hex[8];
+					snprintf(hex, sizeof(hex), "\\u%04x", (unsigned char)chr);
+					out += hex;
+				}
+				else
+				{
+					out += chr;
+				}
+				break;
+		}
+	}
+	out += "\"";
+	return out;
+}
+
+void JsonMessage::skipWhitespace(const std::string& str, size_t& pos) const
+{
+	while (pos < str.size() && (str[pos] == ' ' || str[pos] == '\t' || str[pos] == '\r' || str[pos] == '\n'))
+		pos++;
+}
+
+std::string JsonMessage::parseString(const std::string& str, size_t& pos) const
+{
+	if (pos >= str.size() || str[pos] != '"')
+	{
+		throw fnd::Exception(kModuleName, "Expected a string");
+	}
+	pos++;
+
+	std::string out;
+	while (pos < str.size() && str[pos] != '"')
+	{
+		char chr = str[pos++];
+		if (chr != '\\')
+		{
+			out += chr;
+			continue;
+		}
+
+		if (pos >= str.size())
+			break;
+		chr = str[pos++];
+		switch (chr)
+		{
+			case ('n'):
+				out += '\n';
+				break;
+			case ('r'):
+				out += '\r';
+				break;
+			case ('t'):
+				out += '\t';
+				break;
+			case ('b'):
+				out += '\b';
+				break;
+			case ('f'):
+				out += '\f';
+				break;
+			case ('u'):
+			{
+				// only code points that fit in one byte are expected in paths and names
+				if (pos + 4 > str.size())
+				{
+					throw fnd::Exception(kModuleName, "Truncated \\u escape");
+				}
+				uint32_t code = strtoul(str.substr(pos, 4).c_str(), nullptr, 16);
+				pos += 4;
+				if (code < 0x80)
+				{
+					out += (char)code;
+				}
+				else if (code < 0x800)
+				{
+					out += (char)(0xc0 | (code >> 6));
+					out += (char)(0x80 | (code & 0x3f));
+				}
+				else
+				{
+					out += (char)(0xe0 | (code >> 12));
+					out += (char)(0x80 | ((code >> 6) & 0x3f));
+					out += (char)(0x80 | (code & 0x3f));
+				}
+				break;
+			}
+			default:
+				out += chr;
+				break;
+		}
+	}
+
+	if (pos >= str.size())
+	{
+		throw fnd::Exception(kModuleName, "Unterminated string");
+	}
+	pos++;
+
+	return out;
+}
+
+std::string JsonMessage::parseLiteral(const std::string& str, size_t& pos) const
+{
+	size_t begin = pos;
+	while (pos < str.size() && str[pos] != ',' && str[pos] != '}' && str[pos] != ' ' && str[pos] != '\t' && str[pos] != '\r' && str[pos] != '\n')
+		pos++;
+
+	std::string literal = str.substr(begin, pos - begin);
+	if (literal.empty() || literal[0] == '{' || literal[0] == '[')
+	{
+		throw fnd::Exception(kModuleName, "Unsupported JSON value");
+	}
+	return literal;
+}
+
+const JsonMessage::sValue& JsonMessage::getMember(const std::string& key) const
+{
+	std::map<std::string, sValue>::const_iterator itr = mMembers.find(key);
+	if (itr == mMembers.end())
+	{
+		throw fnd::Exception(kModuleName, "Member \"" + key + "\" is missing");
+	}
+	return itr->second;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <map>
+#include <fnd/types.h>
+
+// A flat JSON object (string, number, bool and null members), as exchanged with
+// server clients one object per line. Nested values can be written but not read.
+class JsonMessage
+{
+public:
+	JsonMessage();
+
+	void fromString(const std::string& str);
+	std::string toString() const;
+
+	bool hasMember(const std::string& key) const;
+	std::string getString(const std::string& key) const;
+	uint64_t getUInt(const std::string& key) const;
+	bool getBool(const std::string& key) const;
+	// member value as JSON text, e.g. to echo a request id of any type
+	std::string getJson(const std::string& key) const;
+
+	void setString(const std::string& key, const std::string& value);
+	void setUInt(const std::string& key, uint64_t value);
+	void setBool(const std::string& key, bool value);
+	// value is inserted verbatim, it must already be valid JSON
+	void setRaw(const std::string& key, const std::string& value);
+
+	static std::string escapeString(const std::string& str);
+private:
+	const std::string kModuleName = "JsonMessage";
+
+	enum ValueType
+	{
+		VALUE_STRING,
+		VALUE_RAW
+	};
+
+	struct sValue
+	{
+		ValueType type;
+		std::string str;
+	};
+
+	std::map<std::string, sValue> mMembers;
+
+	void skipWhitespace(const std::string& str, size_t& pos) const;
+	std::string parseString(const std::string& str, size_t& pos) const;
+	std::string parseLiteral(const std::string& str, size_t& pos) const;
+	const sValue& getMember(const std::string& key) const;
+};
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "LockedIFile.h"
+
+LockedIFile::LockedIFile(fnd::IFile* file, bool ownIFile) :
+	mOwnIFile(ownIFile),
+	mFile(file),
+	mLock(mOwnLock)
+{
+
+}
+
+LockedIFile::LockedIFile(fnd::IFile* file, bool ownIFile, std::mutex& lock) :
+	mOwnIFile(ownIFile),
+	mFile(file),
+	mLock(lock)
+{
+
+}
+
+LockedIFile::~LockedIFile()
+{
+	if (mOwnIFile)
+	{
+		delete mFile;
+	}
+}
+
+size_t LockedIFile::size()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	return mFile->size();
+}
+
+void LockedIFile::seek(size_t offset)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFile->seek(offset);
+}
+
+void LockedIFile::read(byte_t* out, size_t len)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFile->read(out, len);
+}
+
+void LockedIFile::read(byte_t* out, size_t offset, size_t len)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFile->read(out, offset, len);
+}
+
+void LockedIFile::write(const byte_t* out, size_t len)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFile->write(out, len);
+}
+
+void LockedIFile::write(const byte_t* out, size_t offset, size_t len)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFile->write(out, offset, len);
+}
+
+fnd::SimpleFile* LockedIFile::getPlainFile(size_t& offset)
+{
+	// callers of the plain file transfer at explicit offsets, the position shared through the lock isn't used
+	return mFile->getPlainFile(offset);
+}
+
+void LockedIFile::setAccessHint(AccessHint hint)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFile->setAccessHint(hint);
+}
+
+void LockedIFile::prefetch(size_t offset, size_t len)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFile->prefetch(offset, len);
+}
+
+void LockedIFile::readv(const sReadRange* ranges, size_t num)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFile->readv(ranges, num);
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+#include <mutex>
+#include <fnd/IFile.h>
+
+// Serialises access to a file shared between threads. Readers sharing it must
+// use the positional read()/write() so the seek and transfer happen under one lock.
+class LockedIFile : public fnd::IFile
+{
+public:
+	LockedIFile(fnd::IFile* file, bool ownIFile);
+	// locks an existing mutex, to serialise with other code using it (it must outlive this)
+	LockedIFile(fnd::IFile* file, bool ownIFile, std::mutex& lock);
+	~LockedIFile();
+
+	size_t size();
+	void seek(size_t offset);
+	void read(byte_t* out, size_t len);
+	void read(byte_t* out, size_t offset, size_t len);
+	void write(const byte_t* out, size_t len);
+	void write(const byte_t* out, size_t offset, size_t len);
+	fnd::SimpleFile* getPlainFile(size_t& offset);
+	void setAccessHint(AccessHint hint);
+	void prefetch(size_t offset, size_t len);
+	void readv(const sReadRange* ranges, size_t num);
+private:
+	bool mOwnIFile;
+	fnd::IFile* mFile;
+	std::mutex mOwnLock;
+	std::mutex& mLock;
+};
\ No newline at end of file
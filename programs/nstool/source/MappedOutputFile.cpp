@@ -0,0 +1,173 @@
+#include "MappedOutputFile.h"
+#include <cstdio>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedOutputFile::MappedOutputFile() :
+	mFd(-1),
+	mSize(0),
+	mWindow(nullptr),
+	mWindowSize(0)
+{
+}
+
+MappedOutputFile::~MappedOutputFile()
+{
+	// only still open if writing failed, what was written is discarded unsynced
+	release();
+}
+
+bool MappedOutputFile::isSupported()
+{
+#ifdef _WIN32
+	return false;
+#else
+	return true;
+#endif
+}
+
+bool MappedOutputFile::open(const std::string& path, size_t size)
+{
+#ifdef _WIN32
+	throw fnd::Exception(kModuleName, "Memory mapped output is not supported");
+#else
+	close();
+
+	mFd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (mFd < 0)
+	{
+		throw fnd::Exception(kModuleName, "Failed to open file (" + path + ")");
+	}
+
+	// reserve the blocks now, a sparse file (no space left, or a file system without
+	// fallocate) would fault in the mapping instead
+#ifdef __linux__
+	bool allocated = fallocate(mFd, 0, 0, size) == 0;
+#else
+	bool allocated = false;
+#endif
+	if (allocated == false)
+	{
+		release();
+		::remove(path.c_str());
+		return false;
+	}
+
+	if (ftruncate(mFd, size) != 0)
+	{
+		release();
+		throw fnd::Exception(kModuleName, "Failed to set file size (" + path + ")");
+	}
+
+	mSize = size;
+	return true;
+#endif
+}
+
+void MappedOutputFile::close()
+{
+#ifndef _WIN32
+	try
+	{
+		unmap();
+	}
+	catch (const fnd::Exception&)
+	{
+		release();
+		throw;
+	}
+
+	int fd = mFd;
+	mFd = -1;
+	mSize = 0;
+	if (fd < 0)
+		return;
+
+	// write errors (EIO, or ENOSPC on file systems that allocate late) of every window are reported here
+	if (fsync(fd) != 0)
+	{
+		::close(fd);
+		throw fnd::Exception(kModuleName, "Failed to write back mapped file data");
+	}
+
+	if (::close(fd) != 0)
+	{
+		throw fnd::Exception(kModuleName, "Failed to close file");
+	}
+#endif
+}
+
+byte_t* MappedOutputFile::map(size_t offset, size_t& len)
+{
+#ifdef _WIN32
+	throw fnd::Exception(kModuleName, "Memory mapped output is not supported");
+#else
+	if (mFd < 0)
+	{
+		throw fnd::Exception(kModuleName, "File is not open");
+	}
+
+	if ((offset % kWindowSize) != 0 || offset >= mSize)
+	{
+		throw fnd::Exception(kModuleName, "Invalid window offset");
+	}
+
+	unmap();
+
+	size_t window_size = _MIN(mSize - offset, kWindowSize);
+	void* window = mmap(nullptr, window_size, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, offset);
+	if (window == MAP_FAILED)
+	{
+		throw fnd::Exception(kModuleName, "Failed to map file");
+	}
+#ifdef MADV_SEQUENTIAL
+	madvise(window, window_size, MADV_SEQUENTIAL);
+#endif
+
+	mWindow = (byte_t*)window;
+	mWindowSize = window_size;
+	len = window_size;
+	return mWindow;
+#endif
+}
+
+size_t MappedOutputFile::getWindowSize()
+{
+	return kWindowSize;
+}
+
+void MappedOutputFile::unmap()
+{
+#ifndef _WIN32
+	if (mWindow == nullptr)
+		return;
+
+	// only starts the writeback, waiting for each window would stall the producer; close() waits for all of it
+	bool synced = msync(mWindow, mWindowSize, MS_ASYNC) == 0;
+	munmap(mWindow, mWindowSize);
+	mWindow = nullptr;
+	mWindowSize = 0;
+	if (synced == false)
+	{
+		throw fnd::Exception(kModuleName, "Failed to write back mapped file data");
+	}
+#endif
+}
+
+void MappedOutputFile::release()
+{
+#ifndef _WIN32
+	if (mWindow != nullptr)
+		munmap(mWindow, mWindowSize);
+	mWindow = nullptr;
+	mWindowSize = 0;
+	if (mFd >= 0)
+		::close(mFd);
+	mFd = -1;
+	mSize = 0;
+#endif
+}
\ No newline at end of file
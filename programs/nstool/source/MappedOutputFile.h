@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+
+// An output file written through memory mappings. The file is allocated at its final
+// size up front and mapped one window at a time, so readers that produce data in place
+// (AesCtrWrappedIFile, HashTreeWrappedIFile) can decrypt and verify straight into the
+// page cache. Writeback of each window is started (msync MS_ASYNC) as it is unmapped, and
+// close() waits for all of it (fsync), so write errors are thrown rather than lost.
+// Not supported on Windows.
+class MappedOutputFile
+{
+public:
+	MappedOutputFile();
+	~MappedOutputFile();
+
+	static bool isSupported();
+
+	// false (with nothing left open) if the file's blocks can't be allocated up front, a
+	// store to a mapping of unallocated blocks faults, so the file must be written another way
+	bool open(const std::string& path, size_t size);
+	void close();
+
+	// maps the window holding offset (a multiple of getWindowSize()) and returns it, len is set to its size
+	byte_t* map(size_t offset, size_t& len);
+	static size_t getWindowSize();
+
+private:
+	const std::string kModuleName = "MappedOutputFile";
+	static const size_t kWindowSize = 0x4000000;
+
+	int mFd;
+	size_t mSize;
+	byte_t* mWindow;
+	size_t mWindowSize;
+
+	void unmap();
+	void release();
+};
\ No newline at end of file
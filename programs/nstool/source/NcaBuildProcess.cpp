@@ -0,0 +1,295 @@
+#include "NcaBuildProcess.h"
+#include <random>
+#include <vector>
+#include <fnd/io.h>
+#include <nx/NcaUtils.h>
+#include <nx/pfs.h>
+#include <nx/romfs.h>
+#include "AesCtrWrappedIFile.h"
+#include "HashTreeBuilder.h"
+#include "OffsetAdjustedIFile.h"
+
+NcaBuildProcess::NcaBuildProcess() :
+	mKeyset(nullptr),
+	mContentType(nx::nca::TYPE_DATA),
+	mProgramId(0),
+	mKeyGeneration(0),
+	mThreadNum(0),
+	mCliOutputMode(_BIT(OUTPUT_BASIC)),
+	mIsSigned(false)
+{
+}
+
+void NcaBuildProcess::process()
+{
+	if (mKeyset == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No keyset set.");
+	}
+	if (mOutputPath.empty())
+	{
+		throw fnd::Exception(kModuleName, "No output path set.");
+	}
+
+	bool has_partition = false;
+	for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
+		has_partition |= mPartitions[i].path.isSet;
+	if (has_partition == false)
+	{
+		throw fnd::Exception(kModuleName, "No partition images set.");
+	}
+
+	crypto::aes::sAesXts128Key zero_aesxts_key;
+	memset(zero_aesxts_key.key, 0, sizeof(zero_aesxts_key));
+	if (mKeyset->nca.header_key == zero_aesxts_key)
+	{
+		throw fnd::Exception(kModuleName, "NCA header key is required to build an NCA.");
+	}
+
+	crypto::aes::sAes128Key enc_key;
+	makeBodyKey(enc_key);
+
+	memset((byte_t*)&mHdrBlock, 0, sizeof(nx::sNcaHeaderBlock));
+
+	// a failed build leaves no partial NCA
+	fnd::io::replaceFile(mOutputPath, [this, &enc_key](fnd::SimpleFile& out) {
+		// partitions follow the header, each starting on a sector
+		uint64_t offset = nx::nca::kHeaderSize;
+		for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
+		{
+			if (mPartitions[i].path.isSet == false)
+				continue;
+
+			writePartition(i, out, offset);
+			offset += mPartitions[i].size;
+		}
+
+		// the header covers the partitions, so it is written last
+		makeHeader(enc_key, offset);
+
+		nx::sNcaHeaderBlock enc_hdr_block;
+		nx::NcaUtils::encryptNcaHeader((const byte_t*)&mHdrBlock, (byte_t*)&enc_hdr_block, mKeyset->nca.header_key);
+		out.write((const byte_t*)&enc_hdr_block, 0, sizeof(nx::sNcaHeaderBlock));
+	});
+
+	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+		displayInfo();
+}
+
+void NcaBuildProcess::setPartitionPath(size_t index, const std::string& path)
+{
+	if (index >= nx::nca::kPartitionNum)
+	{
+		throw fnd::Exception(kModuleName, "Invalid partition index.");
+	}
+	mPartitions[index].path = path;
+}
+
+void NcaBuildProcess::setOutputPath(const std::string& path)
+{
+	mOutputPath = path;
+}
+
+void NcaBuildProcess::setKeyset(const sKeyset* keyset)
+{
+	mKeyset = keyset;
+}
+
+void NcaBuildProcess::setContentType(nx::nca::ContentType type)
+{
+	mContentType = type;
+}
+
+void NcaBuildProcess::setProgramId(uint64_t program_id)
+{
+	mProgramId = program_id;
+}
+
+void NcaBuildProcess::setKeyGeneration(byte_t key_generation)
+{
+	mKeyGeneration = key_generation;
+}
+
+void NcaBuildProcess::setThreadNum(size_t thread_num)
+{
+	mThreadNum = thread_num;
+}
+
+void NcaBuildProcess::setCliOutputMode(CliOutputMode type)
+{
+	mCliOutputMode = type;
+}
+
+void NcaBuildProcess::makeBodyKey(crypto::aes::sAes128Key& enc_key)
+{
+	crypto::aes::sAes128Key zero_aesctr_key;
+	memset(zero_aesctr_key.key, 0, sizeof(zero_aesctr_key));
+
+	// the key area is encrypted with the key area key of the key generation
+	byte_t masterkey_rev = nx::NcaUtils::getMasterKeyRevisionFromKeyGeneration(mKeyGeneration);
+	if (masterkey_rev >= kMasterKeyNum || mKeyset->nca.key_area_key[nx::nca::KAEK_IDX_APPLICATION][masterkey_rev] == zero_aesctr_key)
+	{
+		throw fnd::Exception(kModuleName, "Application key area key for the key generation is required to build an NCA.");
+	}
+
+	// a body key given with --bodykey is used as is, otherwise one is made up
+	if (mKeyset->nca.manual_body_key_aesctr != zero_aesctr_key)
+	{
+		mBodyKey = mKeyset->nca.manual_body_key_aesctr;
+	}
+	else
+	{
+		std::random_device rng;
+		for (size_t i = 0; i < sizeof(mBodyKey.key); i++)
+			mBodyKey.key[i] = (byte_t)rng();
+	}
+
+	crypto::aes::AesEcbEncrypt(mBodyKey.key, sizeof(mBodyKey.key), mKeyset->nca.key_area_key[nx::nca::KAEK_IDX_APPLICATION][masterkey_rev].key, enc_key.key);
+}
+
+void NcaBuildProcess::determinePartitionType(size_t index, fnd::SimpleFile& file)
+{
+	nx::sRomfsHeader romfs_hdr;
+	if (file.size() < sizeof(nx::sRomfsHeader))
+	{
+		throw fnd::Exception(kModuleName, "Partition " + std::to_string(index) + " image is not a PFS0 or RomFS image.");
+	}
+	file.read((byte_t*)&romfs_hdr, 0, sizeof(nx::sRomfsHeader));
+
+	// PFS0 partitions are code (or other small partitions) and are hashed whole, RomFS partitions have an integrity tree
+	if (((const le_uint32_t*)&romfs_hdr)->get() == nx::pfs::kPfsStructMagic)
+	{
+		mPartitions[index].format_type = nx::nca::FORMAT_PFS0;
+		mPartitions[index].hash_type = nx::nca::HASH_HIERARCHICAL_SHA256;
+	}
+	else if (romfs_hdr.header_size.get() == sizeof(nx::sRomfsHeader))
+	{
+		mPartitions[index].format_type = nx::nca::FORMAT_ROMFS;
+		mPartitions[index].hash_type = nx::nca::HASH_HIERARCHICAL_INTERGRITY;
+	}
+	else
+	{
+		throw fnd::Exception(kModuleName, "Partition " + std::to_string(index) + " image is not a PFS0 or RomFS image.");
+	}
+}
+
+void NcaBuildProcess::writePartition(size_t index, fnd::SimpleFile& out, uint64_t offset)
+{
+	fnd::SimpleFile in(mPartitions[index].path.var, fnd::SimpleFile::Read);
+	determinePartitionType(index, in);
+
+	// the counter of a partition is made from its fs header, the partition index keeps them apart
+	nx::sNcaFsHeader& fs_hdr = mHdrBlock.fs_header[index];
+	fs_hdr.version = nx::nca::kDefaultFsHeaderVersion;
+	fs_hdr.format_type = mPartitions[index].format_type;
+	fs_hdr.hash_type = mPartitions[index].hash_type;
+	fs_hdr.encryption_type = nx::nca::CRYPT_AESCTR;
+	fs_hdr.aes_ctr_upper[0] = (byte_t)index;
+
+	crypto::aes::sAesIvCtr ctr;
+	nx::NcaUtils::getNcaPartitionAesCtr(&fs_hdr, ctr.iv);
+
+	// counters are per NCA offset, so the partition is encrypted where it sits in the NCA; its
+	// size is not known until the hash tree is laid out, so it is left open
+	AesCtrWrappedIFile enc_out(&out, SHARED_IFILE, mBodyKey, ctr);
+	enc_out.setWriteThreadNum(mThreadNum != 0 ? mThreadNum : ThreadPool::getDefaultThreadNum());
+	OffsetAdjustedIFile partition_out(&enc_out, SHARED_IFILE, offset, SIZE_MAX - offset);
+
+	HashTreeBuilder builder;
+	builder.setInputFile(&in, SHARED_IFILE);
+	builder.setOutputFile(&partition_out, SHARED_IFILE);
+	builder.setHashTreeType(mPartitions[index].hash_type == nx::nca::HASH_HIERARCHICAL_SHA256 ? HashTreeMeta::HASH_TYPE_SHA256 : HashTreeMeta::HASH_TYPE_INTEGRITY);
+	builder.setThreadNum(mThreadNum);
+	builder.process();
+
+	if (builder.getHashTreeHeader().size() > nx::nca::kFsHeaderHashSuperblockLen)
+	{
+		throw fnd::Exception(kModuleName, "Hash tree header does not fit in the fs header.");
+	}
+	memcpy(fs_hdr.hash_superblock, builder.getHashTreeHeader().data(), builder.getHashTreeHeader().size());
+
+	// partitions are held in sectors, the tail is padded with (encrypted) zeros
+	uint64_t size = builder.getOutputSize();
+	mPartitions[index].offset = offset;
+	mPartitions[index].size = align(size, nx::nca::kSectorSize);
+	std::vector<byte_t> padding(mPartitions[index].size - size, 0);
+	if (padding.empty() == false)
+		partition_out.write(padding.data(), size, padding.size());
+}
+
+void NcaBuildProcess::makeHeader(const crypto::aes::sAes128Key& enc_key, uint64_t content_size)
+{
+	fnd::List<nx::NcaHeader::sPartition> partitions;
+	for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
+	{
+		if (mPartitions[i].path.isSet == false)
+			continue;
+
+		nx::NcaHeader::sPartition partition;
+		partition.index = (byte_t)i;
+		partition.offset = mPartitions[i].offset;
+		partition.size = mPartitions[i].size;
+		crypto::sha::Sha256((const byte_t*)&mHdrBlock.fs_header[i], sizeof(nx::sNcaFsHeader), partition.hash.bytes);
+		partitions.addElement(partition);
+	}
+
+	// the body key is the AES-CTR key of the key area, the XTS keys are left unset
+	crypto::aes::sAes128Key zero_aesctr_key;
+	memset(zero_aesctr_key.key, 0, sizeof(zero_aesctr_key));
+	fnd::List<crypto::aes::sAes128Key> enc_keys;
+	for (size_t i = 0; i < nx::nca::kAesKeyNum; i++)
+		enc_keys.addElement(i == nx::nca::KEY_AESCTR ? enc_key : zero_aesctr_key);
+
+	mHdr.clear();
+	mHdr.setFormatVersion(nx::NcaHeader::NCA3_FORMAT);
+	mHdr.setDistributionType(nx::nca::DIST_DOWNLOAD);
+	mHdr.setContentType(mContentType);
+	mHdr.setKeyGeneration(mKeyGeneration);
+	mHdr.setKaekIndex(nx::nca::KAEK_IDX_APPLICATION);
+	mHdr.setContentSize(content_size);
+	mHdr.setProgramId(mProgramId);
+	mHdr.setPartitions(partitions);
+	mHdr.setEncAesKeys(enc_keys);
+	mHdr.toBytes();
+	memcpy((byte_t*)&mHdrBlock.header, mHdr.getBytes().data(), sizeof(nx::sNcaHeader));
+
+	// without the private exponent (as in retail keysets) the header is left unsigned
+	mIsSigned = false;
+	for (size_t i = 0; i < crypto::rsa::kRsa2048Size && mIsSigned == false; i++)
+		mIsSigned = mKeyset->nca.header_sign_key.priv_exponent[i] != 0;
+	if (mIsSigned)
+	{
+		crypto::sha::sSha256Hash hash;
+		crypto::sha::Sha256((const byte_t*)&mHdrBlock.header, sizeof(nx::sNcaHeader), hash.bytes);
+		if (crypto::rsa::pss::rsaSign(mKeyset->nca.header_sign_key, crypto::sha::HASH_SHA256, hash.bytes, mHdrBlock.signature_main) != 0)
+		{
+			throw fnd::Exception(kModuleName, "Failed to sign NCA header.");
+		}
+	}
+}
+
+void NcaBuildProcess::displayInfo()
+{
+	const char* content_type_str[] = { "Program", "Meta", "Control", "Manual", "Data", "PublicData" };
+
+	printf("[NCA Build]\n");
+	printf("  Output:        %s\n", mOutputPath.c_str());
+	printf("  ContentType:   %s\n", content_type_str[mContentType]);
+	printf("  ProgID:        0x%016" PRIx64 "\n", mProgramId);
+	printf("  KeyGeneration: %d\n", mKeyGeneration);
+	printf("  Signature:     %s\n", mIsSigned ? "Signed" : "Not signed (no NCA header private key)");
+	printf("  Partitions:\n");
+	for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
+	{
+		if (mPartitions[i].path.isSet == false)
+			continue;
+
+		printf("    %d:\n", (int)i);
+		printf("      Image:     %s\n", mPartitions[i].path.var.c_str());
+		printf("      Format:    %s\n", mPartitions[i].format_type == nx::nca::FORMAT_PFS0 ? "PartitionFs" : "RomFs");
+		printf("      HashType:  %s\n", mPartitions[i].hash_type == nx::nca::HASH_HIERARCHICAL_SHA256 ? "HierarchicalSha256" : "HierarchicalIntegrity");
+		printf("      Offset:    0x%" PRIx64 "\n", mPartitions[i].offset);
+		printf("      Size:      0x%" PRIx64 "\n", mPartitions[i].size);
+	}
+	printf("  ContentSize:   0x%" PRIx64 "\n", mHdr.getContentSize());
+}
\ No newline at end of file
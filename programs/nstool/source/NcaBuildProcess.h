@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include <fnd/SimpleFile.h>
+#include <nx/nca.h>
+#include <nx/NcaHeader.h>
+
+#include "nstool.h"
+
+// Builds an NCA from PFS0/RomFS partition images. Each image is read once: its hash tree is
+// built as it streams through, and it is written AES-CTR encrypted (across a thread pool) behind
+// its hash layers. The header is filled in last, signed with the NCA header key of the keyset
+// (when its private exponent is set), XTS encrypted and written in front of the partitions.
+class NcaBuildProcess
+{
+public:
+	NcaBuildProcess();
+
+	void process();
+
+	void setPartitionPath(size_t index, const std::string& path);
+	void setOutputPath(const std::string& path);
+	void setKeyset(const sKeyset* keyset);
+	void setContentType(nx::nca::ContentType type);
+	void setProgramId(uint64_t program_id);
+	void setKeyGeneration(byte_t key_generation);
+	// 0 uses every CPU core
+	void setThreadNum(size_t thread_num);
+	void setCliOutputMode(CliOutputMode type);
+
+private:
+	const std::string kModuleName = "NcaBuildProcess";
+	static const size_t kCopyBufferSize = 0x100000;
+
+	struct sBuildPartition
+	{
+		sOptional<std::string> path;
+		nx::nca::FormatType format_type;
+		nx::nca::HashType hash_type;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	sBuildPartition mPartitions[nx::nca::kPartitionNum];
+	std::string mOutputPath;
+	const sKeyset* mKeyset;
+	nx::nca::ContentType mContentType;
+	uint64_t mProgramId;
+	byte_t mKeyGeneration;
+	size_t mThreadNum;
+	CliOutputMode mCliOutputMode;
+
+	crypto::aes::sAes128Key mBodyKey;
+	nx::sNcaHeaderBlock mHdrBlock;
+	nx::NcaHeader mHdr;
+	bool mIsSigned;
+
+	void makeBodyKey(crypto::aes::sAes128Key& enc_key);
+	void determinePartitionType(size_t index, fnd::SimpleFile& file);
+	void writePartition(size_t index, fnd::SimpleFile& out, uint64_t offset);
+	void makeHeader(const crypto::aes::sAes128Key& enc_key, uint64_t content_size);
+	void displayInfo();
+};
\ No newline at end of file
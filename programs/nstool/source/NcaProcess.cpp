@@ -226,11 +226,17 @@ NcaProcess::NcaProcess() :
 	mKeyset(nullptr),
 	mCliOutputMode(_BIT(OUTPUT_BASIC)),
 	mVerify(false),
+	mVerifyHash(false),
+	mVerifyPassed(true),
+	mVerifyCache(nullptr),
+	mIncrementalExtract(false),
 	mListFs(false)
 {
 	for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
 	{
 		mPartitionPath[i].doExtract = false;
+		mPartitions[i].configured = false;
+		mPartitions[i].reader_opened = false;
 		mPartitions[i].reader = nullptr;
 	}
 }
@@ -276,16 +282,29 @@ void NcaProcess::process()
 	// import/generate fs header data
 	generatePartitionConfiguration();
 
-	// validate signatures
+	// partitions the extract filter can't match (by partition index) aren't extracted, or opened for it
+	for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
+	{
+		if (mPartitionPath[i].doExtract && mExtractFilter.mayMatchUnder(std::to_string(i)) == false)
+			mPartitionPath[i].doExtract = false;
+	}
+
+	// validate signatures and hash trees
+	mVerifyPassed = true;
 	if (mVerify)
-		validateNcaSignatures();
+		mVerifyPassed = verifyNca();
 
 	// display header
 	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
 		displayHeader();
 
-	// process partition
-	processPartitions();
+	// process partitions, only when they will be displayed or extracted so header-only
+	// runs (and callers that just want getPartitionReader()) don't read the body
+	bool extract_partition = false;
+	for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
+		extract_partition |= mPartitionPath[i].doExtract;
+	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC) || extract_partition)
+		processPartitions();
 
 	/*
 	NCA is a file container
@@ -330,6 +349,17 @@ void NcaProcess::setVerifyMode(bool verify)
 	mVerify = verify;
 }
 
+void NcaProcess::setVerifyHashMode(bool verify_hash)
+{
+	mVerifyHash = verify_hash;
+}
+
+void NcaProcess::setVerifyCache(VerifyCache* cache, const VerifyCache::sFileIdentity& identity)
+{
+	mVerifyCache = cache;
+	mFileIdentity = identity;
+}
+
 void NcaProcess::setPartition0ExtractPath(const std::string& path)
 {
 	mPartitionPath[0].path = path;
@@ -354,11 +384,84 @@ void NcaProcess::setPartition3ExtractPath(const std::string& path)
 	mPartitionPath[3].doExtract = true;
 }
 
+void NcaProcess::setExtractFilter(const PathFilter& filter)
+{
+	mExtractFilter = filter;
+}
+
+void NcaProcess::setIncrementalExtract(bool incremental)
+{
+	mIncrementalExtract = incremental;
+}
+
+void NcaProcess::setExtractStorePath(const std::string& store_path)
+{
+	mExtractStorePath = store_path;
+}
+
 void NcaProcess::setListFs(bool list_fs)
 {
 	mListFs = list_fs;
 }
 
+const nx::NcaHeader& NcaProcess::getNcaHeader() const
+{
+	return mHdr;
+}
+
+fnd::IFile* NcaProcess::getPartitionReader(size_t index)
+{
+	if (index >= nx::nca::kPartitionNum)
+	{
+		throw fnd::Exception(kModuleName, "Illegal partition index.");
+	}
+
+	sPartitionInfo& info = mPartitions[index];
+	if (info.configured && info.reader_opened == false)
+		openPartitionReader(info);
+
+	return info.reader;
+}
+
+const HashTreeMeta* NcaProcess::getPartitionHashTreeMeta(size_t index) const
+{
+	if (index >= nx::nca::kPartitionNum)
+	{
+		throw fnd::Exception(kModuleName, "Illegal partition index.");
+	}
+
+	const sPartitionInfo& info = mPartitions[index];
+	if (info.configured == false || (info.hash_type != nx::nca::HASH_HIERARCHICAL_SHA256 && info.hash_type != nx::nca::HASH_HIERARCHICAL_INTERGRITY))
+		return nullptr;
+
+	return &info.hash_tree_meta;
+}
+
+nx::nca::FormatType NcaProcess::getPartitionFormatType(size_t index) const
+{
+	if (index >= nx::nca::kPartitionNum || mPartitions[index].configured == false)
+	{
+		throw fnd::Exception(kModuleName, "Illegal partition index.");
+	}
+
+	return mPartitions[index].format_type;
+}
+
+bool NcaProcess::isVerifyPassed() const
+{
+	return mVerifyPassed;
+}
+
+fnd::IFile* NcaProcess::openPartitionDecryptedReader(size_t index) const
+{
+	if (index >= nx::nca::kPartitionNum || mPartitions[index].configured == false)
+	{
+		throw fnd::Exception(kModuleName, "Illegal partition index.");
+	}
+
+	return createDecryptedReader(mPartitions[index]);
+}
+
 void NcaProcess::generateNcaBodyEncryptionKeys()
 {
 	// create zeros key
@@ -514,7 +617,6 @@ void NcaProcess::generatePartitionConfiguration()
 		nx::NcaUtils::getNcaPartitionAesCtr(&fs_header, info.aes_ctr.iv);
 
 		// save partition config
-		info.reader = nullptr;
 		info.offset = partition.offset;
 		info.size = partition.size;
 		info.format_type = (nx::nca::FormatType)fs_header.format_type;
@@ -525,75 +627,118 @@ void NcaProcess::generatePartitionConfiguration()
 		else if (info.hash_type == nx::nca::HASH_HIERARCHICAL_INTERGRITY)
 			info.hash_tree_meta.importData(fs_header.hash_superblock, nx::nca::kFsHeaderHashSuperblockLen, HashTreeMeta::HASH_TYPE_INTEGRITY);
 
-		// create reader
-		try 
-		{
-			// filter out unrecognised format types
-			switch (info.format_type)
-			{
-				case (nx::nca::FORMAT_PFS0):
-				case (nx::nca::FORMAT_ROMFS):
-					break;
-				default:
-					error.clear();
-					error <<  "FormatType(" << info.format_type << "): UNKNOWN";
-					throw fnd::Exception(kModuleName, error.str());
-			}
+		// the reader (and the hash layers it loads) is created on first use by getPartitionReader()
+		info.configured = true;
+		info.reader_opened = false;
+	}
+}
 
-			// create reader based on encryption type0
-			if (info.enc_type == nx::nca::CRYPT_NONE)
-			{
-				info.reader = new OffsetAdjustedIFile(mFile, SHARED_IFILE, info.offset, info.size);
-			}
-			else if (info.enc_type == nx::nca::CRYPT_AESCTR)
-			{
-				if (mBodyKeys.aes_ctr.isSet == false)
-					throw fnd::Exception(kModuleName, "AES-CTR Key was not determined");
-				info.reader = new OffsetAdjustedIFile(new AesCtrWrappedIFile(mFile, SHARED_IFILE, mBodyKeys.aes_ctr.var, info.aes_ctr), OWN_IFILE, info.offset, info.size);
-			}
-			else if (info.enc_type == nx::nca::CRYPT_AESXTS || info.enc_type == nx::nca::CRYPT_AESCTREX)
-			{
-				error.clear();
-				error <<  "EncryptionType(" << getEncryptionTypeStr(info.enc_type) << "): UNSUPPORTED";
-				throw fnd::Exception(kModuleName, error.str());
-			}
-			else
-			{
-				error.clear();
-				error <<  "EncryptionType(" << info.enc_type << "): UNKNOWN";
-				throw fnd::Exception(kModuleName, error.str());
-			}
+void NcaProcess::openPartitionReader(sPartitionInfo& info)
+{
+	std::stringstream error;
 
-			// filter out unrecognised hash types, and hash based readers
-			if (info.hash_type == nx::nca::HASH_HIERARCHICAL_SHA256 || info.hash_type == nx::nca::HASH_HIERARCHICAL_INTERGRITY)
-			{	
-				fnd::IFile* tmp = info.reader;
-				info.reader = nullptr;
-				info.reader = new HashTreeWrappedIFile(tmp, OWN_IFILE, info.hash_tree_meta);
-			}
-			else if (info.hash_type != nx::nca::HASH_NONE)
-			{
+	info.reader_opened = true;
+	try 
+	{
+		// filter out unrecognised format types
+		switch (info.format_type)
+		{
+			case (nx::nca::FORMAT_PFS0):
+			case (nx::nca::FORMAT_ROMFS):
+				break;
+			default:
 				error.clear();
-				error <<  "HashType(" << info.hash_type << "): UNKNOWN";
+				error <<  "FormatType(" << info.format_type << "): UNKNOWN";
 				throw fnd::Exception(kModuleName, error.str());
-			}
 		}
-		catch (const fnd::Exception& e)
-		{
-			info.fail_reason = std::string(e.error());
-			if (info.reader != nullptr)
-				delete info.reader;
+
+		// create reader based on encryption type
+		info.reader = createDecryptedReader(info);
+
+		// filter out unrecognised hash types, and hash based readers
+		if (info.hash_type == nx::nca::HASH_HIERARCHICAL_SHA256 || info.hash_type == nx::nca::HASH_HIERARCHICAL_INTERGRITY)
+		{	
+			fnd::IFile* tmp = info.reader;
 			info.reader = nullptr;
+			info.reader = new HashTreeWrappedIFile(tmp, OWN_IFILE, info.hash_tree_meta);
 		}
+		else if (info.hash_type != nx::nca::HASH_NONE)
+		{
+			error.clear();
+			error <<  "HashType(" << info.hash_type << "): UNKNOWN";
+			throw fnd::Exception(kModuleName, error.str());
+		}
+	}
+	catch (const fnd::Exception& e)
+	{
+		info.fail_reason = std::string(e.error());
+		if (info.reader != nullptr)
+			delete info.reader;
+		info.reader = nullptr;
 	}
 }
 
-void NcaProcess::validateNcaSignatures()
+fnd::IFile* NcaProcess::createDecryptedReader(const sPartitionInfo& info) const
+{
+	std::stringstream error;
+
+	if (info.enc_type == nx::nca::CRYPT_NONE)
+	{
+		return new OffsetAdjustedIFile(mFile, SHARED_IFILE, info.offset, info.size);
+	}
+	else if (info.enc_type == nx::nca::CRYPT_AESCTR)
+	{
+		if (mBodyKeys.aes_ctr.isSet == false)
+			throw fnd::Exception(kModuleName, "AES-CTR Key was not determined");
+		return new OffsetAdjustedIFile(new AesCtrWrappedIFile(mFile, SHARED_IFILE, mBodyKeys.aes_ctr.var, info.aes_ctr), OWN_IFILE, info.offset, info.size);
+	}
+	else if (info.enc_type == nx::nca::CRYPT_AESXTS || info.enc_type == nx::nca::CRYPT_AESCTREX)
+	{
+		error <<  "EncryptionType(" << getEncryptionTypeStr(info.enc_type) << "): UNSUPPORTED";
+		throw fnd::Exception(kModuleName, error.str());
+	}
+	else
+	{
+		error <<  "EncryptionType(" << info.enc_type << "): UNKNOWN";
+		throw fnd::Exception(kModuleName, error.str());
+	}
+}
+
+bool NcaProcess::verifyNca()
+{
+	// skip the full read if this exact NCA was verified before
+	sVerifyCacheEntry key;
+	if (mVerifyCache != nullptr)
+	{
+		uint64_t verify_time;
+		VerifyCache::generateNcaKey(mFile, mKeyset, mFileIdentity, mVerifyHash ? verifycache::KIND_NCA : verifycache::KIND_NCA_SIGNATURE, key);
+		if (mVerifyCache->isVerified(key, verify_time))
+		{
+			if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+				printf("[INFO] NCA Verify: OK (verified at %s, cached)\n", VerifyCache::getTimeStr(verify_time).c_str());
+			return true;
+		}
+	}
+
+	bool signature_ok = validateNcaSignatures();
+	// without it, only the blocks read for listing or extraction are checked against the hash trees
+	bool hash_ok = mVerifyHash ? validatePartitionHashes() : true;
+
+	if (mVerifyCache != nullptr)
+		mVerifyCache->recordResult(key, signature_ok && hash_ok);
+
+	return signature_ok && hash_ok;
+}
+
+bool NcaProcess::validateNcaSignatures()
 {
+	bool ok = true;
+
 	// validate signature[0]
 	if (crypto::rsa::pss::rsaVerify(mKeyset->nca.header_sign_key, crypto::sha::HASH_SHA256, mHdrHash.bytes, mHdrBlock.signature_main) != 0)
 	{
 		printf("[WARNING] NCA Header Main Signature: FAIL \n");
+		ok = false;
 	}
 
 	// validate signature[1]
@@ -601,44 +746,94 @@ void NcaProcess::validateNcaSignatures()
 	{
 		if (mPartitions[nx::nca::PARTITION_CODE].format_type == nx::nca::FORMAT_PFS0)
 		{
-			if (mPartitions[nx::nca::PARTITION_CODE].reader != nullptr)
+			fnd::IFile* exefs_reader = getPartitionReader(nx::nca::PARTITION_CODE);
+			if (exefs_reader != nullptr)
 			{
+				// the parsed header is reused when the ExeFs is displayed/extracted by processPartitions()
 				PfsProcess exefs;
-				exefs.setInputFile(mPartitions[nx::nca::PARTITION_CODE].reader, SHARED_IFILE);
+				exefs.setInputFile(exefs_reader, SHARED_IFILE);
 				exefs.setCliOutputMode(0);
 				exefs.process();
+				mExefsHeader = exefs.getPfsHeader();
 
 				// open main.npdm
-				if (exefs.getPfsHeader().getFileList().hasElement(kNpdmExefsPath) == true)
+				if (mExefsHeader.var.getFileList().hasElement(kNpdmExefsPath) == true)
 				{
-					const nx::PfsHeader::sFile& file = exefs.getPfsHeader().getFileList().getElement(kNpdmExefsPath);
+					const nx::PfsHeader::sFile& file = mExefsHeader.var.getFileList().getElement(kNpdmExefsPath);
 
 					NpdmProcess npdm;
-					npdm.setInputFile(new OffsetAdjustedIFile(mPartitions[nx::nca::PARTITION_CODE].reader, SHARED_IFILE, file.offset, file.size), OWN_IFILE);
+					npdm.setInputFile(new OffsetAdjustedIFile(exefs_reader, SHARED_IFILE, file.offset, file.size), OWN_IFILE);
 					npdm.setCliOutputMode(0);
 					npdm.process();
 
 					if (crypto::rsa::pss::rsaVerify(npdm.getNpdmBinary().getAcid().getNcaHeaderSignature2Key(), crypto::sha::HASH_SHA256, mHdrHash.bytes, mHdrBlock.signature_acid) != 0)
 					{
 						printf("[WARNING] NCA Header ACID Signature: FAIL \n");
+						ok = false;
 					}
 									
 				}
 				else
 				{
 					printf("[WARNING] NCA Header ACID Signature: FAIL (\"%s\" not present in ExeFs)\n", kNpdmExefsPath.c_str());
+					ok = false;
 				}
 			}
 			else
 			{
 				printf("[WARNING] NCA Header ACID Signature: FAIL (ExeFs unreadable)\n");
+				ok = false;
 			}
 		}
 		else
 		{
 			printf("[WARNING] NCA Header ACID Signature: FAIL (No ExeFs partition)\n");
+			ok = false;
 		}
 	}
+
+	return ok;
+}
+
+bool NcaProcess::validatePartitionHashes()
+{
+	static const size_t kReadBlockSize = 0x100000;
+	bool ok = true;
+
+	// the hash tree readers validate every block they read, so reading everything validates the partition
+	fnd::Vec<byte_t> scratch;
+	scratch.alloc(kReadBlockSize);
+	for (size_t i = 0; i < mHdr.getPartitions().size(); i++)
+	{
+		size_t index = mHdr.getPartitions()[i].index;
+		sPartitionInfo& partition = mPartitions[index];
+
+		if (partition.hash_type == nx::nca::HASH_NONE)
+			continue;
+
+		// unreadable partitions are reported by processPartitions(), but can't count as verified
+		fnd::IFile* reader = getPartitionReader(index);
+		if (reader == nullptr)
+		{
+			ok = false;
+			continue;
+		}
+
+		try
+		{
+			for (size_t offset = 0; offset < reader->size(); offset += kReadBlockSize)
+			{
+				reader->read(scratch.data(), offset, _MIN(kReadBlockSize, reader->size() - offset));
+			}
+		}
+		catch (const fnd::Exception& e)
+		{
+			printf("[WARNING] NCA Partition %d Hash: FAIL (%s)\n", (int)index, e.error());
+			ok = false;
+		}
+	}
+
+	return ok;
 }
 
 void NcaProcess::displayHeader()
@@ -770,8 +965,13 @@ void NcaProcess::processPartitions()
 		size_t index = mHdr.getPartitions()[i].index;
 		struct sPartitionInfo& partition = mPartitions[index];
 
+		// nothing to display or extract, leave the partition unopened
+		if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC) == false && mPartitionPath[index].doExtract == false)
+			continue;
+
 		// if the reader is null, skip
-		if (partition.reader == nullptr)
+		fnd::IFile* reader = getPartitionReader(index);
+		if (reader == nullptr)
 		{
 			printf("[WARNING] NCA Partition %d not readable.", (int)index);
 			if (partition.fail_reason.empty() == false)
@@ -785,7 +985,9 @@ void NcaProcess::processPartitions()
 		if (partition.format_type == nx::nca::FORMAT_PFS0)
 		{
 			PfsProcess pfs;
-			pfs.setInputFile(partition.reader, SHARED_IFILE);
+			pfs.setInputFile(reader, SHARED_IFILE);
+			if (index == nx::nca::PARTITION_CODE && mExefsHeader.isSet)
+				pfs.setPfsHeader(mExefsHeader.var);
 			pfs.setCliOutputMode(mCliOutputMode);
 			pfs.setListFs(mListFs);
 			if (mHdr.getContentType() == nx::nca::TYPE_PROGRAM)
@@ -798,7 +1000,13 @@ void NcaProcess::processPartitions()
 			}
 			
 			if (mPartitionPath[index].doExtract)
+			{
 				pfs.setExtractPath(mPartitionPath[index].path);
+				pfs.setExtractFilter(mExtractFilter.getSubFilter(std::to_string(index)));
+				pfs.setIncrementalExtract(mIncrementalExtract);
+				pfs.setExtractStorePath(mExtractStorePath);
+				pfs.setExtractSourceTag(getExtractSourceTag(i));
+			}
 			//printf("pfs.process(%lx)\n",partition.data_offset);
 			pfs.process();
 			//printf("pfs.process() end\n");
@@ -806,7 +1014,7 @@ void NcaProcess::processPartitions()
 		else if (partition.format_type == nx::nca::FORMAT_ROMFS)
 		{
 			RomfsProcess romfs;
-			romfs.setInputFile(partition.reader, SHARED_IFILE);
+			romfs.setInputFile(reader, SHARED_IFILE);
 			romfs.setCliOutputMode(mCliOutputMode);
 			romfs.setListFs(mListFs);
 			if (mHdr.getContentType() == nx::nca::TYPE_PROGRAM)
@@ -819,10 +1027,27 @@ void NcaProcess::processPartitions()
 			}
 
 			if (mPartitionPath[index].doExtract)
+			{
 				romfs.setExtractPath(mPartitionPath[index].path);
+				romfs.setExtractFilter(mExtractFilter.getSubFilter(std::to_string(index)));
+				romfs.setIncrementalExtract(mIncrementalExtract);
+				romfs.setExtractStorePath(mExtractStorePath);
+				romfs.setExtractSourceTag(getExtractSourceTag(i));
+			}
 			//printf("romfs.process(%lx)\n", partition.data_offset);
 			romfs.process();
 			//printf("romfs.process() end\n");
 		}
 	}
 }
+
+std::string NcaProcess::getExtractSourceTag(size_t index) const
+{
+	const nx::NcaHeader::sPartition& partition = mHdr.getPartitions()[index];
+
+	// the fs header hash covers the master hash, so it pins the plaintext of a hashed partition
+	if (mPartitions[partition.index].hash_type == nx::nca::HASH_NONE)
+		return std::string();
+
+	return "nca:" + FileExtractor::getHashStr(partition.hash);
+}
\ No newline at end of file
@@ -3,10 +3,13 @@
 #include <fnd/types.h>
 #include <fnd/SimpleFile.h>
 #include <nx/NcaHeader.h>
+#include <nx/PfsHeader.h>
 #include "HashTreeMeta.h"
+#include "VerifyCache.h"
 
 
 #include "nstool.h"
+#include "PathFilter.h"
 
 class NcaProcess
 {
@@ -21,14 +24,32 @@ public:
 	void setKeyset(const sKeyset* keyset);
 	void setCliOutputMode(CliOutputMode type);
 	void setVerifyMode(bool verify);
+	// in verify mode, also read every hashed partition in full and check it against its hash tree
+	void setVerifyHashMode(bool verify_hash);
+	void setVerifyCache(VerifyCache* cache, const VerifyCache::sFileIdentity& identity);
 
 	// nca specfic
 	void setPartition0ExtractPath(const std::string& path);
 	void setPartition1ExtractPath(const std::string& path);
 	void setPartition2ExtractPath(const std::string& path);
 	void setPartition3ExtractPath(const std::string& path);
+	void setExtractFilter(const PathFilter& filter);
+	void setIncrementalExtract(bool incremental);
+	void setExtractStorePath(const std::string& store_path);
 	void setListFs(bool list_fs);
 
+	// post process() accessors
+	const nx::NcaHeader& getNcaHeader() const;
+	// partition readers are created on first access, nullptr if the partition can't be read
+	fnd::IFile* getPartitionReader(size_t index);
+	// hash tree of a partition, nullptr if the partition doesn't exist or isn't hashed
+	const HashTreeMeta* getPartitionHashTreeMeta(size_t index) const;
+	nx::nca::FormatType getPartitionFormatType(size_t index) const;
+	// false if verify mode found a bad signature or hash
+	bool isVerifyPassed() const;
+	// new reader (owned by the caller) of the decrypted partition, including hash layers and without hash checks
+	fnd::IFile* openPartitionDecryptedReader(size_t index) const;
+
 private:
 	const std::string kModuleName = "NcaProcess";
 	const std::string kNpdmExefsPath = "main.npdm";
@@ -39,12 +60,19 @@ private:
 	const sKeyset* mKeyset;
 	CliOutputMode mCliOutputMode;
 	bool mVerify;
+	bool mVerifyHash;
+	bool mVerifyPassed;
+	VerifyCache* mVerifyCache;
+	VerifyCache::sFileIdentity mFileIdentity;
 
 	struct sExtract
 	{
 		std::string path;
 		bool doExtract;
 	} mPartitionPath[nx::nca::kPartitionNum];
+	PathFilter mExtractFilter;
+	bool mIncrementalExtract;
+	std::string mExtractStorePath;
 
 	bool mListFs;
 
@@ -92,6 +120,8 @@ private:
 	
 	struct sPartitionInfo
 	{
+		bool configured;
+		bool reader_opened;
 		fnd::IFile* reader;
 		std::string fail_reason;
 		size_t offset;
@@ -105,9 +135,16 @@ private:
 		crypto::aes::sAesIvCtr aes_ctr;
 	} mPartitions[nx::nca::kPartitionNum];
 
+	sOptional<nx::PfsHeader> mExefsHeader;
+
 	void generateNcaBodyEncryptionKeys();
 	void generatePartitionConfiguration();
-	void validateNcaSignatures();
+	void openPartitionReader(sPartitionInfo& info);
+	fnd::IFile* createDecryptedReader(const sPartitionInfo& info) const;
+	bool verifyNca();
+	bool validateNcaSignatures();
+	bool validatePartitionHashes();
 	void displayHeader();
 	void processPartitions();
+	std::string getExtractSourceTag(size_t index) const;
 };
\ No newline at end of file
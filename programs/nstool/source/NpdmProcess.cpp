@@ -5,7 +5,8 @@ NpdmProcess::NpdmProcess() :
 	mOwnIFile(false),
 	mKeyset(nullptr),
 	mCliOutputMode(_BIT(OUTPUT_BASIC)),
-	mVerify(false)
+	mVerify(false),
+	mVerifyPassed(true)
 {
 }
 
@@ -31,10 +32,11 @@ void NpdmProcess::process()
 
 	mNpdm.fromBytes(scratch.data(), scratch.size());
 
+	mVerifyPassed = true;
 	if (mVerify)
 	{
-		validateAcidSignature(mNpdm.getAcid());
-		validateAciFromAcid(mNpdm.getAci(), mNpdm.getAcid());
+		mVerifyPassed &= validateAcidSignature(mNpdm.getAcid());
+		mVerifyPassed &= validateAciFromAcid(mNpdm.getAci(), mNpdm.getAcid());
 	}
 
 	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
@@ -85,6 +87,11 @@ const nx::NpdmBinary& NpdmProcess::getNpdmBinary() const
 	return mNpdm;
 }
 
+bool NpdmProcess::isVerifyPassed() const
+{
+	return mVerifyPassed;
+}
+
 const std::string kInstructionType[2] = { "32Bit", "64Bit" };
 const std::string kProcAddrSpace[4] = { "Unknown", "64Bit", "32Bit", "32Bit no reserved" };
 const std::string kAcidFlag[32] = 
@@ -336,27 +343,32 @@ const std::string kMemMapType[2] = { "Io", "Static" };
  
 const std::string kAcidTarget[2] = { "Development", "Production" };
 
-void NpdmProcess::validateAcidSignature(const nx::AccessControlInfoDescBinary& acid)
+bool NpdmProcess::validateAcidSignature(const nx::AccessControlInfoDescBinary& acid)
 {
 	try {
 		acid.validateSignature(mKeyset->acid_sign_key);
 	}
 	catch (...) {
 		printf("[WARNING] ACID Signature: FAIL\n");
+		return false;
 	}
-	
+	return true;
 }
 
-void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, const nx::AccessControlInfoDescBinary& acid)
+bool NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, const nx::AccessControlInfoDescBinary& acid)
 {
+	bool ok = true;
+
 	// check Program ID
 	if (acid.getProgramIdRestrict().min > 0 && aci.getProgramId() < acid.getProgramIdRestrict().min)
 	{
 		printf("[WARNING] ACI ProgramId: FAIL (Outside Legal Range)\n");
+		ok = false;
 	}
 	else if (acid.getProgramIdRestrict().max > 0 && aci.getProgramId() > acid.getProgramIdRestrict().max)
 	{
 		printf("[WARNING] ACI ProgramId: FAIL (Outside Legal Range)\n");
+		ok = false;
 	}
 
 	for (size_t i = 0; i < aci.getFileSystemAccessControl().getFsaRightsList().size(); i++)
@@ -372,6 +384,7 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 		{
 
 			printf("[WARNING] ACI/FAC FsaRights: FAIL (%s not permitted)\n", kFsaFlag[aci.getFileSystemAccessControl().getFsaRightsList()[i]].c_str());
+			ok = false;
 		}
 	}
 
@@ -388,6 +401,7 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 		{
 
 			printf("[WARNING] ACI/FAC ContentOwnerId: FAIL (%016" PRIx64 " not permitted)\n", aci.getFileSystemAccessControl().getContentOwnerIdList()[i]);
+			ok = false;
 		}
 	}
 
@@ -404,6 +418,7 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 		{
 
 			printf("[WARNING] ACI/FAC ContentOwnerId: FAIL (%016" PRIx64 "(%d) not permitted)\n", aci.getFileSystemAccessControl().getSaveDataOwnerIdList()[i].id, aci.getFileSystemAccessControl().getSaveDataOwnerIdList()[i].access_type);
+			ok = false;
 		}
 	}
 
@@ -420,6 +435,7 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 		if (rightFound == false)
 		{
 			printf("[WARNING] ACI/SAC ServiceList: FAIL (%s%s not permitted)\n", aci.getServiceAccessControl().getServiceList()[i].getName().c_str(), aci.getServiceAccessControl().getServiceList()[i].isServer()? " (Server)" : "");
+			ok = false;
 		}
 	}
 
@@ -428,18 +444,22 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 	if (aci.getKernelCapabilities().getThreadInfo().getMaxCpuId() != acid.getKernelCapabilities().getThreadInfo().getMaxCpuId())
 	{
 		printf("[WARNING] ACI/KC ThreadInfo/MaxCpuId: FAIL (%d not permitted)\n", aci.getKernelCapabilities().getThreadInfo().getMaxCpuId());
+		ok = false;
 	}
 	if (aci.getKernelCapabilities().getThreadInfo().getMinCpuId() != acid.getKernelCapabilities().getThreadInfo().getMinCpuId())
 	{
 		printf("[WARNING] ACI/KC ThreadInfo/MinCpuId: FAIL (%d not permitted)\n", aci.getKernelCapabilities().getThreadInfo().getMinCpuId());
+		ok = false;
 	}
 	if (aci.getKernelCapabilities().getThreadInfo().getMaxPriority() != acid.getKernelCapabilities().getThreadInfo().getMaxPriority())
 	{
 		printf("[WARNING] ACI/KC ThreadInfo/MaxPriority: FAIL (%d not permitted)\n", aci.getKernelCapabilities().getThreadInfo().getMaxPriority());
+		ok = false;
 	}
 	if (aci.getKernelCapabilities().getThreadInfo().getMinPriority() != acid.getKernelCapabilities().getThreadInfo().getMinPriority())
 	{
 		printf("[WARNING] ACI/KC ThreadInfo/MinPriority: FAIL (%d not permitted)\n", aci.getKernelCapabilities().getThreadInfo().getMinPriority());
+		ok = false;
 	}
 	// check system calls
 	for (size_t i = 0; i < aci.getKernelCapabilities().getSystemCalls().getSystemCalls().size(); i++)
@@ -454,6 +474,7 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 		if (rightFound == false)
 		{
 			printf("[WARNING] ACI/KC SystemCallList: FAIL (%s not permitted)\n", kSysCall[aci.getKernelCapabilities().getSystemCalls().getSystemCalls()[i]].c_str());
+			ok = false;
 		}
 	}
 	// check memory maps
@@ -471,6 +492,7 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 			const nx::MemoryMappingHandler::sMemoryMapping& map = aci.getKernelCapabilities().getMemoryMaps().getMemoryMaps()[i];
 
 			printf("[WARNING] ACI/KC MemoryMap: FAIL (0x%016" PRIx64 " - 0x%016" PRIx64 " (perm=%s) (type=%s) not permitted)\n", (uint64_t)map.addr << 12, ((uint64_t)(map.addr + map.size) << 12) - 1, kMemMapPerm[map.perm].c_str(), kMemMapType[map.type].c_str());
+			ok = false;
 		}
 	}
 	for (size_t i = 0; i < aci.getKernelCapabilities().getMemoryMaps().getIoMemoryMaps().size(); i++)
@@ -487,6 +509,7 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 			const nx::MemoryMappingHandler::sMemoryMapping& map = aci.getKernelCapabilities().getMemoryMaps().getIoMemoryMaps()[i];
 
 			printf("[WARNING] ACI/KC IoMemoryMap: FAIL (0x%016" PRIx64 " - 0x%016" PRIx64 " (perm=%s) (type=%s) not permitted)\n", (uint64_t)map.addr << 12, ((uint64_t)(map.addr + map.size) << 12) - 1, kMemMapPerm[map.perm].c_str(), kMemMapType[map.type].c_str());
+			ok = false;
 		}
 	}
 	// check interupts
@@ -502,12 +525,14 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 		if (rightFound == false)
 		{
 			printf("[WARNING] ACI/KC InteruptsList: FAIL (0x%0x not permitted)\n", aci.getKernelCapabilities().getInterupts().getInteruptList()[i]);
+			ok = false;
 		}
 	}
 	// check misc params
 	if (aci.getKernelCapabilities().getMiscParams().getProgramType() != acid.getKernelCapabilities().getMiscParams().getProgramType())
 	{
 		printf("[WARNING] ACI/KC ProgramType: FAIL (%d not permitted)\n",  aci.getKernelCapabilities().getMiscParams().getProgramType());
+		ok = false;
 	}
 	// check kernel version
 	uint32_t aciKernelVersion = (uint32_t)aci.getKernelCapabilities().getKernelVersion().getVerMajor() << 16 |  (uint32_t)aci.getKernelCapabilities().getKernelVersion().getVerMinor();
@@ -515,11 +540,13 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 	if (aciKernelVersion < acidKernelVersion)
 	{
 		printf("[WARNING] ACI/KC RequiredKernelVersion: FAIL (%d.%d not permitted)\n", aci.getKernelCapabilities().getKernelVersion().getVerMajor(), aci.getKernelCapabilities().getKernelVersion().getVerMinor());
+		ok = false;
 	}
 	// check handle table size
 	if (aci.getKernelCapabilities().getHandleTableSize().getHandleTableSize() > acid.getKernelCapabilities().getHandleTableSize().getHandleTableSize())
 	{
 		printf("[WARNING] ACI/KC HandleTableSize: FAIL (0x%x too large)\n", aci.getKernelCapabilities().getHandleTableSize().getHandleTableSize());
+		ok = false;
 	}
 	// check misc flags
 	for (size_t i = 0; i < aci.getKernelCapabilities().getMiscFlags().getFlagList().size(); i++)
@@ -534,8 +561,11 @@ void NpdmProcess::validateAciFromAcid(const nx::AccessControlInfoBinary& aci, co
 		if (rightFound == false)
 		{
 			printf("[WARNING] ACI/KC MiscFlag: FAIL (%s not permitted)\n", kMiscFlag[aci.getKernelCapabilities().getMiscFlags().getFlagList()[i]].c_str());
+			ok = false;
 		}
 	}
+
+	return ok;
 }
 
 void NpdmProcess::displayNpdmHeader(const nx::NpdmBinary& hdr)
@@ -20,6 +20,8 @@ public:
 	void setVerifyMode(bool verify);
 
 	const nx::NpdmBinary& getNpdmBinary() const;
+	// false if verify mode found a bad signature, or ACI rights the ACID doesn't permit
+	bool isVerifyPassed() const;
 
 private:
 	const std::string kModuleName = "NpdmProcess";
@@ -29,11 +31,12 @@ private:
 	const sKeyset* mKeyset;
 	CliOutputMode mCliOutputMode;
 	bool mVerify;
+	bool mVerifyPassed;
 
 	nx::NpdmBinary mNpdm;
 
-	void validateAcidSignature(const nx::AccessControlInfoDescBinary& acid);
-	void validateAciFromAcid(const nx::AccessControlInfoBinary& aci, const nx::AccessControlInfoDescBinary& acid);
+	bool validateAcidSignature(const nx::AccessControlInfoDescBinary& acid);
+	bool validateAciFromAcid(const nx::AccessControlInfoBinary& aci, const nx::AccessControlInfoDescBinary& acid);
 
 	void displayNpdmHeader(const nx::NpdmBinary& hdr);
 	void displayAciHdr(const nx::AccessControlInfoBinary& aci);
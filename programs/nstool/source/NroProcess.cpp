@@ -91,6 +91,21 @@ void NroProcess::setAssetRomfsExtractPath(const std::string& path)
 	mAssetProc.setRomfsExtractPath(path);
 }
 
+void NroProcess::setAssetRomfsExtractFilter(const PathFilter& filter)
+{
+	mAssetProc.setRomfsExtractFilter(filter);
+}
+
+void NroProcess::setAssetRomfsIncrementalExtract(bool incremental)
+{
+	mAssetProc.setRomfsIncrementalExtract(incremental);
+}
+
+void NroProcess::setAssetRomfsExtractStorePath(const std::string& store_path)
+{
+	mAssetProc.setRomfsExtractStorePath(store_path);
+}
+
 const RoMetadataProcess& NroProcess::getRoMetadataProcess() const
 {
 	return mRoMeta;
@@ -31,6 +31,9 @@ public:
 	void setAssetIconExtractPath(const std::string& path);
 	void setAssetNacpExtractPath(const std::string& path);
 	void setAssetRomfsExtractPath(const std::string& path);
+	void setAssetRomfsExtractFilter(const PathFilter& filter);
+	void setAssetRomfsIncrementalExtract(bool incremental);
+	void setAssetRomfsExtractStorePath(const std::string& store_path);
 
 	const RoMetadataProcess& getRoMetadataProcess() const;
 private:
@@ -30,9 +30,8 @@ void OffsetAdjustedIFile::seek(size_t offset)
 
 void OffsetAdjustedIFile::read(byte_t* out, size_t len)
 {
-	// assert proper position in file
-	mFile->seek(mCurrentOffset + mBaseOffset);
-	mFile->read(out, len);
+	// positional read so the base file can be shared (see LockedIFile)
+	mFile->read(out, mCurrentOffset + mBaseOffset, len);
 	seek(mCurrentOffset + len);
 }
 
@@ -44,9 +43,8 @@ void OffsetAdjustedIFile::read(byte_t* out, size_t offset, size_t len)
 
 void OffsetAdjustedIFile::write(const byte_t* out, size_t len)
 {
-	// assert proper position in file
-	mFile->seek(mCurrentOffset + mBaseOffset);
-	mFile->write(out, len);
+	// positional write so the base file can be shared (see LockedIFile)
+	mFile->write(out, mCurrentOffset + mBaseOffset, len);
 	seek(mCurrentOffset + len);
 }
 
@@ -54,4 +52,33 @@ void OffsetAdjustedIFile::write(const byte_t* out, size_t offset, size_t len)
 {
 	seek(offset);
 	write(out, len);
+}
+
+fnd::SimpleFile* OffsetAdjustedIFile::getPlainFile(size_t& offset)
+{
+	offset += mBaseOffset;
+	return mFile->getPlainFile(offset);
+}
+
+void OffsetAdjustedIFile::setAccessHint(AccessHint hint)
+{
+	mFile->setAccessHint(hint);
+}
+
+void OffsetAdjustedIFile::prefetch(size_t offset, size_t len)
+{
+	mFile->prefetch(offset + mBaseOffset, len);
+}
+
+void OffsetAdjustedIFile::readv(const sReadRange* ranges, size_t num)
+{
+	if (num == 0)
+		return;
+
+	std::vector<sReadRange> adjusted(ranges, ranges + num);
+	for (size_t i = 0; i < num; i++)
+		adjusted[i].offset += mBaseOffset;
+	mFile->readv(adjusted.data(), adjusted.size());
+
+	seek(ranges[num - 1].offset + ranges[num - 1].len);
 }
\ No newline at end of file
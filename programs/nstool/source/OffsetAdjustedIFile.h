@@ -1,3 +1,4 @@
+#include <vector>
 #include <fnd/IFile.h>
 
 class OffsetAdjustedIFile : public fnd::IFile
@@ -12,6 +13,10 @@ public:
 	void read(byte_t* out, size_t offset, size_t len);
 	void write(const byte_t* out, size_t len);
 	void write(const byte_t* out, size_t offset, size_t len);
+	fnd::SimpleFile* getPlainFile(size_t& offset);
+	void setAccessHint(AccessHint hint);
+	void prefetch(size_t offset, size_t len);
+	void readv(const sReadRange* ranges, size_t num);
 private:
 	bool mOwnIFile;
 	fnd::IFile* mFile;
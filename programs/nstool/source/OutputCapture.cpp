@@ -0,0 +1,92 @@
+#include "OutputCapture.h"
+#include <cstdio>
+#include <mutex>
+
+#ifdef __GLIBC__
+// stdout is swapped for an unbuffered cookie stream, writes made while a capture
+// is active on the writing thread go to that capture, everything else is passed
+// through to the original stdout
+static thread_local std::string* gCapture = nullptr;
+static FILE* gRealStdout = nullptr;
+static std::once_flag gInstallFlag;
+
+static ssize_t captureWrite(void* cookie, const char* buf, size_t size)
+{
+	if (gCapture != nullptr)
+	{
+		gCapture->append(buf, size);
+		return size;
+	}
+
+	return fwrite(buf, 1, size, gRealStdout);
+}
+
+static void installCaptureStream()
+{
+	cookie_io_functions_t funcs = { nullptr, captureWrite, nullptr, nullptr };
+	FILE* stream = fopencookie(nullptr, "w", funcs);
+	if (stream == nullptr)
+		return;
+	setvbuf(stream, nullptr, _IONBF, 0);
+
+	fflush(stdout);
+	gRealStdout = stdout;
+	stdout = stream;
+}
+#endif
+
+OutputCapture::OutputCapture() :
+	mPrevCapture(nullptr),
+	mActive(false)
+{
+}
+
+OutputCapture::~OutputCapture()
+{
+	end();
+}
+
+void OutputCapture::begin()
+{
+	if (mActive)
+		return;
+
+#ifdef __GLIBC__
+	std::call_once(gInstallFlag, installCaptureStream);
+	mPrevCapture = gCapture;
+	gCapture = &mOutput;
+#endif
+	mActive = true;
+}
+
+void OutputCapture::end()
+{
+	if (!mActive)
+		return;
+
+#ifdef __GLIBC__
+	gCapture = mPrevCapture;
+#endif
+	mPrevCapture = nullptr;
+	mActive = false;
+}
+
+const std::string& OutputCapture::getOutput() const
+{
+	return mOutput;
+}
+
+void OutputCapture::print(const std::string& output)
+{
+	fwrite(output.data(), 1, output.size(), stdout);
+	fflush(stdout);
+}
+
+bool OutputCapture::isSupported()
+{
+#ifdef __GLIBC__
+	return true;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+
+// Redirects everything the calling thread writes to stdout into a buffer, so
+// processes running concurrently on a ThreadPool can print their output as one
+// uninterrupted block once they have finished.
+class OutputCapture
+{
+public:
+	OutputCapture();
+	~OutputCapture();
+
+	void begin();
+	void end();
+
+	const std::string& getOutput() const;
+
+	// writes a captured block to stdout as a single write
+	static void print(const std::string& output);
+	static bool isSupported();
+
+private:
+	const std::string kModuleName = "OutputCapture";
+
+	std::string mOutput;
+	std::string* mPrevCapture;
+	bool mActive;
+};
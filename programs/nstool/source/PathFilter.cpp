@@ -0,0 +1,189 @@
+#include "PathFilter.h"
+#include <fnd/Exception.h>
+
+// not a member, filters are copied and assigned between processes
+static const std::string kModuleName = "PathFilter";
+
+PathFilter::PathFilter() :
+	mInclude(),
+	mExclude(),
+	mBasePath()
+{
+}
+
+void PathFilter::addInclude(const std::string& pattern, bool is_regex)
+{
+	mInclude.push_back(makePattern(pattern, is_regex));
+}
+
+void PathFilter::addExclude(const std::string& pattern, bool is_regex)
+{
+	mExclude.push_back(makePattern(pattern, is_regex));
+}
+
+bool PathFilter::isActive() const
+{
+	return mInclude.empty() == false || mExclude.empty() == false;
+}
+
+PathFilter PathFilter::getSubFilter(const std::string& dir) const
+{
+	PathFilter filter(*this);
+	if (dir.empty() == false)
+		filter.mBasePath += dir + "/";
+	return filter;
+}
+
+bool PathFilter::isMatch(const std::string& path) const
+{
+	std::string full_path = mBasePath + path;
+
+	bool included = mInclude.empty();
+	for (size_t i = 0; i < mInclude.size() && included == false; i++)
+	{
+		included = isPatternMatch(mInclude[i], full_path);
+	}
+	if (included == false)
+		return false;
+
+	for (size_t i = 0; i < mExclude.size(); i++)
+	{
+		if (isPatternMatch(mExclude[i], full_path))
+			return false;
+	}
+
+	return true;
+}
+
+bool PathFilter::mayMatchUnder(const std::string& dir) const
+{
+	if (mInclude.empty())
+		return true;
+
+	std::string dir_path = mBasePath + dir + "/";
+	for (size_t i = 0; i < mInclude.size(); i++)
+	{
+		// a regex can match anything
+		if (mInclude[i].is_regex)
+			return true;
+
+		// otherwise the glob's literal prefix must agree with the directory path
+		const std::string& glob = mInclude[i].str;
+		size_t literal_len = glob.find_first_of("*?[");
+		if (literal_len == std::string::npos)
+			literal_len = glob.size();
+
+		size_t cmp_len = _MIN(literal_len, dir_path.size());
+		if (glob.compare(0, cmp_len, dir_path, 0, cmp_len) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+PathFilter::sPattern PathFilter::makePattern(const std::string& pattern, bool is_regex) const
+{
+	sPattern out;
+	out.str = pattern;
+	out.is_regex = is_regex;
+	if (is_regex)
+	{
+		try
+		{
+			out.regex = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+		}
+		catch (const std::regex_error& e)
+		{
+			throw fnd::Exception(kModuleName, "Invalid regex \"" + pattern + "\" (" + e.what() + ")");
+		}
+	}
+	return out;
+}
+
+bool PathFilter::isPatternMatch(const sPattern& pattern, const std::string& path) const
+{
+	if (pattern.is_regex)
+		return std::regex_search(path, pattern.regex);
+
+	return isGlobMatch(pattern.str.c_str(), path.c_str());
+}
+
+bool PathFilter::isGlobMatch(const char* pattern, const char* str)
+{
+	// iterative matching, backtracking to the last '*'
+	const char* star = nullptr;
+	const char* star_str = nullptr;
+
+	while (*str != '\0')
+	{
+		bool matched = false;
+		if (*pattern == '*')
+		{
+			star = pattern++;
+			star_str = str;
+			continue;
+		}
+		else if (*pattern == '?')
+		{
+			matched = true;
+			pattern++;
+		}
+		else if (*pattern == '[')
+		{
+			const char* end = pattern + 1;
+			bool negate = (*end == '!' || *end == '^');
+			if (negate)
+				end++;
+
+			bool in_class = false;
+			for (bool first = true; *end != '\0' && (*end != ']' || first); end++, first = false)
+			{
+				if (end[1] == '-' && end[2] != ']' && end[2] != '\0')
+				{
+					in_class |= (*str >= end[0] && *str <= end[2]);
+					end += 2;
+				}
+				else
+				{
+					in_class |= (*str == *end);
+				}
+			}
+
+			// an unterminated class is a literal '['
+			if (*end == '\0')
+			{
+				matched = (*str == '[');
+				pattern++;
+			}
+			else
+			{
+				matched = (in_class != negate);
+				pattern = end + 1;
+			}
+		}
+		else if (*pattern != '\0' && *pattern == *str)
+		{
+			matched = true;
+			pattern++;
+		}
+
+		if (matched)
+		{
+			str++;
+		}
+		else if (star != nullptr)
+		{
+			pattern = star + 1;
+			str = ++star_str;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while (*pattern == '*')
+		pattern++;
+
+	return *pattern == '\0';
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <regex>
+#include <fnd/types.h>
+
+// Include/exclude patterns for extraction, tested against the virtual path of a file
+// (the nested container path used by --cat, e.g. "secure/<id>.nca/1/sound/x.bfsar").
+// Globs support '*' (any characters, including '/'), '?' and '[...]', and must match
+// the whole path. Regexes match anywhere in the path.
+// With no include patterns every path is included, excludes take precedence.
+class PathFilter
+{
+public:
+	PathFilter();
+
+	void addInclude(const std::string& pattern, bool is_regex);
+	void addExclude(const std::string& pattern, bool is_regex);
+
+	bool isActive() const;
+
+	// filter for the contents of dir, which are then tested by their path relative to dir
+	PathFilter getSubFilter(const std::string& dir) const;
+
+	bool isMatch(const std::string& path) const;
+	// false only if no path below dir can be included, so dir needn't be opened or traversed
+	bool mayMatchUnder(const std::string& dir) const;
+
+private:
+	struct sPattern
+	{
+		std::string str;
+		bool is_regex;
+		std::regex regex;
+	};
+
+	std::vector<sPattern> mInclude;
+	std::vector<sPattern> mExclude;
+	std::string mBasePath;
+
+	sPattern makePattern(const std::string& pattern, bool is_regex) const;
+	bool isPatternMatch(const sPattern& pattern, const std::string& path) const;
+	static bool isGlobMatch(const char* pattern, const char* str);
+};
\ No newline at end of file
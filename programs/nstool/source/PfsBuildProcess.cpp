@@ -0,0 +1,246 @@
+#include "PfsBuildProcess.h"
+#include <algorithm>
+#include <map>
+#include <fnd/io.h>
+
+PfsBuildProcess::PfsBuildProcess() :
+	mFsType(nx::PfsHeader::TYPE_PFS0),
+	mHashProtectedSize(nx::nca::kSectorSize),
+	mCliOutputMode(_BIT(OUTPUT_BASIC)),
+	mOrderedFileNum(0)
+{
+}
+
+void PfsBuildProcess::process()
+{
+	if (mInputPath.empty())
+	{
+		throw fnd::Exception(kModuleName, "No input path set.");
+	}
+	if (mOutputPath.empty())
+	{
+		throw fnd::Exception(kModuleName, "No output path set.");
+	}
+
+	collectFiles();
+	orderFiles();
+	makeHeader();
+	writeImage();
+
+	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+		displayInfo();
+}
+
+void PfsBuildProcess::setInputPath(const std::string& path)
+{
+	mInputPath = path;
+}
+
+void PfsBuildProcess::setOutputPath(const std::string& path)
+{
+	mOutputPath = path;
+}
+
+void PfsBuildProcess::setFsType(nx::PfsHeader::FsType type)
+{
+	mFsType = type;
+}
+
+void PfsBuildProcess::setHashProtectedSize(size_t size)
+{
+	mHashProtectedSize = size;
+}
+
+void PfsBuildProcess::setEntryOrderPath(const std::string& path)
+{
+	mEntryOrderPath = path;
+}
+
+void PfsBuildProcess::setCliOutputMode(CliOutputMode type)
+{
+	mCliOutputMode = type;
+}
+
+void PfsBuildProcess::collectFiles()
+{
+	// the files of a directory (not its sub directories, a PFS has none) in name order, or the files of a list in list order
+	std::vector<std::string> paths;
+	if (fnd::io::isDirectory(mInputPath))
+	{
+		fnd::List<std::string> dir_list, file_list;
+		fnd::io::getDirectoryListing(mInputPath, dir_list, file_list);
+
+		std::vector<std::string> names;
+		for (size_t i = 0; i < file_list.size(); i++)
+			names.push_back(file_list[i]);
+		std::sort(names.begin(), names.end());
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			std::string path;
+			fnd::io::appendToPath(path, mInputPath);
+			fnd::io::appendToPath(path, names[i]);
+			paths.push_back(path);
+		}
+	}
+	else
+	{
+		fnd::io::getLineList(mInputPath, paths);
+	}
+
+	mFiles.clear();
+	std::map<std::string, size_t> file_index;
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		sBuildFile file;
+		size_t name_pos = paths[i].find_last_of("/\\");
+		file.name = name_pos == std::string::npos ? paths[i] : paths[i].substr(name_pos + 1);
+		file.host_path = paths[i];
+		file.size = fnd::io::getFileSize(file.host_path);
+		file.hash_protected_size = mFsType == nx::PfsHeader::TYPE_HFS0 ? _MIN(file.size, (uint64_t)mHashProtectedSize) : 0;
+		memset(file.hash.bytes, 0, sizeof(file.hash));
+
+		if (file.name.empty() || file_index.find(file.name) != file_index.end())
+		{
+			throw fnd::Exception(kModuleName, "Duplicate or empty entry name (" + file.host_path + ")");
+		}
+		file_index[file.name] = mFiles.size();
+		mFiles.push_back(file);
+	}
+
+	if (mFiles.empty())
+	{
+		throw fnd::Exception(kModuleName, "No files to pack.");
+	}
+}
+
+void PfsBuildProcess::orderFiles()
+{
+	// the entries named in the order first, in the order given, then the rest as collected
+	mOrderedFileNum = 0;
+	if (mEntryOrderPath.empty())
+		return;
+
+	std::map<std::string, size_t> file_index;
+	for (size_t i = 0; i < mFiles.size(); i++)
+		file_index[mFiles[i].name] = i;
+
+	std::vector<std::string> order;
+	fnd::io::getLineList(mEntryOrderPath, order);
+
+	std::vector<sBuildFile> ordered;
+	std::vector<bool> placed(mFiles.size(), false);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		// names may be written as mounted (/name)
+		std::string name = order[i].substr(order[i].find_first_not_of('/') == std::string::npos ? order[i].size() : order[i].find_first_not_of('/'));
+		std::map<std::string, size_t>::const_iterator itr = file_index.find(name);
+		if (itr == file_index.end() || placed[itr->second])
+			continue;
+		ordered.push_back(mFiles[itr->second]);
+		placed[itr->second] = true;
+		mOrderedFileNum++;
+	}
+	for (size_t i = 0; i < mFiles.size(); i++)
+	{
+		if (placed[i] == false)
+			ordered.push_back(mFiles[i]);
+	}
+	mFiles = ordered;
+}
+
+void PfsBuildProcess::makeHeader()
+{
+	// file data follows the header in entry order, so the layout only depends on names and sizes (not hashes)
+	mHdr.clear();
+	mHdr.setFsType(mFsType);
+	for (size_t i = 0; i < mFiles.size(); i++)
+	{
+		if (mFsType == nx::PfsHeader::TYPE_HFS0)
+			mHdr.addFile(mFiles[i].name, mFiles[i].size, mFiles[i].hash_protected_size, mFiles[i].hash);
+		else
+			mHdr.addFile(mFiles[i].name, mFiles[i].size);
+	}
+	mHdr.toBytes();
+}
+
+void PfsBuildProcess::writeImage()
+{
+	// a failed build leaves no partial image
+	fnd::io::replaceFile(mOutputPath, [this](fnd::SimpleFile& out) {
+		std::vector<byte_t> buffer(kCopyBufferSize);
+
+		// the header is written again once the HFS0 hashes are known, its size doesn't change
+		out.write(mHdr.getBytes().data(), mHdr.getBytes().size());
+
+		for (size_t i = 0; i < mFiles.size(); i++)
+		{
+			writeFileData(out, mFiles[i], buffer);
+		}
+
+		if (mFsType == nx::PfsHeader::TYPE_HFS0)
+			makeHeader();
+		out.write(mHdr.getBytes().data(), 0, mHdr.getBytes().size());
+	});
+}
+
+void PfsBuildProcess::writeFileData(fnd::SimpleFile& out, sBuildFile& file, std::vector<byte_t>& buffer)
+{
+	fnd::SimpleFile in(file.host_path, fnd::SimpleFile::Read);
+	if (in.size() != file.size)
+	{
+		throw fnd::Exception(kModuleName, "File changed while building (" + file.host_path + ")");
+	}
+
+	// the hash protected region is copied through the buffer so it is hashed on the way
+	uint64_t pos = 0;
+	if (file.hash_protected_size > 0)
+	{
+		crypto::sha::Sha256Calculator calc;
+		for (; pos < file.hash_protected_size; pos += buffer.size())
+		{
+			size_t len = (size_t)_MIN(file.hash_protected_size - pos, (uint64_t)buffer.size());
+			in.read(buffer.data(), pos, len);
+			calc.update(buffer.data(), len);
+			out.write(buffer.data(), len);
+		}
+		calc.finalise(file.hash.bytes);
+		pos = file.hash_protected_size;
+	}
+
+	// the rest is copied without passing through user space where supported
+	pos += out.copyFrom(in, pos, file.size - pos);
+	for (; pos < file.size; pos += buffer.size())
+	{
+		size_t len = (size_t)_MIN(file.size - pos, (uint64_t)buffer.size());
+		in.read(buffer.data(), pos, len);
+		out.write(buffer.data(), len);
+	}
+}
+
+void PfsBuildProcess::displayInfo()
+{
+	uint64_t data_size = 0;
+	for (size_t i = 0; i < mFiles.size(); i++)
+		data_size += mFiles[i].size;
+
+	printf("[PartitionFS Build]\n");
+	printf("  Output:         %s\n", mOutputPath.c_str());
+	printf("  Type:           %s\n", mFsType == nx::PfsHeader::TYPE_HFS0 ? "HFS0" : "PFS0");
+	printf("  FileNum:        %" PRIu64 "\n", (uint64_t)mFiles.size());
+	if (mEntryOrderPath.empty() == false)
+		printf("  OrderedFileNum: %" PRIu64 "\n", (uint64_t)mOrderedFileNum);
+	printf("  HeaderSize:     0x%" PRIx64 "\n", (uint64_t)mHdr.getSize());
+	printf("  DataSize:       0x%" PRIx64 "\n", data_size);
+	if (_HAS_BIT(mCliOutputMode, OUTPUT_LAYOUT))
+	{
+		printf("  Files:\n");
+		for (size_t i = 0; i < mHdr.getFileList().size(); i++)
+		{
+			const nx::PfsHeader::sFile& file = mHdr.getFileList()[i];
+			printf("    %s (offset=0x%" PRIx64 ", size=0x%" PRIx64, file.name.c_str(), (uint64_t)file.offset, (uint64_t)file.size);
+			if (mFsType == nx::PfsHeader::TYPE_HFS0)
+				printf(", hash_protected_size=0x%" PRIx64, (uint64_t)file.hash_protected_size);
+			printf(")\n");
+		}
+	}
+}
\ No newline at end of file
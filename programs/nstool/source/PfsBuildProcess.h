@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fnd/types.h>
+#include <fnd/SimpleFile.h>
+#include <nx/PfsHeader.h>
+
+#include "nstool.h"
+
+// Builds a PFS0 (NSP) or HFS0 image from the files of a directory (in name order) or a list
+// file (one path per line, in list order). An entry order can be given to place files first.
+// The header is laid out before any data is copied, file data is copied without passing
+// through user space where supported, and an HFS0 file's hash protected region is hashed as
+// it is copied; the header is written last, once the hashes are known.
+class PfsBuildProcess
+{
+public:
+	PfsBuildProcess();
+
+	void process();
+
+	void setInputPath(const std::string& path);
+	void setOutputPath(const std::string& path);
+	void setFsType(nx::PfsHeader::FsType type);
+	// HFS0 only, the size of the start of each file covered by its hash (at most the file size)
+	void setHashProtectedSize(size_t size);
+	void setEntryOrderPath(const std::string& path);
+	void setCliOutputMode(CliOutputMode type);
+
+private:
+	const std::string kModuleName = "PfsBuildProcess";
+	static const size_t kCopyBufferSize = 0x100000;
+
+	struct sBuildFile
+	{
+		std::string name;
+		std::string host_path;
+		uint64_t size;
+		uint64_t hash_protected_size;
+		crypto::sha::sSha256Hash hash;
+	};
+
+	std::string mInputPath;
+	std::string mOutputPath;
+	nx::PfsHeader::FsType mFsType;
+	size_t mHashProtectedSize;
+	std::string mEntryOrderPath;
+	CliOutputMode mCliOutputMode;
+
+	// in entry order, which is also data order
+	std::vector<sBuildFile> mFiles;
+	size_t mOrderedFileNum;
+	nx::PfsHeader mHdr;
+
+	void collectFiles();
+	void orderFiles();
+	void makeHeader();
+	void writeImage();
+	void writeFileData(fnd::SimpleFile& out, sBuildFile& file, std::vector<byte_t>& buffer);
+	void displayInfo();
+};
\ No newline at end of file
@@ -1,17 +1,35 @@
 #include <fnd/SimpleFile.h>
 #include <fnd/io.h>
 #include "PfsProcess.h"
+#include "NcaProcess.h"
+#include "CnmtProcess.h"
+#include "HashingIFile.h"
+#include "OffsetAdjustedIFile.h"
+#include "LockedIFile.h"
+#include "OutputCapture.h"
+#include "ThreadPool.h"
 
 PfsProcess::PfsProcess() :
 	mFile(nullptr),
 	mOwnIFile(false),
+	mKeyset(nullptr),
 	mCliOutputMode(_BIT(OUTPUT_BASIC)),
 	mVerify(false),
+	mVerifyHash(false),
+	mVerifyPassed(true),
+	mVerifyCache(nullptr),
 	mExtractPath(),
 	mExtract(false),
+	mIncrementalExtract(false),
 	mMountName(),
 	mListFs(false),
-	mPfs()
+	mProcessNca(false),
+	mNcaExtractPath(),
+	mNcaExtract(false),
+	mJobNum(0),
+	mValidateContent(false),
+	mPfs(),
+	mPfsImported(false)
 {
 }
 
@@ -32,19 +50,22 @@ void PfsProcess::process()
 		throw fnd::Exception(kModuleName, "No file reader set.");
 	}
 	
-	// open minimum header to get full header size
-	scratch.alloc(sizeof(nx::sPfsHeader));
-	mFile->read(scratch.data(), 0, scratch.size());
-	if (validateHeaderMagic(((nx::sPfsHeader*)scratch.data())) == false)
+	if (mPfsImported == false)
 	{
-		throw fnd::Exception(kModuleName, "Corrupt Header");
+		// open minimum header to get full header size
+		scratch.alloc(sizeof(nx::sPfsHeader));
+		mFile->read(scratch.data(), 0, scratch.size());
+		if (validateHeaderMagic(((nx::sPfsHeader*)scratch.data())) == false)
+		{
+			throw fnd::Exception(kModuleName, "Corrupt Header");
+		}
+		size_t pfsHeaderSize = determineHeaderSize(((nx::sPfsHeader*)scratch.data()));
+		
+		// open minimum header to get full header size
+		scratch.alloc(pfsHeaderSize);
+		mFile->read(scratch.data(), 0, scratch.size());
+		mPfs.fromBytes(scratch.data(), scratch.size());
 	}
-	size_t pfsHeaderSize = determineHeaderSize(((nx::sPfsHeader*)scratch.data()));
-	
-	// open minimum header to get full header size
-	scratch.alloc(pfsHeaderSize);
-	mFile->read(scratch.data(), 0, scratch.size());
-	mPfs.fromBytes(scratch.data(), scratch.size());
 
 	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
 	{
@@ -52,10 +73,27 @@ void PfsProcess::process()
 		if (mListFs || _HAS_BIT(mCliOutputMode, OUTPUT_EXTENDED))
 			displayFs();
 	}
+
+	// NCAs are validated against the CNMT, this needs the keyset to read the meta NCA
+	mVerifyPassed = true;
+	mValidateContent = false;
+	if (mVerify && mKeyset != nullptr)
+	{
+		for (size_t i = 0; i < mPfs.getFileList().size(); i++)
+		{
+			if (isNcaFile(mPfs.getFileList()[i].name))
+				mValidateContent = true;
+		}
+	}
+
 	if (mPfs.getFsType() == mPfs.TYPE_HFS0 && mVerify)
 		validateHfs();
 	if (mExtract)
 		extractFs();
+	if (mProcessNca || mValidateContent)
+		processNcas();
+	if (mExtract)
+		mExtractor.close();
 }
 
 void PfsProcess::setInputFile(fnd::IFile* file, bool ownIFile)
@@ -64,6 +102,11 @@ void PfsProcess::setInputFile(fnd::IFile* file, bool ownIFile)
 	mOwnIFile = ownIFile;
 }
 
+void PfsProcess::setKeyset(const sKeyset* keyset)
+{
+	mKeyset = keyset;
+}
+
 void PfsProcess::setCliOutputMode(CliOutputMode type)
 {
 	mCliOutputMode = type;
@@ -74,27 +117,85 @@ void PfsProcess::setVerifyMode(bool verify)
 	mVerify = verify;
 }
 
+void PfsProcess::setVerifyHashMode(bool verify_hash)
+{
+	mVerifyHash = verify_hash;
+}
+
+void PfsProcess::setVerifyCache(VerifyCache* cache, const VerifyCache::sFileIdentity& identity)
+{
+	mVerifyCache = cache;
+	mFileIdentity = identity;
+}
+
 void PfsProcess::setMountPointName(const std::string& mount_name)
 {
 	mMountName = mount_name;
 }
 
+void PfsProcess::setPfsHeader(const nx::PfsHeader& hdr)
+{
+	mPfs = hdr;
+	mPfsImported = true;
+}
+
 void PfsProcess::setExtractPath(const std::string& path)
 {
 	mExtract = true;
 	mExtractPath = path;
 }
 
+void PfsProcess::setExtractFilter(const PathFilter& filter)
+{
+	mExtractFilter = filter;
+}
+
+void PfsProcess::setIncrementalExtract(bool incremental)
+{
+	mIncrementalExtract = incremental;
+}
+
+void PfsProcess::setExtractStorePath(const std::string& store_path)
+{
+	mExtractStorePath = store_path;
+}
+
+void PfsProcess::setExtractSourceTag(const std::string& tag)
+{
+	mExtractSourceTag = tag;
+}
+
 void PfsProcess::setListFs(bool list_fs)
 {
 	mListFs = list_fs;
 }
 
+void PfsProcess::setNcaProcessMode(bool process_nca)
+{
+	mProcessNca = process_nca;
+}
+
+void PfsProcess::setNcaExtractPath(const std::string& path)
+{
+	mNcaExtract = true;
+	mNcaExtractPath = path;
+}
+
+void PfsProcess::setJobNum(size_t job_num)
+{
+	mJobNum = job_num;
+}
+
 const nx::PfsHeader& PfsProcess::getPfsHeader() const
 {
 	return mPfs;
 }
 
+bool PfsProcess::isVerifyPassed() const
+{
+	return mVerifyPassed;
+}
+
 void PfsProcess::displayHeader()
 {
 	printf("[PartitionFS]\n");
@@ -146,44 +247,419 @@ void PfsProcess::validateHfs()
 	const fnd::List<nx::PfsHeader::sFile>& file = mPfs.getFileList();
 	for (size_t i = 0; i < file.size(); i++)
 	{
+		// NCAs are hashed in the content validation pass instead
+		if (mValidateContent && isNcaFile(file[i].name))
+			continue;
+
 		mCache.alloc(file[i].hash_protected_size);
 		mFile->read(mCache.data(), file[i].offset, file[i].hash_protected_size);
 		crypto::sha::Sha256(mCache.data(), file[i].hash_protected_size, hash.bytes);
 		if (hash != file[i].hash)
 		{
 			printf("[WARNING] HFS0 %s%s%s: FAIL (bad hash)\n", !mMountName.empty()? mMountName.c_str() : "", (!mMountName.empty() && mMountName.at(mMountName.length()-1) != '/' )? "/" : "", file[i].name.c_str());
+			mVerifyPassed = false;
 		}
 	}
 }
 
 void PfsProcess::extractFs()
 {
-	// allocate only when extractDir is invoked
-	mCache.alloc(kCacheSize);
+	// the extractor stays open for processNcas(), it is closed by process()
+	mExtractor.setCliOutputMode(mCliOutputMode);
+	mExtractor.setIncremental(mIncrementalExtract);
+	mExtractor.setStorePath(mExtractStorePath);
+	mExtractor.open(mExtractPath);
 
-	// make extract dir
-	fnd::io::makeDirectory(mExtractPath);
+	// files are extracted in the order they are stored
+	mFile->setAccessHint(fnd::IFile::ACCESS_SEQUENTIAL);
 
-	fnd::SimpleFile outFile;
 	const fnd::List<nx::PfsHeader::sFile>& file = mPfs.getFileList();
 
 	std::string file_path;
 	for (size_t i = 0; i < file.size(); i++)
 	{
+		if (mExtractFilter.isMatch(file[i].name) == false)
+			continue;
+
+		// NCAs being validated are extracted by the hashing pass, so they are only read once
+		if (mValidateContent && isNcaFile(file[i].name))
+			continue;
+
 		file_path.clear();
 		fnd::io::appendToPath(file_path, mExtractPath);
 		fnd::io::appendToPath(file_path, file[i].name);
 
-		if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
-			printf("extract=[%s]\n", file_path.c_str());
+		mExtractor.extractFile(mFile, file[i].offset, file[i].size, file[i].name, file_path, getExtractSourceTag(file[i]));
+	}
+
+	mFile->setAccessHint(fnd::IFile::ACCESS_NORMAL);
+}
+
+void PfsProcess::extractNca(fnd::IFile* file, const nx::PfsHeader::sFile& entry)
+{
+	if (mExtract == false || mExtractFilter.isMatch(entry.name) == false)
+		return;
+
+	std::string file_path;
+	fnd::io::appendToPath(file_path, mExtractPath);
+	fnd::io::appendToPath(file_path, entry.name);
+
+	// file is a view of the NCA alone
+	std::lock_guard<std::mutex> lock(mExtractorLock);
+	mExtractor.extractFile(file, 0, entry.size, entry.name, file_path, getExtractSourceTag(entry));
+}
+
+std::string PfsProcess::getExtractSourceTag(const nx::PfsHeader::sFile& file) const
+{
+	// a HFS0 entry hash covering the whole file identifies it by itself
+	if (mPfs.getFsType() == mPfs.TYPE_HFS0 && file.hash_protected_size == file.size)
+		return "hfs0:" + FileExtractor::getHashStr(file.hash);
+
+	if (mExtractSourceTag.empty())
+		return std::string();
+
+	return mExtractSourceTag + ":" + std::to_string(file.offset) + ":" + std::to_string(file.size);
+}
+
+void PfsProcess::processNcas()
+{
+	const fnd::List<nx::PfsHeader::sFile>& file = mPfs.getFileList();
+
+	if (mKeyset == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No keyset set.");
+	}
+
+	if (mNcaExtract)
+	{
+		fnd::io::makeDirectory(mNcaExtractPath);
+	}
+
+	// the NCAs are read through views of the one input file, so reads must be serialised
+	LockedIFile locked_file(mFile, SHARED_IFILE);
+
+	// the content records to validate against come from the CNMT in the meta NCA(s)
+	mContentInfo.clear();
+	if (mValidateContent)
+		importContentMeta(&locked_file);
+
+	struct sNcaResult
+	{
+		size_t index;
+		std::string output;
+		std::string error;
+		bool passed;
+	};
+	std::vector<sNcaResult> results;
+	for (size_t i = 0; i < file.size(); i++)
+	{
+		if (isNcaFile(file[i].name))
+		{
+			sNcaResult result;
+			result.index = i;
+			// only a task that ran to the end reports a pass
+			result.passed = false;
+			results.push_back(result);
+		}
+	}
+
+	// without output capture concurrent tasks would interleave their output
+	size_t job_num = mJobNum != 0 ? mJobNum : ThreadPool::getDefaultThreadNum();
+	if (OutputCapture::isSupported() == false)
+		job_num = 1;
+
+	{
+		ThreadPool pool(_MIN(job_num, results.size()));
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			sNcaResult* result = &results[i];
+			pool.enqueue([this, &locked_file, &file, result] {
+				OutputCapture capture;
+				capture.begin();
+				result->passed = processNca(&locked_file, file[result->index], result->error);
+				capture.end();
+				result->output = capture.getOutput();
+			});
+		}
+		pool.wait();
+	}
+
+	// print results in pfs order
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		OutputCapture::print(results[i].output);
+		if (results[i].error.empty() == false)
+		{
+			printf("[WARNING] NCA %s: FAIL (%s)\n", getMountedPath(file[results[i].index].name).c_str(), results[i].error.c_str());
+		}
+		if (results[i].passed == false || results[i].error.empty() == false)
+			mVerifyPassed = false;
+	}
 
-		outFile.open(file_path, outFile.Create);
-		mFile->seek(file[i].offset);
-		for (size_t j = 0; j < ((file[i].size / kCacheSize) + ((file[i].size % kCacheSize) != 0)); j++)
+	// report content the CNMT lists but the file system does not contain
+	for (size_t i = 0; i < mContentInfo.size(); i++)
+	{
+		if (file.hasElement(getContentIdStr(mContentInfo[i].nca_id) + ".nca") == false)
 		{
-			mFile->read(mCache.data(), _MIN(file[i].size - (kCacheSize * j),kCacheSize));
-			outFile.write(mCache.data(), _MIN(file[i].size - (kCacheSize * j),kCacheSize));
-		}		
-		outFile.close();
+			printf("[WARNING] NCA %s: FAIL (missing)\n", getMountedPath(getContentIdStr(mContentInfo[i].nca_id) + ".nca").c_str());
+			mVerifyPassed = false;
+		}
+	}
+}
+
+bool PfsProcess::processNca(fnd::IFile* file, const nx::PfsHeader::sFile& entry, std::string& error)
+{
+	bool passed = true;
+
+	OffsetAdjustedIFile view(file, SHARED_IFILE, entry.offset, entry.size);
+
+	VerifyCache::sFileIdentity identity = mFileIdentity;
+	identity.offset += entry.offset;
+
+	// a content check recorded for this exact NCA doesn't need the hashing pass
+	bool validate_content = mValidateContent;
+	sVerifyCacheEntry content_key;
+	bool has_content_key = false;
+	if (mValidateContent && mVerifyCache != nullptr)
+	{
+		uint64_t verify_time;
+		try
+		{
+			VerifyCache::generateNcaKey(&view, mKeyset, identity, verifycache::KIND_CONTENT, content_key);
+			has_content_key = true;
+			if (mVerifyCache->isVerified(content_key, verify_time))
+			{
+				validate_content = false;
+				if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+					printf("[INFO] NCA %s: OK (verified at %s, cached)\n", getMountedPath(entry.name).c_str(), VerifyCache::getTimeStr(verify_time).c_str());
+			}
+		}
+		catch (const fnd::Exception&)
+		{
+			// no key for an NCA with a corrupt header, it is validated (and fails) as normal
+		}
+	}
+
+	// when validating, the NcaProcess reads double as the hashing pass
+	HashingIFile hashed_view(&view, SHARED_IFILE);
+	if (mPfs.getFsType() == mPfs.TYPE_HFS0)
+		hashed_view.setPartialHashSize(entry.hash_protected_size);
+
+	try
+	{
+		// extracting first makes its sequential read the hashing pass, NcaProcess then reads hashed data
+		if (mValidateContent)
+			extractNca(validate_content ? (fnd::IFile*)&hashed_view : (fnd::IFile*)&view, entry);
+
+		if (mProcessNca)
+		{
+			NcaProcess nca;
+
+			nca.setInputFile(validate_content ? (fnd::IFile*)&hashed_view : (fnd::IFile*)&view, SHARED_IFILE);
+			nca.setKeyset(mKeyset);
+			nca.setCliOutputMode(mCliOutputMode);
+			nca.setVerifyMode(mVerify);
+			nca.setVerifyHashMode(mVerifyHash);
+			if (mVerifyCache != nullptr)
+				nca.setVerifyCache(mVerifyCache, identity);
+			nca.setListFs(mListFs);
+
+			if (mNcaExtract && mExtractFilter.mayMatchUnder(entry.name))
+			{
+				// extract each partition to <path>/<nca name>/<partition index>
+				std::string nca_path;
+				fnd::io::appendToPath(nca_path, mNcaExtractPath);
+				fnd::io::appendToPath(nca_path, entry.name.substr(0, entry.name.find('.')));
+				fnd::io::makeDirectory(nca_path);
+
+				std::string part_path[nx::nca::kPartitionNum];
+				for (size_t i = 0; i < nx::nca::kPartitionNum; i++)
+				{
+					fnd::io::appendToPath(part_path[i], nca_path);
+					fnd::io::appendToPath(part_path[i], std::to_string(i));
+				}
+				nca.setExtractFilter(mExtractFilter.getSubFilter(entry.name));
+				nca.setIncrementalExtract(mIncrementalExtract);
+				nca.setExtractStorePath(mExtractStorePath);
+				nca.setPartition0ExtractPath(part_path[0]);
+				nca.setPartition1ExtractPath(part_path[1]);
+				nca.setPartition2ExtractPath(part_path[2]);
+				nca.setPartition3ExtractPath(part_path[3]);
+			}
+
+			if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+			{
+				printf("[PartitionFS Content]\n");
+				printf("  Path:        %s\n", getMountedPath(entry.name).c_str());
+			}
+
+			nca.process();
+			passed = nca.isVerifyPassed();
+		}
+	}
+	catch (const fnd::Exception& e)
+	{
+		error = e.what();
+	}
+	catch (const std::exception& e)
+	{
+		error = e.what();
+	}
+
+	// a broken NCA is still worth validating against the CNMT
+	try
+	{
+		if (validate_content)
+		{
+			hashed_view.finalise();
+			bool ok = validateContent(entry, hashed_view.getHash(), hashed_view.getPartialHash());
+			if (has_content_key)
+				mVerifyCache->recordResult(content_key, ok);
+			passed &= ok;
+		}
+	}
+	catch (const fnd::Exception& e)
+	{
+		if (error.empty())
+			error = e.what();
+	}
+
+	return passed;
+}
+
+void PfsProcess::importContentMeta(fnd::IFile* file)
+{
+	static const std::string kCnmtExtention = ".cnmt";
+	const fnd::List<nx::PfsHeader::sFile>& file_list = mPfs.getFileList();
+
+	for (size_t i = 0; i < file_list.size(); i++)
+	{
+		if (isNcaFile(file_list[i].name) == false || file_list[i].name.find(kCnmtExtention) == std::string::npos)
+			continue;
+
+		// the meta NCA is only parsed here, anything it would print is discarded
+		OutputCapture capture;
+		capture.begin();
+		try
+		{
+			NcaProcess nca;
+			nca.setInputFile(new OffsetAdjustedIFile(file, SHARED_IFILE, file_list[i].offset, file_list[i].size), OWN_IFILE);
+			nca.setKeyset(mKeyset);
+			nca.setCliOutputMode(0);
+			nca.process();
+
+			fnd::IFile* partition = nca.getPartitionReader(0);
+			if (partition == nullptr)
+			{
+				throw fnd::Exception(kModuleName, "Meta NCA partition 0 not readable");
+			}
+
+			PfsProcess pfs;
+			pfs.setInputFile(partition, SHARED_IFILE);
+			pfs.setCliOutputMode(0);
+			pfs.process();
+
+			const fnd::List<nx::PfsHeader::sFile>& meta_files = pfs.getPfsHeader().getFileList();
+			size_t cnmt_num = 0;
+			for (size_t j = 0; j < meta_files.size(); j++)
+			{
+				const std::string& name = meta_files[j].name;
+				if (name.size() <= kCnmtExtention.size() || name.compare(name.size() - kCnmtExtention.size(), kCnmtExtention.size(), kCnmtExtention) != 0)
+					continue;
+
+				CnmtProcess cnmt;
+				cnmt.setInputFile(new OffsetAdjustedIFile(partition, SHARED_IFILE, meta_files[j].offset, meta_files[j].size), OWN_IFILE);
+				cnmt.setCliOutputMode(0);
+				cnmt.process();
+
+				const fnd::List<nx::ContentMetaBinary::ContentInfo>& info = cnmt.getContentMetaBinary().getContentInfo();
+				for (size_t k = 0; k < info.size(); k++)
+				{
+					mContentInfo.addElement(info[k]);
+				}
+				cnmt_num++;
+			}
+
+			if (cnmt_num == 0)
+			{
+				throw fnd::Exception(kModuleName, "Meta NCA contains no CNMT");
+			}
+			capture.end();
+		}
+		catch (const fnd::Exception& e)
+		{
+			capture.end();
+			printf("[WARNING] CNMT %s: FAIL (%s)\n", getMountedPath(file_list[i].name).c_str(), e.what());
+			mVerifyPassed = false;
+		}
+	}
+}
+
+bool PfsProcess::validateContent(const nx::PfsHeader::sFile& entry, const crypto::sha::sSha256Hash& hash, const crypto::sha::sSha256Hash& partial_hash)
+{
+	bool ok = true;
+
+	// the HFS0 hash covers the hash protected region, which was hashed in the same pass
+	if (mPfs.getFsType() == mPfs.TYPE_HFS0 && partial_hash != entry.hash)
+	{
+		printf("[WARNING] HFS0 %s: FAIL (bad hash)\n", getMountedPath(entry.name).c_str());
+		ok = false;
+	}
+
+	// the content id is the first half of the content hash
+	if (getContentIdStr(hash.bytes) != entry.name.substr(0, entry.name.find('.')))
+	{
+		printf("[WARNING] NCA %s: FAIL (content id does not match hash)\n", getMountedPath(entry.name).c_str());
+		ok = false;
+	}
+
+	// meta NCAs are not listed in their own CNMT
+	const nx::ContentMetaBinary::ContentInfo* info = nullptr;
+	for (size_t i = 0; i < mContentInfo.size(); i++)
+	{
+		if (getContentIdStr(mContentInfo[i].nca_id) + ".nca" == entry.name)
+		{
+			info = &mContentInfo[i];
+			break;
+		}
+	}
+	if (info == nullptr)
+		return ok;
+
+	if (info->size != entry.size)
+	{
+		printf("[WARNING] NCA %s: FAIL (size does not match CNMT)\n", getMountedPath(entry.name).c_str());
+		ok = false;
+	}
+	if (info->hash != hash)
+	{
+		printf("[WARNING] NCA %s: FAIL (hash does not match CNMT)\n", getMountedPath(entry.name).c_str());
+		ok = false;
+	}
+
+	return ok;
+}
+
+std::string PfsProcess::getMountedPath(const std::string& name) const
+{
+	std::string path;
+	if (mMountName.empty() == false)
+	{
+		path = mMountName;
+		if (mMountName.at(mMountName.length()-1) != '/')
+			path += "/";
+	}
+	return path + name;
+}
+
+std::string PfsProcess::getContentIdStr(const byte_t* id) const
+{
+	static const char kHexChars[] = "0123456789abcdef";
+	std::string str;
+	for (size_t i = 0; i < nx::cnmt::kContentIdLen; i++)
+	{
+		str += kHexChars[(id[i] >> 4) & 0xf];
+		str += kHexChars[id[i] & 0xf];
 	}
+	return str;
 }
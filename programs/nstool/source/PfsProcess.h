@@ -1,10 +1,16 @@
 #pragma once
 #include <string>
+#include <mutex>
 #include <fnd/types.h>
 #include <fnd/IFile.h>
+#include <fnd/List.h>
 #include <nx/PfsHeader.h>
+#include <nx/ContentMetaBinary.h>
 
 #include "nstool.h"
+#include "PathFilter.h"
+#include "FileExtractor.h"
+#include "VerifyCache.h"
 
 class PfsProcess
 {
@@ -16,15 +22,32 @@ public:
 
 	// generic
 	void setInputFile(fnd::IFile* file, bool ownIFile);
+	void setKeyset(const sKeyset* keyset);
 	void setCliOutputMode(CliOutputMode type);
 	void setVerifyMode(bool verify);
+	void setVerifyHashMode(bool verify_hash);
+	void setVerifyCache(VerifyCache* cache, const VerifyCache::sFileIdentity& identity);
 
 	// pfs specific
 	void setMountPointName(const std::string& mount_name);
+	// use a header already parsed from this file instead of reading it again
+	void setPfsHeader(const nx::PfsHeader& hdr);
 	void setExtractPath(const std::string& path);
+	void setExtractFilter(const PathFilter& filter);
+	void setIncrementalExtract(bool incremental);
+	void setExtractStorePath(const std::string& store_path);
+	// identity of the file system bytes, see FileExtractor
+	void setExtractSourceTag(const std::string& tag);
 	void setListFs(bool list_fs);
 
+	// nested nca processing
+	void setNcaProcessMode(bool process_nca);
+	void setNcaExtractPath(const std::string& path);
+	void setJobNum(size_t job_num);
+
 	const nx::PfsHeader& getPfsHeader() const;
+	// false if verify mode found a bad hash, or content (nested NCAs included) that failed validation
+	bool isVerifyPassed() const;
 
 private:
 	const std::string kModuleName = "PfsProcess";
@@ -32,17 +55,38 @@ private:
 
 	fnd::IFile* mFile;
 	bool mOwnIFile;
+	const sKeyset* mKeyset;
 	CliOutputMode mCliOutputMode;
 	bool mVerify;
+	bool mVerifyHash;
+	bool mVerifyPassed;
+	VerifyCache* mVerifyCache;
+	VerifyCache::sFileIdentity mFileIdentity;
 
 	std::string mExtractPath;
 	bool mExtract;
+	PathFilter mExtractFilter;
+	bool mIncrementalExtract;
+	std::string mExtractStorePath;
+	std::string mExtractSourceTag;
+	// with content validation the NCAs are extracted by their hashing pass, which may run on several threads
+	FileExtractor mExtractor;
+	std::mutex mExtractorLock;
 	std::string mMountName;
 	bool mListFs;
 
+	bool mProcessNca;
+	std::string mNcaExtractPath;
+	bool mNcaExtract;
+	size_t mJobNum;
+
+	bool mValidateContent;
+	fnd::List<nx::ContentMetaBinary::ContentInfo> mContentInfo;
+
 	fnd::Vec<byte_t> mCache;
 
 	nx::PfsHeader mPfs;
+	bool mPfsImported;
 
 	void displayHeader();
 	void displayFs();
@@ -50,4 +94,12 @@ private:
 	bool validateHeaderMagic(const nx::sPfsHeader* hdr);
 	void validateHfs();
 	void extractFs();
+	void extractNca(fnd::IFile* file, const nx::PfsHeader::sFile& entry);
+	std::string getExtractSourceTag(const nx::PfsHeader::sFile& file) const;
+	void processNcas();
+	bool processNca(fnd::IFile* file, const nx::PfsHeader::sFile& entry, std::string& error);
+	void importContentMeta(fnd::IFile* file);
+	bool validateContent(const nx::PfsHeader::sFile& entry, const crypto::sha::sSha256Hash& hash, const crypto::sha::sSha256Hash& partial_hash);
+	std::string getMountedPath(const std::string& name) const;
+	std::string getContentIdStr(const byte_t* id) const;
 };
\ No newline at end of file
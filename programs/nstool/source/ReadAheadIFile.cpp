@@ -0,0 +1,216 @@
+#include "ReadAheadIFile.h"
+#include <algorithm>
+#include <cstring>
+
+ReadAheadIFile::ReadAheadIFile(fnd::IFile* file, bool ownIFile, size_t chunk_num, size_t chunk_size) :
+	mOwnIFile(ownIFile),
+	mFile(file),
+	mChunkNum(chunk_num),
+	mChunkSize(chunk_size > 0 ? chunk_size : kDefaultChunkSize),
+	mSize(file->size()),
+	mPos(0),
+	mHint(ACCESS_NORMAL),
+	mLastReadEnd(0),
+	mSequentialNum(0),
+	mStop(false)
+{
+}
+
+ReadAheadIFile::~ReadAheadIFile()
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mStop = true;
+	}
+	mWorkCond.notify_all();
+	if (mThread.joinable())
+		mThread.join();
+
+	if (mOwnIFile)
+	{
+		delete mFile;
+	}
+}
+
+size_t ReadAheadIFile::size()
+{
+	return mSize;
+}
+
+void ReadAheadIFile::seek(size_t offset)
+{
+	mPos = offset;
+}
+
+void ReadAheadIFile::read(byte_t* out, size_t len)
+{
+	read(out, mPos, len);
+}
+
+void ReadAheadIFile::read(byte_t* out, size_t offset, size_t len)
+{
+	size_t done = readFromChunks(out, offset, len);
+
+	// whatever wasn't prefetched is read now
+	if (done < len)
+	{
+		std::lock_guard<std::mutex> lock(mFileLock);
+		mFile->read(out + done, offset + done, len - done);
+	}
+
+	std::unique_lock<std::mutex> lock(mLock);
+	mSequentialNum = (offset == mLastReadEnd) ? mSequentialNum + 1 : 0;
+	mLastReadEnd = offset + len;
+	bool sequential = mHint == ACCESS_SEQUENTIAL || (mHint == ACCESS_NORMAL && mSequentialNum >= kSequentialReadNum);
+	if (sequential && mChunkNum > 0)
+		schedule(offset + len);
+	else
+		dropChunks(offset + len);
+	lock.unlock();
+
+	mPos = offset + len;
+}
+
+void ReadAheadIFile::write(const byte_t* out, size_t len)
+{
+	throw fnd::Exception(kModuleName, "write() not supported");
+}
+
+void ReadAheadIFile::write(const byte_t* out, size_t offset, size_t len)
+{
+	throw fnd::Exception(kModuleName, "write() not supported");
+}
+
+void ReadAheadIFile::setAccessHint(AccessHint hint)
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mHint = hint;
+		if (hint == ACCESS_RANDOM)
+			dropChunks(mSize);
+	}
+
+	std::lock_guard<std::mutex> lock(mFileLock);
+	mFile->setAccessHint(hint);
+}
+
+void ReadAheadIFile::prefetch(size_t offset, size_t len)
+{
+	std::lock_guard<std::mutex> lock(mFileLock);
+	mFile->prefetch(offset, len);
+}
+
+size_t ReadAheadIFile::readFromChunks(byte_t* out, size_t offset, size_t len)
+{
+	std::unique_lock<std::mutex> lock(mLock);
+
+	size_t done = 0;
+	for (size_t i = 0; i < mChunks.size() && done < len; i++)
+	{
+		std::shared_ptr<sChunk> chunk = mChunks[i];
+		size_t pos = offset + done;
+		if (pos < chunk->offset)
+			break;
+		if (pos >= chunk->offset + chunk->len)
+			continue;
+
+		mReadyCond.wait(lock, [&chunk] { return chunk->state == CHUNK_READY || chunk->state == CHUNK_FAILED; });
+		// read it directly, so the error comes from the caller's own read
+		if (chunk->state == CHUNK_FAILED)
+			break;
+
+		size_t copy_len = _MIN(len - done, chunk->offset + chunk->len - pos);
+		memcpy(out + done, chunk->data.data() + (pos - chunk->offset), copy_len);
+		done += copy_len;
+	}
+
+	return done;
+}
+
+void ReadAheadIFile::schedule(size_t offset)
+{
+	// reads that left the prefetched range start a new one
+	if (mChunks.empty() == false && (offset < mChunks.front()->offset || offset > mChunks.back()->offset + mChunks.back()->len))
+		dropChunks(mSize);
+	dropChunks(offset);
+
+	size_t next = mChunks.empty() ? offset : mChunks.back()->offset + mChunks.back()->len;
+	while (mChunks.size() < mChunkNum && next < mSize)
+	{
+		std::shared_ptr<sChunk> chunk;
+		if (mFreeChunks.empty() == false)
+		{
+			chunk = mFreeChunks.back();
+			mFreeChunks.pop_back();
+		}
+		else
+		{
+			chunk = std::make_shared<sChunk>();
+			chunk->data.alloc(mChunkSize);
+		}
+
+		chunk->offset = next;
+		chunk->len = _MIN(mChunkSize, mSize - next);
+		chunk->state = CHUNK_PENDING;
+		mChunks.push_back(chunk);
+		next += chunk->len;
+	}
+
+	if (mThread.joinable() == false && mChunks.empty() == false)
+		mThread = std::thread(&ReadAheadIFile::prefetchMain, this);
+	mWorkCond.notify_one();
+}
+
+void ReadAheadIFile::dropChunks(size_t offset)
+{
+	while (mChunks.empty() == false && mChunks.front()->offset + mChunks.front()->len <= offset)
+	{
+		// a chunk still being read is recycled by the prefetch thread when it is done
+		if (mChunks.front().use_count() == 1)
+			mFreeChunks.push_back(mChunks.front());
+		mChunks.pop_front();
+	}
+}
+
+void ReadAheadIFile::prefetchMain()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	while (true)
+	{
+		std::shared_ptr<sChunk> chunk;
+		mWorkCond.wait(lock, [this, &chunk]
+		{
+			for (size_t i = 0; i < mChunks.size(); i++)
+			{
+				if (mChunks[i]->state == CHUNK_PENDING)
+				{
+					chunk = mChunks[i];
+					return true;
+				}
+			}
+			return mStop;
+		});
+		if (mStop)
+			break;
+
+		chunk->state = CHUNK_READING;
+		lock.unlock();
+
+		ChunkState state = CHUNK_READY;
+		try
+		{
+			std::lock_guard<std::mutex> file_lock(mFileLock);
+			mFile->read(chunk->data.data(), chunk->offset, chunk->len);
+		}
+		catch (const fnd::Exception&)
+		{
+			state = CHUNK_FAILED;
+		}
+
+		lock.lock();
+		chunk->state = state;
+		if (chunk.use_count() == 1)
+			mFreeChunks.push_back(chunk);
+		mReadyCond.notify_all();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+#include <memory>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fnd/IFile.h>
+#include <fnd/Vec.h>
+
+// Prefetches the chunks after a sequential read on a background thread, so the next
+// reads are served from memory while the caller decrypts and writes. A read that
+// continues where the previous two ended is sequential, as is every read while the
+// ACCESS_SEQUENTIAL hint is set; ACCESS_RANDOM turns prefetching off.
+// Chunk buffers are recycled, at most chunk_num chunks are held at once.
+class ReadAheadIFile : public fnd::IFile
+{
+public:
+	static const size_t kDefaultChunkSize = 0x100000;
+
+	ReadAheadIFile(fnd::IFile* file, bool ownIFile, size_t chunk_num, size_t chunk_size = kDefaultChunkSize);
+	~ReadAheadIFile();
+
+	size_t size();
+	void seek(size_t offset);
+	void read(byte_t* out, size_t len);
+	void read(byte_t* out, size_t offset, size_t len);
+	void write(const byte_t* out, size_t len);
+	void write(const byte_t* out, size_t offset, size_t len);
+	void setAccessHint(AccessHint hint);
+	void prefetch(size_t offset, size_t len);
+
+private:
+	const std::string kModuleName = "ReadAheadIFile";
+	static const size_t kSequentialReadNum = 2;
+
+	enum ChunkState
+	{
+		CHUNK_PENDING,
+		CHUNK_READING,
+		CHUNK_READY,
+		CHUNK_FAILED
+	};
+
+	struct sChunk
+	{
+		size_t offset;
+		size_t len;
+		ChunkState state;
+		fnd::Vec<byte_t> data;
+	};
+
+	bool mOwnIFile;
+	fnd::IFile* mFile;
+	size_t mChunkNum;
+	size_t mChunkSize;
+	size_t mSize;
+	size_t mPos;
+
+	// serialises reads of mFile between the caller and the prefetch thread
+	std::mutex mFileLock;
+
+	std::mutex mLock;
+	std::condition_variable mWorkCond;
+	std::condition_variable mReadyCond;
+	// contiguous chunks in offset order, shared with the prefetch thread while it reads one
+	std::deque<std::shared_ptr<sChunk>> mChunks;
+	std::vector<std::shared_ptr<sChunk>> mFreeChunks;
+	AccessHint mHint;
+	size_t mLastReadEnd;
+	size_t mSequentialNum;
+	bool mStop;
+	std::thread mThread;
+
+	size_t readFromChunks(byte_t* out, size_t offset, size_t len);
+	void schedule(size_t offset);
+	void dropChunks(size_t offset);
+	void prefetchMain();
+};
\ No newline at end of file
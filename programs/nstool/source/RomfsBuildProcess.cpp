@@ -0,0 +1,443 @@
+#include "RomfsBuildProcess.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <fnd/io.h>
+#include "AccessTrace.h"
+#include "RomfsProcess.h"
+
+RomfsBuildProcess::RomfsBuildProcess() :
+	mCliOutputMode(_BIT(OUTPUT_BASIC)),
+	mOrderedFileNum(0),
+	mDataSize(0)
+{
+}
+
+void RomfsBuildProcess::process()
+{
+	if (mInputPath.empty() || fnd::io::isDirectory(mInputPath) == false)
+	{
+		throw fnd::Exception(kModuleName, "Input path is not a directory.");
+	}
+	if (mOutputPath.empty())
+	{
+		throw fnd::Exception(kModuleName, "No output path set.");
+	}
+
+	// the root directory
+	mDirs.clear();
+	mFiles.clear();
+	sBuildDir root;
+	root.host_path = mInputPath;
+	root.parent = 0;
+	root.entry_offset = 0;
+	mDirs.push_back(root);
+	collectDirectory(0);
+
+	layoutData();
+	buildTables();
+	writeImage();
+
+	if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
+		displayInfo();
+}
+
+void RomfsBuildProcess::setInputPath(const std::string& path)
+{
+	mInputPath = path;
+}
+
+void RomfsBuildProcess::setOutputPath(const std::string& path)
+{
+	mOutputPath = path;
+}
+
+void RomfsBuildProcess::setFileOrderPath(const std::string& path)
+{
+	mFileOrderPath = path;
+}
+
+void RomfsBuildProcess::setCliOutputMode(CliOutputMode type)
+{
+	mCliOutputMode = type;
+}
+
+void RomfsBuildProcess::collectDirectory(size_t dir_index)
+{
+	fnd::List<std::string> dir_list, file_list;
+	fnd::io::getDirectoryListing(mDirs[dir_index].host_path, dir_list, file_list);
+
+	// name order, so the image is the same however the host file system lists them
+	std::vector<std::string> names;
+	for (size_t i = 0; i < file_list.size(); i++)
+		names.push_back(file_list[i]);
+	std::sort(names.begin(), names.end());
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		sBuildFile file;
+		file.name = names[i];
+		fnd::io::appendToPath(file.host_path, mDirs[dir_index].host_path);
+		fnd::io::appendToPath(file.host_path, names[i]);
+		file.romfs_path = mDirs[dir_index].romfs_path.empty() ? names[i] : mDirs[dir_index].romfs_path + "/" + names[i];
+		file.parent = dir_index;
+		file.size = fnd::io::getFileSize(file.host_path);
+		file.entry_offset = 0;
+		file.data_offset = 0;
+		mDirs[dir_index].files.push_back(mFiles.size());
+		mFiles.push_back(file);
+	}
+
+	names.clear();
+	for (size_t i = 0; i < dir_list.size(); i++)
+		names.push_back(dir_list[i]);
+	std::sort(names.begin(), names.end());
+	size_t first_child = mDirs.size();
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		sBuildDir dir;
+		dir.name = names[i];
+		fnd::io::appendToPath(dir.host_path, mDirs[dir_index].host_path);
+		fnd::io::appendToPath(dir.host_path, names[i]);
+		dir.romfs_path = mDirs[dir_index].romfs_path.empty() ? names[i] : mDirs[dir_index].romfs_path + "/" + names[i];
+		dir.parent = dir_index;
+		dir.entry_offset = 0;
+		mDirs[dir_index].dirs.push_back(mDirs.size());
+		mDirs.push_back(dir);
+	}
+
+	for (size_t i = first_child; i < first_child + names.size(); i++)
+		collectDirectory(i);
+}
+
+void RomfsBuildProcess::loadFileOrder(std::vector<std::string>& order)
+{
+	// an access trace, or a list of paths
+	{
+		fnd::SimpleFile file(mFileOrderPath, fnd::SimpleFile::Read);
+		sAccessTraceHeader hdr;
+		if (file.size() >= sizeof(sAccessTraceHeader))
+		{
+			file.read((byte_t*)&hdr, 0, sizeof(sAccessTraceHeader));
+			if (hdr.st_magic.get() == accesstrace::kAccessTraceStructMagic)
+			{
+				loadFileOrderFromTrace(order);
+				return;
+			}
+		}
+	}
+
+	std::vector<std::string> lines;
+	fnd::io::getLineList(mFileOrderPath, lines);
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		std::string line = lines[i];
+
+		// paths may be written as mounted (/a/b) or with windows separators
+		std::replace(line.begin(), line.end(), '\\', '/');
+		line = line.substr(line.find_first_not_of('/') == std::string::npos ? line.size() : line.find_first_not_of('/'));
+		order.push_back(line);
+	}
+}
+
+void RomfsBuildProcess::loadFileOrderFromTrace(std::vector<std::string>& order)
+{
+	struct sImageFile
+	{
+		uint64_t offset;
+		uint64_t size;
+		std::string path;
+	};
+
+	AccessTrace trace;
+	trace.load(mFileOrderPath);
+
+	// the files of each traced RomFS image, in offset order
+	std::vector<std::vector<sImageFile>> layer_files(trace.getLayerNum());
+	bool has_image = false;
+	for (size_t i = 0; i < trace.getLayerNum(); i++)
+	{
+		try
+		{
+			RomfsProcess romfs;
+			romfs.setInputFile(new fnd::SimpleFile(trace.getLayerName(i), fnd::SimpleFile::Read), OWN_IFILE);
+			romfs.setCliOutputMode(0);
+			romfs.process();
+
+			std::vector<std::pair<const RomfsProcess::sDirectory*, std::string>> dirs;
+			dirs.push_back(std::make_pair(&romfs.getRootDir(), std::string()));
+			while (dirs.empty() == false)
+			{
+				const RomfsProcess::sDirectory* dir = dirs.back().first;
+				std::string path = dirs.back().second;
+				dirs.pop_back();
+
+				for (size_t j = 0; j < dir->file_list.size(); j++)
+					layer_files[i].push_back({ dir->file_list[j].offset, dir->file_list[j].size, path.empty() ? dir->file_list[j].name : path + "/" + dir->file_list[j].name });
+				for (size_t j = 0; j < dir->dir_list.size(); j++)
+					dirs.push_back(std::make_pair(&dir->dir_list[j], path.empty() ? dir->dir_list[j].name : path + "/" + dir->dir_list[j].name));
+			}
+			std::sort(layer_files[i].begin(), layer_files[i].end(), [](const sImageFile& a, const sImageFile& b) { return a.offset < b.offset; });
+			has_image = true;
+		}
+		catch (const fnd::Exception&)
+		{
+			// not a RomFS image (or no longer there), its reads can't be attributed to files
+			layer_files[i].clear();
+		}
+	}
+
+	if (has_image == false)
+	{
+		throw fnd::Exception(kModuleName, "The access trace has no reads of a RomFS image (" + mFileOrderPath + ")");
+	}
+
+	// records are in the order they were first read
+	std::set<std::string> seen;
+	for (size_t i = 0; i < trace.getRecordNum(); i++)
+	{
+		sAccessTraceRecordEntry record = trace.getRecord(i);
+		const std::vector<sImageFile>& files = layer_files[record.layer_index.get()];
+		uint64_t begin = record.offset.get();
+		uint64_t end = begin + record.size.get();
+
+		// the first file that could end after the read begins
+		size_t j = std::upper_bound(files.begin(), files.end(), begin, [](uint64_t offset, const sImageFile& file) { return offset < file.offset; }) - files.begin();
+		if (j > 0)
+			j--;
+		for (; j < files.size() && files[j].offset < end; j++)
+		{
+			if (files[j].size == 0 || files[j].offset + files[j].size <= begin)
+				continue;
+			if (seen.insert(files[j].path).second)
+				order.push_back(files[j].path);
+		}
+	}
+}
+
+void RomfsBuildProcess::layoutData()
+{
+	// hot files first, in the order given, then the rest in table order
+	std::vector<size_t> data_order;
+	std::vector<bool> placed(mFiles.size(), false);
+	mOrderedFileNum = 0;
+	if (mFileOrderPath.empty() == false)
+	{
+		std::map<std::string, size_t> file_index;
+		for (size_t i = 0; i < mFiles.size(); i++)
+			file_index[mFiles[i].romfs_path] = i;
+
+		std::vector<std::string> order;
+		loadFileOrder(order);
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			std::map<std::string, size_t>::const_iterator itr = file_index.find(order[i]);
+			if (itr == file_index.end() || placed[itr->second])
+				continue;
+			data_order.push_back(itr->second);
+			placed[itr->second] = true;
+			mOrderedFileNum++;
+		}
+	}
+	for (size_t i = 0; i < mFiles.size(); i++)
+	{
+		if (placed[i] == false)
+			data_order.push_back(i);
+	}
+
+	// file offsets are relative to the data
+	uint64_t pos = 0;
+	for (size_t i = 0; i < data_order.size(); i++)
+	{
+		sBuildFile& file = mFiles[data_order[i]];
+		pos = align(pos, kFileDataAlign);
+		file.data_offset = pos;
+		pos += file.size;
+	}
+	mDataSize = pos;
+}
+
+void RomfsBuildProcess::buildTables()
+{
+	// entry offsets, in table order
+	uint32_t offset = 0;
+	for (size_t i = 0; i < mDirs.size(); i++)
+	{
+		mDirs[i].entry_offset = offset;
+		offset += (uint32_t)getEntrySize(sizeof(nx::sRomfsDirEntry), mDirs[i].name);
+	}
+	mDirTable.assign(offset, 0);
+
+	offset = 0;
+	for (size_t i = 0; i < mFiles.size(); i++)
+	{
+		mFiles[i].entry_offset = offset;
+		offset += (uint32_t)getEntrySize(sizeof(nx::sRomfsFileEntry), mFiles[i].name);
+	}
+	mFileTable.assign(offset, 0);
+
+	// hash buckets hold the offset of the last entry added to them, each entry links to the one before
+	mDirHashTable.assign(getHashTableEntryNum(mDirs.size()) * sizeof(uint32_t), 0xff);
+	mFileHashTable.assign(getHashTableEntryNum(mFiles.size()) * sizeof(uint32_t), 0xff);
+	le_uint32_t* dir_buckets = (le_uint32_t*)mDirHashTable.data();
+	le_uint32_t* file_buckets = (le_uint32_t*)mFileHashTable.data();
+	size_t dir_bucket_num = mDirHashTable.size() / sizeof(uint32_t);
+	size_t file_bucket_num = mFileHashTable.size() / sizeof(uint32_t);
+
+	for (size_t i = 0; i < mDirs.size(); i++)
+	{
+		const sBuildDir& dir = mDirs[i];
+		uint32_t parent_offset = mDirs[dir.parent].entry_offset;
+		nx::sRomfsDirEntry* entry = (nx::sRomfsDirEntry*)(mDirTable.data() + dir.entry_offset);
+
+		// siblings are the directories listed after this one in its parent
+		uint32_t sibling = nx::romfs::kInvalidAddr;
+		if (i != 0)
+		{
+			const std::vector<size_t>& siblings = mDirs[dir.parent].dirs;
+			std::vector<size_t>::const_iterator itr = std::find(siblings.begin(), siblings.end(), i);
+			if (itr + 1 != siblings.end())
+				sibling = mDirs[*(itr + 1)].entry_offset;
+		}
+
+		uint32_t bucket = calcPathHash(parent_offset, dir.name) % dir_bucket_num;
+		entry->parent = parent_offset;
+		entry->sibling = sibling;
+		entry->child = dir.dirs.empty() ? nx::romfs::kInvalidAddr : mDirs[dir.dirs.front()].entry_offset;
+		entry->file = dir.files.empty() ? nx::romfs::kInvalidAddr : mFiles[dir.files.front()].entry_offset;
+		entry->hash = dir_buckets[bucket].get();
+		entry->name_size = (uint32_t)dir.name.size();
+		memcpy(entry->name(), dir.name.data(), dir.name.size());
+		dir_buckets[bucket] = dir.entry_offset;
+	}
+
+	for (size_t i = 0; i < mDirs.size(); i++)
+	{
+		const std::vector<size_t>& files = mDirs[i].files;
+		for (size_t j = 0; j < files.size(); j++)
+		{
+			const sBuildFile& file = mFiles[files[j]];
+			nx::sRomfsFileEntry* entry = (nx::sRomfsFileEntry*)(mFileTable.data() + file.entry_offset);
+
+			uint32_t bucket = calcPathHash(mDirs[i].entry_offset, file.name) % file_bucket_num;
+			entry->parent = mDirs[i].entry_offset;
+			entry->sibling = (j + 1 < files.size()) ? mFiles[files[j + 1]].entry_offset : nx::romfs::kInvalidAddr;
+			entry->offset = file.data_offset;
+			entry->size = file.size;
+			entry->hash = file_buckets[bucket].get();
+			entry->name_size = (uint32_t)file.name.size();
+			memcpy(entry->name(), file.name.data(), file.name.size());
+			file_buckets[bucket] = file.entry_offset;
+		}
+	}
+
+	// the tables follow the file data, in header section order
+	uint64_t pos = align(kDataOffset + mDataSize, kEntryNameAlign);
+	const size_t section_size[nx::romfs::SECTION_NUM] = { mDirHashTable.size(), mDirTable.size(), mFileHashTable.size(), mFileTable.size() };
+	memset(&mHdr, 0, sizeof(nx::sRomfsHeader));
+	mHdr.header_size = sizeof(nx::sRomfsHeader);
+	for (size_t i = 0; i < nx::romfs::SECTION_NUM; i++)
+	{
+		mHdr.sections[i].offset = pos;
+		mHdr.sections[i].size = section_size[i];
+		pos += section_size[i];
+	}
+	mHdr.data_offset = kDataOffset;
+}
+
+void RomfsBuildProcess::writeImage()
+{
+	// a failed build leaves no partial image
+	fnd::io::replaceFile(mOutputPath, [this](fnd::SimpleFile& out) {
+		std::vector<byte_t> buffer(kCopyBufferSize);
+
+		// header, padded to the data
+		memset(buffer.data(), 0, kDataOffset);
+		memcpy(buffer.data(), &mHdr, sizeof(nx::sRomfsHeader));
+		out.write(buffer.data(), kDataOffset);
+
+		// file data, in data order
+		std::vector<const sBuildFile*> data_order;
+		for (size_t i = 0; i < mFiles.size(); i++)
+			data_order.push_back(&mFiles[i]);
+		std::sort(data_order.begin(), data_order.end(), [](const sBuildFile* a, const sBuildFile* b) { return a->data_offset < b->data_offset; });
+
+		uint64_t pos = kDataOffset;
+		for (size_t i = 0; i < data_order.size(); i++)
+		{
+			uint64_t padding = kDataOffset + data_order[i]->data_offset - pos;
+			memset(buffer.data(), 0, padding);
+			out.write(buffer.data(), padding);
+			writeFileData(out, *data_order[i], buffer);
+			pos = kDataOffset + data_order[i]->data_offset + data_order[i]->size;
+		}
+
+		// tables
+		uint64_t padding = mHdr.sections[nx::romfs::DIR_HASHMAP_TABLE].offset.get() - pos;
+		memset(buffer.data(), 0, padding);
+		out.write(buffer.data(), padding);
+		out.write(mDirHashTable.data(), mDirHashTable.size());
+		out.write(mDirTable.data(), mDirTable.size());
+		out.write(mFileHashTable.data(), mFileHashTable.size());
+		out.write(mFileTable.data(), mFileTable.size());
+	});
+}
+
+void RomfsBuildProcess::writeFileData(fnd::SimpleFile& out, const sBuildFile& file, std::vector<byte_t>& buffer)
+{
+	fnd::SimpleFile in(file.host_path, fnd::SimpleFile::Read);
+	if (in.size() != file.size)
+	{
+		throw fnd::Exception(kModuleName, "File changed while building (" + file.host_path + ")");
+	}
+
+	size_t copied = out.copyFrom(in, 0, file.size);
+	for (uint64_t pos = copied; pos < file.size; pos += buffer.size())
+	{
+		size_t len = (size_t)_MIN(file.size - pos, (uint64_t)buffer.size());
+		in.read(buffer.data(), pos, len);
+		out.write(buffer.data(), len);
+	}
+}
+
+void RomfsBuildProcess::displayInfo()
+{
+	printf("[RomFS Build]\n");
+	printf("  Output:         %s\n", mOutputPath.c_str());
+	// not counting the root, as RomfsProcess shows it
+	printf("  DirNum:         %" PRIu64 "\n", (uint64_t)mDirs.size() - 1);
+	printf("  FileNum:        %" PRIu64 "\n", (uint64_t)mFiles.size());
+	if (mFileOrderPath.empty() == false)
+		printf("  OrderedFileNum: %" PRIu64 "\n", (uint64_t)mOrderedFileNum);
+	printf("  DataSize:       0x%" PRIx64 "\n", mDataSize);
+	printf("  ImageSize:      0x%" PRIx64 "\n", mHdr.sections[nx::romfs::FILE_NODE_TABLE].offset.get() + mHdr.sections[nx::romfs::FILE_NODE_TABLE].size.get());
+}
+
+uint32_t RomfsBuildProcess::calcPathHash(uint32_t parent_offset, const std::string& name)
+{
+	uint32_t hash = parent_offset ^ 123456789;
+	for (size_t i = 0; i < name.size(); i++)
+	{
+		hash = (hash >> 5) | (hash << 27);
+		hash ^= (byte_t)name[i];
+	}
+	return hash;
+}
+
+uint32_t RomfsBuildProcess::getHashTableEntryNum(size_t entry_num)
+{
+	// a prime-ish bucket count, as made by the official tools
+	if (entry_num < 3)
+		return 3;
+	if (entry_num < 19)
+		return (uint32_t)entry_num | 1;
+
+	uint32_t count = (uint32_t)entry_num;
+	while (count % 2 == 0 || count % 3 == 0 || count % 5 == 0 || count % 7 == 0 || count % 11 == 0 || count % 13 == 0 || count % 17 == 0)
+		count++;
+	return count;
+}
+
+size_t RomfsBuildProcess::getEntrySize(size_t entry_struct_size, const std::string& name)
+{
+	return entry_struct_size + align(name.size(), kEntryNameAlign);
+}
\ No newline at end of file
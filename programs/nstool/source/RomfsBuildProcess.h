@@ -0,0 +1,85 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fnd/types.h>
+#include <fnd/SimpleFile.h>
+#include <nx/romfs.h>
+
+#include "nstool.h"
+
+// Builds a RomFS image from a directory tree. Directories and files are listed in name
+// order; file data is laid out in the same order, or hot-first when a file order is set:
+// either a text file of RomFS paths (one per line), or an access trace of RomFS images
+// (files are ordered by when they were first read). File data is copied in chunks
+// (or without passing through user space, where supported), never whole.
+class RomfsBuildProcess
+{
+public:
+	RomfsBuildProcess();
+
+	void process();
+
+	void setInputPath(const std::string& path);
+	void setOutputPath(const std::string& path);
+	void setFileOrderPath(const std::string& path);
+	void setCliOutputMode(CliOutputMode type);
+
+private:
+	const std::string kModuleName = "RomfsBuildProcess";
+	static const uint64_t kDataOffset = nx::romfs::kRomfsHeaderAlign;
+	static const uint64_t kFileDataAlign = 0x10;
+	static const size_t kEntryNameAlign = 4;
+	static const size_t kCopyBufferSize = 0x100000;
+
+	struct sBuildDir
+	{
+		std::string name;
+		std::string host_path;
+		std::string romfs_path;
+		size_t parent;
+		std::vector<size_t> dirs;
+		std::vector<size_t> files;
+		uint32_t entry_offset;
+	};
+
+	struct sBuildFile
+	{
+		std::string name;
+		std::string host_path;
+		std::string romfs_path;
+		size_t parent;
+		uint64_t size;
+		uint32_t entry_offset;
+		uint64_t data_offset;
+	};
+
+	std::string mInputPath;
+	std::string mOutputPath;
+	std::string mFileOrderPath;
+	CliOutputMode mCliOutputMode;
+
+	// in table order, the root directory first
+	std::vector<sBuildDir> mDirs;
+	std::vector<sBuildFile> mFiles;
+	size_t mOrderedFileNum;
+	uint64_t mDataSize;
+
+	nx::sRomfsHeader mHdr;
+	std::vector<byte_t> mDirHashTable;
+	std::vector<byte_t> mDirTable;
+	std::vector<byte_t> mFileHashTable;
+	std::vector<byte_t> mFileTable;
+
+	void collectDirectory(size_t dir_index);
+	void loadFileOrder(std::vector<std::string>& order);
+	void loadFileOrderFromTrace(std::vector<std::string>& order);
+	void layoutData();
+	void buildTables();
+	void writeImage();
+	void writeFileData(fnd::SimpleFile& out, const sBuildFile& file, std::vector<byte_t>& buffer);
+	void displayInfo();
+
+	static uint32_t calcPathHash(uint32_t parent_offset, const std::string& name);
+	static uint32_t getHashTableEntryNum(size_t entry_num);
+	static size_t getEntrySize(size_t entry_struct_size, const std::string& name);
+};
\ No newline at end of file
@@ -10,6 +10,7 @@ RomfsProcess::RomfsProcess() :
 	mVerify(false),
 	mExtractPath(),
 	mExtract(false),
+	mIncrementalExtract(false),
 	mMountName(),
 	mListFs(false),
 	mDirNum(0),
@@ -73,6 +74,26 @@ void RomfsProcess::setExtractPath(const std::string& path)
 	mExtractPath = path;
 }
 
+void RomfsProcess::setExtractFilter(const PathFilter& filter)
+{
+	mExtractFilter = filter;
+}
+
+void RomfsProcess::setIncrementalExtract(bool incremental)
+{
+	mIncrementalExtract = incremental;
+}
+
+void RomfsProcess::setExtractStorePath(const std::string& store_path)
+{
+	mExtractStorePath = store_path;
+}
+
+void RomfsProcess::setExtractSourceTag(const std::string& tag)
+{
+	mExtractSourceTag = tag;
+}
+
 void RomfsProcess::setListFs(bool list_fs)
 {
 	mListFs = list_fs;
@@ -134,8 +155,34 @@ void RomfsProcess::displayFs()
 	displayDir(mRootDir, 1);
 }
 
-void RomfsProcess::extractDir(const std::string& path, const sDirectory& dir)
+bool RomfsProcess::hasFilteredFile(const sDirectory& dir, const std::string& virtual_path) const
 {
+	if (mExtractFilter.mayMatchUnder(virtual_path) == false)
+		return false;
+
+	std::string prefix = virtual_path.empty() ? std::string() : virtual_path + "/";
+	for (size_t i = 0; i < dir.file_list.size(); i++)
+	{
+		if (mExtractFilter.isMatch(prefix + dir.file_list[i].name))
+			return true;
+	}
+	for (size_t i = 0; i < dir.dir_list.size(); i++)
+	{
+		if (hasFilteredFile(dir.dir_list[i], prefix + dir.dir_list[i].name))
+			return true;
+	}
+
+	return false;
+}
+
+void RomfsProcess::extractDir(const std::string& path, const sDirectory& dir, const std::string& virtual_path)
+{
+	// with a filter, directories holding no wanted files are neither created nor traversed
+	if (mExtractFilter.isActive() && hasFilteredFile(dir, virtual_path) == false)
+		return;
+
+	std::string virtual_prefix = virtual_path.empty() ? std::string() : virtual_path + "/";
+
 	std::string dir_path;
 	std::string file_path;
 
@@ -148,38 +195,40 @@ void RomfsProcess::extractDir(const std::string& path, const sDirectory& dir)
 	fnd::io::makeDirectory(dir_path);
 
 	// extract files
-	fnd::SimpleFile outFile;
 	for (size_t i = 0; i < dir.file_list.size(); i++)
 	{
+		if (mExtractFilter.isMatch(virtual_prefix + dir.file_list[i].name) == false)
+			continue;
+
 		file_path.clear();
 		fnd::io::appendToPath(file_path, dir_path);
 		fnd::io::appendToPath(file_path, dir.file_list[i].name);
 
-		if (_HAS_BIT(mCliOutputMode, OUTPUT_BASIC))
-			printf("extract=[%s]\n", file_path.c_str());	
-		
-		outFile.open(file_path, outFile.Create);
-		mFile->seek(dir.file_list[i].offset);
-		for (size_t j = 0; j < ((dir.file_list[i].size / kCacheSize) + ((dir.file_list[i].size % kCacheSize) != 0)); j++)
-		{
-			mFile->read(mCache.data(), _MIN(dir.file_list[i].size - (kCacheSize * j),kCacheSize));
-			outFile.write(mCache.data(), _MIN(dir.file_list[i].size - (kCacheSize * j),kCacheSize));
-		}	
-		outFile.close();
+		const sFile& file = dir.file_list[i];
+		std::string source_tag = mExtractSourceTag.empty() ? std::string() : mExtractSourceTag + ":" + std::to_string(file.offset) + ":" + std::to_string(file.size);
+		mExtractor.extractFile(mFile, file.offset, file.size, virtual_prefix + file.name, file_path, source_tag);
 	}
 
 	for (size_t i = 0; i < dir.dir_list.size(); i++)
 	{
-		extractDir(dir_path, dir.dir_list[i]);
+		extractDir(dir_path, dir.dir_list[i], virtual_prefix + dir.dir_list[i].name);
 	}
 }
 
 
 void RomfsProcess::extractFs()
 {
-	// allocate only when extractDir is invoked
-	mCache.alloc(kCacheSize);
-	extractDir(mExtractPath, mRootDir);
+	mExtractor.setCliOutputMode(mCliOutputMode);
+	mExtractor.setIncremental(mIncrementalExtract);
+	mExtractor.setStorePath(mExtractStorePath);
+	mExtractor.open(mExtractPath);
+
+	// file data is laid out in directory tree order, which is the order it's extracted in
+	mFile->setAccessHint(fnd::IFile::ACCESS_SEQUENTIAL);
+	extractDir(mExtractPath, mRootDir, std::string());
+	mFile->setAccessHint(fnd::IFile::ACCESS_NORMAL);
+
+	mExtractor.close();
 }
 
 bool RomfsProcess::validateHeaderLayout(const nx::sRomfsHeader* hdr) const
@@ -263,15 +312,17 @@ void RomfsProcess::resolveRomfs()
 		throw fnd::Exception(kModuleName, "Invalid ROMFS Header");
 	}
 
-	// read directory nodes
+	// read directory and file nodes together
 	mDirNodes.alloc(mHdr.sections[nx::romfs::DIR_NODE_TABLE].size.get());
-	mFile->read(mDirNodes.data(), mHdr.sections[nx::romfs::DIR_NODE_TABLE].offset.get(), mDirNodes.size());
+	mFileNodes.alloc(mHdr.sections[nx::romfs::FILE_NODE_TABLE].size.get());
+	const fnd::IFile::sReadRange node_tables[2] =
+	{
+		{ mDirNodes.data(), mHdr.sections[nx::romfs::DIR_NODE_TABLE].offset.get(), mDirNodes.size() },
+		{ mFileNodes.data(), mHdr.sections[nx::romfs::FILE_NODE_TABLE].offset.get(), mFileNodes.size() }
+	};
+	mFile->readv(node_tables, 2);
 	//printf("[RAW DIR NODES]\n");
 	//fnd::SimpleTextOutput::hxdStyleDump(mDirNodes.data(), mDirNodes.size());
-
-	// read file nodes
-	mFileNodes.alloc(mHdr.sections[nx::romfs::FILE_NODE_TABLE].size.get());
-	mFile->read(mFileNodes.data(), mHdr.sections[nx::romfs::FILE_NODE_TABLE].offset.get(), mFileNodes.size());
 	//printf("[RAW FILE NODES]\n");
 	//fnd::SimpleTextOutput::hxdStyleDump(mFileNodes.data(), mFileNodes.size());
 	
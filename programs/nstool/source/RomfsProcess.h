@@ -7,6 +7,8 @@
 #include <nx/romfs.h>
 
 #include "nstool.h"
+#include "PathFilter.h"
+#include "FileExtractor.h"
 
 class RomfsProcess
 {
@@ -89,12 +91,16 @@ public:
 	// romfs specific
 	void setMountPointName(const std::string& mount_name);
 	void setExtractPath(const std::string& path);
+	void setExtractFilter(const PathFilter& filter);
+	void setIncrementalExtract(bool incremental);
+	void setExtractStorePath(const std::string& store_path);
+	// identity of the RomFS image bytes, see FileExtractor
+	void setExtractSourceTag(const std::string& tag);
 	void setListFs(bool list_fs);
 
 	const sDirectory& getRootDir() const;
 private:
 	const std::string kModuleName = "RomfsProcess";
-	static const size_t kCacheSize = 0x10000;
 
 	fnd::IFile* mFile;
 	bool mOwnIFile;
@@ -103,11 +109,14 @@ private:
 
 	std::string mExtractPath;
 	bool mExtract;
+	PathFilter mExtractFilter;
+	bool mIncrementalExtract;
+	std::string mExtractStorePath;
+	std::string mExtractSourceTag;
+	FileExtractor mExtractor;
 	std::string mMountName;
 	bool mListFs;
 
-	fnd::Vec<byte_t> mCache;
-
 	size_t mDirNum;
 	size_t mFileNum;
 	nx::sRomfsHeader mHdr;
@@ -126,7 +135,8 @@ private:
 	void displayHeader();
 	void displayFs();
 
-	void extractDir(const std::string& path, const sDirectory& dir);
+	bool hasFilteredFile(const sDirectory& dir, const std::string& virtual_path) const;
+	void extractDir(const std::string& path, const sDirectory& dir, const std::string& virtual_path);
 	void extractFs();
 
 	bool validateHeaderLayout(const nx::sRomfsHeader* hdr) const;
@@ -0,0 +1,579 @@
+#include "ServerProcess.h"
+#include <iostream>
+#include <thread>
+#include <future>
+#include <fnd/io.h>
+#include <fnd/SimpleFile.h>
+#include <fnd/AsyncWriteFile.h>
+#include <fnd/Vec.h>
+#include "FileProcess.h"
+#include "OutputCapture.h"
+#include "version.h"
+
+#ifndef _WIN32
+#include <csignal>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+ServerProcess::ServerProcess() :
+	mUserSettings(nullptr),
+	mSocketPath(),
+	mJobNum(0),
+	mVerifyCache(nullptr),
+	mStop(false),
+	mListenSocket(-1)
+{
+}
+
+ServerProcess::~ServerProcess()
+{
+}
+
+void ServerProcess::process()
+{
+	if (mUserSettings == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No user settings set.");
+	}
+
+	if (mSocketPath == kStdioPath)
+		serveStdio();
+	else
+		serveSocket();
+}
+
+void ServerProcess::setUserSettings(const UserSettings* user_set)
+{
+	mUserSettings = user_set;
+}
+
+void ServerProcess::setSocketPath(const std::string& path)
+{
+	mSocketPath = path;
+}
+
+void ServerProcess::setJobNum(size_t job_num)
+{
+	mJobNum = job_num;
+}
+
+void ServerProcess::setExtractRoot(const std::string& path)
+{
+	mExtractRoot = path;
+}
+
+void ServerProcess::setVerifyCache(VerifyCache* cache)
+{
+	mVerifyCache = cache;
+}
+
+void ServerProcess::serveStdio()
+{
+	// requests are answered in order, responses are only ever written by this thread
+	// while everything the processes print is captured, so stdout stays line-delimited JSON
+	std::string line;
+	while (mStop == false && std::getline(std::cin, line))
+	{
+		if (line.empty() || line == "\r")
+			continue;
+
+		OutputCapture::print(handleRequest(line) + "\n");
+	}
+}
+
+void ServerProcess::serveSocket()
+{
+#ifdef _WIN32
+	throw fnd::Exception(kModuleName, "Server mode is only supported on stdin/stdout on this platform");
+#else
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (mSocketPath.size() >= sizeof(addr.sun_path))
+	{
+		throw fnd::Exception(kModuleName, "Socket path is too long");
+	}
+	strncpy(addr.sun_path, mSocketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+	// a client disconnecting early must not end the server
+	signal(SIGPIPE, SIG_IGN);
+
+	mListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (mListenSocket < 0)
+	{
+		throw fnd::Exception(kModuleName, "Failed to create socket");
+	}
+
+	// a socket left behind by a previous instance would make bind() fail
+	unlink(mSocketPath.c_str());
+	if (bind(mListenSocket, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(mListenSocket, 16) != 0)
+	{
+		close(mListenSocket);
+		mListenSocket = -1;
+		throw fnd::Exception(kModuleName, "Failed to listen on \"" + mSocketPath + "\"");
+	}
+
+	{
+		// connections only hold a thread while they are open, a worker only while a request runs
+		ThreadPool pool(mJobNum != 0 ? mJobNum : ThreadPool::getDefaultThreadNum());
+
+		while (mStop == false)
+		{
+			int client = accept(mListenSocket, nullptr, nullptr);
+			if (client < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mClientLock);
+				if (mStop)
+				{
+					close(client);
+					break;
+				}
+				mClientSockets.insert(client);
+			}
+
+			std::thread(&ServerProcess::serveClient, this, client, &pool).detach();
+		}
+
+		// the pool must outlive every connection thread
+		std::unique_lock<std::mutex> lock(mClientLock);
+		mClientDone.wait(lock, [this] { return mClientSockets.empty(); });
+	}
+
+	close(mListenSocket);
+	mListenSocket = -1;
+	unlink(mSocketPath.c_str());
+#endif
+}
+
+void ServerProcess::serveClient(int client, ThreadPool* pool)
+{
+#ifndef _WIN32
+	std::string buffer;
+	char chunk[0x1000];
+	bool connected = true;
+
+	while (connected && mStop == false)
+	{
+		ssize_t len = recv(client, chunk, sizeof(chunk), 0);
+		if (len <= 0)
+			break;
+		buffer.append(chunk, len);
+
+		size_t pos;
+		while (connected && (pos = buffer.find('\n')) != std::string::npos)
+		{
+			std::string line = buffer.substr(0, pos);
+			buffer.erase(0, pos + 1);
+			if (line.empty() || line == "\r")
+				continue;
+
+			std::string response = dispatchRequest(line, pool) + "\n";
+			for (size_t sent = 0; sent < response.size();)
+			{
+				ssize_t ret = send(client, response.data() + sent, response.size() - sent, 0);
+				if (ret <= 0)
+				{
+					connected = false;
+					break;
+				}
+				sent += ret;
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mClientLock);
+		mClientSockets.erase(client);
+		// notified under the lock, the server may be gone as soon as it is released
+		mClientDone.notify_all();
+	}
+	close(client);
+#endif
+}
+
+std::string ServerProcess::dispatchRequest(const std::string& line, ThreadPool* pool)
+{
+	// the connection thread waits for the response, so responses keep the order of the requests
+	std::shared_ptr<std::promise<std::string>> response = std::make_shared<std::promise<std::string>>();
+	std::future<std::string> result = response->get_future();
+
+	pool->enqueue([this, line, response, pool] {
+		try
+		{
+			std::unique_lock<std::mutex> lock(mRequestLock, std::defer_lock);
+			if (pool->getThreadNum() == 1)
+				lock.lock();
+			response->set_value(handleRequest(line));
+		}
+		catch (...)
+		{
+			response->set_exception(std::current_exception());
+		}
+	});
+
+	try
+	{
+		return result.get();
+	}
+	catch (const std::exception& e)
+	{
+		JsonMessage error;
+		error.setRaw("id", "null");
+		error.setBool("ok", false);
+		error.setString("error", e.what());
+		return error.toString();
+	}
+}
+
+void ServerProcess::stop()
+{
+	mStop = true;
+
+#ifndef _WIN32
+	// wake up accept() and any client threads blocked in recv()
+	std::lock_guard<std::mutex> lock(mClientLock);
+	if (mListenSocket >= 0)
+		shutdown(mListenSocket, SHUT_RDWR);
+	for (std::set<int>::iterator itr = mClientSockets.begin(); itr != mClientSockets.end(); itr++)
+		shutdown(*itr, SHUT_RD);
+#endif
+}
+
+std::string ServerProcess::handleRequest(const std::string& line)
+{
+	JsonMessage response;
+	response.setRaw("id", "null");
+
+	// anything the processes print belongs to this request, not the stdio protocol
+	OutputCapture capture;
+	capture.begin();
+
+	try
+	{
+		JsonMessage req;
+		req.fromString(line);
+		if (req.hasMember("id"))
+			response.setRaw("id", req.getJson("id"));
+
+		std::string op = req.getString("op");
+		JsonMessage result;
+		if (op == "ping")
+			result.setString("version", std::to_string(VER_MAJOR) + "." + std::to_string(VER_MINOR));
+		else if (op == "stat")
+			opStat(req, result);
+		else if (op == "list")
+			opList(req, result);
+		else if (op == "read")
+			opRead(req, result);
+		else if (op == "extract")
+			opExtract(req, result);
+		else if (op == "verify")
+			opVerify(req, result);
+		else if (op == "shutdown")
+			stop();
+		else
+			throw fnd::Exception(kModuleName, "Unknown op \"" + op + "\"");
+
+		response.setBool("ok", true);
+		response.setRaw("result", result.toString());
+	}
+	catch (const fnd::Exception& e)
+	{
+		response.setBool("ok", false);
+		response.setString("error", e.what());
+	}
+	catch (const std::exception& e)
+	{
+		// e.g. bad_alloc for a huge entry, the request fails but the server keeps answering
+		response.setBool("ok", false);
+		response.setString("error", e.what());
+	}
+
+	// every way out of the try block ends up here, the capture must not outlive the request
+	capture.end();
+	return response.toString();
+}
+
+std::shared_ptr<ContainerFs> ServerProcess::openContainer(const std::string& path)
+{
+	uint64_t size = fnd::io::getFileSize(path);
+	uint64_t mtime = fnd::io::getFileModifiedTime(path);
+
+	std::lock_guard<std::mutex> lock(mContainerLock);
+
+	for (std::list<sOpenContainer>::iterator itr = mContainers.begin(); itr != mContainers.end(); itr++)
+	{
+		if (itr->path != path)
+			continue;
+
+		// a file replaced since it was mounted is mounted again
+		if (itr->size != size || itr->mtime != mtime)
+		{
+			mContainers.erase(itr);
+			break;
+		}
+
+		mContainers.splice(mContainers.begin(), mContainers, itr);
+		return mContainers.front().fs;
+	}
+
+	sOpenContainer container;
+	container.path = path;
+	container.size = size;
+	container.mtime = mtime;
+	container.fs = std::make_shared<ContainerFs>();
+	container.fs->open(path, mUserSettings);
+
+	mContainers.push_front(container);
+	// clients still using an evicted container keep it alive until they finish
+	while (mContainers.size() > kMaxOpenContainerNum)
+		mContainers.pop_back();
+
+	return container.fs;
+}
+
+void ServerProcess::opStat(const JsonMessage& req, JsonMessage& result)
+{
+	std::string path, entry;
+	getRequestPath(req, path, entry);
+
+	std::shared_ptr<ContainerFs> fs = openContainer(path);
+	setEntryMembers(fs->getEntry(entry), result);
+}
+
+void ServerProcess::opList(const JsonMessage& req, JsonMessage& result)
+{
+	std::string path, entry;
+	getRequestPath(req, path, entry);
+
+	std::shared_ptr<ContainerFs> fs = openContainer(path);
+	std::vector<ContainerFs::sEntry> entries = fs->listDir(entry);
+
+	std::string list = "[";
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		JsonMessage entry;
+		setEntryMembers(entries[i], entry);
+		if (i != 0)
+			list += ",";
+		list += entry.toString();
+	}
+	list += "]";
+
+	result.setRaw("entries", list);
+}
+
+void ServerProcess::opRead(const JsonMessage& req, JsonMessage& result)
+{
+	std::string path, entry;
+	getRequestPath(req, path, entry);
+
+	std::shared_ptr<ContainerFs> fs = openContainer(path);
+
+	uint64_t offset = req.hasMember("offset") ? req.getUInt("offset") : 0;
+	uint64_t size = req.hasMember("size") ? req.getUInt("size") : fs->getEntry(entry).size;
+	if (size > kMaxReadSize)
+	{
+		throw fnd::Exception(kModuleName, "Read size exceeds the maximum of " + std::to_string(kMaxReadSize) + " bytes");
+	}
+
+	fnd::Vec<byte_t> data;
+	data.alloc((size_t)size);
+	size_t read_size = fs->readFile(entry, offset, (size_t)size, data.data());
+
+	result.setUInt("offset", offset);
+	result.setUInt("size", read_size);
+	result.setString("data", encodeBase64(data.data(), read_size));
+}
+
+void ServerProcess::opExtract(const JsonMessage& req, JsonMessage& result)
+{
+	std::string path, entry;
+	getRequestPath(req, path, entry);
+
+	// clients may only write below the directory the server was started with
+	if (mExtractRoot.empty())
+		throw fnd::Exception(kModuleName, "Extract is disabled, the server was started without --serverout");
+	std::string out = req.getString("out");
+	if (isRelativeSubPath(out) == false)
+		throw fnd::Exception(kModuleName, "\"out\" must be a relative path without \"..\" (\"" + out + "\")");
+
+	std::string out_path;
+	fnd::io::appendToPath(out_path, mExtractRoot);
+	fnd::io::appendToPath(out_path, out);
+
+	std::shared_ptr<ContainerFs> fs = openContainer(path);
+
+	uint64_t file_num = 0;
+	uint64_t byte_num = 0;
+	extractEntry(*fs, entry, out_path, file_num, byte_num);
+
+	result.setUInt("files", file_num);
+	result.setUInt("bytes", byte_num);
+}
+
+void ServerProcess::opVerify(const JsonMessage& req, JsonMessage& result)
+{
+	std::string path, entry;
+	getRequestPath(req, path, entry);
+
+	// the process output is returned to the client, the request capture holds it
+	OutputCapture capture;
+	capture.begin();
+
+	bool passed = true;
+
+	if (entry.empty())
+	{
+		// verified straight from the file, so results can be recorded in the verify cache
+		FileProcess obj;
+		obj.setInputFile(mUserSettings->openInputFile(path), OWN_IFILE);
+		obj.setInputPath(path);
+		obj.setFileType(mUserSettings->determineFileTypeFromFile(path));
+		obj.setUserSettings(mUserSettings);
+		obj.setVerifyMode(true);
+		if (mVerifyCache != nullptr)
+			obj.setVerifyCache(mVerifyCache);
+		obj.process();
+		passed = obj.isVerifyPassed();
+	}
+	else
+	{
+		std::shared_ptr<ContainerFs> fs = openContainer(path);
+		const UserSettings* user_set = mUserSettings;
+		fs->accessFile(entry, [user_set, &passed](fnd::IFile* file, FileType type) {
+			FileProcess obj;
+			obj.setInputFile(file, SHARED_IFILE);
+			obj.setFileType(type);
+			obj.setUserSettings(user_set);
+			obj.setVerifyMode(true);
+			obj.process();
+			passed = obj.isVerifyPassed();
+		});
+	}
+
+	capture.end();
+
+	result.setBool("passed", passed);
+	result.setString("output", capture.getOutput());
+}
+
+void ServerProcess::extractEntry(ContainerFs& fs, const std::string& entry, const std::string& out_path, uint64_t& file_num, uint64_t& byte_num)
+{
+	ContainerFs::sEntry info = fs.getEntry(entry);
+
+	// the container itself is unpacked, nested containers are extracted as files
+	if (info.is_dir || entry.empty())
+	{
+		fnd::io::makeDirectory(out_path);
+
+		std::vector<ContainerFs::sEntry> children = fs.listDir(entry);
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			// names come from the container, a crafted one must not lead out of out_path
+			if (isPlainEntryName(children[i].name) == false)
+				throw fnd::Exception(kModuleName, "Entry \"" + children[i].name + "\" can't be extracted (not a plain file name)");
+
+			std::string child_out;
+			fnd::io::appendToPath(child_out, out_path);
+			fnd::io::appendToPath(child_out, children[i].name);
+			extractEntry(fs, entry.empty() ? children[i].name : entry + "/" + children[i].name, child_out, file_num, byte_num);
+		}
+		return;
+	}
+
+	fnd::Vec<byte_t> block;
+	block.alloc((size_t)_MIN(info.size, kExtractBlockSize));
+
+	fnd::AsyncWriteFile out_file;
+	out_file.open(out_path, (size_t)_MIN(info.size, fnd::AsyncWriteFile::kDefaultBufferSize));
+	for (uint64_t offset = 0; offset < info.size;)
+	{
+		size_t read_size = fs.readFile(entry, offset, block.size(), block.data());
+		if (read_size == 0)
+			break;
+		out_file.write(block.data(), read_size);
+		offset += read_size;
+	}
+	out_file.close();
+
+	file_num++;
+	byte_num += info.size;
+}
+
+void ServerProcess::getRequestPath(const JsonMessage& req, std::string& container_path, std::string& entry) const
+{
+	// without an "entry" the path can address a nested entry directly, e.g. "game.xci/secure/<id>.nca/romfs/x.bin"
+	if (req.hasMember("entry"))
+	{
+		container_path = req.getString("path");
+		entry = req.getString("entry");
+	}
+	else
+	{
+		ContainerFs::splitPath(req.getString("path"), container_path, entry);
+	}
+}
+
+bool ServerProcess::isRelativeSubPath(const std::string& path)
+{
+	if (path.empty() || path[0] == '/' || path[0] == '\\' || path.find(':') != std::string::npos)
+		return false;
+
+	size_t begin = 0;
+	while (begin <= path.size())
+	{
+		size_t end = path.find_first_of("/\\", begin);
+		if (end == std::string::npos)
+			end = path.size();
+		if (path.compare(begin, end - begin, "..") == 0)
+			return false;
+		begin = end + 1;
+	}
+
+	return true;
+}
+
+bool ServerProcess::isPlainEntryName(const std::string& name)
+{
+	return name.empty() == false && name != "." && name != ".." && name.find_first_of("/\\:") == std::string::npos;
+}
+
+void ServerProcess::setEntryMembers(const ContainerFs::sEntry& entry, JsonMessage& msg)
+{
+	msg.setString("name", entry.name);
+	msg.setString("type", entry.is_dir ? "dir" : getFileTypeStr(entry.type));
+	msg.setUInt("size", entry.size);
+	msg.setBool("is_dir", entry.is_dir);
+}
+
+std::string ServerProcess::encodeBase64(const byte_t* data, size_t size)
+{
+	static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	std::string str;
+	str.reserve(((size + 2) / 3) * 4);
+	for (size_t i = 0; i < size; i += 3)
+	{
+		uint32_t block = data[i] << 16;
+		if (i + 1 < size)
+			block |= data[i + 1] << 8;
+		if (i + 2 < size)
+			block |= data[i + 2];
+
+		str += kAlphabet[(block >> 18) & 0x3f];
+		str += kAlphabet[(block >> 12) & 0x3f];
+		str += i + 1 < size ? kAlphabet[(block >> 6) & 0x3f] : '=';
+		str += i + 2 < size ? kAlphabet[block & 0x3f] : '=';
+	}
+	return str;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+#include <string>
+#include <list>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <fnd/types.h>
+#include "UserSettings.h"
+#include "VerifyCache.h"
+#include "ContainerFs.h"
+#include "JsonMessage.h"
+#include "ThreadPool.h"
+
+#include "nstool.h"
+
+// Long running mode answering JSON requests, one object per line, from clients
+// connected to a unix domain socket (or from stdin, answered on stdout).
+// Each connection is read on its own thread, its requests are run on a pool of
+// --jobs workers and answered in the order they were sent.
+// The keyset is loaded once, and recently used containers are kept mounted
+// between requests so repeated queries skip re-parsing headers and hash trees.
+//
+// request:  {"id":1, "op":"read", "path":"game.nsp", "entry":"<id>.nca/romfs/file", "offset":0, "size":16}
+//           ("path" may also hold the whole nested path, see ContainerFs::splitPath())
+// response: {"id":1, "ok":true, "result":{...}} or {"id":1, "ok":false, "error":"..."}
+class ServerProcess
+{
+public:
+	ServerProcess();
+	~ServerProcess();
+
+	void process();
+
+	void setUserSettings(const UserSettings* user_set);
+	// "-" serves stdin/stdout
+	void setSocketPath(const std::string& path);
+	void setJobNum(size_t job_num);
+	void setVerifyCache(VerifyCache* cache);
+	// extract requests write under this directory only, they are refused if it isn't set
+	void setExtractRoot(const std::string& path);
+
+private:
+	const std::string kModuleName = "ServerProcess";
+	const std::string kStdioPath = "-";
+	static const size_t kMaxOpenContainerNum = 16;
+	static const size_t kMaxReadSize = 0x1000000;
+	static const size_t kExtractBlockSize = 0x100000;
+
+	const UserSettings* mUserSettings;
+	std::string mSocketPath;
+	size_t mJobNum;
+	VerifyCache* mVerifyCache;
+	std::string mExtractRoot;
+
+	struct sOpenContainer
+	{
+		std::string path;
+		uint64_t size;
+		uint64_t mtime;
+		std::shared_ptr<ContainerFs> fs;
+	};
+
+	// most recently used first
+	std::list<sOpenContainer> mContainers;
+	std::mutex mContainerLock;
+
+	std::atomic<bool> mStop;
+	int mListenSocket;
+	std::set<int> mClientSockets;
+	std::mutex mClientLock;
+	std::condition_variable mClientDone;
+	// held by requests when a single job runs them inline on the connection threads
+	std::mutex mRequestLock;
+
+	void serveStdio();
+	void serveSocket();
+	void serveClient(int client, ThreadPool* pool);
+	std::string dispatchRequest(const std::string& line, ThreadPool* pool);
+	void stop();
+
+	std::string handleRequest(const std::string& line);
+	std::shared_ptr<ContainerFs> openContainer(const std::string& path);
+
+	void opStat(const JsonMessage& req, JsonMessage& result);
+	void opList(const JsonMessage& req, JsonMessage& result);
+	void opRead(const JsonMessage& req, JsonMessage& result);
+	void opExtract(const JsonMessage& req, JsonMessage& result);
+	void opVerify(const JsonMessage& req, JsonMessage& result);
+
+	void extractEntry(ContainerFs& fs, const std::string& entry, const std::string& out_path, uint64_t& file_num, uint64_t& byte_num);
+	void getRequestPath(const JsonMessage& req, std::string& container_path, std::string& entry) const;
+	static bool isRelativeSubPath(const std::string& path);
+	static bool isPlainEntryName(const std::string& name);
+	static void setEntryMembers(const ContainerFs::sEntry& entry, JsonMessage& msg);
+	static std::string encodeBase64(const byte_t* data, size_t size);
+};
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "ThreadPool.h"
+#include <fnd/types.h>
+
+ThreadPool::ThreadPool(size_t thread_num) :
+	mActiveTaskNum(0),
+	mStop(false)
+{
+	if (thread_num > 1)
+	{
+		for (size_t i = 0; i < thread_num; i++)
+		{
+			mThreads.push_back(std::thread(&ThreadPool::workerMain, this));
+		}
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(mLock);
+		mStop = true;
+	}
+	mTaskReady.notify_all();
+
+	for (size_t i = 0; i < mThreads.size(); i++)
+	{
+		mThreads[i].join();
+	}
+}
+
+void ThreadPool::enqueue(const std::function<void()>& task)
+{
+	if (mThreads.empty())
+	{
+		task();
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mLock);
+		mTasks.push(task);
+	}
+	mTaskReady.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	mTaskDone.wait(lock, [this] { return mTasks.empty() && mActiveTaskNum == 0; });
+
+	if (mError)
+	{
+		std::exception_ptr error = mError;
+		mError = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+size_t ThreadPool::getThreadNum() const
+{
+	return _MAX(mThreads.size(), (size_t)1);
+}
+
+size_t ThreadPool::getDefaultThreadNum()
+{
+	size_t num = std::thread::hardware_concurrency();
+	return num == 0 ? 1 : num;
+}
+
+void ThreadPool::workerMain()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(mLock);
+			mTaskReady.wait(lock, [this] { return mStop || !mTasks.empty(); });
+			if (mStop && mTasks.empty())
+				return;
+
+			task = mTasks.front();
+			mTasks.pop();
+			mActiveTaskNum++;
+		}
+
+		// an exception escaping here would terminate the process, the first one is kept for wait() instead
+		std::exception_ptr error;
+		try {
+			task();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mLock);
+			if (error && !mError)
+				mError = error;
+			mActiveTaskNum--;
+		}
+		mTaskDone.notify_all();
+	}
+}
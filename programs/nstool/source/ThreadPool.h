@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <exception>
+
+class ThreadPool
+{
+public:
+	// a thread_num of 0 or 1 runs every task inline in enqueue()
+	ThreadPool(size_t thread_num);
+	~ThreadPool();
+
+	void enqueue(const std::function<void()>& task);
+	// rethrows the first exception a task threw since the last wait()
+	void wait();
+
+	size_t getThreadNum() const;
+	static size_t getDefaultThreadNum();
+
+private:
+	const std::string kModuleName = "ThreadPool";
+
+	std::vector<std::thread> mThreads;
+	std::queue<std::function<void()>> mTasks;
+	std::mutex mLock;
+	std::condition_variable mTaskReady;
+	std::condition_variable mTaskDone;
+	size_t mActiveTaskNum;
+	bool mStop;
+	std::exception_ptr mError;
+
+	void workerMain();
+};
@@ -0,0 +1,72 @@
+#include "TracingIFile.h"
+
+TracingIFile::TracingIFile(fnd::IFile* file, bool ownIFile, AccessTrace* trace, size_t layer_index) :
+	mOwnIFile(ownIFile),
+	mFile(file),
+	mTrace(trace),
+	mLayerIndex(layer_index),
+	mPos(0)
+{
+
+}
+
+TracingIFile::~TracingIFile()
+{
+	if (mOwnIFile)
+	{
+		delete mFile;
+	}
+}
+
+size_t TracingIFile::size()
+{
+	return mFile->size();
+}
+
+void TracingIFile::seek(size_t offset)
+{
+	mPos = offset;
+}
+
+void TracingIFile::read(byte_t* out, size_t len)
+{
+	read(out, mPos, len);
+}
+
+void TracingIFile::read(byte_t* out, size_t offset, size_t len)
+{
+	mTrace->recordRead(mLayerIndex, offset, len);
+	mFile->read(out, offset, len);
+	mPos = offset + len;
+}
+
+void TracingIFile::write(const byte_t* out, size_t len)
+{
+	write(out, mPos, len);
+}
+
+void TracingIFile::write(const byte_t* out, size_t offset, size_t len)
+{
+	mFile->write(out, offset, len);
+	mPos = offset + len;
+}
+
+void TracingIFile::setAccessHint(AccessHint hint)
+{
+	mFile->setAccessHint(hint);
+}
+
+void TracingIFile::prefetch(size_t offset, size_t len)
+{
+	mFile->prefetch(offset, len);
+}
+
+void TracingIFile::readv(const sReadRange* ranges, size_t num)
+{
+	for (size_t i = 0; i < num; i++)
+		mTrace->recordRead(mLayerIndex, ranges[i].offset, ranges[i].len);
+	mFile->readv(ranges, num);
+
+	if (num > 0)
+		mPos = ranges[num - 1].offset + ranges[num - 1].len;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <fnd/IFile.h>
+#include "AccessTrace.h"
+
+// Records every read of the file it wraps in an access trace, as reads of one layer.
+// It offers no plain file, so zero-copy transfers are read (and recorded) too.
+class TracingIFile : public fnd::IFile
+{
+public:
+	TracingIFile(fnd::IFile* file, bool ownIFile, AccessTrace* trace, size_t layer_index);
+	~TracingIFile();
+
+	size_t size();
+	void seek(size_t offset);
+	void read(byte_t* out, size_t len);
+	void read(byte_t* out, size_t offset, size_t len);
+	void write(const byte_t* out, size_t len);
+	void write(const byte_t* out, size_t offset, size_t len);
+	void setAccessHint(AccessHint hint);
+	void prefetch(size_t offset, size_t len);
+	void readv(const sReadRange* ranges, size_t num);
+private:
+	bool mOwnIFile;
+	fnd::IFile* mFile;
+	AccessTrace* mTrace;
+	size_t mLayerIndex;
+	size_t mPos;
+};
\ No newline at end of file
@@ -5,8 +5,11 @@
 #include <algorithm>
 #include <iostream>
 #include <cstdlib>
+#include <cerrno>
 #include <fnd/io.h>
 #include <fnd/SimpleFile.h>
+#include <fnd/UringFile.h>
+#include <fnd/UncachedFile.h>
 #include <fnd/SimpleTextOutput.h>
 #include <fnd/Vec.h>
 #include <fnd/ResourceFileReader.h>
@@ -22,8 +25,14 @@
 #include <nx/nso.h>
 #include <nx/nro.h>
 #include <nx/aset.h>
-
-UserSettings::UserSettings()
+#include "CatalogueIndex.h"
+#include "BlockIndex.h"
+#include "ReadAheadIFile.h"
+#include "TracingIFile.h"
+
+UserSettings::UserSettings() :
+	mReadTrace(nullptr),
+	mPrefetchTrace(nullptr)
 {}
 
 void UserSettings::parseCmdArgs(int argc, char** argv)
@@ -43,12 +52,76 @@ void UserSettings::showHelp()
 	printf("\n  General Options:\n");
 	printf("      -d, --dev       Use devkit keyset\n");
 	printf("      -k, --keyset    Specify keyset file\n");
-	printf("      -t, --type      Specify input file type [xci, pfs, romfs, nca, npdm, cnmt, nso, nro, nacp, aset]\n");
-	printf("      -y, --verify    Verify file\n");
+	printf("      -t, --type      Specify input file type [xci, pfs, romfs, nca, npdm, cnmt, nso, nro, nacp, aset, index, blockindex, trace]\n");
+	printf("      -y, --verify    Verify file (NCA hash trees are only checked for the data that is read)\n");
+	printf("      --verifyhash    Verify file, also reading every NCA partition in full to check it against its hash tree\n");
+	printf("      --verifycache   Record NCA verify results in a cache file, unchanged NCAs verified OK before are skipped\n");
+	printf("      --force         Verify everything again, ignoring results in the verify cache\n");
+	printf("      --uring         Read input files through io_uring, keeping large reads queued in parallel (Linux, falls back to pread)\n");
+	printf("      --directio      Read input files with direct I/O, bypassing the page cache (falls back to --dropcache)\n");
+	printf("      --dropcache     Drop input file data from the page cache once read\n");
+	printf("      --readahead     Prefetch this many 1 MiB chunks ahead of sequential reads on a background thread\n");
+	printf("      --tracereads    Record the reads made from input files in an access trace file\n");
+	printf("      --prefetch      Prefetch what an access trace file recorded for each input file as it is opened, in offset order\n");
 	printf("\n  Output Options:\n");
 	printf("      --showkeys      Show keys generated\n");
 	printf("      --showlayout    Show layout metadata\n");
 	printf("      -v, --verbose   Verbose output\n");
+	printf("\n  Batch Options:\n");
+	printf("    nstool --batch [--jobs <num>] <dir or wildcard path>\n");
+	printf("    nstool --batchlist [--jobs <num>] <list file>\n");
+	printf("    nstool --batch --index <index file> [--jobs <num>] <dir or wildcard path>\n");
+	printf("    nstool --batch --blockindex <index file> [--jobs <num>] <dir or wildcard path>\n");
+	printf("      --batch         Process every file in a directory (recursively) or matching a wildcard path\n");
+	printf("      --batchlist     Process every file, directory or wildcard path listed in a text file (one per line)\n");
+	printf("      --jobs          Number of files to process concurrently (default is the number of CPU cores)\n");
+	printf("      --index         Record XCI/NSP/NCA files in a catalogue index instead of displaying them (only new or changed files are rescanned)\n");
+	printf("      --blockindex    Record the data block hashes of every hashed NCA partition in a block index, from the hash trees only\n");
+	printf("\n  Server Options:\n");
+	printf("    nstool --server [--jobs <num>] [--serverout <dir>] <socket path or - for stdin/stdout>\n");
+	printf("      --server        Answer JSON requests (one per line) for ping, stat, list, read, extract, verify and shutdown,\n");
+	printf("                      keeping keys and recently opened containers loaded between requests\n");
+	printf("      --serverout     Directory that extract requests write under (\"out\" is a relative path in it), extract is refused without it\n");
+	printf("\n  Nested Container Paths\n");
+	printf("    nstool --cat <container file>/<entry path>\n");
+	printf("    nstool --stat <container file>[/<entry path>]\n");
+	printf("      --cat           Write a file nested in containers to stdout (e.g. game.xci/secure/<id>.nca/romfs/data/x.bin)\n");
+	printf("      --stat          Show the type and size of a nested entry, and the entries of a directory or container\n");
+	printf("                      (NCA partitions are named 0-3, code/data/logo for programs, romfs for the first RomFS)\n");
+	printf("\n  Version Diff\n");
+	printf("    nstool --diff <old nca> <new nca>\n");
+	printf("      --diff          List files changed (M), added (A) or removed (D) between two builds of an NCA,\n");
+	printf("                      comparing hash trees so only differing hash blocks are read (paths may be nested)\n");
+	printf("\n  RomFS Build\n");
+	printf("    nstool --mkromfs <out file> [--order <file>] <dir>\n");
+	printf("      --mkromfs       Build a RomFS image from a directory\n");
+	printf("      --order         Lay out file data hot-first: a list of RomFS paths (one per line), or an access trace\n");
+	printf("                      recorded with --tracereads while reading a RomFS image (files ordered by first read)\n");
+	printf("\n  PartitionFS Build\n");
+	printf("    nstool --mkpfs <out file> [--pfstype <type>] [--hashsize <size>] [--order <file>] <dir or list file>\n");
+	printf("      --mkpfs         Build a PFS0 (NSP) or HFS0 image from the files in a directory (in name order),\n");
+	printf("                      or the files in a list file (one path per line, in list order)\n");
+	printf("      --pfstype       Image type [pfs0|hfs0] (pfs0 is assumed)\n");
+	printf("      --hashsize      HFS0 only, size of the start of each file covered by its hash (default is 0x200)\n");
+	printf("      --order         List of entry names (one per line) to place first, in the order given\n");
+	printf("\n  NCA Build\n");
+	printf("    nstool --mknca <out file> [--ncatype <type>] [--titleid <id>] [--keygen <num>] [--bodykey <key>]\n");
+	printf("                  [--part1 <image> ...] [--jobs <num>] <partition 0 image>\n");
+	printf("      --mknca         Build an NCA from PFS0/RomFS partition images (needs the NCA header key and the\n");
+	printf("                      application key area key; the header is signed if the header private key is set)\n");
+	printf("      --ncatype       Content type [program|meta|control|manual|data|publicdata] (data is assumed)\n");
+	printf("      --titleid       Program id of the NCA\n");
+	printf("      --keygen        Key generation (default is 0)\n");
+	printf("      --bodykey       Body encryption key (a random key is used otherwise)\n");
+	printf("      --part1         Image of \"partition 1\" (likewise --part2, --part3)\n");
+	printf("      --jobs          Number of threads hashing and encrypting (default is the number of CPU cores)\n");
+	printf("\n  Catalogue Index\n");
+	printf("    nstool [--titleid <id>] [--titlever <version>] <index file>\n");
+	printf("      --titleid       Only show titles with this title id\n");
+	printf("      --titlever      Only show titles with this title version\n");
+	printf("\n  Block Index\n");
+	printf("    nstool [-v] <block index file>\n");
+	printf("                      Report the data duplicated across NCA partitions (-v lists every pair and their blocks)\n");
 	printf("\n  XCI (GameCard Image)\n");
 	printf("    nstool [--listfs] [--update <dir> --logo <dir> --normal <dir> --secure <dir>] <.xci file>\n");
 	printf("      --listfs        Print file system in embedded partitions\n");
@@ -60,6 +133,26 @@ void UserSettings::showHelp()
 	printf("    nstool [--listfs] [--fsdir <dir>] <file>\n");
 	printf("      --listfs        Print file system\n");
 	printf("      --fsdir         Extract file system to directory\n");
+	printf("\n  Extraction Filters (apply to every extract option above and below, may be repeated)\n");
+	printf("    nstool [--include <glob>] [--exclude <glob>] [--includere <regex>] [--excludere <regex>] ...\n");
+	printf("      --include       Only extract files whose path matches the glob (* also matches /, e.g. \"*.bfsar\")\n");
+	printf("      --exclude       Don't extract files whose path matches the glob\n");
+	printf("      --includere     Only extract files whose path contains a match of the regex\n");
+	printf("      --excludere     Don't extract files whose path contains a match of the regex\n");
+	printf("                      Paths are relative to the input file, as used by --cat (e.g. secure/<id>.nca/1/x.bin).\n");
+	printf("                      NCA partitions are named by index, and not opened if no path in them can match.\n");
+	printf("\n  Extraction Output (applies to every extract option above and below)\n");
+	printf("    nstool [--incremental] [--casstore <dir>] ...\n");
+	printf("      --incremental   Don't rewrite output files that already hold the same data\n");
+	printf("                      Digests are kept in <dir>.nstool-manifest next to each extract directory.\n");
+	printf("      --casstore      Store file data once in <dir> by SHA-256, and extract hard links to it\n");
+	printf("                      (falls back to reflinks or copies where links aren't possible).\n");
+	printf("\n  NSP, XCI (Embedded NCAs)\n");
+	printf("    nstool [--nested] [--ncadir <dir>] [--jobs <num>] <file>\n");
+	printf("      --nested        Process every NCA in the file system (or XCI partitions) concurrently\n");
+	printf("      --ncadir        Extract partitions of every NCA to <dir>/<nca id>/<partition index> (implies --nested)\n");
+	printf("      --jobs          Number of NCAs to process concurrently (default is the number of CPU cores)\n");
+	printf("      -y, --verify    Also validate every NCA against the size and hash recorded in the CNMT\n");
 	printf("\n  NCA (Nintendo Content Archive)\n");
 	printf("    nstool [--listfs] [--bodykey <key> --titlekey <key>] [--part0 <dir> ...] <.nca file>\n");
 	printf("      --listfs        Print file system in embedded partitions\n");
@@ -103,16 +196,146 @@ bool UserSettings::isVerifyFile() const
 	return mVerifyFile;
 }
 
+bool UserSettings::isVerifyHash() const
+{
+	return mVerifyHash;
+}
+
 CliOutputMode UserSettings::getCliOutputMode() const
 {
 	return mOutputMode;
 }
 
+const sOptional<std::string>& UserSettings::getVerifyCachePath() const
+{
+	return mVerifyCachePath;
+}
+
+bool UserSettings::isForceVerify() const
+{
+	return mForceVerify;
+}
+
+InputReadMode UserSettings::getInputReadMode() const
+{
+	return mInputReadMode;
+}
+
+size_t UserSettings::getReadAheadNum() const
+{
+	return mReadAheadNum;
+}
+
+const sOptional<std::string>& UserSettings::getReadTracePath() const
+{
+	return mReadTracePath;
+}
+
+const sOptional<std::string>& UserSettings::getPrefetchTracePath() const
+{
+	return mPrefetchTracePath;
+}
+
+bool UserSettings::isBatchMode() const
+{
+	return mBatchMode;
+}
+
+bool UserSettings::isBatchFileList() const
+{
+	return mBatchFileList;
+}
+
+bool UserSettings::isServerMode() const
+{
+	return mServerMode;
+}
+
+const sOptional<std::string>& UserSettings::getServerOutPath() const
+{
+	return mServerOutPath;
+}
+
+bool UserSettings::isVfsCat() const
+{
+	return mVfsCat;
+}
+
+bool UserSettings::isVfsStat() const
+{
+	return mVfsStat;
+}
+
+const sOptional<std::string>& UserSettings::getDiffBasePath() const
+{
+	return mDiffBasePath;
+}
+
+const sOptional<std::string>& UserSettings::getMkRomfsPath() const
+{
+	return mMkRomfsPath;
+}
+
+const sOptional<std::string>& UserSettings::getFileOrderPath() const
+{
+	return mFileOrderPath;
+}
+
+const sOptional<std::string>& UserSettings::getMkNcaPath() const
+{
+	return mMkNcaPath;
+}
+
+nx::nca::ContentType UserSettings::getNcaContentType() const
+{
+	return mNcaContentType;
+}
+
+byte_t UserSettings::getNcaKeyGeneration() const
+{
+	return mNcaKeyGeneration;
+}
+
+const sOptional<std::string>& UserSettings::getMkPfsPath() const
+{
+	return mMkPfsPath;
+}
+
+nx::PfsHeader::FsType UserSettings::getPfsType() const
+{
+	return mPfsType;
+}
+
+size_t UserSettings::getHfsHashProtectedSize() const
+{
+	return mHfsHashProtectedSize;
+}
+
+size_t UserSettings::getJobNum() const
+{
+	return mJobNum;
+}
+
+const sOptional<std::string>& UserSettings::getCataloguePath() const
+{
+	return mCataloguePath;
+}
+
+const sOptional<std::string>& UserSettings::getBlockIndexPath() const
+{
+	return mBlockIndexPath;
+}
+
 bool UserSettings::isListFs() const
 {
 	return mListFs;
 }
 
+bool UserSettings::isProcessNca() const
+{
+	return mProcessNca;
+}
+
 bool UserSettings::isListApi() const
 {
 	return mListApi;
@@ -172,6 +395,11 @@ const sOptional<std::string>& UserSettings::getNcaPart3Path() const
 	return mNcaPart3Path;
 }
 
+const sOptional<std::string>& UserSettings::getNcaDirPath() const
+{
+	return mNcaDirPath;
+}
+
 const sOptional<std::string>& UserSettings::getAssetIconPath() const
 {
 	return mAssetIconPath;
@@ -182,6 +410,31 @@ const sOptional<std::string>& UserSettings::getAssetNacpPath() const
 	return mAssetNacpPath;
 }
 
+const PathFilter& UserSettings::getExtractFilter() const
+{
+	return mExtractFilter;
+}
+
+bool UserSettings::isIncrementalExtract() const
+{
+	return mIncrementalExtract;
+}
+
+const sOptional<std::string>& UserSettings::getExtractStorePath() const
+{
+	return mExtractStorePath;
+}
+
+const sOptional<uint64_t>& UserSettings::getQueryTitleId() const
+{
+	return mQueryTitleId;
+}
+
+const sOptional<uint32_t>& UserSettings::getQueryTitleVersion() const
+{
+	return mQueryTitleVersion;
+}
+
 void UserSettings::populateCmdArgs(int argc, char** argv, sCmdArgs& cmd_args)
 {
 	// create vector of args
@@ -225,6 +478,12 @@ void UserSettings::populateCmdArgs(int argc, char** argv, sCmdArgs& cmd_args)
 			cmd_args.verify_file = true;
 		}
 
+		else if (args[i] == "--verifyhash")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			cmd_args.verify_hash = true;
+		}
+
 		else if (args[i] == "--showkeys")
 		{
 			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
@@ -357,6 +616,216 @@ void UserSettings::populateCmdArgs(int argc, char** argv, sCmdArgs& cmd_args)
 			cmd_args.asset_nacp_path = args[i + 1];
 		}
 
+		else if (args[i] == "--include")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.include_glob.push_back(args[i + 1]);
+		}
+
+		else if (args[i] == "--exclude")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.exclude_glob.push_back(args[i + 1]);
+		}
+
+		else if (args[i] == "--includere")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.include_regex.push_back(args[i + 1]);
+		}
+
+		else if (args[i] == "--excludere")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.exclude_regex.push_back(args[i + 1]);
+		}
+
+		else if (args[i] == "--incremental")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			cmd_args.incremental = true;
+		}
+
+		else if (args[i] == "--casstore")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.store_path = args[i + 1];
+		}
+
+		else if (args[i] == "--nested")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			cmd_args.process_nca = true;
+		}
+
+		else if (args[i] == "--ncadir")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.nca_dir_path = args[i + 1];
+		}
+
+		else if (args[i] == "--batch")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			cmd_args.batch_mode = true;
+		}
+
+		else if (args[i] == "--batchlist")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			cmd_args.batch_list = true;
+		}
+
+		else if (args[i] == "--server")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			cmd_args.server_mode = true;
+		}
+
+		else if (args[i] == "--serverout")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.server_out_path = args[i + 1];
+		}
+
+		else if (args[i] == "--cat")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			cmd_args.vfs_cat = true;
+		}
+
+		else if (args[i] == "--stat")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			cmd_args.vfs_stat = true;
+		}
+
+		else if (args[i] == "--diff")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.diff_base_path = args[i + 1];
+		}
+
+		else if (args[i] == "--mkromfs")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.mkromfs_path = args[i + 1];
+		}
+
+		else if (args[i] == "--order")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.file_order_path = args[i + 1];
+		}
+
+		else if (args[i] == "--mknca")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.mknca_path = args[i + 1];
+		}
+
+		else if (args[i] == "--ncatype")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.nca_type = args[i + 1];
+		}
+
+		else if (args[i] == "--keygen")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.nca_keygen = args[i + 1];
+		}
+
+		else if (args[i] == "--mkpfs")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.mkpfs_path = args[i + 1];
+		}
+
+		else if (args[i] == "--pfstype")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.pfs_type = args[i + 1];
+		}
+
+		else if (args[i] == "--hashsize")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.hfs_hash_size = args[i + 1];
+		}
+
+		else if (args[i] == "--jobs")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.job_num = args[i + 1];
+		}
+
+		else if (args[i] == "--verifycache")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.verify_cache_path = args[i + 1];
+		}
+
+		else if (args[i] == "--force")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			cmd_args.force_verify = true;
+		}
+
+		else if (args[i] == "--readahead")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.read_ahead_num = args[i + 1];
+		}
+
+		else if (args[i] == "--tracereads")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.read_trace_path = args[i + 1];
+		}
+
+		else if (args[i] == "--prefetch")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.prefetch_trace_path = args[i + 1];
+		}
+
+		else if (args[i] == "--uring" || args[i] == "--directio" || args[i] == "--dropcache")
+		{
+			if (hasParamter) throw fnd::Exception(kModuleName, args[i] + " does not take a parameter.");
+			if (cmd_args.input_read_mode.isSet) throw fnd::Exception(kModuleName, "Only one of --uring, --directio and --dropcache can be used.");
+			if (args[i] == "--uring")
+				cmd_args.input_read_mode = INPUT_URING;
+			else if (args[i] == "--directio")
+				cmd_args.input_read_mode = INPUT_DIRECT_IO;
+			else
+				cmd_args.input_read_mode = INPUT_DROP_CACHE;
+		}
+
+		else if (args[i] == "--index")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.catalogue_path = args[i + 1];
+		}
+
+		else if (args[i] == "--blockindex")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.block_index_path = args[i + 1];
+		}
+
+		else if (args[i] == "--titleid")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.query_title_id = args[i + 1];
+		}
+
+		else if (args[i] == "--titlever")
+		{
+			if (!hasParamter) throw fnd::Exception(kModuleName, args[i] + " requries a parameter.");
+			cmd_args.query_title_ver = args[i + 1];
+		}
+
 		else
 		{
 			throw fnd::Exception(kModuleName, args[i] + " is not recognised.");
@@ -599,7 +1068,18 @@ void UserSettings::populateUserSettings(sCmdArgs& args)
 	
 	// save arguments
 	mInputPath = *args.input_path;
-	mVerifyFile = args.verify_file.isSet;
+	mVerifyFile = args.verify_file.isSet || args.verify_hash.isSet;
+	mVerifyHash = args.verify_hash.isSet;
+	mVerifyCachePath = args.verify_cache_path;
+	mForceVerify = args.force_verify.isSet;
+	mInputReadMode = args.input_read_mode.isSet ? args.input_read_mode.var : INPUT_BUFFERED;
+	mReadAheadNum = 0;
+	if (args.read_ahead_num.isSet)
+	{
+		mReadAheadNum = parseCountParameter("--readahead", args.read_ahead_num.var, kMaxReadAheadNum);
+	}
+	mReadTracePath = args.read_trace_path;
+	mPrefetchTracePath = args.prefetch_trace_path;
 	mListFs = args.list_fs.isSet;
 	mXciUpdatePath = args.update_path;
 	mXciNormalPath = args.normal_path;
@@ -611,6 +1091,8 @@ void UserSettings::populateUserSettings(sCmdArgs& args)
 	mNcaPart1Path = args.part1_path;
 	mNcaPart2Path = args.part2_path;
 	mNcaPart3Path = args.part3_path;
+	mNcaDirPath = args.nca_dir_path;
+	mProcessNca = args.process_nca.isSet || args.nca_dir_path.isSet;
 
 	// determine the architecture type for NSO/NRO
 	if (args.inst_type.isSet)
@@ -624,6 +1106,33 @@ void UserSettings::populateUserSettings(sCmdArgs& args)
 	mAssetIconPath = args.asset_icon_path;
 	mAssetNacpPath = args.asset_nacp_path;
 
+	// extraction filters
+	for (size_t i = 0; i < args.include_glob.size(); i++)
+		mExtractFilter.addInclude(args.include_glob[i], false);
+	for (size_t i = 0; i < args.exclude_glob.size(); i++)
+		mExtractFilter.addExclude(args.exclude_glob[i], false);
+	for (size_t i = 0; i < args.include_regex.size(); i++)
+		mExtractFilter.addInclude(args.include_regex[i], true);
+	for (size_t i = 0; i < args.exclude_regex.size(); i++)
+		mExtractFilter.addExclude(args.exclude_regex[i], true);
+	mIncrementalExtract = args.incremental.isSet;
+	mExtractStorePath = args.store_path;
+
+	if (args.query_title_id.isSet)
+	{
+		uint64_t title_id;
+		if (parseNumber(args.query_title_id.var, 16, title_id) == false)
+			throw fnd::Exception(kModuleName, "--titleid requires a title ID in hexadecimal.");
+		mQueryTitleId = title_id;
+	}
+	if (args.query_title_ver.isSet)
+	{
+		uint64_t title_ver;
+		if (parseNumber(args.query_title_ver.var, 0, title_ver) == false || title_ver > UINT32_MAX)
+			throw fnd::Exception(kModuleName, "--titlever requires a number less than 2^32.");
+		mQueryTitleVersion = (uint32_t)title_ver;
+	}
+
 	// determine output mode
 	mOutputMode = _BIT(OUTPUT_BASIC);
 	if (args.verbose_output.isSet)
@@ -641,18 +1150,141 @@ void UserSettings::populateUserSettings(sCmdArgs& args)
 		mOutputMode |= _BIT(OUTPUT_LAYOUT);
 	}
 
+	// determine batch mode
+	mBatchMode = args.batch_mode.isSet || args.batch_list.isSet;
+	mBatchFileList = args.batch_list.isSet;
+	mJobNum = 0;
+	if (args.job_num.isSet)
+	{
+		mJobNum = parseCountParameter("--jobs", args.job_num.var, kMaxJobNum);
+	}
+
+	if (mBatchMode)
+	{
+		// a single output location would be overwritten by every file in the batch
+		if (mXciUpdatePath.isSet || mXciNormalPath.isSet || mXciSecurePath.isSet || mXciLogoPath.isSet \
+			|| mFsPath.isSet || mNcaPart0Path.isSet || mNcaPart1Path.isSet || mNcaPart2Path.isSet || mNcaPart3Path.isSet || mNcaDirPath.isSet \
+			|| mAssetIconPath.isSet || mAssetNacpPath.isSet)
+			throw fnd::Exception(kModuleName, "Extraction options are not supported in batch mode.");
+	}
+
+	// determine server mode
+	mServerMode = args.server_mode.isSet;
+	if (mServerMode && mBatchMode)
+		throw fnd::Exception(kModuleName, "--server cannot be combined with batch mode.");
+	mServerOutPath = args.server_out_path;
+	if (mServerOutPath.isSet && mServerMode == false)
+		throw fnd::Exception(kModuleName, "--serverout requires --server.");
+
+	// determine nested container path mode
+	mVfsCat = args.vfs_cat.isSet;
+	mVfsStat = args.vfs_stat.isSet;
+	if (mVfsCat && mVfsStat)
+		throw fnd::Exception(kModuleName, "--cat and --stat cannot be combined.");
+	if ((mVfsCat || mVfsStat) && (mBatchMode || mServerMode))
+		throw fnd::Exception(kModuleName, "--cat and --stat cannot be combined with batch or server mode.");
+
+	// determine version diff mode
+	mDiffBasePath = args.diff_base_path;
+	if (mDiffBasePath.isSet && (mBatchMode || mServerMode || mVfsCat || mVfsStat))
+		throw fnd::Exception(kModuleName, "--diff cannot be combined with batch, server, --cat or --stat modes.");
+
+	// determine build mode
+	mMkRomfsPath = args.mkromfs_path;
+	mFileOrderPath = args.file_order_path;
+	if (mMkRomfsPath.isSet && (mBatchMode || mServerMode || mVfsCat || mVfsStat || mDiffBasePath.isSet))
+		throw fnd::Exception(kModuleName, "--mkromfs cannot be combined with batch, server, --cat, --stat or --diff modes.");
+
+	mMkNcaPath = args.mknca_path;
+	mNcaContentType = nx::nca::TYPE_DATA;
+	mNcaKeyGeneration = 0;
+	if (mMkNcaPath.isSet && (mBatchMode || mServerMode || mVfsCat || mVfsStat || mDiffBasePath.isSet || mMkRomfsPath.isSet))
+		throw fnd::Exception(kModuleName, "--mknca cannot be combined with batch, server, --cat, --stat, --diff or --mkromfs modes.");
+	if (mMkNcaPath.isSet && mNcaPart0Path.isSet)
+		throw fnd::Exception(kModuleName, "--part0 is not supported with --mknca (the input is partition 0).");
+	if ((args.nca_type.isSet || args.nca_keygen.isSet) && mMkNcaPath.isSet == false)
+		throw fnd::Exception(kModuleName, "--ncatype and --keygen are only supported with --mknca.");
+	if (args.nca_type.isSet)
+		mNcaContentType = getNcaContentTypeFromString(*args.nca_type);
+	if (args.nca_keygen.isSet)
+	{
+		uint64_t keygen;
+		if (parseNumber(args.nca_keygen.var, 0, keygen) == false || keygen > 0xff)
+			throw fnd::Exception(kModuleName, "--keygen requires a number less than 256.");
+		mNcaKeyGeneration = (byte_t)keygen;
+	}
+
+	mMkPfsPath = args.mkpfs_path;
+	mPfsType = nx::PfsHeader::TYPE_PFS0;
+	mHfsHashProtectedSize = nx::nca::kSectorSize;
+	if (mMkPfsPath.isSet && (mBatchMode || mServerMode || mVfsCat || mVfsStat || mDiffBasePath.isSet || mMkRomfsPath.isSet || mMkNcaPath.isSet))
+		throw fnd::Exception(kModuleName, "--mkpfs cannot be combined with batch, server, --cat, --stat, --diff, --mkromfs or --mknca modes.");
+	if ((args.pfs_type.isSet || args.hfs_hash_size.isSet) && mMkPfsPath.isSet == false)
+		throw fnd::Exception(kModuleName, "--pfstype and --hashsize are only supported with --mkpfs.");
+	if (args.pfs_type.isSet)
+		mPfsType = getPfsTypeFromString(*args.pfs_type);
+	if (args.hfs_hash_size.isSet)
+	{
+		if (mPfsType != nx::PfsHeader::TYPE_HFS0)
+			throw fnd::Exception(kModuleName, "--hashsize is only supported with --pfstype hfs0.");
+		uint64_t hash_size;
+		if (parseNumber(args.hfs_hash_size.var, 0, hash_size) == false || hash_size == 0 || hash_size > UINT32_MAX)
+			throw fnd::Exception(kModuleName, "--hashsize requires a number greater than 0 (and less than 4 GiB).");
+		mHfsHashProtectedSize = (size_t)hash_size;
+	}
+
+	if (mFileOrderPath.isSet && mMkRomfsPath.isSet == false && mMkPfsPath.isSet == false)
+		throw fnd::Exception(kModuleName, "--order is only supported with --mkromfs or --mkpfs.");
+
+	mCataloguePath = args.catalogue_path;
+	if (mCataloguePath.isSet && mBatchMode == false)
+		throw fnd::Exception(kModuleName, "--index is only supported in batch mode.");
+	mBlockIndexPath = args.block_index_path;
+	if (mBlockIndexPath.isSet && mBatchMode == false)
+		throw fnd::Exception(kModuleName, "--blockindex is only supported in batch mode.");
+	if (mBlockIndexPath.isSet && mCataloguePath.isSet)
+		throw fnd::Exception(kModuleName, "--blockindex and --index cannot be combined.");
+
 	// determine input file type
 	if (args.file_type.isSet)
 		mFileType = getFileTypeFromString(*args.file_type);
+	else if (mBatchMode || mServerMode || mVfsCat || mVfsStat || mDiffBasePath.isSet || mMkRomfsPath.isSet || mMkNcaPath.isSet || mMkPfsPath.isSet)
+		mFileType = FILE_INVALID; // determined for each file in the batch or request, or each container in the path (or the input is a directory to build from)
 	else
 		mFileType = determineFileTypeFromFile(mInputPath);
 	
 	// check is the input file could be identified
-	if (mFileType == FILE_INVALID)
+	if (mFileType == FILE_INVALID && ((mBatchMode == false && mServerMode == false && mVfsCat == false && mVfsStat == false && mDiffBasePath.isSet == false && mMkRomfsPath.isSet == false && mMkNcaPath.isSet == false && mMkPfsPath.isSet == false) || args.file_type.isSet))
 		throw fnd::Exception(kModuleName, "Unknown file type.");
 }
 
 
+size_t UserSettings::parseCountParameter(const std::string& name, const std::string& str, size_t max_count)
+{
+	uint64_t count;
+	if (parseNumber(str, 0, count) == false || count == 0 || count > max_count)
+		throw fnd::Exception(kModuleName, name + " requires a number between 1 and " + std::to_string(max_count) + ".");
+
+	return (size_t)count;
+}
+
+bool UserSettings::parseNumber(const std::string& str, int base, uint64_t& value)
+{
+	// strtoul() takes "-1" as ULONG_MAX, so a sign is rejected before parsing
+	size_t begin = str.find_first_not_of(" \t");
+	if (begin == std::string::npos || str[begin] == '-' || str[begin] == '+')
+		return false;
+
+	char* end = nullptr;
+	errno = 0;
+	unsigned long long number = strtoull(str.c_str() + begin, &end, base);
+	if (end == str.c_str() + begin || *end != '\0' || errno == ERANGE)
+		return false;
+
+	value = number;
+	return true;
+}
+
 void UserSettings::decodeHexStringToBytes(const std::string& name, const std::string& str, byte_t* out, size_t out_len)
 {
 	size_t size = str.size();
@@ -697,27 +1329,78 @@ FileType UserSettings::getFileTypeFromString(const std::string& type_str)
 		type = FILE_NACP;
 	else if (str == "aset" || str == "asset")
 		type = FILE_HB_ASSET;
+	else if (str == "index" || str == "catalogue")
+		type = FILE_CATALOGUE;
+	else if (str == "blockindex")
+		type = FILE_BLOCKINDEX;
+	else if (str == "trace")
+		type = FILE_ACCESSTRACE;
 	else
 		type = FILE_INVALID;
 
 	return type;
 }
 
-FileType UserSettings::determineFileTypeFromFile(const std::string& path)
+FileType UserSettings::determineFileTypeFromFile(const std::string& path) const
 {
-	static const size_t kMaxReadSize = 0x4000;
-	FileType file_type = FILE_INVALID;
 	fnd::SimpleFile file;
-	fnd::Vec<byte_t> scratch;
 
 	// open file
 	file.open(path, file.Read);
 
+	return determineFileType(&file);
+}
+
+fnd::IFile* UserSettings::openInputFile(const std::string& path) const
+{
+	fnd::IFile* file;
+	if (mInputReadMode == INPUT_URING)
+		file = new fnd::UringFile(path);
+	else if (mInputReadMode == INPUT_DIRECT_IO)
+		file = new fnd::UncachedFile(path, fnd::UncachedFile::DirectIo);
+	else if (mInputReadMode == INPUT_DROP_CACHE)
+		file = new fnd::UncachedFile(path, fnd::UncachedFile::DropCache);
+	else
+		file = new fnd::SimpleFile(path, fnd::SimpleFile::Read);
+
+	// start loading what the file was read at last time, in offset order
+	size_t layer_index;
+	if (mPrefetchTrace != nullptr && mPrefetchTrace->findLayer(path, layer_index))
+	{
+		fnd::List<AccessTrace::sExtent> plan;
+		mPrefetchTrace->makePrefetchPlan(layer_index, AccessTrace::kDefaultPlanGapSize, plan);
+		for (size_t i = 0; i < plan.size(); i++)
+			file->prefetch(plan[i].offset, plan[i].size);
+	}
+
+	if (mReadAheadNum > 0)
+		file = new ReadAheadIFile(file, OWN_IFILE, mReadAheadNum);
+
+	if (mReadTrace != nullptr)
+		file = new TracingIFile(file, OWN_IFILE, mReadTrace, mReadTrace->addLayer(path));
+
+	return file;
+}
+
+void UserSettings::setReadTrace(AccessTrace* trace)
+{
+	mReadTrace = trace;
+}
+
+void UserSettings::setPrefetchTrace(const AccessTrace* trace)
+{
+	mPrefetchTrace = trace;
+}
+
+FileType UserSettings::determineFileType(fnd::IFile* file) const
+{
+	static const size_t kMaxReadSize = 0x4000;
+	FileType file_type = FILE_INVALID;
+	fnd::Vec<byte_t> scratch;
+
 	// read file
-	scratch.alloc(_MIN(kMaxReadSize, file.size()));
-	file.read(scratch.data(), 0, scratch.size());
-	// close file
-	file.close();
+	scratch.alloc(_MIN(kMaxReadSize, file->size()));
+	file->read(scratch.data(), 0, scratch.size());
 
 	// _TYPE_PTR resolves to a pointer of type 'st' located at scratch.data()
 #define _TYPE_PTR(st) ((st*)(scratch.data()))
@@ -756,6 +1439,15 @@ FileType UserSettings::determineFileTypeFromFile(const std::string& path)
 	// test hb asset
 	else if (_ASSERT_SIZE(sizeof(nx::sAssetHeader)) && _TYPE_PTR(nx::sAssetHeader)->st_magic.get() == nx::aset::kAssetStructMagic)
 		file_type = FILE_HB_ASSET;
+	// test catalogue index
+	else if (_ASSERT_SIZE(sizeof(sCatalogueHeader)) && _TYPE_PTR(sCatalogueHeader)->st_magic.get() == catalogue::kCatalogueStructMagic)
+		file_type = FILE_CATALOGUE;
+	// test block index
+	else if (_ASSERT_SIZE(sizeof(sBlockIndexHeader)) && _TYPE_PTR(sBlockIndexHeader)->st_magic.get() == blockindex::kBlockIndexStructMagic)
+		file_type = FILE_BLOCKINDEX;
+	// test access trace
+	else if (_ASSERT_SIZE(sizeof(sAccessTraceHeader)) && _TYPE_PTR(sAccessTraceHeader)->st_magic.get() == accesstrace::kAccessTraceStructMagic)
+		file_type = FILE_ACCESSTRACE;
 	// else unrecognised
 	else
 		file_type = FILE_INVALID;
@@ -870,3 +1562,44 @@ nx::npdm::InstructionType UserSettings::getInstructionTypeFromString(const std::
 
 	return type;
 }
+
+
+nx::nca::ContentType UserSettings::getNcaContentTypeFromString(const std::string& type_str)
+{
+	std::string str = type_str;
+	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+
+	nx::nca::ContentType type;
+	if (str == "program")
+		type = nx::nca::TYPE_PROGRAM;
+	else if (str == "meta")
+		type = nx::nca::TYPE_META;
+	else if (str == "control")
+		type = nx::nca::TYPE_CONTROL;
+	else if (str == "manual")
+		type = nx::nca::TYPE_MANUAL;
+	else if (str == "data")
+		type = nx::nca::TYPE_DATA;
+	else if (str == "publicdata")
+		type = nx::nca::TYPE_PUBLIC_DATA;
+	else
+		throw fnd::Exception(kModuleName, "Unsupported NCA content type: " + str);
+
+	return type;
+}
+
+nx::PfsHeader::FsType UserSettings::getPfsTypeFromString(const std::string& type_str)
+{
+	std::string str = type_str;
+	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+
+	nx::PfsHeader::FsType type;
+	if (str == "pfs0" || str == "nsp")
+		type = nx::PfsHeader::TYPE_PFS0;
+	else if (str == "hfs0")
+		type = nx::PfsHeader::TYPE_HFS0;
+	else
+		throw fnd::Exception(kModuleName, "Unsupported PartitionFS type: " + str);
+
+	return type;
+}
\ No newline at end of file
@@ -2,8 +2,12 @@
 #include <string>
 #include <fnd/types.h>
 #include <fnd/Vec.h>
+#include <fnd/IFile.h>
 #include <nx/npdm.h>
+#include <nx/PfsHeader.h>
 #include "nstool.h"
+#include "PathFilter.h"
+#include "AccessTrace.h"
 
 class UserSettings
 {
@@ -18,10 +22,46 @@ public:
 	const sKeyset& getKeyset() const;
 	FileType getFileType() const;
 	bool isVerifyFile() const;
+	bool isVerifyHash() const;
 	CliOutputMode getCliOutputMode() const;
+	const sOptional<std::string>& getVerifyCachePath() const;
+	bool isForceVerify() const;
+	InputReadMode getInputReadMode() const;
+	size_t getReadAheadNum() const;
+	const sOptional<std::string>& getReadTracePath() const;
+	const sOptional<std::string>& getPrefetchTracePath() const;
+
+	// batch options
+	bool isBatchMode() const;
+	bool isBatchFileList() const;
+	size_t getJobNum() const;
+	const sOptional<std::string>& getCataloguePath() const;
+	const sOptional<std::string>& getBlockIndexPath() const;
+
+	// server options
+	bool isServerMode() const;
+	const sOptional<std::string>& getServerOutPath() const;
+
+	// nested container path options
+	bool isVfsCat() const;
+	bool isVfsStat() const;
+
+	// version diff options
+	const sOptional<std::string>& getDiffBasePath() const;
+
+	// build options
+	const sOptional<std::string>& getMkRomfsPath() const;
+	const sOptional<std::string>& getFileOrderPath() const;
+	const sOptional<std::string>& getMkNcaPath() const;
+	nx::nca::ContentType getNcaContentType() const;
+	byte_t getNcaKeyGeneration() const;
+	const sOptional<std::string>& getMkPfsPath() const;
+	nx::PfsHeader::FsType getPfsType() const;
+	size_t getHfsHashProtectedSize() const;
 	
 	// specialised toggles
 	bool isListFs() const;
+	bool isProcessNca() const;
 	bool isListApi() const;
 	bool isListSymbols() const;
 	nx::npdm::InstructionType getInstType() const;
@@ -36,11 +76,33 @@ public:
 	const sOptional<std::string>& getNcaPart1Path() const;
 	const sOptional<std::string>& getNcaPart2Path() const;
 	const sOptional<std::string>& getNcaPart3Path() const;
+	const sOptional<std::string>& getNcaDirPath() const;
 	const sOptional<std::string>& getAssetIconPath() const;
 	const sOptional<std::string>& getAssetNacpPath() const;
+	const PathFilter& getExtractFilter() const;
+	bool isIncrementalExtract() const;
+	const sOptional<std::string>& getExtractStorePath() const;
+
+	// catalogue query
+	const sOptional<uint64_t>& getQueryTitleId() const;
+	const sOptional<uint32_t>& getQueryTitleVersion() const;
+
+	// file type detection
+	FileType determineFileTypeFromFile(const std::string& path) const;
+	FileType determineFileType(fnd::IFile* file) const;
+
+	// opens an input file with the reader selected by the options (caller owns it)
+	fnd::IFile* openInputFile(const std::string& path) const;
+	// reads of files opened by openInputFile are recorded in this trace
+	void setReadTrace(AccessTrace* trace);
+	// files opened by openInputFile prefetch what this trace recorded for them
+	void setPrefetchTrace(const AccessTrace* trace);
 
 private:
 	const std::string kModuleName = "UserSettings";
+	// upper bounds for counts given on the command line (threads, 1 MiB read ahead chunks)
+	static const size_t kMaxJobNum = 1024;
+	static const size_t kMaxReadAheadNum = 1024;
 	
 	struct sCmdArgs
 	{
@@ -50,6 +112,13 @@ private:
 		sOptional<std::string> keyset_path;
 		sOptional<std::string> file_type;
 		sOptional<bool> verify_file;
+		sOptional<bool> verify_hash;
+		sOptional<std::string> verify_cache_path;
+		sOptional<bool> force_verify;
+		sOptional<InputReadMode> input_read_mode;
+		sOptional<std::string> read_ahead_num;
+		sOptional<std::string> read_trace_path;
+		sOptional<std::string> prefetch_trace_path;
 		sOptional<bool> show_keys;
 		sOptional<bool> show_layout;
 		sOptional<bool> verbose_output;
@@ -70,15 +139,72 @@ private:
 		sOptional<std::string> inst_type;
 		sOptional<std::string> asset_icon_path;
 		sOptional<std::string> asset_nacp_path;
+		std::vector<std::string> include_glob;
+		std::vector<std::string> exclude_glob;
+		std::vector<std::string> include_regex;
+		std::vector<std::string> exclude_regex;
+		sOptional<bool> incremental;
+		sOptional<std::string> store_path;
+		sOptional<bool> batch_mode;
+		sOptional<bool> batch_list;
+		sOptional<bool> server_mode;
+		sOptional<std::string> server_out_path;
+		sOptional<bool> vfs_cat;
+		sOptional<bool> vfs_stat;
+		sOptional<std::string> diff_base_path;
+		sOptional<std::string> mkromfs_path;
+		sOptional<std::string> file_order_path;
+		sOptional<std::string> mknca_path;
+		sOptional<std::string> nca_type;
+		sOptional<std::string> nca_keygen;
+		sOptional<std::string> mkpfs_path;
+		sOptional<std::string> pfs_type;
+		sOptional<std::string> hfs_hash_size;
+		sOptional<std::string> job_num;
+		sOptional<bool> process_nca;
+		sOptional<std::string> nca_dir_path;
+		sOptional<std::string> catalogue_path;
+		sOptional<std::string> block_index_path;
+		sOptional<std::string> query_title_id;
+		sOptional<std::string> query_title_ver;
 	};
 	
 	std::string mInputPath;
 	FileType mFileType;
 	sKeyset mKeyset;
 	bool mVerifyFile;
+	bool mVerifyHash;
+	sOptional<std::string> mVerifyCachePath;
+	bool mForceVerify;
+	InputReadMode mInputReadMode;
+	size_t mReadAheadNum;
+	sOptional<std::string> mReadTracePath;
+	sOptional<std::string> mPrefetchTracePath;
+	AccessTrace* mReadTrace;
+	const AccessTrace* mPrefetchTrace;
 	CliOutputMode mOutputMode;
 
+	bool mBatchMode;
+	bool mBatchFileList;
+	bool mServerMode;
+	sOptional<std::string> mServerOutPath;
+	bool mVfsCat;
+	bool mVfsStat;
+	sOptional<std::string> mDiffBasePath;
+	sOptional<std::string> mMkRomfsPath;
+	sOptional<std::string> mFileOrderPath;
+	sOptional<std::string> mMkNcaPath;
+	nx::nca::ContentType mNcaContentType;
+	byte_t mNcaKeyGeneration;
+	sOptional<std::string> mMkPfsPath;
+	nx::PfsHeader::FsType mPfsType;
+	size_t mHfsHashProtectedSize;
+	size_t mJobNum;
+	sOptional<std::string> mCataloguePath;
+	sOptional<std::string> mBlockIndexPath;
+
 	bool mListFs;
+	bool mProcessNca;
 	sOptional<std::string> mXciUpdatePath;
 	sOptional<std::string> mXciLogoPath;
 	sOptional<std::string> mXciNormalPath;
@@ -89,9 +215,16 @@ private:
 	sOptional<std::string> mNcaPart1Path;
 	sOptional<std::string> mNcaPart2Path;
 	sOptional<std::string> mNcaPart3Path;
+	sOptional<std::string> mNcaDirPath;
 
 	sOptional<std::string> mAssetIconPath;
 	sOptional<std::string> mAssetNacpPath;
+	PathFilter mExtractFilter;
+	bool mIncrementalExtract;
+	sOptional<std::string> mExtractStorePath;
+
+	sOptional<uint64_t> mQueryTitleId;
+	sOptional<uint32_t> mQueryTitleVersion;
 
 	bool mListApi;
 	bool mListSymbols;
@@ -101,10 +234,14 @@ private:
 	void populateKeyset(sCmdArgs& args);
 	void populateUserSettings(sCmdArgs& args);
 	void decodeHexStringToBytes(const std::string& name, const std::string& str, byte_t* out, size_t out_len);
+	size_t parseCountParameter(const std::string& name, const std::string& str, size_t max_count);
+	// false unless the whole string is an unsigned number (no sign) that fits in 64 bits
+	static bool parseNumber(const std::string& str, int base, uint64_t& value);
 	FileType getFileTypeFromString(const std::string& type_str);
-	FileType determineFileTypeFromFile(const std::string& path);
 	bool determineValidNcaFromSample(const fnd::Vec<byte_t>& sample) const;
 	bool determineValidCnmtFromSample(const fnd::Vec<byte_t>& sample) const;
 	bool determineValidNacpFromSample(const fnd::Vec<byte_t>& sample) const;
 	nx::npdm::InstructionType getInstructionTypeFromString(const std::string& type_str);
+	nx::nca::ContentType getNcaContentTypeFromString(const std::string& type_str);
+	nx::PfsHeader::FsType getPfsTypeFromString(const std::string& type_str);
 };
\ No newline at end of file
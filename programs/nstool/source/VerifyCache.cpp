@@ -0,0 +1,208 @@
+#include "VerifyCache.h"
+#include <cstdio>
+#include <ctime>
+#include <fnd/io.h>
+#include <fnd/SimpleFile.h>
+#include <fnd/Vec.h>
+#include <fnd/StringConv.h>
+#include <nx/NcaHeader.h>
+#include <nx/NcaUtils.h>
+#include "HashTreeMeta.h"
+#ifdef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <sys/stat.h>
+#endif
+
+VerifyCache::VerifyCache() :
+	mForce(false),
+	mModified(false)
+{
+}
+
+void VerifyCache::load(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	mPath = path;
+	mEntries.clear();
+	mModified = false;
+
+	// a missing cache is created on save
+	if (fnd::io::fileExists(path) == false)
+		return;
+
+	fnd::SimpleFile file(path, fnd::SimpleFile::Read);
+	fnd::Vec<byte_t> data;
+	data.alloc(file.size());
+	file.read(data.data(), 0, data.size());
+
+	const sVerifyCacheHeader* hdr = (const sVerifyCacheHeader*)data.data();
+	if (data.size() < sizeof(sVerifyCacheHeader) || hdr->st_magic.get() != verifycache::kVerifyCacheStructMagic)
+	{
+		throw fnd::Exception(kModuleName, "Verify cache corrupt (" + path + ")");
+	}
+
+	// a cache from another version is discarded rather than trusted
+	if (hdr->format_version.get() != verifycache::kFormatVersion || hdr->entry_size.get() != sizeof(sVerifyCacheEntry))
+		return;
+
+	if (sizeof(sVerifyCacheHeader) + (uint64_t)hdr->entry_num.get() * sizeof(sVerifyCacheEntry) > data.size())
+	{
+		throw fnd::Exception(kModuleName, "Verify cache corrupt (" + path + ")");
+	}
+
+	const sVerifyCacheEntry* entry = (const sVerifyCacheEntry*)(data.data() + sizeof(sVerifyCacheHeader));
+	for (size_t i = 0; i < hdr->entry_num.get(); i++)
+	{
+		mEntries[getKeyStr(entry[i])] = entry[i];
+	}
+}
+
+void VerifyCache::save()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (mModified == false || mPath.empty())
+		return;
+
+	fnd::Vec<byte_t> data;
+	data.alloc(sizeof(sVerifyCacheHeader) + mEntries.size() * sizeof(sVerifyCacheEntry));
+
+	sVerifyCacheHeader* hdr = (sVerifyCacheHeader*)data.data();
+	hdr->st_magic = verifycache::kVerifyCacheStructMagic;
+	hdr->format_version = verifycache::kFormatVersion;
+	hdr->entry_num = (uint32_t)mEntries.size();
+	hdr->entry_size = sizeof(sVerifyCacheEntry);
+
+	sVerifyCacheEntry* entry = (sVerifyCacheEntry*)(data.data() + sizeof(sVerifyCacheHeader));
+	for (std::unordered_map<std::string, sVerifyCacheEntry>::const_iterator itr = mEntries.begin(); itr != mEntries.end(); itr++)
+	{
+		*entry++ = itr->second;
+	}
+
+	fnd::io::replaceFile(mPath, data.data(), data.size());
+
+	mModified = false;
+}
+
+void VerifyCache::setForce(bool force)
+{
+	mForce = force;
+}
+
+bool VerifyCache::isForce() const
+{
+	return mForce;
+}
+
+void VerifyCache::getFileIdentity(const std::string& path, sFileIdentity& identity)
+{
+#ifdef _WIN32
+	// there is no stable inode from _wstat64, the mtime has to do
+	std::u16string wpath = fnd::StringConv::ConvertChar8ToChar16(path);
+	struct _stat64 st;
+	if (_wstat64((const wchar_t*)wpath.c_str(), &st) != 0)
+	{
+		throw fnd::Exception("VerifyCache", "Failed to stat file (" + path + ")");
+	}
+	identity.device = st.st_dev;
+	identity.inode = 0;
+	identity.mtime = st.st_mtime;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+	{
+		throw fnd::Exception("VerifyCache", "Failed to stat file (" + path + ")");
+	}
+	identity.device = st.st_dev;
+	identity.inode = st.st_ino;
+	identity.mtime = st.st_mtime;
+#endif
+	identity.offset = 0;
+}
+
+void VerifyCache::generateNcaKey(fnd::IFile* nca, const sKeyset* keyset, const sFileIdentity& identity, verifycache::VerifyKind kind, sVerifyCacheEntry& key)
+{
+	memset(&key, 0, sizeof(sVerifyCacheEntry));
+	key.kind = kind;
+	key.device = identity.device;
+	key.inode = identity.inode;
+	key.mtime = identity.mtime;
+	key.offset = identity.offset;
+	key.size = nca->size();
+
+	nx::sNcaHeaderBlock hdr_block;
+	if (nca->size() < sizeof(nx::sNcaHeaderBlock))
+	{
+		throw fnd::Exception("VerifyCache", "NCA too small to generate key");
+	}
+	nca->read((byte_t*)&hdr_block, 0, sizeof(nx::sNcaHeaderBlock));
+	crypto::sha::Sha256((const byte_t*)&hdr_block, sizeof(nx::sNcaHeaderBlock), key.header_hash);
+
+	// the master hashes of every hashed partition, hashed together
+	nx::NcaUtils::decryptNcaHeader((const byte_t*)&hdr_block, (byte_t*)&hdr_block, keyset->nca.header_key);
+	nx::NcaHeader hdr;
+	hdr.fromBytes((const byte_t*)&hdr_block.header, sizeof(nx::sNcaHeader));
+
+	crypto::sha::Sha256Calculator master_hash;
+	master_hash.initialise();
+	for (size_t i = 0; i < hdr.getPartitions().size(); i++)
+	{
+		const nx::sNcaFsHeader& fs_header = hdr_block.fs_header[hdr.getPartitions()[i].index];
+		HashTreeMeta meta;
+		if (fs_header.hash_type == nx::nca::HASH_HIERARCHICAL_SHA256)
+			meta.importData(fs_header.hash_superblock, nx::nca::kFsHeaderHashSuperblockLen, HashTreeMeta::HASH_TYPE_SHA256);
+		else if (fs_header.hash_type == nx::nca::HASH_HIERARCHICAL_INTERGRITY)
+			meta.importData(fs_header.hash_superblock, nx::nca::kFsHeaderHashSuperblockLen, HashTreeMeta::HASH_TYPE_INTEGRITY);
+		else
+			continue;
+
+		for (size_t j = 0; j < meta.getMasterHashList().size(); j++)
+		{
+			master_hash.update(meta.getMasterHashList()[j].bytes, crypto::sha::kSha256HashLen);
+		}
+	}
+	master_hash.finalise(key.master_hash);
+}
+
+bool VerifyCache::isVerified(const sVerifyCacheEntry& key, uint64_t& verify_time) const
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	if (mForce)
+		return false;
+
+	std::unordered_map<std::string, sVerifyCacheEntry>::const_iterator itr = mEntries.find(getKeyStr(key));
+	if (itr == mEntries.end() || itr->second.result.get() != verifycache::RESULT_OK)
+		return false;
+
+	verify_time = itr->second.verify_time.get();
+	return true;
+}
+
+void VerifyCache::recordResult(const sVerifyCacheEntry& key, bool ok)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	sVerifyCacheEntry entry = key;
+	entry.verify_time = (uint64_t)time(nullptr);
+	entry.result = ok ? verifycache::RESULT_OK : verifycache::RESULT_FAIL;
+
+	mEntries[getKeyStr(entry)] = entry;
+	mModified = true;
+}
+
+std::string VerifyCache::getTimeStr(uint64_t time)
+{
+	time_t t = (time_t)time;
+	char str[0x40] = "";
+	strftime(str, sizeof(str), "%Y-%m-%d %H:%M:%S UTC", gmtime(&t));
+	return str;
+}
+
+std::string VerifyCache::getKeyStr(const sVerifyCacheEntry& key)
+{
+	return std::string((const char*)&key, kKeySize);
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <fnd/types.h>
+#include <fnd/IFile.h>
+#include <crypto/sha.h>
+#include <nx/macro.h>
+
+#include "nstool.h"
+
+namespace verifycache
+{
+	static const uint32_t kVerifyCacheStructMagic = _MAKE_STRUCT_MAGIC_U32("NSVC");
+	static const uint32_t kFormatVersion = 1;
+
+	enum VerifyKind
+	{
+		KIND_NCA, // signatures and hash trees of an NCA
+		KIND_CONTENT, // an NCA checked against the content record of its CNMT
+		KIND_NCA_SIGNATURE // signatures of an NCA only
+	};
+
+	enum VerifyResult
+	{
+		RESULT_FAIL,
+		RESULT_OK
+	};
+}
+
+#pragma pack(push,1)
+struct sVerifyCacheHeader
+{
+	le_uint32_t st_magic;
+	le_uint32_t format_version;
+	le_uint32_t entry_num;
+	le_uint32_t entry_size;
+};
+
+struct sVerifyCacheEntry
+{
+	// key
+	byte_t kind;
+	byte_t reserved_0[7];
+	le_uint64_t device;
+	le_uint64_t inode;
+	le_uint64_t mtime;
+	le_uint64_t offset;
+	le_uint64_t size;
+	byte_t header_hash[crypto::sha::kSha256HashLen];
+	byte_t master_hash[crypto::sha::kSha256HashLen];
+
+	// outcome
+	le_uint64_t verify_time;
+	le_uint32_t result;
+	byte_t reserved_1[4];
+};
+#pragma pack(pop)
+
+// Remembers verification outcomes of NCAs so an unchanged NCA isn't re-read to verify it again.
+// An entry is keyed by the identity of the file holding the NCA (device/inode/mtime), the NCA
+// offset and size within it, the hash of the raw header block and the partition master hashes.
+class VerifyCache
+{
+public:
+	struct sFileIdentity
+	{
+		uint64_t device;
+		uint64_t inode;
+		uint64_t mtime;
+		uint64_t offset;
+
+		sFileIdentity() : device(0), inode(0), mtime(0), offset(0) {}
+	};
+
+	VerifyCache();
+
+	void load(const std::string& path);
+	void save();
+
+	// ignore recorded outcomes (everything is verified again and re-recorded)
+	void setForce(bool force);
+	bool isForce() const;
+
+	static void getFileIdentity(const std::string& path, sFileIdentity& identity);
+	static void generateNcaKey(fnd::IFile* nca, const sKeyset* keyset, const sFileIdentity& identity, verifycache::VerifyKind kind, sVerifyCacheEntry& key);
+
+	// returns true if the key was previously verified OK (and the time it was verified)
+	bool isVerified(const sVerifyCacheEntry& key, uint64_t& verify_time) const;
+	void recordResult(const sVerifyCacheEntry& key, bool ok);
+
+	static std::string getTimeStr(uint64_t time);
+
+private:
+	const std::string kModuleName = "VerifyCache";
+	static const size_t kKeySize = offsetof(sVerifyCacheEntry, verify_time);
+
+	std::string mPath;
+	bool mForce;
+	bool mModified;
+
+	mutable std::mutex mLock;
+	std::unordered_map<std::string, sVerifyCacheEntry> mEntries;
+
+	static std::string getKeyStr(const sVerifyCacheEntry& key);
+};
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "VfsProcess.h"
+#include <cstdio>
+#include <memory>
+#include <fnd/Vec.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+VfsProcess::VfsProcess() :
+	mUserSettings(nullptr),
+	mPath(),
+	mMode(VFS_STAT)
+{
+}
+
+VfsProcess::~VfsProcess()
+{
+}
+
+void VfsProcess::process()
+{
+	if (mUserSettings == nullptr)
+	{
+		throw fnd::Exception(kModuleName, "No user settings set.");
+	}
+
+	std::string container_path;
+	std::string entry;
+	ContainerFs::splitPath(mPath, container_path, entry);
+
+	ContainerFs fs;
+	fs.open(container_path, mUserSettings);
+
+	if (mMode == VFS_CAT)
+		catFile(fs, entry);
+	else
+		displayEntry(fs, entry);
+}
+
+void VfsProcess::setUserSettings(const UserSettings* user_set)
+{
+	mUserSettings = user_set;
+}
+
+void VfsProcess::setPath(const std::string& path)
+{
+	mPath = path;
+}
+
+void VfsProcess::setMode(VfsMode mode)
+{
+	mMode = mode;
+}
+
+void VfsProcess::catFile(ContainerFs& fs, const std::string& entry)
+{
+	std::unique_ptr<fnd::IFile> file(fs.openFile(entry));
+
+#ifdef _WIN32
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	fnd::Vec<byte_t> cache;
+	cache.alloc(_MIN(file->size(), kCacheSize));
+	for (size_t offset = 0; offset < file->size(); offset += cache.size())
+	{
+		size_t len = _MIN(file->size() - offset, cache.size());
+		file->read(cache.data(), offset, len);
+		if (fwrite(cache.data(), 1, len, stdout) != len)
+		{
+			throw fnd::Exception(kModuleName, "Failed to write to stdout");
+		}
+	}
+	fflush(stdout);
+}
+
+void VfsProcess::displayEntry(ContainerFs& fs, const std::string& entry)
+{
+	ContainerFs::sEntry info = fs.getEntry(entry);
+	bool is_container = info.type == FILE_XCI || info.type == FILE_PARTITIONFS || info.type == FILE_NCA || info.type == FILE_ROMFS;
+
+	printf("[Entry]\n");
+	printf("  Path:        %s\n", mPath.c_str());
+	printf("  Type:        %s\n", info.is_dir ? "dir" : getFileTypeStr(info.type).c_str());
+	if (info.is_dir == false)
+		printf("  Size:        0x%" PRIx64 "\n", info.size);
+
+	// the root is always a container, so an empty entry path is listed too
+	if (info.is_dir || is_container || entry.empty())
+	{
+		std::vector<ContainerFs::sEntry> children = fs.listDir(entry);
+		printf("  Entries:\n");
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			if (children[i].is_dir)
+				printf("    %s/\n", children[i].name.c_str());
+			else
+				printf("    %s (%s, size=0x%" PRIx64 ")\n", children[i].name.c_str(), getFileTypeStr(children[i].type).c_str(), children[i].size);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <fnd/types.h>
+#include "UserSettings.h"
+#include "ContainerFs.h"
+
+#include "nstool.h"
+
+// Shows or streams an entry addressed by a path through nested containers,
+// e.g. "game.xci/secure/<id>.nca/romfs/data/x.bin", without extracting each level
+class VfsProcess
+{
+public:
+	enum VfsMode
+	{
+		VFS_CAT,
+		VFS_STAT
+	};
+
+	VfsProcess();
+	~VfsProcess();
+
+	void process();
+
+	void setUserSettings(const UserSettings* user_set);
+	void setPath(const std::string& path);
+	void setMode(VfsMode mode);
+
+private:
+	const std::string kModuleName = "VfsProcess";
+	static const size_t kCacheSize = 0x100000;
+
+	const UserSettings* mUserSettings;
+	std::string mPath;
+	VfsMode mMode;
+
+	void catFile(ContainerFs& fs, const std::string& entry);
+	void displayEntry(ContainerFs& fs, const std::string& entry);
+};
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <vector>
 #include <fnd/SimpleTextOutput.h>
 #include <nx/XciUtils.h>
 #include "OffsetAdjustedIFile.h"
@@ -9,9 +10,16 @@ XciProcess::XciProcess() :
 	mKeyset(nullptr),
 	mCliOutputMode(_BIT(OUTPUT_BASIC)),
 	mVerify(false),
+	mVerifyHash(false),
+	mVerifyPassed(true),
+	mVerifyCache(nullptr),
 	mListFs(false),
+	mProcessNca(false),
+	mNcaExtractPath(),
+	mJobNum(0),
 	mRootPfs(),
-	mExtractInfo()
+	mExtractInfo(),
+	mIncrementalExtract(false)
 {
 }
 
@@ -40,9 +48,10 @@ void XciProcess::process()
 	nx::XciUtils::decryptXciHeader((const byte_t*)&mHdrPage.header, scratch.data(), mKeyset->xci.header_key.key);
 
 	// validate header signature
+	mVerifyPassed = true;
 	if (mVerify)
 	{
-		validateXciSignature();
+		mVerifyPassed = validateXciSignature();
 	}
 
 	// deserialise header
@@ -80,6 +89,17 @@ void XciProcess::setVerifyMode(bool verify)
 	mVerify = verify;
 }
 
+void XciProcess::setVerifyHashMode(bool verify_hash)
+{
+	mVerifyHash = verify_hash;
+}
+
+void XciProcess::setVerifyCache(VerifyCache* cache, const VerifyCache::sFileIdentity& identity)
+{
+	mVerifyCache = cache;
+	mFileIdentity = identity;
+}
+
 void XciProcess::setPartitionForExtract(const std::string& partition_name, const std::string& extract_path)
 {
 	mExtractInfo.addElement({partition_name, extract_path});
@@ -90,6 +110,51 @@ void XciProcess::setListFs(bool list_fs)
 	mListFs = list_fs;
 }
 
+void XciProcess::setExtractFilter(const PathFilter& filter)
+{
+	mExtractFilter = filter;
+}
+
+void XciProcess::setIncrementalExtract(bool incremental)
+{
+	mIncrementalExtract = incremental;
+}
+
+void XciProcess::setExtractStorePath(const std::string& store_path)
+{
+	mExtractStorePath = store_path;
+}
+
+void XciProcess::setNcaProcessMode(bool process_nca)
+{
+	mProcessNca = process_nca;
+}
+
+void XciProcess::setNcaExtractPath(const std::string& path)
+{
+	mNcaExtractPath = path;
+}
+
+void XciProcess::setJobNum(size_t job_num)
+{
+	mJobNum = job_num;
+}
+
+const nx::XciHeader& XciProcess::getXciHeader() const
+{
+	return mHdr;
+}
+
+const nx::PfsHeader& XciProcess::getRootPfsHeader() const
+{
+	return mRootPfs.getPfsHeader();
+}
+
+bool XciProcess::isVerifyPassed() const
+{
+	return mVerifyPassed;
+}
+
 void XciProcess::displayHeader()
 {
 	printf("[XCI Header]\n");
@@ -180,33 +245,53 @@ void XciProcess::displayHeader()
 	}	
 }
 
-bool XciProcess::validateRegionOfFile(size_t offset, size_t len, const byte_t* test_hash)
+bool XciProcess::validateRegion(const byte_t* data, size_t len, const byte_t* test_hash)
 {
-	fnd::Vec<byte_t> scratch;
 	crypto::sha::sSha256Hash calc_hash;
-	scratch.alloc(len);
-	mFile->read(scratch.data(), offset, scratch.size());
-	crypto::sha::Sha256(scratch.data(), scratch.size(), calc_hash.bytes);
+	crypto::sha::Sha256(data, len, calc_hash.bytes);
 	return calc_hash.compare(test_hash);
 }
 
-void XciProcess::validateXciSignature()
+void XciProcess::importPfsHeader(PfsProcess& pfs, const byte_t* data, size_t len)
+{
+	try
+	{
+		nx::PfsHeader hdr;
+		hdr.fromBytes(data, len);
+		pfs.setPfsHeader(hdr);
+	}
+	catch (const fnd::Exception&)
+	{
+		// the PfsProcess reads the header itself, and reports what is wrong with it
+	}
+}
+
+bool XciProcess::validateXciSignature()
 {
 	crypto::sha::sSha256Hash calc_hash;
 	crypto::sha::Sha256((byte_t*)&mHdrPage.header, sizeof(nx::sXciHeader), calc_hash.bytes);
 	if (crypto::rsa::pkcs::rsaVerify(mKeyset->xci.header_sign_key, crypto::sha::HASH_SHA256, calc_hash.bytes, mHdrPage.signature) != 0)
 	{
 		printf("[WARNING] XCI Header Signature: FAIL \n");
+		return false;
 	}
+	return true;
 }
 
 void XciProcess::processRootPfs()
 {
-	if (mVerify && validateRegionOfFile(mHdr.getPartitionFsAddress(), mHdr.getPartitionFsSize(), mHdr.getPartitionFsHash().bytes) == false)
+	// the root header is read once, to check its hash and to import it
+	fnd::Vec<byte_t> root_hdr;
+	root_hdr.alloc(mHdr.getPartitionFsSize());
+	mFile->read(root_hdr.data(), mHdr.getPartitionFsAddress(), root_hdr.size());
+
+	if (mVerify && validateRegion(root_hdr.data(), root_hdr.size(), mHdr.getPartitionFsHash().bytes) == false)
 	{
 		printf("[WARNING] XCI Root HFS0: FAIL (bad hash)\n");
+		mVerifyPassed = false;
 	}
 	mRootPfs.setInputFile(new OffsetAdjustedIFile(mFile, SHARED_IFILE, mHdr.getPartitionFsAddress(), mHdr.getPartitionFsSize()), OWN_IFILE);
+	importPfsHeader(mRootPfs, root_hdr.data(), root_hdr.size());
 	mRootPfs.setListFs(mListFs);
 	mRootPfs.setVerifyMode(false);
 	mRootPfs.setCliOutputMode(mCliOutputMode);
@@ -217,24 +302,54 @@ void XciProcess::processRootPfs()
 void XciProcess::processPartitionPfs()
 {
 	const fnd::List<nx::PfsHeader::sFile>& rootPartitions = mRootPfs.getPfsHeader().getFileList();
+
+	// the partition headers are read together, each is checked and imported from memory
+	std::vector<fnd::Vec<byte_t>> partition_hdrs(rootPartitions.size());
+	std::vector<fnd::IFile::sReadRange> ranges(rootPartitions.size());
+	for (size_t i = 0; i < rootPartitions.size(); i++)
+	{
+		partition_hdrs[i].alloc(rootPartitions[i].hash_protected_size);
+		ranges[i] = { partition_hdrs[i].data(), mHdr.getPartitionFsAddress() + rootPartitions[i].offset, partition_hdrs[i].size() };
+	}
+	mFile->readv(ranges.data(), ranges.size());
+
 	for (size_t i = 0; i < rootPartitions.size(); i++)
 	{
 		// this must be validated here because only the size of the root partiton header is known at verification time
-		if (mVerify && validateRegionOfFile(mHdr.getPartitionFsAddress() + rootPartitions[i].offset, rootPartitions[i].hash_protected_size, rootPartitions[i].hash.bytes) == false)
+		if (mVerify && validateRegion(partition_hdrs[i].data(), partition_hdrs[i].size(), rootPartitions[i].hash.bytes) == false)
 		{
 			printf("[WARNING] XCI %s Partition HFS0: FAIL (bad hash)\n", rootPartitions[i].name.c_str());
+			mVerifyPassed = false;
 		}
 
 		PfsProcess tmp;
 		tmp.setInputFile(new OffsetAdjustedIFile(mFile, SHARED_IFILE, mHdr.getPartitionFsAddress() + rootPartitions[i].offset, rootPartitions[i].size), OWN_IFILE);
 		tmp.setListFs(mListFs);
 		tmp.setVerifyMode(mVerify);
+		tmp.setVerifyHashMode(mVerifyHash);
 		tmp.setCliOutputMode(mCliOutputMode);
 		tmp.setMountPointName(kXciMountPointName + rootPartitions[i].name);
-		if (mExtractInfo.hasElement<std::string>(rootPartitions[i].name))
+		importPfsHeader(tmp, partition_hdrs[i].data(), partition_hdrs[i].size());
+		if (mExtractInfo.hasElement<std::string>(rootPartitions[i].name) && mExtractFilter.mayMatchUnder(rootPartitions[i].name))
 			tmp.setExtractPath(mExtractInfo.getElement<std::string>(rootPartitions[i].name).extract_path);
+		tmp.setExtractFilter(mExtractFilter.getSubFilter(rootPartitions[i].name));
+		tmp.setIncrementalExtract(mIncrementalExtract);
+		tmp.setExtractStorePath(mExtractStorePath);
+		tmp.setKeyset(mKeyset);
+		tmp.setNcaProcessMode(mProcessNca);
+		if (mNcaExtractPath.isSet)
+			tmp.setNcaExtractPath(mNcaExtractPath.var);
+		tmp.setJobNum(mJobNum);
+		if (mVerifyCache != nullptr)
+		{
+			VerifyCache::sFileIdentity identity = mFileIdentity;
+			identity.offset += mHdr.getPartitionFsAddress() + rootPartitions[i].offset;
+			tmp.setVerifyCache(mVerifyCache, identity);
+		}
 	
 		tmp.process();
+		if (tmp.isVerifyPassed() == false)
+			mVerifyPassed = false;
 	}
 }
 
@@ -23,10 +23,26 @@ public:
 	void setKeyset(const sKeyset* keyset);
 	void setCliOutputMode(CliOutputMode type);
 	void setVerifyMode(bool verify);
+	void setVerifyHashMode(bool verify_hash);
+	void setVerifyCache(VerifyCache* cache, const VerifyCache::sFileIdentity& identity);
 
 	// xci specific
 	void setPartitionForExtract(const std::string& partition_name, const std::string& extract_path);
 	void setListFs(bool list_fs);
+	void setExtractFilter(const PathFilter& filter);
+	void setIncrementalExtract(bool incremental);
+	void setExtractStorePath(const std::string& store_path);
+
+	// nested nca processing
+	void setNcaProcessMode(bool process_nca);
+	void setNcaExtractPath(const std::string& path);
+	void setJobNum(size_t job_num);
+
+	// post process() accessors
+	const nx::XciHeader& getXciHeader() const;
+	const nx::PfsHeader& getRootPfsHeader() const;
+	// false if verify mode found a bad signature or hash, in the partitions too
+	bool isVerifyPassed() const;
 
 private:
 	const std::string kModuleName = "XciProcess";
@@ -37,6 +53,10 @@ private:
 	const sKeyset* mKeyset;
 	CliOutputMode mCliOutputMode;
 	bool mVerify;
+	bool mVerifyHash;
+	bool mVerifyPassed;
+	VerifyCache* mVerifyCache;
+	VerifyCache::sFileIdentity mFileIdentity;
 
 	struct sExtractInfo
 	{
@@ -57,14 +77,22 @@ private:
 
 	bool mListFs;
 
+	bool mProcessNca;
+	sOptional<std::string> mNcaExtractPath;
+	size_t mJobNum;
+
 	nx::sXciHeaderPage mHdrPage;
 	nx::XciHeader mHdr;
 	PfsProcess mRootPfs;
 	fnd::List<sExtractInfo> mExtractInfo;
+	PathFilter mExtractFilter;
+	bool mIncrementalExtract;
+	std::string mExtractStorePath;
 
 	void displayHeader();
-	bool validateRegionOfFile(size_t offset, size_t len, const byte_t* test_hash);
-	void validateXciSignature();
+	bool validateRegion(const byte_t* data, size_t len, const byte_t* test_hash);
+	void importPfsHeader(PfsProcess& pfs, const byte_t* data, size_t len);
+	bool validateXciSignature();
 	void processRootPfs();
 	void processPartitionPfs();
 
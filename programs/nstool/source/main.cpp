@@ -1,16 +1,16 @@
 #include <cstdio>
 #include <fnd/SimpleFile.h>
 #include "UserSettings.h"
-#include "XciProcess.h"
-#include "PfsProcess.h"
-#include "RomfsProcess.h"
-#include "NcaProcess.h"
-#include "NpdmProcess.h"
-#include "CnmtProcess.h"
-#include "NsoProcess.h"
-#include "NroProcess.h"
-#include "NacpProcess.h"
-#include "AssetProcess.h"
+#include "FileProcess.h"
+#include "BatchProcess.h"
+#include "ServerProcess.h"
+#include "VfsProcess.h"
+#include "DiffProcess.h"
+#include "RomfsBuildProcess.h"
+#include "NcaBuildProcess.h"
+#include "PfsBuildProcess.h"
+#include "VerifyCache.h"
+#include "AccessTrace.h"
 
 int main(int argc, char** argv)
 {
@@ -18,165 +18,139 @@ int main(int argc, char** argv)
 	try {
 		user_set.parseCmdArgs(argc, argv);
 
-		if (user_set.getFileType() == FILE_XCI)
-		{	
-			XciProcess xci;
-
-			xci.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			
-			xci.setKeyset(&user_set.getKeyset());
-			xci.setCliOutputMode(user_set.getCliOutputMode());
-			xci.setVerifyMode(user_set.isVerifyFile());
-
-			if (user_set.getXciUpdatePath().isSet)
-				xci.setPartitionForExtract(nx::xci::kUpdatePartitionStr, user_set.getXciUpdatePath().var);
-			if (user_set.getXciLogoPath().isSet)
-				xci.setPartitionForExtract(nx::xci::kLogoPartitionStr, user_set.getXciLogoPath().var);
-			if (user_set.getXciNormalPath().isSet)
-				xci.setPartitionForExtract(nx::xci::kNormalPartitionStr, user_set.getXciNormalPath().var);
-			if (user_set.getXciSecurePath().isSet)
-				xci.setPartitionForExtract(nx::xci::kSecurePartitionStr, user_set.getXciSecurePath().var);
-			xci.setListFs(user_set.isListFs());
-
-			xci.process();
-		}
-		else if (user_set.getFileType() == FILE_PARTITIONFS || user_set.getFileType() == FILE_NSP)
+		VerifyCache verify_cache;
+		bool use_verify_cache = (user_set.isVerifyFile() || user_set.isServerMode()) && user_set.getVerifyCachePath().isSet;
+		if (use_verify_cache)
 		{
-			PfsProcess pfs;
-
-			pfs.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			pfs.setCliOutputMode(user_set.getCliOutputMode());
-			pfs.setVerifyMode(user_set.isVerifyFile());
-
-			if (user_set.getFsPath().isSet)
-				pfs.setExtractPath(user_set.getFsPath().var);
-			pfs.setListFs(user_set.isListFs());
-			
-			pfs.process();
+			verify_cache.load(user_set.getVerifyCachePath().var);
+			verify_cache.setForce(user_set.isForceVerify());
 		}
-		else if (user_set.getFileType() == FILE_ROMFS)
+
+		AccessTrace read_trace, prefetch_trace;
+		if (user_set.getReadTracePath().isSet)
+			user_set.setReadTrace(&read_trace);
+		if (user_set.getPrefetchTracePath().isSet)
 		{
-			RomfsProcess romfs;
+			prefetch_trace.load(user_set.getPrefetchTracePath().var);
+			user_set.setPrefetchTrace(&prefetch_trace);
+		}
 
-			romfs.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			romfs.setCliOutputMode(user_set.getCliOutputMode());
-			romfs.setVerifyMode(user_set.isVerifyFile());
+		if (user_set.isServerMode())
+		{
+			ServerProcess server;
 
-			if (user_set.getFsPath().isSet)
-				romfs.setExtractPath(user_set.getFsPath().var);
-			romfs.setListFs(user_set.isListFs());
+			server.setUserSettings(&user_set);
+			server.setSocketPath(user_set.getInputPath());
+			server.setJobNum(user_set.getJobNum());
+			if (user_set.getServerOutPath().isSet)
+				server.setExtractRoot(user_set.getServerOutPath().var);
+			if (use_verify_cache)
+				server.setVerifyCache(&verify_cache);
 
-			romfs.process();
+			server.process();
 		}
-		else if (user_set.getFileType() == FILE_NCA)
+		else if (user_set.isVfsCat() || user_set.isVfsStat())
 		{
-			NcaProcess nca;
+			VfsProcess vfs;
 
-			nca.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			nca.setKeyset(&user_set.getKeyset());
-			nca.setCliOutputMode(user_set.getCliOutputMode());
-			nca.setVerifyMode(user_set.isVerifyFile());
+			vfs.setUserSettings(&user_set);
+			vfs.setPath(user_set.getInputPath());
+			vfs.setMode(user_set.isVfsCat() ? VfsProcess::VFS_CAT : VfsProcess::VFS_STAT);
 
-
-			if (user_set.getNcaPart0Path().isSet)
-				nca.setPartition0ExtractPath(user_set.getNcaPart0Path().var);
-			if (user_set.getNcaPart1Path().isSet)
-				nca.setPartition1ExtractPath(user_set.getNcaPart1Path().var);
-			if (user_set.getNcaPart2Path().isSet)
-				nca.setPartition2ExtractPath(user_set.getNcaPart2Path().var);
-			if (user_set.getNcaPart3Path().isSet)
-				nca.setPartition3ExtractPath(user_set.getNcaPart3Path().var);
-			nca.setListFs(user_set.isListFs());
-
-			nca.process();
+			vfs.process();
 		}
-		else if (user_set.getFileType() == FILE_NPDM)
+		else if (user_set.getDiffBasePath().isSet)
 		{
-			NpdmProcess npdm;
+			DiffProcess diff;
 
-			npdm.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			npdm.setKeyset(&user_set.getKeyset());
-			npdm.setCliOutputMode(user_set.getCliOutputMode());
-			npdm.setVerifyMode(user_set.isVerifyFile());
+			diff.setUserSettings(&user_set);
+			diff.setInputPaths(user_set.getDiffBasePath().var, user_set.getInputPath());
 
-			npdm.process();
+			diff.process();
 		}
-		else if (user_set.getFileType() == FILE_CNMT)
+		else if (user_set.getMkRomfsPath().isSet)
 		{
-			CnmtProcess cnmt;
+			RomfsBuildProcess build;
 
-			cnmt.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			cnmt.setCliOutputMode(user_set.getCliOutputMode());
-			cnmt.setVerifyMode(user_set.isVerifyFile());
+			build.setInputPath(user_set.getInputPath());
+			build.setOutputPath(user_set.getMkRomfsPath().var);
+			if (user_set.getFileOrderPath().isSet)
+				build.setFileOrderPath(user_set.getFileOrderPath().var);
+			build.setCliOutputMode(user_set.getCliOutputMode());
 
-			cnmt.process();
+			build.process();
 		}
-		else if (user_set.getFileType() == FILE_NSO)
+		else if (user_set.getMkNcaPath().isSet)
 		{
-			NsoProcess obj;
-
-			obj.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			obj.setCliOutputMode(user_set.getCliOutputMode());
-			obj.setVerifyMode(user_set.isVerifyFile());
-			
-			obj.setInstructionType(user_set.getInstType());
-			obj.setListApi(user_set.isListApi());
-			obj.setListSymbols(user_set.isListSymbols());
+			NcaBuildProcess build;
 
-			obj.process();
+			build.setOutputPath(user_set.getMkNcaPath().var);
+			build.setKeyset(&user_set.getKeyset());
+			build.setPartitionPath(0, user_set.getInputPath());
+			if (user_set.getNcaPart1Path().isSet)
+				build.setPartitionPath(1, user_set.getNcaPart1Path().var);
+			if (user_set.getNcaPart2Path().isSet)
+				build.setPartitionPath(2, user_set.getNcaPart2Path().var);
+			if (user_set.getNcaPart3Path().isSet)
+				build.setPartitionPath(3, user_set.getNcaPart3Path().var);
+			build.setContentType(user_set.getNcaContentType());
+			if (user_set.getQueryTitleId().isSet)
+				build.setProgramId(user_set.getQueryTitleId().var);
+			build.setKeyGeneration(user_set.getNcaKeyGeneration());
+			build.setThreadNum(user_set.getJobNum());
+			build.setCliOutputMode(user_set.getCliOutputMode());
+
+			build.process();
 		}
-		else if (user_set.getFileType() == FILE_NRO)
+		else if (user_set.getMkPfsPath().isSet)
 		{
-			NroProcess obj;
-
-			obj.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			obj.setCliOutputMode(user_set.getCliOutputMode());
-			obj.setVerifyMode(user_set.isVerifyFile());
-			
-			obj.setInstructionType(user_set.getInstType());
-			obj.setListApi(user_set.isListApi());
-			obj.setListSymbols(user_set.isListSymbols());
-
-			if (user_set.getAssetIconPath().isSet)
-				obj.setAssetIconExtractPath(user_set.getAssetIconPath().var);
-			if (user_set.getAssetNacpPath().isSet)
-				obj.setAssetNacpExtractPath(user_set.getAssetNacpPath().var);
+			PfsBuildProcess build;
 
-			if (user_set.getFsPath().isSet)
-				obj.setAssetRomfsExtractPath(user_set.getFsPath().var);
-			obj.setAssetListFs(user_set.isListFs());
+			build.setInputPath(user_set.getInputPath());
+			build.setOutputPath(user_set.getMkPfsPath().var);
+			build.setFsType(user_set.getPfsType());
+			build.setHashProtectedSize(user_set.getHfsHashProtectedSize());
+			if (user_set.getFileOrderPath().isSet)
+				build.setEntryOrderPath(user_set.getFileOrderPath().var);
+			build.setCliOutputMode(user_set.getCliOutputMode());
 
-			obj.process();
+			build.process();
 		}
-		else if (user_set.getFileType() == FILE_NACP)
+		else if (user_set.isBatchMode())
 		{
-			NacpProcess nacp;
-
-			nacp.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			nacp.setCliOutputMode(user_set.getCliOutputMode());
-			nacp.setVerifyMode(user_set.isVerifyFile());
-
-			nacp.process();
+			BatchProcess batch;
+
+			batch.setUserSettings(&user_set);
+			batch.setInputPath(user_set.getInputPath());
+			batch.setInputIsFileList(user_set.isBatchFileList());
+			batch.setJobNum(user_set.getJobNum());
+			if (use_verify_cache)
+				batch.setVerifyCache(&verify_cache);
+			if (user_set.getCataloguePath().isSet)
+				batch.setCataloguePath(user_set.getCataloguePath().var);
+			if (user_set.getBlockIndexPath().isSet)
+				batch.setBlockIndexPath(user_set.getBlockIndexPath().var);
+
+			batch.process();
 		}
-		else if (user_set.getFileType() == FILE_HB_ASSET)
+		else
 		{
-			AssetProcess obj;
+			FileProcess obj;
 
-			obj.setInputFile(new fnd::SimpleFile(user_set.getInputPath(), fnd::SimpleFile::Read), OWN_IFILE);
-			obj.setCliOutputMode(user_set.getCliOutputMode());
-			obj.setVerifyMode(user_set.isVerifyFile());
-
-			if (user_set.getAssetIconPath().isSet)
-				obj.setIconExtractPath(user_set.getAssetIconPath().var);
-			if (user_set.getAssetNacpPath().isSet)
-				obj.setNacpExtractPath(user_set.getAssetNacpPath().var);
-
-			if (user_set.getFsPath().isSet)
-				obj.setRomfsExtractPath(user_set.getFsPath().var);
-			obj.setListFs(user_set.isListFs());
+			obj.setInputFile(user_set.openInputFile(user_set.getInputPath()), OWN_IFILE);
+			obj.setInputPath(user_set.getInputPath());
+			obj.setFileType(user_set.getFileType());
+			obj.setUserSettings(&user_set);
+			if (use_verify_cache)
+				obj.setVerifyCache(&verify_cache);
 
 			obj.process();
 		}
+
+		if (use_verify_cache)
+			verify_cache.save();
+		if (user_set.getReadTracePath().isSet)
+			read_trace.save(user_set.getReadTracePath().var);
 	}
 	catch (const fnd::Exception& e) {
 		printf("\n\n%s\n", e.what());
@@ -0,0 +1,63 @@
+#include "nstool.h"
+
+std::string getFileTypeStr(FileType type)
+{
+	std::string str;
+
+	switch (type)
+	{
+		case (FILE_XCI):
+			str = "xci";
+			break;
+		case (FILE_NSP):
+			str = "nsp";
+			break;
+		case (FILE_PARTITIONFS):
+			str = "partitionfs";
+			break;
+		case (FILE_ROMFS):
+			str = "romfs";
+			break;
+		case (FILE_NCA):
+			str = "nca";
+			break;
+		case (FILE_NPDM):
+			str = "npdm";
+			break;
+		case (FILE_CNMT):
+			str = "cnmt";
+			break;
+		case (FILE_NSO):
+			str = "nso";
+			break;
+		case (FILE_NRO):
+			str = "nro";
+			break;
+		case (FILE_NACP):
+			str = "nacp";
+			break;
+		case (FILE_HB_ASSET):
+			str = "aset";
+			break;
+		case (FILE_CATALOGUE):
+			str = "index";
+			break;
+		case (FILE_BLOCKINDEX):
+			str = "blockindex";
+			break;
+		case (FILE_ACCESSTRACE):
+			str = "trace";
+			break;
+		default:
+			str = "file";
+			break;
+	}
+
+	return str;
+}
+
+bool isNcaFile(const std::string& name)
+{
+	static const std::string kNcaExtention = ".nca";
+	return name.size() > kNcaExtention.size() && name.compare(name.size() - kNcaExtention.size(), kNcaExtention.size(), kNcaExtention) == 0;
+}
\ No newline at end of file
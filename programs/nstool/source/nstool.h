@@ -28,9 +28,20 @@ enum FileType
 	FILE_NRO,
 	FILE_NACP,
 	FILE_HB_ASSET,
+	FILE_CATALOGUE,
+	FILE_BLOCKINDEX,
+	FILE_ACCESSTRACE,
 	FILE_INVALID = -1,
 };
 
+enum InputReadMode
+{
+	INPUT_BUFFERED,
+	INPUT_URING,
+	INPUT_DIRECT_IO,
+	INPUT_DROP_CACHE
+};
+
 enum CliOutputModeFlag
 {
 	OUTPUT_BASIC,
@@ -92,6 +103,11 @@ struct sKeyset
 	} ticket;
 };
 
+// the name of a file type, as given to --type ("file" for an unknown type)
+std::string getFileTypeStr(FileType type);
+// true for entry names with the .nca extension
+bool isNcaFile(const std::string& name);
+
 inline byte_t charToByte(char chr)
 {
 	if (chr >= 'a' && chr <= 'f')